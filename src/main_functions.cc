@@ -20,6 +20,12 @@ limitations under the License.
 #ifndef OUTPUT_LENGTH
   #define OUTPUT_LENGTH 10
 #endif
+
+// Largest batch of samples the input tensor may hold. INPUT_LENGTH and
+// OUTPUT_LENGTH are the lengths of a single sample.
+#ifndef BATCH_SIZE
+  #define BATCH_SIZE 1
+#endif
 #define OUTPUT_TYPE tkTFLiteFloat32
 
 #ifdef CYCLES
@@ -35,6 +41,9 @@ limitations under the License.
 #include "output_handler.h"
 #include "model_data.h"
 #include "benchmark.h"
+#ifdef MODEL_OP_RESOLVER
+  #include "model_op_resolver.h"
+#endif
 
 #include "tensorflow/lite/micro/kernels/all_ops_resolver.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
@@ -64,7 +73,18 @@ int output_length = 1;
 int input_dim;
 int output_dim;
 
+// Samples in the input tensor. Only read from its first dimension if
+// BATCH_SIZE allows batches and the input is NHWC or [batch, features].
+int batch_size = 1;
+
+// Set once setup() has finished, loop() does nothing before.
+bool setup_done = false;
+
 float output_arr[OUTPUT_LENGTH];
+#ifdef TOP_CLASS_ONLY
+  int top_class = -1;
+  float top_confidence = 0.f;
+#endif
 //int probability_beforedec;
 //int probability_afterdec;
 
@@ -75,7 +95,7 @@ Benchmark benchmark_inference;
 // using optimization levels starting from -O1.
 volatile int uart_status = -1;
 
-float buffer_image[INPUT_LENGTH];
+float buffer_image[BATCH_SIZE * INPUT_LENGTH];
 
 #ifndef ENERGY_MEASUREMENT
   DigitalOut inference_led(LED1);
@@ -154,6 +174,13 @@ inline void gather_model_information()
     TF_LITE_REPORT_ERROR(error_reporter, "%d. input dimension:\n\t%d", i, input->dims->data[i]);
   }
   TF_LITE_REPORT_ERROR(error_reporter, "total input length:\n\t%d", input_length);
+  #if BATCH_SIZE > 1
+  if (input_dim == 4 || input_dim == 2)
+  {
+    batch_size = input->dims->data[0];
+  }
+  #endif
+  TF_LITE_REPORT_ERROR(error_reporter, "batch size:\n\t%d", batch_size);
 
 
   TF_LITE_REPORT_ERROR(error_reporter, "\n\noutput length:\n\t%d", output_length);
@@ -195,8 +222,12 @@ void setup() {
 
   // This pulls in all the operation implementations we need.
   // NOLINTNEXTLINE(runtime-global-variables)
-  // TODO Only pull the operations which are necessary for the given model.
-  static tflite::ops::micro::AllOpsResolver resolver;
+  #ifdef MODEL_OP_RESOLVER
+    // Only the operations of the given model, see model_op_resolver.h.
+    static ModelOpResolver resolver;
+  #else
+    static tflite::ops::micro::AllOpsResolver resolver;
+  #endif
 
   // Build an interpreter to run the model with.
   static tflite::MicroInterpreter static_interpreter(
@@ -219,6 +250,14 @@ void setup() {
 
 
   gather_model_information();
+  if (batch_size > BATCH_SIZE || input_length > batch_size * INPUT_LENGTH)
+  {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Input of %d samples does not fit BATCH_SIZE %d "
+                         "and INPUT_LENGTH %d.",
+                         batch_size, BATCH_SIZE, INPUT_LENGTH);
+    return;
+  }
   #ifndef ENERGY_MEASUREMENT
     inference_led = 0;
     input_led = 0;
@@ -233,6 +272,7 @@ void setup() {
   #ifndef BENCHMARK_LAYERS
     benchmark_inference.init();
   #endif
+  setup_done = true;
 }
 
 
@@ -248,6 +288,10 @@ void read_event(int event) {
 
 // The name of this function is important for Arduino compatibility.
 void loop() {
+    if (!setup_done)
+    {
+        return;
+    }
     #ifndef NO_MANUAL_INPUT
         if(inference_count == 0)
         {   
@@ -259,14 +303,14 @@ void loop() {
 
             // for some reason this target only supports the blocking read function with two arugments
             #ifdef TARGET_STM32F469
-              pc.read((uint8_t*) buffer_image, INPUT_LENGTH * sizeof(float));
+              pc.read((uint8_t*) buffer_image, input_length * sizeof(float));
               #ifndef ENERGY_MEASUREMENT
                 input_led = 0;
               #else 
                 input_gpio = 0;
               #endif
             #else
-              pc.read((uint8_t*) buffer_image, INPUT_LENGTH * sizeof(float), read_event);
+              pc.read((uint8_t*) buffer_image, input_length * sizeof(float), read_event);
 
               while(uart_status != 1)
               {
@@ -283,7 +327,8 @@ void loop() {
       inference_gpio = 1;
     #endif
 
-    // Place our just received image into the buffer
+    // Place our just received images into the buffer, one sample after the
+    // other. Without manual input, every sample is the example input.
     // TODO: Make this dynamic for the input format. At the moment this only works for float32.
    
    for(int i = 0; i < input_length; i++)
@@ -291,7 +336,7 @@ void loop() {
         #ifndef NO_MANUAL_INPUT
             input->data.f[i] = buffer_image[i];
         #else
-            input->data.f[i] = input_example[i];
+            input->data.f[i] = input_example[i % (input_length / batch_size)];
         #endif
 
     }
@@ -305,7 +350,14 @@ void loop() {
   #endif
 
   // Run inference, and report any error
-  TfLiteStatus invoke_status = interpreter->Invoke();
+  #ifdef TOP_CLASS_ONLY
+    // Only the label is needed, so the softmax at the end of the model is
+    // replaced by a search for the largest logit.
+    TfLiteStatus invoke_status =
+        interpreter->InvokeTopK(1, &top_class, &top_confidence);
+  #else
+    TfLiteStatus invoke_status = interpreter->Invoke();
+  #endif
 
   if (invoke_status != kTfLiteOk) {
     TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed.");
@@ -335,17 +387,28 @@ void loop() {
         pc.printf("Duration of inferences in %s\n%lu\n", BENCHMARK_UNIT, benchmark_inference.read());
         benchmark_inference.clear();
       #endif
-      // Read the predicted values from the model's output tensor
+      #ifdef TOP_CLASS_ONLY
+        pc.printf("\tClass %d (%.10f)\n\t%a\n", top_class, top_confidence, top_confidence);
+      #else
+      // Read the predicted values from the model's output tensor, sample by
+      // sample.
+        const int sample_length = output_length / batch_size;
         for(int i = 0; i < output_length; i++)
         {
+          const int sample_index = i % sample_length;
+          if (batch_size > 1 && sample_index == 0)
+          {
+            pc.printf("Sample %d\n", i / sample_length);
+          }
           // TODO: Make this dynamic for the input format. At the moment this only works for float32.
-          output_arr[i] = output->data.f[i];
-          pc.printf("\tClass %d (%.10f)\n\t%a\n", i, output_arr[i], output_arr[i]);
+          output_arr[sample_index] = output->data.f[i];
+          pc.printf("\tClass %d (%.10f)\n\t%a\n", sample_index, output_arr[sample_index], output_arr[sample_index]);
 
           //probability_beforedec = static_cast<int>(output_arr[i] * 100);
           //probability_afterdec = static_cast<int>((output_arr[i] * 100 - probability_beforedec) * 10000);
           //TF_LITE_REPORT_ERROR(error_reporter, "Class %d: %d%.%d%%", i , probability_beforedec, probability_afterdec);
         } 
+      #endif
       pc.printf("_end_report_\n\n");
     #endif //NO_PREDICTIONS
 
@@ -0,0 +1,84 @@
+// Automatically created by tensorflow/lite/micro/tools/generate_op_resolver from:
+//   model.tflite
+// Regenerate it whenever the model changes.
+
+#ifndef MODEL_OP_RESOLVER_H_
+#define MODEL_OP_RESOLVER_H_
+
+#include "tensorflow/lite/micro/compatibility.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_static_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace model_op_resolver {
+
+static_assert(tflite::BuiltinOperator_MAX == 125,
+              "Schema changed, regenerate this file.");
+
+constexpr unsigned int kOpCount = 7;
+constexpr unsigned int kRegistrationCount = 7;
+
+constexpr uint8_t kNone = tflite::kMicroStaticOpNotFound;
+constexpr uint8_t kOpIndex[tflite::BuiltinOperator_MAX + 1] = {
+    kNone,
+    0,  // AVERAGE_POOL_2D
+    kNone,
+    1,  // CONV_2D
+    kNone, kNone,
+    2,  // DEQUANTIZE
+    kNone, kNone,
+    3,  // FULLY_CONNECTED
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone,
+    4,  // RESHAPE
+    kNone, kNone,
+    5,  // SOFTMAX
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    6,  // QUANTIZE
+    kNone, kNone, kNone, kNone, kNone, kNone, kNone, kNone,
+    kNone, kNone, kNone,
+};
+
+constexpr tflite::MicroStaticOpEntry kOps[kOpCount] = {
+    {tflite::BuiltinOperator_AVERAGE_POOL_2D, nullptr, 2, 2,
+     tflite::ops::micro::Register_AVERAGE_POOL_2D},
+    {tflite::BuiltinOperator_CONV_2D, nullptr, 3, 3,
+     tflite::ops::micro::Register_CONV_2D},
+    {tflite::BuiltinOperator_DEQUANTIZE, nullptr, 2, 2,
+     tflite::ops::micro::Register_DEQUANTIZE},
+    {tflite::BuiltinOperator_FULLY_CONNECTED, nullptr, 4, 4,
+     tflite::ops::micro::Register_FULLY_CONNECTED},
+    {tflite::BuiltinOperator_RESHAPE, nullptr, 1, 1,
+     tflite::ops::micro::Register_RESHAPE},
+    {tflite::BuiltinOperator_SOFTMAX, nullptr, 2, 2,
+     tflite::ops::micro::Register_SOFTMAX},
+    {tflite::BuiltinOperator_QUANTIZE, nullptr, 1, 1,
+     tflite::ops::micro::Register_QUANTIZE},
+};
+
+}  // namespace model_op_resolver
+
+class ModelOpResolver
+    : public tflite::MicroStaticOpResolver<
+          model_op_resolver::kOpCount,
+          model_op_resolver::kRegistrationCount> {
+ public:
+  ModelOpResolver()
+      : MicroStaticOpResolver(model_op_resolver::kOpIndex,
+                              model_op_resolver::kOps) {}
+
+ private:
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+#endif  // MODEL_OP_RESOLVER_H_
@@ -156,6 +156,24 @@ inline int32 MultiplyByQuantizedMultiplier(int32 x, int32 quantized_multiplier,
                              right_shift);
 }
 
+// Version for the 64 bit accumulators of kernels with 16 bit activations and
+// 8 bit weights. The multiplier is rounded to 16 bits so that the product
+// fits into 64 bits, which requires x to be within [-(1 << 47), 1 << 47).
+inline int32 MultiplyByQuantizedMultiplier64(std::int64_t x,
+                                             int32 quantized_multiplier,
+                                             int shift) {
+  TFLITE_DCHECK_GE(quantized_multiplier, 0);
+  TFLITE_DCHECK(shift >= -31 && shift < 8);
+  const std::int32_t reduced_multiplier =
+      quantized_multiplier < 0x7FFF0000
+          ? (quantized_multiplier + (1 << 15)) >> 16
+          : 0x7FFF;
+  const int total_shift = 15 - shift;
+  const std::int64_t round = static_cast<std::int64_t>(1)
+                             << (total_shift - 1);
+  return static_cast<int32>((x * reduced_multiplier + round) >> total_shift);
+}
+
 template <typename T>
 int CountLeadingZeros(T integer_input) {
   static_assert(std::is_unsigned<T>::value,
@@ -94,7 +94,7 @@ inline void FullyConnected(
         acc += bias_data[out_c];
       }
       int32_t acc_scaled =
-          MultiplyByQuantizedMultiplier(acc, output_multiplier, output_shift);
+          MultiplyByQuantizedMultiplier64(acc, output_multiplier, output_shift);
       acc_scaled = std::max(acc_scaled, output_activation_min);
       acc_scaled = std::min(acc_scaled, output_activation_max);
       output_data[out_c + output_depth * b] = static_cast<int16_t>(acc_scaled);
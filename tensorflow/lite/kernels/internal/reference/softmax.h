@@ -165,6 +165,120 @@ inline void Softmax(const float* in, const int input_size, const int batch_size,
   }
 }
 
+// Number of entries of the int16 softmax LUTs: 512 segments plus one entry
+// that is only used for the slope of the last segment.
+constexpr int kInt16SoftmaxLUTSize = 513;
+
+// Samples `func` over [min, max] into a Q0.15 table of `num` entries for
+// generic_int16_table_lookup. Each entry is biased by half the interpolation
+// error at the middle of its segment.
+inline void gen_lut(double (*func)(double), double min, double max,
+                    int16_t* table, const int num) {
+  const double step = (max - min) / (num - 1);
+  const double half_step = step / 2.0;
+  for (int i = 0; i < num - 1; i++) {
+    const double sample_val = TfLiteRound(func(min + i * step) * 32768.0);
+    const double midpoint_interp_val =
+        TfLiteRound((func(min + (i + 1) * step) * 32768.0 +
+                     TfLiteRound(func(min + i * step) * 32768.0)) /
+                    2.0);
+    const double midpoint_val =
+        TfLiteRound(func(min + i * step + half_step) * 32768.0);
+    const double midpoint_err = midpoint_interp_val - midpoint_val;
+    const double bias = TfLiteRound(midpoint_err / 2.0);
+    table[i] = static_cast<int16_t>(
+        std::min(std::max(sample_val - bias, -32768.0), 32767.0));
+  }
+  table[num - 1] = static_cast<int16_t>(std::min(
+      std::max(TfLiteRound(func(max) * 32768.0), -32768.0), 32767.0));
+}
+
+// Looks up a function of a Q0.15 `value` in a table from gen_lut, linearly
+// interpolating between its 512 segments.
+inline int16_t generic_int16_table_lookup(int16_t value, const int16_t* lut) {
+  const uint16_t index = static_cast<uint16_t>(256 + (value >> 7));
+  TFLITE_DCHECK(index < 512);
+  const int16_t offset = value & 0x7f;
+
+  // base and slope are Q0.15
+  const int16_t base = lut[index];
+  const int16_t slope = lut[index + 1] - lut[index];
+
+  // Q0.15 * Q0.7 = Q0.22, rounded back to Q0.15.
+  const int32_t delta = (static_cast<int32_t>(slope) * offset + 64) >> 7;
+  return base + delta;
+}
+
+// Quantized softmax with int16 input and output, both symmetric. The output
+// scale is 1 / 32768. exp() and the reciprocal of the sum come from the LUTs
+// in `params`. The exponentials are kept in `output_data` until they are
+// normalized, so no scratch memory is needed.
+inline void SoftmaxInt16(const SoftmaxParams& params,
+                         const RuntimeShape& input_shape,
+                         const int16_t* input_data,
+                         const RuntimeShape& output_shape,
+                         int16_t* output_data) {
+  const int trailing_dim = input_shape.DimensionsCount() - 1;
+  const int outer_size =
+      MatchingFlatSizeSkipDim(input_shape, trailing_dim, output_shape);
+  const int depth =
+      MatchingDim(input_shape, trailing_dim, output_shape, trailing_dim);
+
+  for (int i = 0; i < outer_size; ++i) {
+    const int16_t* input_row = input_data + i * depth;
+    int16_t* output_row = output_data + i * depth;
+    int16_t max_in_row = std::numeric_limits<int16_t>::min();
+    for (int j = 0; j < depth; ++j) {
+      max_in_row = std::max(max_in_row, input_row[j]);
+    }
+
+    // exp(input - max) in Q0.15, summed in Q16.15.
+    int32_t sum_of_exps = 0;
+    for (int j = 0; j < depth; ++j) {
+      const int32_t input_diff = input_row[j] - max_in_row;
+      // Scaled such that [-65535, 0] corresponds to [-10.0, 0.0], then
+      // recentered to [-32768, 32767] for the LUT.
+      const int32_t scaled_diff = MultiplyByQuantizedMultiplier(
+          input_diff, params.input_multiplier, params.input_left_shift);
+      const int32_t sym_scaled_diff = scaled_diff + 32767;
+      const int16_t sat_sym_scaled_diff = static_cast<int16_t>(
+          std::min(std::max(sym_scaled_diff, static_cast<int32_t>(-32768)),
+                   static_cast<int32_t>(32767)));
+      output_row[j] =
+          generic_int16_table_lookup(sat_sym_scaled_diff, params.exp_lut);
+      sum_of_exps += output_row[j];
+    }
+
+    // 1 / sum_of_exps from the 1 / (1 + x) LUT, with x = sum - 1 in [0, 1)
+    // after normalizing the sum, recentered to [-32768, 32767].
+    const int headroom_plus_one =
+        CountLeadingZeros(static_cast<uint32_t>(sum_of_exps));
+    const int32_t shifted_sum =
+        ((static_cast<int64_t>(sum_of_exps) << (headroom_plus_one - 1)) +
+         (1 << 13)) >>
+        14;
+    const int32_t sym_shifted_sum = shifted_sum + (-((1 << 15) + (1 << 16)));
+    const int16_t sat_sym_shifted_sum = static_cast<int16_t>(
+        std::min(std::max(sym_shifted_sum, static_cast<int32_t>(-32768)),
+                 static_cast<int32_t>(32767)));
+    const int16_t reciprocal_scale_Q015 = generic_int16_table_lookup(
+        sat_sym_shifted_sum, params.one_over_one_plus_x_lut);
+
+    // Output range [0, 32767] corresponds to [0.0, 1.0].
+    const int right_shift = 31 - headroom_plus_one;
+    const int64_t round = static_cast<int64_t>(1) << (right_shift - 1);
+    for (int j = 0; j < depth; ++j) {
+      const int32_t result = static_cast<int32_t>(
+          (static_cast<int64_t>(output_row[j]) * reciprocal_scale_Q015 +
+           round) >>
+          right_shift);
+      output_row[j] = static_cast<int16_t>(
+          std::min(std::max(result, static_cast<int32_t>(0)),
+                   static_cast<int32_t>(32767)));
+    }
+  }
+}
+
 }  // namespace reference_ops
 }  // namespace tflite
 
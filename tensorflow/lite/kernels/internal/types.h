@@ -1024,6 +1024,11 @@ struct SoftmaxParams {
   int32_t zero_point;
   float scale;
   float* table;
+  // int16 LUTs for exp(x), where x uniform distributed between [-10.0 , 0.0],
+  // and 1 / (1 + x), where x uniform distributed between [0.0 , 1.0]. See
+  // reference_ops::SoftmaxInt16.
+  const int16_t* exp_lut;
+  const int16_t* one_over_one_plus_x_lut;
 };
 
 struct SpaceToBatchParams {
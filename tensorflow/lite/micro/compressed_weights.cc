@@ -0,0 +1,78 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/compressed_weights.h"
+
+#include <cstring>
+
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+namespace tflite {
+
+void DecompressTensor(const CompressedTensor& tensor, size_t element_size,
+                      size_t start, size_t count, uint8_t* output) {
+  if (tensor.palette == nullptr) {
+    // Int4, sign extended by moving each nibble to the top of a byte.
+    int8_t* values = reinterpret_cast<int8_t*>(output);
+    for (size_t i = start; i < start + count; ++i) {
+      const uint8_t packed = tensor.indices[i / 2];
+      *values++ = static_cast<int8_t>(i % 2 ? packed & 0xF0 : packed << 4) >> 4;
+    }
+    return;
+  }
+  const int bits = tensor.bits;
+  const int per_byte = 8 / bits;
+  const uint8_t mask = (1 << bits) - 1;
+  const uint8_t* palette = tensor.palette;
+  const size_t end = start + count;
+  size_t i = start;
+  if (element_size == 1) {
+    // Weights of int8 and uint8 models, one whole byte of indices at a time
+    // once `i` is at a byte boundary.
+    for (; i < end && i % per_byte != 0; ++i) {
+      *output++ =
+          palette[(tensor.indices[i / per_byte] >> ((i % per_byte) * bits)) &
+                  mask];
+    }
+    const uint8_t* indices = tensor.indices + i / per_byte;
+    for (; i + per_byte <= end; i += per_byte) {
+      uint8_t packed = *indices++;
+      for (int j = 0; j < per_byte; ++j) {
+        *output++ = palette[packed & mask];
+        packed >>= bits;
+      }
+    }
+  }
+  for (; i < end; ++i) {
+    const int shift = (i % per_byte) * bits;
+    const int index = (tensor.indices[i / per_byte] >> shift) & mask;
+    memcpy(output, palette + index * element_size, element_size);
+    output += element_size;
+  }
+}
+
+bool ClaimCompressedTensor(TfLiteContext* context,
+                           const TfLiteTensor* tensor) {
+  return static_cast<internal::ContextHelper*>(context->impl_)
+      ->ClaimCompressedTensor(tensor);
+}
+
+const CompressedTensor* GetCompressedTensor(TfLiteContext* context,
+                                            const TfLiteTensor* tensor) {
+  return static_cast<internal::ContextHelper*>(context->impl_)
+      ->GetCompressedTensor(tensor);
+}
+
+}  // namespace tflite
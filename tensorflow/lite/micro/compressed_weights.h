@@ -0,0 +1,80 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_COMPRESSED_WEIGHTS_H_
+#define TENSORFLOW_LITE_MICRO_COMPRESSED_WEIGHTS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+
+namespace tflite {
+
+// Constant tensors, typically the weights of a clustered model, can be stored
+// as indices into a small palette of values, which takes 1, 2, 4 or 8 bits
+// per element in flash instead of one or more bytes.
+//
+// The model lists these tensors in a metadata entry named
+// kCompressedWeightsMetadata. Its buffer holds little endian uint32 words:
+//   kCompressedWeightsVersion, number of tensors,
+//   then per tensor: subgraph index, tensor index, palette buffer index, bits.
+// The buffer of the tensor holds one index per element, packed `bits` at a
+// time starting from the least significant bit of each byte. The palette
+// buffer holds up to 2^bits values of the tensor's type.
+//
+// Int8 tensors whose values fit into 4 bits, e.g. from 4 bit quantization
+// aware training, can instead be listed in a kInt4WeightsMetadata entry:
+//   kInt4WeightsVersion, number of tensors,
+//   then per tensor: subgraph index, tensor index.
+// Their buffer holds two values per byte as two's complement nibbles, the
+// first one in the low nibble. Kernels can read them without a palette.
+//
+// MicroAllocator plans compressed tensors in the arena like activations,
+// alive only while an operator reading them runs, and MicroInterpreter
+// expands them right before each such operator. Kernels see an ordinary
+// tensor during Eval, but its data is not available in Prepare. Kernels that
+// can expand a tensor piece by piece claim it instead, so that it never takes
+// its full size in RAM. tools/compress_weights writes such models.
+constexpr char kCompressedWeightsMetadata[] = "TFLM_COMPRESSED_WEIGHTS";
+constexpr uint32_t kCompressedWeightsVersion = 1;
+constexpr char kInt4WeightsMetadata[] = "TFLM_INT4_WEIGHTS";
+constexpr uint32_t kInt4WeightsVersion = 1;
+
+// Packed form of a compressed tensor. Int4 tensors have no palette and 4 bits.
+struct CompressedTensor {
+  const uint8_t* indices;
+  const uint8_t* palette;
+  int bits;
+};
+
+// Expands elements [start, start + count) of `tensor`, each `element_size`
+// bytes, into `output`.
+void DecompressTensor(const CompressedTensor& tensor, size_t element_size,
+                      size_t start, size_t count, uint8_t* output);
+
+// Called in Prepare by kernels that expand a compressed input themselves,
+// e.g. one tile of weights at a time into a scratch buffer. Succeeds if
+// `tensor` is compressed and only read by the node being prepared. The tensor
+// then gets no arena buffer, is not expanded before the node runs and its
+// data.raw stays null.
+bool ClaimCompressedTensor(TfLiteContext* context, const TfLiteTensor* tensor);
+
+// Packed form of `tensor` if it is compressed, claimed or not, or null.
+const CompressedTensor* GetCompressedTensor(TfLiteContext* context,
+                                            const TfLiteTensor* tensor);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_COMPRESSED_WEIGHTS_H_
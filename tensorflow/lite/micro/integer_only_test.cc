@@ -0,0 +1,272 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Runs an int8 model built with TF_LITE_INTEGER_ONLY. When built with
+// TF_LITE_TRAP_SOFT_FLOAT for a target without FPU, every soft-float helper
+// is wrapped and the test checks that Invoke() calls none of them. See
+// tensorflow/lite/micro/testing/test_integer_only.sh, which also passes the
+// matching --wrap linker flags.
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/kernels/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_model_builder.h"
+
+namespace {
+
+int soft_float_calls = 0;
+
+}  // namespace
+
+#if defined(TF_LITE_TRAP_SOFT_FLOAT)
+
+#define TF_LITE_WRAP_SOFT_FLOAT(ret, name, params, args) \
+  extern "C" ret __real_##name params;                  \
+  extern "C" ret __wrap_##name params {                 \
+    ++soft_float_calls;                                 \
+    return __real_##name args;                          \
+  }
+
+#define TF_LITE_WRAP_ARITHMETIC(type, prefix)                                \
+  TF_LITE_WRAP_SOFT_FLOAT(type, __aeabi_##prefix##add, (type a, type b),     \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(type, __aeabi_##prefix##sub, (type a, type b),     \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(type, __aeabi_##prefix##rsub, (type a, type b),    \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(type, __aeabi_##prefix##mul, (type a, type b),     \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(type, __aeabi_##prefix##div, (type a, type b),     \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(int, __aeabi_##prefix##cmpeq, (type a, type b),    \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(int, __aeabi_##prefix##cmplt, (type a, type b),    \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(int, __aeabi_##prefix##cmple, (type a, type b),    \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(int, __aeabi_##prefix##cmpge, (type a, type b),    \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(int, __aeabi_##prefix##cmpgt, (type a, type b),    \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(int, __aeabi_##prefix##cmpun, (type a, type b),    \
+                          (a, b))                                            \
+  TF_LITE_WRAP_SOFT_FLOAT(int, __aeabi_##prefix##2iz, (type a), (a))         \
+  TF_LITE_WRAP_SOFT_FLOAT(unsigned, __aeabi_##prefix##2uiz, (type a), (a))   \
+  TF_LITE_WRAP_SOFT_FLOAT(long long, __aeabi_##prefix##2lz, (type a), (a))   \
+  TF_LITE_WRAP_SOFT_FLOAT(unsigned long long, __aeabi_##prefix##2ulz,        \
+                          (type a), (a))                                     \
+  TF_LITE_WRAP_SOFT_FLOAT(type, __aeabi_i2##prefix, (int a), (a))            \
+  TF_LITE_WRAP_SOFT_FLOAT(type, __aeabi_ui2##prefix, (unsigned a), (a))      \
+  TF_LITE_WRAP_SOFT_FLOAT(type, __aeabi_l2##prefix, (long long a), (a))      \
+  TF_LITE_WRAP_SOFT_FLOAT(type, __aeabi_ul2##prefix, (unsigned long long a), \
+                          (a))
+
+TF_LITE_WRAP_ARITHMETIC(float, f)
+TF_LITE_WRAP_ARITHMETIC(double, d)
+TF_LITE_WRAP_SOFT_FLOAT(double, __aeabi_f2d, (float a), (a))
+TF_LITE_WRAP_SOFT_FLOAT(float, __aeabi_d2f, (double a), (a))
+
+#undef TF_LITE_WRAP_ARITHMETIC
+#undef TF_LITE_WRAP_SOFT_FLOAT
+
+#endif  // defined(TF_LITE_TRAP_SOFT_FLOAT)
+
+namespace tflite {
+namespace testing {
+namespace {
+
+constexpr int kSize = 8;
+constexpr int kInputDepth = 3;
+constexpr int kConvDepth = 4;
+constexpr int kPooledSize = 3;
+constexpr int kClasses = 10;
+constexpr int kFullyConnectedDepth = kPooledSize * kPooledSize * kConvDepth;
+
+constexpr float kInputScale = 0.05f;
+constexpr float kWeightScale = 0.02f;
+constexpr float kActivationScale = 0.1f;
+constexpr float kLogitScale = 0.2f;
+constexpr float kProbabilityScale = 1.0f / 256;
+
+// Weights in [-7, 7], varying along every dimension.
+void FillWeights(int8_t* weights, int count) {
+  for (int i = 0; i < count; ++i) {
+    weights[i] = (i * 7) % 15 - 7;
+  }
+}
+
+// Adds per-channel quantized int8 weights and their int32 bias.
+void AddWeightsAndBias(TestModelBuilder* builder,
+                       std::initializer_list<int32_t> shape, int channels,
+                       int quantized_dimension, float input_scale,
+                       int8_t* weights, int32_t* bias, int* weights_tensor,
+                       int* bias_tensor) {
+  int count = 1;
+  for (int32_t dim : shape) {
+    count *= dim;
+  }
+  FillWeights(weights, count);
+  float weight_scales[kClasses];
+  float bias_scales[kClasses];
+  int64_t zero_points[kClasses];
+  for (int c = 0; c < channels; ++c) {
+    weight_scales[c] = kWeightScale * (c + 1);
+    bias_scales[c] = input_scale * weight_scales[c];
+    zero_points[c] = 0;
+    bias[c] = c * 50 - 100;
+  }
+  *weights_tensor = builder->AddTensor(
+      TensorType_INT8, shape.begin(), shape.size(), weights, count,
+      weight_scales, zero_points, channels, quantized_dimension);
+  const int32_t bias_shape[] = {channels};
+  *bias_tensor = builder->AddTensor(TensorType_INT32, bias_shape, 1, bias,
+                                    channels * sizeof(int32_t), bias_scales,
+                                    zero_points, channels, 0);
+}
+
+}  // namespace
+}  // namespace testing
+}  // namespace tflite
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(Int8ModelInvokesWithoutFloat) {
+  using tflite::testing::kClasses;
+  using tflite::testing::kConvDepth;
+  using tflite::testing::kInputDepth;
+  using tflite::testing::kPooledSize;
+  using tflite::testing::kSize;
+
+  // CONV_2D -> DEPTHWISE_CONV_2D -> AVERAGE_POOL_2D -> FULLY_CONNECTED,
+  // followed by SOFTMAX and LOGISTIC on the logits.
+  tflite::testing::TestModelBuilder builder;
+  flatbuffers::FlatBufferBuilder* fbb = builder.builder();
+  const int conv = builder.AddOperatorCode(tflite::BuiltinOperator_CONV_2D, 3);
+  const int depthwise =
+      builder.AddOperatorCode(tflite::BuiltinOperator_DEPTHWISE_CONV_2D, 3);
+  const int average_pool =
+      builder.AddOperatorCode(tflite::BuiltinOperator_AVERAGE_POOL_2D, 2);
+  const int fully_connected =
+      builder.AddOperatorCode(tflite::BuiltinOperator_FULLY_CONNECTED, 4);
+  const int softmax =
+      builder.AddOperatorCode(tflite::BuiltinOperator_SOFTMAX, 2);
+  const int logistic =
+      builder.AddOperatorCode(tflite::BuiltinOperator_LOGISTIC, 2);
+
+  const int input = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kSize, kSize, kInputDepth},
+      tflite::testing::kInputScale, -1);
+  const int conv_output = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kSize, kSize, kConvDepth},
+      tflite::testing::kActivationScale, -128);
+  const int depthwise_output = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kSize - 2, kSize - 2, kConvDepth},
+      tflite::testing::kActivationScale, 3);
+  const int pooled = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kPooledSize, kPooledSize, kConvDepth},
+      tflite::testing::kActivationScale, 3);
+  const int logits = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kClasses}, tflite::testing::kLogitScale, 0);
+  const int probabilities = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kClasses},
+      tflite::testing::kProbabilityScale, -128);
+  const int sigmoid = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kClasses},
+      tflite::testing::kProbabilityScale, -128);
+
+  int8_t conv_weights[kConvDepth * 3 * 3 * kInputDepth];
+  int32_t conv_bias[kConvDepth];
+  int conv_weights_tensor, conv_bias_tensor;
+  tflite::testing::AddWeightsAndBias(
+      &builder, {kConvDepth, 3, 3, kInputDepth}, kConvDepth, 0,
+      tflite::testing::kInputScale, conv_weights, conv_bias,
+      &conv_weights_tensor, &conv_bias_tensor);
+  int8_t depthwise_weights[3 * 3 * kConvDepth];
+  int32_t depthwise_bias[kConvDepth];
+  int depthwise_weights_tensor, depthwise_bias_tensor;
+  tflite::testing::AddWeightsAndBias(
+      &builder, {1, 3, 3, kConvDepth}, kConvDepth, 3,
+      tflite::testing::kActivationScale, depthwise_weights, depthwise_bias,
+      &depthwise_weights_tensor, &depthwise_bias_tensor);
+  int8_t fully_connected_weights[kClasses *
+                                 tflite::testing::kFullyConnectedDepth];
+  int32_t fully_connected_bias[kClasses];
+  int fully_connected_weights_tensor, fully_connected_bias_tensor;
+  tflite::testing::AddWeightsAndBias(
+      &builder, {kClasses, tflite::testing::kFullyConnectedDepth}, kClasses,
+      0, tflite::testing::kActivationScale, fully_connected_weights,
+      fully_connected_bias, &fully_connected_weights_tensor,
+      &fully_connected_bias_tensor);
+
+  builder.AddOperator(
+      conv, {input, conv_weights_tensor, conv_bias_tensor}, {conv_output},
+      tflite::BuiltinOptions_Conv2DOptions,
+      tflite::CreateConv2DOptions(*fbb, tflite::Padding_SAME, 1, 1,
+                                  tflite::ActivationFunctionType_RELU)
+          .Union());
+  builder.AddOperator(
+      depthwise,
+      {conv_output, depthwise_weights_tensor, depthwise_bias_tensor},
+      {depthwise_output}, tflite::BuiltinOptions_DepthwiseConv2DOptions,
+      tflite::CreateDepthwiseConv2DOptions(*fbb, tflite::Padding_VALID, 1, 1,
+                                           1)
+          .Union());
+  builder.AddOperator(
+      average_pool, {depthwise_output}, {pooled},
+      tflite::BuiltinOptions_Pool2DOptions,
+      tflite::CreatePool2DOptions(*fbb, tflite::Padding_VALID, 2, 2, 2, 2)
+          .Union());
+  builder.AddOperator(
+      fully_connected,
+      {pooled, fully_connected_weights_tensor, fully_connected_bias_tensor},
+      {logits}, tflite::BuiltinOptions_FullyConnectedOptions,
+      tflite::CreateFullyConnectedOptions(*fbb).Union());
+  builder.AddOperator(softmax, {logits}, {probabilities},
+                      tflite::BuiltinOptions_SoftmaxOptions,
+                      tflite::CreateSoftmaxOptions(*fbb, 1.0f).Union());
+  builder.AddOperator(logistic, {logits}, {sigmoid});
+  const tflite::Model* model =
+      builder.BuildModel({input}, {probabilities, sigmoid});
+
+  tflite::ops::micro::AllOpsResolver resolver;
+  constexpr size_t kArenaSize = 16 * 1024;
+  alignas(16) static uint8_t arena[kArenaSize];
+  tflite::MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                                       micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+#if defined(TF_LITE_TRAP_SOFT_FLOAT)
+  // Prepare computes the quantization parameters in float, which shows that
+  // the wrappers are in place.
+  TF_LITE_MICRO_EXPECT_GT(soft_float_calls, 0);
+#endif
+
+  int8_t* input_data = interpreter.input(0)->data.int8;
+  for (int i = 0; i < kSize * kSize * kInputDepth; ++i) {
+    input_data[i] = (i * 37) % 256 - 128;
+  }
+  soft_float_calls = 0;
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+  TF_LITE_MICRO_EXPECT_EQ(0, soft_float_calls);
+
+  // The probabilities are still meaningful, i.e. add up to about 1.
+  int probability_sum = 0;
+  for (int i = 0; i < kClasses; ++i) {
+    probability_sum += interpreter.output(0)->data.int8[i] + 128;
+  }
+  TF_LITE_MICRO_EXPECT_NEAR(256, probability_sum, kClasses);
+}
+
+TF_LITE_MICRO_TESTS_END
@@ -13,6 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
@@ -22,6 +27,10 @@ limitations under the License.
 #include "tensorflow/lite/kernels/op_macros.h"
 #include "tensorflow/lite/micro/micro_utils.h"
 
+#if defined(__ARM_FEATURE_DSP)
+#include "arm_nnfunctions.h"
+#endif
+
 namespace tflite {
 namespace ops {
 namespace micro {
@@ -30,16 +39,138 @@ namespace activations {
 constexpr int kInputTensor = 0;
 constexpr int kOutputTensor = 0;
 
+// Parameters of the quantized RELU and RELU6 kernels, computed in Prepare.
+struct ReluOpData {
+  // Set when input and output share scale and zero point, so Eval only has
+  // to clamp.
+  bool same_quantization;
+  int32_t input_offset;
+  int32_t output_offset;
+  int32_t output_multiplier;
+  int output_shift;
+  // Output codes of 0 and of 6 (RELU6) or the type maximum (RELU).
+  int32_t activation_min;
+  int32_t activation_max;
+};
+
+// Clamps quantized values to [lower, upper]. `output_data` may be the same
+// buffer as `input_data`.
 template <typename Q>
-inline void ReluQuantized(int32_t lower, const RuntimeShape& input_shape,
-                          const Q* input_data, const RuntimeShape& output_shape,
-                          Q* output_data) {
-  const int flat_size = MatchingFlatSize(input_shape, output_shape);
-  for (int i = 0; i < flat_size; ++i) {
-    const Q val = input_data[i];
-    const Q clamped = val < lower ? lower : val;
-    output_data[i] = clamped;
+void ClampQuantized(int32_t lower, int32_t upper, const Q* input_data,
+                    int size, Q* output_data) {
+  int i = 0;
+#if defined(__ARM_FEATURE_DSP)
+  // Four values per word: SSUB8/USUB8 set the GE flag of every lane that is
+  // not below the bound, and SEL picks each lane from the value or the bound.
+  const uint32_t lower_word = 0x01010101u * static_cast<uint8_t>(lower);
+  const uint32_t upper_word = 0x01010101u * static_cast<uint8_t>(upper);
+  for (; i <= size - 4; i += 4) {
+    uint32_t word;
+    std::memcpy(&word, input_data + i, sizeof(word));
+    if (std::numeric_limits<Q>::is_signed) {
+      __SSUB8(word, lower_word);
+      word = __SEL(word, lower_word);
+      __SSUB8(upper_word, word);
+      word = __SEL(word, upper_word);
+    } else {
+      __USUB8(word, lower_word);
+      word = __SEL(word, lower_word);
+      __USUB8(upper_word, word);
+      word = __SEL(word, upper_word);
+    }
+    std::memcpy(output_data + i, &word, sizeof(word));
+  }
+#endif
+  for (; i < size; ++i) {
+    const int32_t val = input_data[i];
+    output_data[i] =
+        static_cast<Q>(val > upper ? upper : val < lower ? lower : val);
+  }
+}
+
+// Used when output and input quantization differ.
+template <typename Q>
+void RequantizeAndClamp(const ReluOpData& data, const Q* input_data, int size,
+                        Q* output_data) {
+  for (int i = 0; i < size; ++i) {
+    const int32_t val =
+        MultiplyByQuantizedMultiplier(data.input_offset + input_data[i],
+                                      data.output_multiplier,
+                                      data.output_shift) +
+        data.output_offset;
+    output_data[i] = static_cast<Q>(
+        std::min(std::max(val, data.activation_min), data.activation_max));
+  }
+}
+
+template <typename Q>
+void ReluQuantized(const ReluOpData& data, const TfLiteTensor* input,
+                   TfLiteTensor* output) {
+  const int flat_size =
+      MatchingFlatSize(GetTensorShape(input), GetTensorShape(output));
+  const Q* input_data = GetTensorData<Q>(input);
+  Q* output_data = GetTensorData<Q>(output);
+  if (!data.same_quantization) {
+    RequantizeAndClamp(data, input_data, flat_size, output_data);
+    return;
+  }
+#if defined(__ARM_FEATURE_DSP)
+  // arm_relu_q7 clamps at a raw 0 in place, which is the RELU of an int8
+  // tensor with zero point 0.
+  if (std::is_same<Q, int8_t>::value && data.activation_min == 0 &&
+      data.activation_max == std::numeric_limits<int8_t>::max()) {
+    if (output_data != input_data) {
+      std::memcpy(output_data, input_data, flat_size);
+    }
+    // Its size argument is only 16 bits wide.
+    constexpr int kMaxChunk = 0x8000;
+    for (int i = 0; i < flat_size; i += kMaxChunk) {
+      arm_relu_q7(reinterpret_cast<q7_t*>(output_data) + i,
+                  std::min(kMaxChunk, flat_size - i));
+    }
+    return;
   }
+#endif
+  ClampQuantized(data.activation_min, data.activation_max, input_data,
+                 flat_size, output_data);
+}
+
+TfLiteStatus CalculateReluOpData(TfLiteContext* context, TfLiteNode* node,
+                                 bool relu6) {
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  TF_LITE_ENSURE_EQ(context, input->type, output->type);
+  if (input->type != kTfLiteInt8 && input->type != kTfLiteUInt8) {
+    return kTfLiteOk;
+  }
+  TF_LITE_ENSURE(context, output->params.scale > 0.f);
+
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(ReluOpData), &raw));
+  ReluOpData* data = static_cast<ReluOpData*>(raw);
+  data->same_quantization =
+      input->params.scale == output->params.scale &&
+      input->params.zero_point == output->params.zero_point;
+  data->input_offset = -input->params.zero_point;
+  data->output_offset = output->params.zero_point;
+  QuantizeMultiplier(static_cast<double>(input->params.scale) /
+                         static_cast<double>(output->params.scale),
+                     &data->output_multiplier, &data->output_shift);
+  data->activation_min = output->params.zero_point;
+  if (input->type == kTfLiteInt8) {
+    data->activation_max =
+        relu6 ? FloatToAsymmetricQuantizedInt8(6.0f, output->params.scale,
+                                               output->params.zero_point)
+              : std::numeric_limits<int8_t>::max();
+  } else {
+    data->activation_max =
+        relu6 ? FloatToAsymmetricQuantizedUInt8(6.0f, output->params.scale,
+                                                output->params.zero_point)
+              : std::numeric_limits<uint8_t>::max();
+  }
+  node->user_data = data;
+  return kTfLiteOk;
 }
 
 inline void ReluFloat(const RuntimeShape& input_shape, const float* input_data,
@@ -65,20 +196,8 @@ inline void Relu6Float(const RuntimeShape& input_shape, const float* input_data,
   }
 }
 
-template <typename Q>
-inline void Relu6Quantized(Q lower, Q upper, const RuntimeShape& input_shape,
-                           const Q* input_data,
-                           const RuntimeShape& output_shape, Q* output_data) {
-  const int flat_size = MatchingFlatSize(input_shape, output_shape);
-  for (int i = 0; i < flat_size; ++i) {
-    const Q val = input_data[i];
-    const Q clamped = val > upper ? upper : val < lower ? lower : val;
-    output_data[i] = clamped;
-  }
-}
-
 TfLiteStatus ReluPrepare(TfLiteContext* context, TfLiteNode* node) {
-  return kTfLiteOk;
+  return CalculateReluOpData(context, node, /*relu6=*/false);
 }
 
 TfLiteStatus ReluEval(TfLiteContext* context, TfLiteNode* node) {
@@ -93,17 +212,13 @@ TfLiteStatus ReluEval(TfLiteContext* context, TfLiteNode* node) {
       return kTfLiteOk;
     }
     case kTfLiteInt8: {
-      ReluQuantized<int8_t>(input->params.zero_point, GetTensorShape(input),
-                            GetTensorData<int8_t>(input),
-                            GetTensorShape(output),
-                            GetTensorData<int8_t>(output));
+      ReluQuantized<int8_t>(*static_cast<const ReluOpData*>(node->user_data),
+                            input, output);
       return kTfLiteOk;
     }
     case kTfLiteUInt8: {
-      ReluQuantized<uint8_t>(input->params.zero_point, GetTensorShape(input),
-                             GetTensorData<uint8_t>(input),
-                             GetTensorShape(output),
-                             GetTensorData<uint8_t>(output));
+      ReluQuantized<uint8_t>(*static_cast<const ReluOpData*>(node->user_data),
+                             input, output);
       return kTfLiteOk;
     }
     default: {
@@ -115,7 +230,7 @@ TfLiteStatus ReluEval(TfLiteContext* context, TfLiteNode* node) {
 }
 
 TfLiteStatus Relu6Prepare(TfLiteContext* context, TfLiteNode* node) {
-  return kTfLiteOk;
+  return CalculateReluOpData(context, node, /*relu6=*/true);
 }
 
 TfLiteStatus Relu6Eval(TfLiteContext* context, TfLiteNode* node) {
@@ -130,21 +245,13 @@ TfLiteStatus Relu6Eval(TfLiteContext* context, TfLiteNode* node) {
       return kTfLiteOk;
     }
     case kTfLiteInt8: {
-      const int8_t six = FloatToAsymmetricQuantizedInt8(
-          6.0f, input->params.scale, input->params.zero_point);
-      const int8_t zero = input->params.zero_point;
-      Relu6Quantized<int8_t>(
-          zero, six, GetTensorShape(input), GetTensorData<int8_t>(input),
-          GetTensorShape(output), GetTensorData<int8_t>(output));
+      ReluQuantized<int8_t>(*static_cast<const ReluOpData*>(node->user_data),
+                            input, output);
       return kTfLiteOk;
     }
     case kTfLiteUInt8: {
-      const uint8_t six = FloatToAsymmetricQuantizedUInt8(
-          6.0f, input->params.scale, input->params.zero_point);
-      const uint8_t zero = input->params.zero_point;
-      Relu6Quantized<uint8_t>(
-          zero, six, GetTensorShape(input), GetTensorData<uint8_t>(input),
-          GetTensorShape(output), GetTensorData<uint8_t>(output));
+      ReluQuantized<uint8_t>(*static_cast<const ReluOpData*>(node->user_data),
+                             input, output);
       return kTfLiteOk;
     }
     default: {
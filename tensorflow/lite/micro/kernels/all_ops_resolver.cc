@@ -22,14 +22,25 @@ namespace micro {
 // AddBuiltin(<operator ID>, <registration>, [min version], [max version])
 AllOpsResolver::AllOpsResolver() {
   AddBuiltin(BuiltinOperator_FULLY_CONNECTED, Register_FULLY_CONNECTED(), 1, 4);
+  // Version 7 is int16 activations with int8 weights, version 8 sparse
+  // weights.
+  AddBuiltin(BuiltinOperator_FULLY_CONNECTED, Register_FULLY_CONNECTED(), 7,
+             8);
   AddBuiltin(BuiltinOperator_MAX_POOL_2D, Register_MAX_POOL_2D());
-  AddBuiltin(BuiltinOperator_SOFTMAX, Register_SOFTMAX(), 1, 2);
-  AddBuiltin(BuiltinOperator_LOGISTIC, Register_LOGISTIC());
+  // Version 3 is int16 input and output.
+  AddBuiltin(BuiltinOperator_SOFTMAX, Register_SOFTMAX(), 1, 3);
+  AddBuiltin(BuiltinOperator_LOGISTIC, Register_LOGISTIC(), 1, 2);
+  AddBuiltin(BuiltinOperator_TANH, Register_TANH(), 1, 2);
+  AddBuiltin(BuiltinOperator_ELU, Register_ELU());
+  AddBuiltin(BuiltinOperator_HARD_SWISH, Register_HARD_SWISH());
   AddBuiltin(BuiltinOperator_SVDF, Register_SVDF(), 1, 3);
-  AddBuiltin(BuiltinOperator_CONV_2D, Register_CONV_2D(), 1, 3);
+  AddBuiltin(BuiltinOperator_CONV_2D, Register_CONV_2D(), 1, 4);
   AddBuiltin(BuiltinOperator_CONCATENATION, Register_CONCATENATION(), 1, 3);
   AddBuiltin(BuiltinOperator_DEPTHWISE_CONV_2D, Register_DEPTHWISE_CONV_2D(), 1,
              3);
+  // Version 5 is int16 activations with int8 weights.
+  AddBuiltin(BuiltinOperator_DEPTHWISE_CONV_2D, Register_DEPTHWISE_CONV_2D(), 5,
+             5);
   AddBuiltin(BuiltinOperator_AVERAGE_POOL_2D, Register_AVERAGE_POOL_2D(), 1, 2);
   AddBuiltin(BuiltinOperator_ABS, Register_ABS());
   AddBuiltin(BuiltinOperator_SIN, Register_SIN());
@@ -39,9 +50,10 @@ AllOpsResolver::AllOpsResolver() {
   AddBuiltin(BuiltinOperator_RSQRT, Register_RSQRT());
   AddBuiltin(BuiltinOperator_SQUARE, Register_SQUARE());
   AddBuiltin(BuiltinOperator_PRELU, Register_PRELU());
+  AddBuiltin(BuiltinOperator_LEAKY_RELU, Register_LEAKY_RELU(), 1, 2);
   AddBuiltin(BuiltinOperator_FLOOR, Register_FLOOR());
-  AddBuiltin(BuiltinOperator_MAXIMUM, Register_MAXIMUM());
-  AddBuiltin(BuiltinOperator_MINIMUM, Register_MINIMUM());
+  AddBuiltin(BuiltinOperator_MAXIMUM, Register_MAXIMUM(), 1, 2);
+  AddBuiltin(BuiltinOperator_MINIMUM, Register_MINIMUM(), 1, 2);
   AddBuiltin(BuiltinOperator_ARG_MAX, Register_ARG_MAX());
   AddBuiltin(BuiltinOperator_ARG_MIN, Register_ARG_MIN());
   AddBuiltin(BuiltinOperator_LOGICAL_OR, Register_LOGICAL_OR());
@@ -63,13 +75,15 @@ AllOpsResolver::AllOpsResolver() {
   AddBuiltin(BuiltinOperator_SPLIT, Register_SPLIT(), 1, 3);
   AddBuiltin(BuiltinOperator_UNPACK, Register_UNPACK(), 1, 2);
   AddBuiltin(BuiltinOperator_NEG, Register_NEG());
-  AddBuiltin(BuiltinOperator_ADD, Register_ADD(), 1, 2);
+  AddBuiltin(BuiltinOperator_ADD, Register_ADD(), 1, 3);
   AddBuiltin(BuiltinOperator_MUL, Register_MUL(), 1, 3);
   AddBuiltin(BuiltinOperator_QUANTIZE, Register_QUANTIZE());
   AddBuiltin(BuiltinOperator_DEQUANTIZE, Register_DEQUANTIZE(), 1, 2);
-  AddBuiltin(BuiltinOperator_RELU, Register_RELU());
-  AddBuiltin(BuiltinOperator_RELU6, Register_RELU6());
-  AddBuiltin(BuiltinOperator_MEAN, Register_MEAN());
+  // Version 2 is int8.
+  AddBuiltin(BuiltinOperator_RELU, Register_RELU(), 1, 2);
+  AddBuiltin(BuiltinOperator_RELU6, Register_RELU6(), 1, 2);
+  AddBuiltin(BuiltinOperator_MEAN, Register_MEAN(), 1, 2);
+  AddBuiltin(BuiltinOperator_SUM, Register_SUM(), 1, 2);
 }
 
 }  // namespace micro
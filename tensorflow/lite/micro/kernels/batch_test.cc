@@ -0,0 +1,285 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/testing/kernel_test_helpers.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_model_builder.h"
+
+// Runs int8 conv, depthwise conv and fully connected on 1 to kMaxBatches
+// samples and compares every output with the reference kernels.
+
+namespace tflite {
+namespace testing {
+namespace {
+
+constexpr int kMaxBatches = 8;
+constexpr float kInputScale = 0.5f;
+constexpr int kInputZeroPoint = -5;
+constexpr float kOutputScale = 1.0f;
+constexpr int kOutputZeroPoint = -2;
+constexpr int kMaxElements = 1024;
+
+// Output size and leading padding of a stride 1 convolution.
+int OutputSize(Padding padding, int input_size, int filter_size) {
+  return padding == Padding_VALID ? input_size - filter_size + 1 : input_size;
+}
+
+int PaddingSize(Padding padding, int filter_size) {
+  return padding == Padding_VALID ? 0 : (filter_size - 1) / 2;
+}
+
+void TestConv(int batches, int filter_size, Padding padding) {
+  constexpr int kHeight = 5;
+  constexpr int kWidth = 4;
+  constexpr int kInputDepth = 3;
+  constexpr int kOutputDepth = 4;
+  const int out_height = OutputSize(padding, kHeight, filter_size);
+  const int out_width = OutputSize(padding, kWidth, filter_size);
+  const int32_t filter_shape[] = {kOutputDepth, filter_size, filter_size,
+                                  kInputDepth};
+  const int weight_count = kOutputDepth * filter_size * filter_size *
+                           kInputDepth;
+  Weights weights;
+  FillWeights(weight_count, kOutputDepth, kInputScale, kOutputScale, &weights);
+
+  TestModelBuilder builder;
+  const int conv = builder.AddOperatorCode(BuiltinOperator_CONV_2D, 3);
+  const int input = builder.AddQuantizedTensor(
+      TensorType_INT8, {batches, kHeight, kWidth, kInputDepth}, kInputScale,
+      kInputZeroPoint);
+  int bias;
+  const int filter = AddWeights(&builder, filter_shape, 4, weight_count,
+                                kOutputDepth, 0, weights, &bias);
+  const int output = builder.AddQuantizedTensor(
+      TensorType_INT8, {batches, out_height, out_width, kOutputDepth},
+      kOutputScale, kOutputZeroPoint);
+  builder.AddOperator(
+      conv, {input, filter, bias}, {output}, BuiltinOptions_Conv2DOptions,
+      CreateConv2DOptions(*builder.builder(), padding, 1, 1).Union());
+
+  const int input_size = batches * kHeight * kWidth * kInputDepth;
+  const int output_size = batches * out_height * out_width * kOutputDepth;
+  TFLITE_DCHECK(input_size <= kMaxElements && output_size <= kMaxElements);
+  int8_t input_data[kMaxElements];
+  for (int i = 0; i < input_size; ++i) {
+    input_data[i] = InputValue(i);
+  }
+  int8_t actual[kMaxElements];
+  RunInt8Model(builder.BuildModel({input}, {output}), BuiltinOperator_CONV_2D,
+               ops::micro::Register_CONV_2D(), 3, input_data, input_size,
+               actual, output_size);
+
+  ConvParams params;
+  params.input_offset = -kInputZeroPoint;
+  params.output_offset = kOutputZeroPoint;
+  params.stride_height = 1;
+  params.stride_width = 1;
+  params.dilation_height_factor = 1;
+  params.dilation_width_factor = 1;
+  params.padding_values.height = PaddingSize(padding, filter_size);
+  params.padding_values.width = PaddingSize(padding, filter_size);
+  params.quantized_activation_min = -128;
+  params.quantized_activation_max = 127;
+  int8_t expected[kMaxElements];
+  reference_integer_ops::ConvPerChannel(
+      params, weights.multipliers, weights.shifts,
+      RuntimeShape({batches, kHeight, kWidth, kInputDepth}), input_data,
+      RuntimeShape({kOutputDepth, filter_size, filter_size, kInputDepth}),
+      weights.filter, RuntimeShape({kOutputDepth}), weights.bias,
+      RuntimeShape({batches, out_height, out_width, kOutputDepth}),
+      expected);
+  ExpectEqual(expected, actual, output_size);
+}
+
+void TestDepthwiseConv(int batches, int depth_multiplier, Padding padding) {
+  constexpr int kHeight = 4;
+  constexpr int kWidth = 5;
+  constexpr int kInputDepth = 3;
+  constexpr int kFilterSize = 3;
+  const int out_height = OutputSize(padding, kHeight, kFilterSize);
+  const int out_width = OutputSize(padding, kWidth, kFilterSize);
+  const int output_depth = kInputDepth * depth_multiplier;
+  const int32_t filter_shape[] = {1, kFilterSize, kFilterSize, output_depth};
+  const int weight_count = kFilterSize * kFilterSize * output_depth;
+  Weights weights;
+  FillWeights(weight_count, output_depth, kInputScale, kOutputScale, &weights);
+
+  TestModelBuilder builder;
+  const int depthwise =
+      builder.AddOperatorCode(BuiltinOperator_DEPTHWISE_CONV_2D, 3);
+  const int input = builder.AddQuantizedTensor(
+      TensorType_INT8, {batches, kHeight, kWidth, kInputDepth}, kInputScale,
+      kInputZeroPoint);
+  int bias;
+  const int filter = AddWeights(&builder, filter_shape, 4, weight_count,
+                                output_depth, 3, weights, &bias);
+  const int output = builder.AddQuantizedTensor(
+      TensorType_INT8, {batches, out_height, out_width, output_depth},
+      kOutputScale, kOutputZeroPoint);
+  builder.AddOperator(depthwise, {input, filter, bias}, {output},
+                      BuiltinOptions_DepthwiseConv2DOptions,
+                      CreateDepthwiseConv2DOptions(*builder.builder(), padding,
+                                                   1, 1, depth_multiplier)
+                          .Union());
+
+  const int input_size = batches * kHeight * kWidth * kInputDepth;
+  const int output_size = batches * out_height * out_width * output_depth;
+  TFLITE_DCHECK(input_size <= kMaxElements && output_size <= kMaxElements);
+  int8_t input_data[kMaxElements];
+  for (int i = 0; i < input_size; ++i) {
+    input_data[i] = InputValue(i);
+  }
+  int8_t actual[kMaxElements];
+  RunInt8Model(builder.BuildModel({input}, {output}),
+               BuiltinOperator_DEPTHWISE_CONV_2D,
+               ops::micro::Register_DEPTHWISE_CONV_2D(), 3, input_data,
+               input_size, actual, output_size);
+
+  DepthwiseParams params;
+  params.input_offset = -kInputZeroPoint;
+  params.output_offset = kOutputZeroPoint;
+  params.stride_height = 1;
+  params.stride_width = 1;
+  params.dilation_height_factor = 1;
+  params.dilation_width_factor = 1;
+  params.padding_values.height = PaddingSize(padding, kFilterSize);
+  params.padding_values.width = PaddingSize(padding, kFilterSize);
+  params.depth_multiplier = depth_multiplier;
+  params.quantized_activation_min = -128;
+  params.quantized_activation_max = 127;
+  int8_t expected[kMaxElements];
+  reference_integer_ops::DepthwiseConvPerChannel(
+      params, weights.multipliers, weights.shifts,
+      RuntimeShape({batches, kHeight, kWidth, kInputDepth}), input_data,
+      RuntimeShape({1, kFilterSize, kFilterSize, output_depth}),
+      weights.filter, RuntimeShape({output_depth}), weights.bias,
+      RuntimeShape({batches, out_height, out_width, output_depth}), expected);
+  ExpectEqual(expected, actual, output_size);
+}
+
+void TestFullyConnected(int batches, bool with_bias) {
+  // An odd depth, so that batches do not start on word boundaries.
+  constexpr int kAccumDepth = 19;
+  constexpr int kUnits = 5;
+  const int32_t filter_shape[] = {kUnits, kAccumDepth};
+  Weights weights;
+  FillWeights(kUnits * kAccumDepth, 1, kInputScale, kOutputScale, &weights);
+  for (int c = 0; c < kUnits; ++c) {
+    weights.bias[c] = BiasValue(c);
+  }
+
+  TestModelBuilder builder;
+  const int fc = builder.AddOperatorCode(BuiltinOperator_FULLY_CONNECTED, 4);
+  const int input = builder.AddQuantizedTensor(
+      TensorType_INT8, {batches, kAccumDepth}, kInputScale, kInputZeroPoint);
+  int bias = -1;
+  const int filter =
+      with_bias ? AddWeights(&builder, filter_shape, 2, kUnits * kAccumDepth,
+                             1, 0, weights, &bias)
+                : builder.AddTensor(TensorType_INT8, filter_shape, 2,
+                                    weights.filter, kUnits * kAccumDepth,
+                                    weights.filter_scales, weights.zero_points,
+                                    1);
+  const int output = builder.AddQuantizedTensor(
+      TensorType_INT8, {batches, kUnits}, kOutputScale, kOutputZeroPoint);
+  builder.AddOperator(
+      fc, {input, filter, bias}, {output},
+      BuiltinOptions_FullyConnectedOptions,
+      CreateFullyConnectedOptions(*builder.builder()).Union());
+
+  const int input_size = batches * kAccumDepth;
+  const int output_size = batches * kUnits;
+  int8_t input_data[kMaxBatches * kAccumDepth];
+  for (int i = 0; i < input_size; ++i) {
+    input_data[i] = InputValue(i);
+  }
+  int8_t actual[kMaxBatches * kUnits];
+  RunInt8Model(builder.BuildModel({input}, {output}),
+               BuiltinOperator_FULLY_CONNECTED,
+               ops::micro::Register_FULLY_CONNECTED(), 4, input_data,
+               input_size, actual, output_size);
+
+  FullyConnectedParams params;
+  params.input_offset = -kInputZeroPoint;
+  params.weights_offset = 0;
+  params.output_offset = kOutputZeroPoint;
+  params.output_multiplier = weights.multipliers[0];
+  params.output_shift = weights.shifts[0];
+  params.quantized_activation_min = -128;
+  params.quantized_activation_max = 127;
+  int8_t expected[kMaxBatches * kUnits];
+  reference_integer_ops::FullyConnected(
+      params, RuntimeShape({batches, kAccumDepth}), input_data,
+      RuntimeShape({kUnits, kAccumDepth}), weights.filter,
+      RuntimeShape({kUnits}), with_bias ? weights.bias : nullptr,
+      RuntimeShape({batches, kUnits}), expected);
+  ExpectEqual(expected, actual, output_size);
+}
+
+}  // namespace
+}  // namespace testing
+}  // namespace tflite
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(Conv3x3SameBatches) {
+  for (int b = 1; b <= tflite::testing::kMaxBatches; ++b) {
+    tflite::testing::TestConv(b, 3, tflite::Padding_SAME);
+  }
+}
+
+TF_LITE_MICRO_TEST(Conv3x3ValidBatches) {
+  for (int b = 1; b <= tflite::testing::kMaxBatches; ++b) {
+    tflite::testing::TestConv(b, 3, tflite::Padding_VALID);
+  }
+}
+
+TF_LITE_MICRO_TEST(Conv1x1Batches) {
+  for (int b = 1; b <= tflite::testing::kMaxBatches; ++b) {
+    tflite::testing::TestConv(b, 1, tflite::Padding_VALID);
+  }
+}
+
+TF_LITE_MICRO_TEST(DepthwiseConvSameBatches) {
+  for (int b = 1; b <= tflite::testing::kMaxBatches; ++b) {
+    tflite::testing::TestDepthwiseConv(b, 1, tflite::Padding_SAME);
+  }
+}
+
+TF_LITE_MICRO_TEST(DepthwiseConvMultiplier2Batches) {
+  for (int b = 1; b <= tflite::testing::kMaxBatches; ++b) {
+    tflite::testing::TestDepthwiseConv(b, 2, tflite::Padding_VALID);
+  }
+}
+
+TF_LITE_MICRO_TEST(FullyConnectedBatches) {
+  for (int b = 1; b <= tflite::testing::kMaxBatches; ++b) {
+    tflite::testing::TestFullyConnected(b, true);
+  }
+}
+
+TF_LITE_MICRO_TEST(FullyConnectedWithoutBiasBatches) {
+  for (int b = 1; b <= tflite::testing::kMaxBatches; ++b) {
+    tflite::testing::TestFullyConnected(b, false);
+  }
+}
+
+TF_LITE_MICRO_TESTS_END
@@ -43,7 +43,8 @@ struct OpData {
   int32 output_activation_min;
   int32 output_activation_max;
 
-  // These fields are used only in the general 8-bit -> 8bit quantized path
+  // These fields are used only in the general quantized paths, 8-bit -> 8-bit
+  // and symmetric 16-bit -> 16-bit
   int32 input1_multiplier;
   int32 input2_multiplier;
   int32 output_multiplier;
@@ -60,12 +61,22 @@ TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteAddParams* params,
                              OpData* data) {
   data->requires_broadcast = !HaveSameShapes(input1, input2);
 
-  if (output->type == kTfLiteUInt8 || output->type == kTfLiteInt8) {
-    // 8bit -> 8bit general quantized path, with general rescalings
+  if (output->type == kTfLiteInt16) {
+    TF_LITE_ENSURE_EQ(context, input1->type, kTfLiteInt16);
+    TF_LITE_ENSURE_EQ(context, input2->type, kTfLiteInt16);
+    TF_LITE_ENSURE_EQ(context, input1->params.zero_point, 0);
+    TF_LITE_ENSURE_EQ(context, input2->params.zero_point, 0);
+    TF_LITE_ENSURE_EQ(context, output->params.zero_point, 0);
+  }
+
+  if (output->type == kTfLiteUInt8 || output->type == kTfLiteInt8 ||
+      output->type == kTfLiteInt16) {
+    // General quantized path, with general rescalings. 16 bit inputs leave
+    // less headroom for the shift.
     data->input1_offset = -input1->params.zero_point;
     data->input2_offset = -input2->params.zero_point;
     data->output_offset = output->params.zero_point;
-    data->left_shift = 20;
+    data->left_shift = output->type == kTfLiteInt16 ? 15 : 20;
     const double twice_max_input_scale =
         2 * std::max(input1->params.scale, input2->params.scale);
     const double real_input1_multiplier =
@@ -93,6 +104,25 @@ TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteAddParams* params,
   return kTfLiteOk;
 }
 
+// The rescaling parameters are computed here, so that Eval does no floating
+// point math for quantized models.
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  auto* params = reinterpret_cast<TfLiteAddParams*>(node->builtin_data);
+
+  const TfLiteTensor* input1 = GetInput(context, node, kInputTensor1);
+  const TfLiteTensor* input2 = GetInput(context, node, kInputTensor2);
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(OpData), &raw));
+  OpData* data = static_cast<OpData*>(raw);
+  TF_LITE_ENSURE_STATUS(
+      CalculateOpData(context, params, input1, input2, output, data));
+  node->user_data = data;
+  return kTfLiteOk;
+}
+
 void EvalAdd(TfLiteContext* context, TfLiteNode* node, TfLiteAddParams* params,
              const OpData* data, const TfLiteTensor* input1,
              const TfLiteTensor* input2, TfLiteTensor* output) {
@@ -114,12 +144,64 @@ void EvalAdd(TfLiteContext* context, TfLiteNode* node, TfLiteAddParams* params,
 #undef TF_LITE_ADD
 }
 
+// Same rescaling as reference_integer_ops::AddElementwise, for 16 bit
+// inputs and outputs.
+inline int16_t AddInt16(const tflite::ArithmeticParams& params,
+                        int16_t input1, int16_t input2) {
+  const int32_t scaled_input1 = MultiplyByQuantizedMultiplierSmallerThanOneExp(
+      input1 * (1 << params.left_shift), params.input1_multiplier,
+      params.input1_shift);
+  const int32_t scaled_input2 = MultiplyByQuantizedMultiplierSmallerThanOneExp(
+      input2 * (1 << params.left_shift), params.input2_multiplier,
+      params.input2_shift);
+  const int32_t raw_output = MultiplyByQuantizedMultiplierSmallerThanOneExp(
+      scaled_input1 + scaled_input2, params.output_multiplier,
+      params.output_shift);
+  return static_cast<int16_t>(
+      std::min(params.quantized_activation_max,
+               std::max(params.quantized_activation_min, raw_output)));
+}
+
+void EvalAddInt16(const tflite::ArithmeticParams& params, bool need_broadcast,
+                  const TfLiteTensor* input1, const TfLiteTensor* input2,
+                  TfLiteTensor* output) {
+  const int16_t* input1_data = GetTensorData<int16_t>(input1);
+  const int16_t* input2_data = GetTensorData<int16_t>(input2);
+  int16_t* output_data = GetTensorData<int16_t>(output);
+  if (!need_broadcast) {
+    const int size = MatchingElementsSize(
+        GetTensorShape(input1), GetTensorShape(input2), GetTensorShape(output));
+    for (int i = 0; i < size; ++i) {
+      output_data[i] = AddInt16(params, input1_data[i], input2_data[i]);
+    }
+    return;
+  }
+  NdArrayDesc<4> desc1;
+  NdArrayDesc<4> desc2;
+  NdArrayDescsForElementwiseBroadcast(GetTensorShape(input1),
+                                      GetTensorShape(input2), &desc1, &desc2);
+  const RuntimeShape extended_output_shape =
+      RuntimeShape::ExtendedShape(4, GetTensorShape(output));
+  for (int b = 0; b < extended_output_shape.Dims(0); ++b) {
+    for (int y = 0; y < extended_output_shape.Dims(1); ++y) {
+      for (int x = 0; x < extended_output_shape.Dims(2); ++x) {
+        for (int c = 0; c < extended_output_shape.Dims(3); ++c) {
+          *output_data++ =
+              AddInt16(params, input1_data[SubscriptToIndex(desc1, b, y, x, c)],
+                       input2_data[SubscriptToIndex(desc2, b, y, x, c)]);
+        }
+      }
+    }
+  }
+}
+
 TfLiteStatus EvalAddQuantized(TfLiteContext* context, TfLiteNode* node,
                               TfLiteAddParams* params, const OpData* data,
                               const TfLiteTensor* input1,
                               const TfLiteTensor* input2,
                               TfLiteTensor* output) {
-  if (output->type == kTfLiteUInt8 || output->type == kTfLiteInt8) {
+  if (output->type == kTfLiteUInt8 || output->type == kTfLiteInt8 ||
+      output->type == kTfLiteInt16) {
     tflite::ArithmeticParams op_params;
     op_params.left_shift = data->left_shift;
     op_params.input1_offset = data->input1_offset;
@@ -140,7 +222,9 @@ TfLiteStatus EvalAddQuantized(TfLiteContext* context, TfLiteNode* node,
                GetTensorData<dtype>(input1), GetTensorShape(input2), \
                GetTensorData<dtype>(input2), GetTensorShape(output), \
                GetTensorData<dtype>(output));
-    if (output->type == kTfLiteInt8) {
+    if (output->type == kTfLiteInt16) {
+      EvalAddInt16(op_params, need_broadcast, input1, input2, output);
+    } else if (output->type == kTfLiteInt8) {
       if (need_broadcast) {
         TF_LITE_ADD(reference_integer_ops, BroadcastAdd4DSlow, int8_t);
       } else {
@@ -176,18 +260,17 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteTensor* input2 = GetInput(context, node, kInputTensor2);
   TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
 
-  OpData data;
-  TF_LITE_ENSURE_STATUS(
-      CalculateOpData(context, params, input1, input2, output, &data));
+  const OpData* data = static_cast<const OpData*>(node->user_data);
 
   if (output->type == kTfLiteFloat32) {
-    EvalAdd(context, node, params, &data, input1, input2, output);
-  } else if (output->type == kTfLiteUInt8 || output->type == kTfLiteInt8) {
-    TF_LITE_ENSURE_OK(context, EvalAddQuantized(context, node, params, &data,
+    EvalAdd(context, node, params, data, input1, input2, output);
+  } else if (output->type == kTfLiteUInt8 || output->type == kTfLiteInt8 ||
+             output->type == kTfLiteInt16) {
+    TF_LITE_ENSURE_OK(context, EvalAddQuantized(context, node, params, data,
                                                 input1, input2, output));
   } else {
-    TF_LITE_KERNEL_LOG(context,
-                       "Inputs and outputs not all float|uint8|int8 types.");
+    TF_LITE_KERNEL_LOG(
+        context, "Inputs and outputs not all float|uint8|int8|int16 types.");
     return kTfLiteError;
   }
 
@@ -198,7 +281,7 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
 
 TfLiteRegistration* Register_ADD() {
   static TfLiteRegistration r = {nullptr /* Init */, nullptr /* Free */,
-                                 nullptr /* Prepare */, add::Eval};
+                                 add::Prepare, add::Eval};
   return &r;
 }
 
@@ -0,0 +1,140 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#include "tensorflow/lite/micro/kernels/cmsis-nn/block_sparse.h"
+
+#include "arm_nnsupportfunctions.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+
+TfLiteStatus ValidateBlockSparseMatrix(TfLiteContext* context,
+                                       const TfLiteTensor* filter, int cols) {
+  const TfLiteSparsity* sparsity = filter->sparsity;
+  TF_LITE_ENSURE(context, sparsity != nullptr);
+  TF_LITE_ENSURE_EQ(context, filter->type, kTfLiteInt8);
+  // Skipping a block only works if zero weights are quantized to zero.
+  TF_LITE_ENSURE_EQ(context, filter->params.zero_point, 0);
+
+  const int rank = NumDimensions(filter);
+  const int levels = sparsity->dim_metadata_size;
+  TF_LITE_ENSURE(context, rank >= 2);
+  TF_LITE_ENSURE(context, levels == rank || levels == rank + 1);
+  if (sparsity->traversal_order != nullptr) {
+    TF_LITE_ENSURE_EQ(context, sparsity->traversal_order->size, levels);
+    for (int i = 0; i < levels; ++i) {
+      TF_LITE_ENSURE_EQ(context, sparsity->traversal_order->data[i], i);
+    }
+  }
+
+  int block_size = 1;
+  if (levels == rank + 1) {
+    const TfLiteDimensionMetadata& block = sparsity->dim_metadata[rank];
+    TF_LITE_ENSURE(context, sparsity->block_map != nullptr);
+    TF_LITE_ENSURE_EQ(context, sparsity->block_map->size, 1);
+    TF_LITE_ENSURE_EQ(context, sparsity->block_map->data[0], rank - 1);
+    TF_LITE_ENSURE_EQ(context, block.format, kTfLiteDimDense);
+    block_size = block.dense_size;
+    TF_LITE_ENSURE(context, block_size > 0);
+  }
+  TF_LITE_ENSURE_EQ(context, SizeOfDimension(filter, rank - 1), cols);
+  TF_LITE_ENSURE_EQ(context, cols % block_size, 0);
+
+  int rows = 1;
+  for (int i = 0; i < rank - 1; ++i) {
+    const TfLiteDimensionMetadata& dim = sparsity->dim_metadata[i];
+    TF_LITE_ENSURE_EQ(context, dim.format, kTfLiteDimDense);
+    TF_LITE_ENSURE_EQ(context, dim.dense_size, SizeOfDimension(filter, i));
+    rows *= dim.dense_size;
+  }
+
+  const TfLiteDimensionMetadata& csr = sparsity->dim_metadata[rank - 1];
+  TF_LITE_ENSURE_EQ(context, csr.format, kTfLiteDimSparseCSR);
+  TF_LITE_ENSURE(context,
+                 csr.array_segments != nullptr && csr.array_indices != nullptr);
+  TF_LITE_ENSURE_EQ(context, csr.array_segments->size, rows + 1);
+  const int* segments = csr.array_segments->data;
+  TF_LITE_ENSURE_EQ(context, segments[0], 0);
+  for (int r = 0; r < rows; ++r) {
+    TF_LITE_ENSURE(context, segments[r] <= segments[r + 1]);
+  }
+  const int blocks = segments[rows];
+  TF_LITE_ENSURE_EQ(context, csr.array_indices->size, blocks);
+  const int block_cols = cols / block_size;
+  for (int k = 0; k < blocks; ++k) {
+    const int index = csr.array_indices->data[k];
+    TF_LITE_ENSURE(context, index >= 0 && index < block_cols);
+  }
+  TF_LITE_ENSURE(context, filter->bytes >= static_cast<size_t>(blocks) *
+                                               static_cast<size_t>(block_size));
+  return kTfLiteOk;
+}
+
+BlockSparseMatrix GetBlockSparseMatrix(const TfLiteTensor* filter) {
+  const TfLiteSparsity* sparsity = filter->sparsity;
+  const int rank = filter->dims->size;
+  const TfLiteDimensionMetadata& csr = sparsity->dim_metadata[rank - 1];
+  BlockSparseMatrix matrix;
+  matrix.rows = csr.array_segments->size - 1;
+  matrix.block_size = sparsity->dim_metadata_size > rank
+                          ? sparsity->dim_metadata[rank].dense_size
+                          : 1;
+  matrix.segments = csr.array_segments->data;
+  matrix.indices = csr.array_indices->data;
+  matrix.values = filter->data.int8;
+  return matrix;
+}
+
+int32_t BlockSparseDotProduct(const BlockSparseMatrix& matrix, int row,
+                              const int8_t* input) {
+  const int block_size = matrix.block_size;
+  const int begin = matrix.segments[row];
+  const int end = matrix.segments[row + 1];
+  const int8_t* filter = matrix.values + begin * block_size;
+  int32_t acc = 0;
+#if defined(__ARM_FEATURE_DSP)
+  if (block_size % 4 == 0) {
+    // Same reordered expansion as arm_nn_mat_mult_nt_t_s8.
+    for (int k = begin; k < end; ++k) {
+      const int8_t* block_input = input + matrix.indices[k] * block_size;
+      for (int j = 0; j < block_size; j += 4) {
+        q31_t filter_02;
+        q31_t filter_13;
+        q31_t input_02;
+        q31_t input_13;
+        filter = read_and_pad_reordered(filter, &filter_02, &filter_13);
+        block_input = read_and_pad_reordered(block_input, &input_02, &input_13);
+        acc = __SMLAD(filter_02, input_02, acc);
+        acc = __SMLAD(filter_13, input_13, acc);
+      }
+    }
+    return acc;
+  }
+#endif
+  for (int k = begin; k < end; ++k) {
+    const int8_t* block_input = input + matrix.indices[k] * block_size;
+    for (int j = 0; j < block_size; ++j) {
+      acc += *filter++ * block_input[j];
+    }
+  }
+  return acc;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
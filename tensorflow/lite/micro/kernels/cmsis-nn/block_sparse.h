@@ -0,0 +1,63 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_BLOCK_SPARSE_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_BLOCK_SPARSE_H_
+
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+
+// Pruned int8 weights stored with SparsityParameters. The supported encoding
+// is the one the converter emits for 1xK block sparsity: the filter is seen as
+// a matrix whose rows are all but the last dimension, the leading dimensions
+// are DENSE and the last one is SPARSE_CSR over blocks of K consecutive
+// weights, given by an extra DENSE block dimension with block_map = [rank - 1].
+// Without a block dimension K is 1. Only the non-zero blocks are stored, row
+// after row.
+struct BlockSparseMatrix {
+  int rows;
+  int block_size;
+  // rows + 1 entries, the blocks of row r are [segments[r], segments[r + 1]).
+  const int* segments;
+  // Column of each block, in units of block_size.
+  const int* indices;
+  const int8_t* values;
+};
+
+// Checks that the sparsity parameters of `filter` use the encoding above for
+// a matrix of `cols` columns and that all indices are in range, so that Eval
+// can use GetBlockSparseMatrix without further checks.
+TfLiteStatus ValidateBlockSparseMatrix(TfLiteContext* context,
+                                       const TfLiteTensor* filter, int cols);
+
+BlockSparseMatrix GetBlockSparseMatrix(const TfLiteTensor* filter);
+
+// Sum over the non-zero blocks of `row` of filter * input. The weights are
+// symmetric, skipped blocks contribute nothing, and the input offset is
+// folded into the bias, see folded_bias.h.
+int32_t BlockSparseDotProduct(const BlockSparseMatrix& matrix, int row,
+                              const int8_t* input);
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_BLOCK_SPARSE_H_
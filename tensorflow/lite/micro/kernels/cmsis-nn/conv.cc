@@ -24,7 +24,14 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/compressed_weights.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/block_sparse.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/folded_bias.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/int16x8.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/int4.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/packed_weights.h"
 #include "tensorflow/lite/micro/kernels/cmsis-nn/scratch_buffer.h"
+#include "tensorflow/lite/micro/patch_execution.h"
 
 namespace tflite {
 namespace ops {
@@ -35,7 +42,6 @@ constexpr int kInputTensor = 0;
 constexpr int kFilterTensor = 1;
 constexpr int kBiasTensor = 2;
 constexpr int kOutputTensor = 0;
-constexpr int kMaxChannels = 256;
 
 // Conv is quantized along dimension 0:
 // https://www.tensorflow.org/lite/performance/quantization_spec
@@ -43,24 +49,64 @@ constexpr int kConvQuantizedDimension = 0;
 
 const int kTensorNotAllocated = -1;
 
+// Longest im2col column expanded to q15 for packed weights. Two columns take
+// 8 KB of the CMSIS-NN scratch buffer.
+constexpr int kMaxPackedDepth = 2048;
+
 struct OpData {
+  // Padding of the full tensors, computed in Prepare, and of the rows the node
+  // runs on, set in Eval. They differ while it runs on a strip of a patched
+  // prefix, see patch_execution.h.
+  TfLitePaddingValues tensor_padding;
   TfLitePaddingValues padding;
   // The scaling factor from input to output (aka the 'real multiplier') can
   // be represented as a fixed point multiplier plus a left shift.
   int32_t output_multiplier;
   int output_shift;
 
-  // Per channel output multiplier and shift.
-  // TODO(b/141139247): Allocate these dynamically when possible.
-  int32_t per_channel_output_multiplier[kMaxChannels];
-  int32_t per_channel_output_shift[kMaxChannels];
-
   // The range of the fused activation layer. For example for kNone and
   // uint8_t these would be 0 and 255.
   int32_t output_activation_min;
   int32_t output_activation_max;
+
+  // Per channel output multipliers and shifts are stored right behind the
+  // struct in the same persistent buffer, `num_channels` of each, so that the
+  // buffer holds no pointers.
+  int num_channels;
+
+  // Int4 weights are read in their packed form.
+  bool weights_int4;
+
+  // Int8 kernels take the bias with the input offset folded in, stored after
+  // the per channel parameters, see folded_bias.h.
+  bool bias_folded;
+  // With TF_LITE_PACK_WEIGHTS, the packed weights if the arena had room for
+  // them, see packed_weights.h. Their kernel always reads the folded bias.
+  SpareBuffer packed_weights;
+  bool weights_packed;
 };
 
+int32_t* PerChannelOutputMultiplier(OpData* data) {
+  return reinterpret_cast<int32_t*>(data + 1);
+}
+
+int32_t* PerChannelOutputShift(OpData* data) {
+  return PerChannelOutputMultiplier(data) + data->num_channels;
+}
+
+int32_t* FoldedBias(OpData* data) {
+  return PerChannelOutputShift(data) + data->num_channels;
+}
+
+// The bias and input offset the int8 kernels apply.
+const int32_t* Int8Bias(OpData* data, const TfLiteTensor* bias) {
+  return data->bias_folded ? FoldedBias(data) : GetTensorData<int32_t>(bias);
+}
+
+int32_t Int8InputOffset(const OpData* data, const TfLiteTensor* input) {
+  return data->bias_folded ? 0 : -input->params.zero_point;
+}
+
 inline PaddingType RuntimePaddingType(TfLitePadding padding) {
   switch (padding) {
     case TfLitePadding::kTfLitePaddingSame:
@@ -85,10 +131,11 @@ TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteNode* node,
 
   // Matching GetWindowedOutputSize in TensorFlow.
   auto padding = params->padding;
-  data->padding = ComputePaddingHeightWidth(
+  data->tensor_padding = ComputePaddingHeightWidth(
       params->stride_height, params->stride_width,
       params->dilation_height_factor, params->dilation_width_factor, height,
       width, filter_height, filter_width, padding, &out_height, &out_width);
+  data->padding = data->tensor_padding;
 
   // Note that quantized inference requires that all tensors have their
   // parameters set. This is usually done during quantized training.
@@ -98,14 +145,14 @@ TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteNode* node,
     const TfLiteTensor* bias =
         GetOptionalInputTensor(context, node, kBiasTensor);
     TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
-    int num_channels = filter->dims->data[kConvQuantizedDimension];
 
     TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
         context, input, filter, bias, output, params->activation,
         &data->output_multiplier, &data->output_shift,
         &data->output_activation_min, &data->output_activation_max,
-        data->per_channel_output_multiplier,
-        reinterpret_cast<int*>(data->per_channel_output_shift), num_channels));
+        PerChannelOutputMultiplier(data),
+        reinterpret_cast<int*>(PerChannelOutputShift(data)),
+        data->num_channels));
   }
   return kTfLiteOk;
 }
@@ -116,7 +163,131 @@ void* Init(TfLiteContext* context, const char* buffer, size_t length) {
 
 void Free(TfLiteContext* context, void* buffer) {}
 
+// All quantization parameters are computed here, so that Eval does no
+// floating point math for quantized models.
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  auto* params = reinterpret_cast<TfLiteConvParams*>(node->builtin_data);
+
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+
+  int input_width = input->dims->data[2];
+  int input_height = input->dims->data[1];
+  int filter_width = filter->dims->data[2];
+  int filter_height = filter->dims->data[1];
+  int output_width = output->dims->data[2];
+  int output_height = output->dims->data[1];
+
+  // All per-channel quantized tensors need valid zero point and scale arrays.
+  if (input->type == kTfLiteInt8 || input->type == kTfLiteInt16) {
+    TF_LITE_ENSURE_EQ(context, filter->quantization.type,
+                      kTfLiteAffineQuantization);
+
+    const auto* affine_quantization =
+        reinterpret_cast<TfLiteAffineQuantization*>(
+            filter->quantization.params);
+    TF_LITE_ENSURE(context, affine_quantization);
+    TF_LITE_ENSURE(context, affine_quantization->scale);
+    TF_LITE_ENSURE(context, affine_quantization->zero_point);
+    TF_LITE_ENSURE(context,
+                   affine_quantization->scale->size == 1 ||
+                       affine_quantization->scale->size ==
+                           filter->dims->data[kConvQuantizedDimension]);
+    TF_LITE_ENSURE_EQ(context, affine_quantization->scale->size,
+                      affine_quantization->zero_point->size);
+  }
+
+  // 16 bit activations with 8 bit weights, all symmetric.
+  if (input->type == kTfLiteInt16) {
+    const TfLiteTensor* bias =
+        GetOptionalInputTensor(context, node, kBiasTensor);
+    TF_LITE_ENSURE_EQ(context, filter->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, output->type, kTfLiteInt16);
+    TF_LITE_ENSURE_EQ(context, input->params.zero_point, 0);
+    TF_LITE_ENSURE_EQ(context, output->params.zero_point, 0);
+    if (bias) {
+      TF_LITE_ENSURE_EQ(context, bias->type, kTfLiteInt64);
+    }
+  }
+
+  // Pruned 1x1 filters are used in their compressed form.
+  if (filter->sparsity) {
+    TF_LITE_ENSURE_EQ(context, input->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, filter_width, 1);
+    TF_LITE_ENSURE_EQ(context, filter_height, 1);
+    TF_LITE_ENSURE_STATUS(ValidateBlockSparseMatrix(
+        context, filter, SizeOfDimension(input, 3)));
+  }
+
+  const int num_channels =
+      input->type == kTfLiteFloat32
+          ? 0
+          : filter->dims->data[kConvQuantizedDimension];
+
+  // The input offset is folded into the bias if no filter tap can fall into
+  // the padding. Block sparse 1x1 filters never do, and the int4 and packed
+  // kernels pad with the input zero point, so they always fold and are only
+  // used if the weights can be folded. The int8 kernels still take the bias
+  // as it is if the packed weights do not fit.
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+  const bool can_fold = input->type == kTfLiteInt8 &&
+                        CanFoldInputOffset(context, filter, bias);
+  if (filter->sparsity) {
+    TF_LITE_ENSURE(context, can_fold);
+  }
+  const CompressedTensor* compressed = GetCompressedTensor(context, filter);
+  const bool weights_int4 = can_fold && compressed != nullptr &&
+                            compressed->palette == nullptr &&
+                            ClaimCompressedTensor(context, filter);
+
+  // Only weights read in place from the model are packed.
+#if defined(TF_LITE_PACK_WEIGHTS)
+  const bool pack_weights =
+      can_fold && !filter->sparsity &&
+      filter->allocation_type == kTfLiteMmapRo &&
+      NumElements(filter) / num_channels <= kMaxPackedDepth;
+#else
+  const bool pack_weights = false;
+#endif
+  const bool bias_folded =
+      can_fold &&
+      (filter->sparsity || weights_int4 ||
+       (FilterStaysInside(input_height, filter_height, output_height,
+                          params->stride_height,
+                          params->dilation_height_factor) &&
+        FilterStaysInside(input_width, filter_width, output_width,
+                          params->stride_width,
+                          params->dilation_width_factor)));
+  const bool fold = bias_folded || pack_weights;
+  const size_t folded_bytes = fold ? num_channels * sizeof(int32_t) : 0;
+
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context,
+      sizeof(OpData) + 2 * num_channels * sizeof(int32_t) + folded_bytes,
+      &raw));
+  OpData* data = static_cast<OpData*>(raw);
+  data->num_channels = num_channels;
+  data->weights_int4 = weights_int4;
+  data->bias_folded = bias_folded;
+  data->packed_weights = SpareBuffer();
+  data->weights_packed = false;
+  if (fold) {
+    const int depth = NumElements(filter) / num_channels;
+    TF_LITE_ENSURE_STATUS(FoldInputOffset(context, filter, bias,
+                                          -input->params.zero_point,
+                                          num_channels, depth, depth, 1,
+                                          FoldedBias(data)));
+  }
+  if (pack_weights) {
+    RequestSpareBuffer(context, NumElements(filter) * sizeof(int16_t),
+                       &data->packed_weights);
+  }
+  TF_LITE_ENSURE_STATUS(CalculateOpData(
+      context, node, params, input_width, input_height, filter_width,
+      filter_height, output_width, output_height, input->type, data));
+  node->user_data = data;
   return kTfLiteOk;
 }
 
@@ -154,12 +325,71 @@ TfLiteStatus EvalQuantized(TfLiteContext* context, TfLiteNode* node,
   return kTfLiteOk;
 }
 
+// Without padding every filter tap is a dot product over the input channels
+// of one pixel, with the input offset folded into the bias.
+TfLiteStatus EvalFoldedPerChannel(TfLiteContext* context, TfLiteNode* node,
+                                  TfLiteConvParams* params, OpData* data,
+                                  const TfLiteTensor* input,
+                                  const TfLiteTensor* filter,
+                                  TfLiteTensor* output) {
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int32_t output_offset = output->params.zero_point;
+  const int32_t* output_multiplier = PerChannelOutputMultiplier(data);
+  const int32_t* output_shift = PerChannelOutputShift(data);
+
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  const int8_t* filter_data = GetTensorData<int8_t>(filter);
+  const int32_t* bias_data = FoldedBias(data);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = out_y * params->stride_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = out_x * params->stride_width;
+        const int8_t* weights = filter_data;
+        for (int out_channel = 0; out_channel < output_depth; ++out_channel) {
+          int32_t acc = bias_data[out_channel];
+          for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+            const int in_y =
+                in_y_origin + params->dilation_height_factor * filter_y;
+            for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+              const int in_x =
+                  in_x_origin + params->dilation_width_factor * filter_x;
+              acc += DotProductInt8(
+                  weights,
+                  input_data + Offset(input_shape, batch, in_y, in_x, 0),
+                  input_depth);
+              weights += input_depth;
+            }
+          }
+          acc = MultiplyByQuantizedMultiplier(
+              acc, output_multiplier[out_channel], output_shift[out_channel]);
+          acc += output_offset;
+          acc = std::max(acc, data->output_activation_min);
+          acc = std::min(acc, data->output_activation_max);
+          *output_data++ = static_cast<int8_t>(acc);
+        }
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus EvalQuantizedPerChannel(
     TfLiteContext* context, TfLiteNode* node, TfLiteConvParams* params,
     OpData* data, const TfLiteTensor* input, const TfLiteTensor* filter,
     const TfLiteTensor* bias, TfLiteTensor* output, TfLiteTensor* im2col) {
   ConvParams op_params;
-  op_params.input_offset = -input->params.zero_point;
+  op_params.input_offset = Int8InputOffset(data, input);
   op_params.output_offset = output->params.zero_point;
   op_params.stride_height = params->stride_height;
   op_params.stride_width = params->stride_width;
@@ -176,9 +406,8 @@ TfLiteStatus EvalQuantizedPerChannel(
   RuntimeShape output_shape = GetTensorShape(output);
   RuntimeShape bias_shape = GetTensorShape(bias);
 
-  // Set min and max value of the output.
-  const int32 output_activation_min = std::numeric_limits<int8_t>::min();
-  const int32 output_activation_max = std::numeric_limits<int8_t>::max();
+  const int32 output_activation_min = data->output_activation_min;
+  const int32 output_activation_max = data->output_activation_max;
 
   // Sanity check.
   TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
@@ -214,8 +443,8 @@ TfLiteStatus EvalQuantizedPerChannel(
             input_depth, batches, GetTensorData<int8_t>(filter), output_depth,
             op_params.padding_values.width, op_params.padding_values.height,
             op_params.stride_width, op_params.stride_height,
-            GetTensorData<int32>(bias), GetTensorData<int8_t>(output),
-            data->per_channel_output_shift, data->per_channel_output_multiplier,
+            Int8Bias(data, bias), GetTensorData<int8_t>(output),
+            PerChannelOutputShift(data), PerChannelOutputMultiplier(data),
             op_params.output_offset, op_params.input_offset,
             output_activation_min, output_activation_max, output_width,
             output_height, buf) != ARM_MATH_SUCCESS) {
@@ -232,9 +461,9 @@ TfLiteStatus EvalQuantizedPerChannel(
             input_depth, batches, GetTensorData<int8_t>(filter), output_depth,
             filter_width, filter_height, op_params.padding_values.width,
             op_params.padding_values.height, op_params.stride_width,
-            op_params.stride_height, GetTensorData<int32>(bias),
-            GetTensorData<int8_t>(output), data->per_channel_output_shift,
-            data->per_channel_output_multiplier, op_params.output_offset,
+            op_params.stride_height, Int8Bias(data, bias),
+            GetTensorData<int8_t>(output), PerChannelOutputShift(data),
+            PerChannelOutputMultiplier(data), op_params.output_offset,
             op_params.input_offset, output_activation_min,
             output_activation_max, output_width, output_height,
             buf) != ARM_MATH_SUCCESS) {
@@ -245,9 +474,13 @@ TfLiteStatus EvalQuantizedPerChannel(
 #pragma message( \
     "CMSIS-NN optimization for conv not available for this target. Using reference kernel.")
 
+  if (data->bias_folded) {
+    return EvalFoldedPerChannel(context, node, params, data, input, filter,
+                                output);
+  }
   reference_integer_ops::ConvPerChannel(
-      op_params, data->per_channel_output_multiplier,
-      data->per_channel_output_shift, GetTensorShape(input),
+      op_params, PerChannelOutputMultiplier(data),
+      PerChannelOutputShift(data), GetTensorShape(input),
       GetTensorData<int8>(input), GetTensorShape(filter),
       GetTensorData<int8>(filter), GetTensorShape(bias),
       GetTensorData<int32>(bias), GetTensorShape(output),
@@ -257,6 +490,330 @@ TfLiteStatus EvalQuantizedPerChannel(
   return kTfLiteOk;
 }
 
+// 1x1 convolution with block sparse weights: every output pixel is the
+// sparse filter matrix times one input pixel. A 1x1 filter needs no padding,
+// whatever the padding type and stride.
+TfLiteStatus EvalSparsePerChannel(TfLiteContext* context, TfLiteNode* node,
+                                  TfLiteConvParams* params, OpData* data,
+                                  const TfLiteTensor* input,
+                                  const TfLiteTensor* filter,
+                                  TfLiteTensor* output) {
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int output_depth = output_shape.Dims(3);
+  const int32_t output_offset = output->params.zero_point;
+  const int32_t* output_multiplier = PerChannelOutputMultiplier(data);
+  const int32_t* output_shift = PerChannelOutputShift(data);
+  const BlockSparseMatrix matrix = GetBlockSparseMatrix(filter);
+  TF_LITE_ENSURE_EQ(context, matrix.rows, output_depth);
+
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  const int32_t* bias_data = FoldedBias(data);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y = out_y * params->stride_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x = out_x * params->stride_width;
+        const int8_t* pixel =
+            input_data + Offset(input_shape, batch, in_y, in_x, 0);
+        for (int out_channel = 0; out_channel < output_depth; ++out_channel) {
+          int32_t acc = bias_data[out_channel] +
+                        BlockSparseDotProduct(matrix, out_channel, pixel);
+          acc = MultiplyByQuantizedMultiplier(
+              acc, output_multiplier[out_channel], output_shift[out_channel]);
+          acc += output_offset;
+          acc = std::max(acc, data->output_activation_min);
+          acc = std::min(acc, data->output_activation_max);
+          *output_data++ = static_cast<int8_t>(acc);
+        }
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
+// Expands the im2col column of one output pixel to q15. Padding takes the
+// input zero point, which contributes nothing once the input offset is folded
+// into the bias.
+void FillPackedColumn(const TfLiteConvParams* params, const OpData* data,
+                      const TfLiteTensor* input,
+                      const RuntimeShape& input_shape, int filter_height,
+                      int filter_width, int batch, int out_y, int out_x,
+                      int16_t* column) {
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = input_shape.Dims(3);
+  const int16_t pad_value = input->params.zero_point;
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  const int in_y_origin = out_y * params->stride_height - data->padding.height;
+  const int in_x_origin = out_x * params->stride_width - data->padding.width;
+  for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+    const int in_y = in_y_origin + params->dilation_height_factor * filter_y;
+    for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+      const int in_x = in_x_origin + params->dilation_width_factor * filter_x;
+      if (in_y < 0 || in_y >= input_height || in_x < 0 ||
+          in_x >= input_width) {
+        std::fill(column, column + input_depth, pad_value);
+      } else {
+        arm_q7_to_q15_no_shift(
+            input_data + Offset(input_shape, batch, in_y, in_x, 0), column,
+            input_depth);
+      }
+      column += input_depth;
+    }
+  }
+}
+
+int8_t RequantizePerChannel(OpData* data, int channel, int32_t acc,
+                            int32_t output_offset) {
+  acc = MultiplyByQuantizedMultiplier(acc,
+                                      PerChannelOutputMultiplier(data)[channel],
+                                      PerChannelOutputShift(data)[channel]);
+  acc += output_offset;
+  acc = std::max(acc, data->output_activation_min);
+  acc = std::min(acc, data->output_activation_max);
+  return static_cast<int8_t>(acc);
+}
+
+// Output pixels are taken two at a time, like arm_convolve_s8 does: both
+// im2col columns are expanded to q15 and multiplied with the packed weights,
+// two output channels at a time, see packed_weights.h.
+TfLiteStatus EvalPackedPerChannel(TfLiteContext* context, TfLiteNode* node,
+                                  TfLiteConvParams* params, OpData* data,
+                                  const int16_t* packed_weights,
+                                  const TfLiteTensor* input,
+                                  const TfLiteTensor* filter,
+                                  TfLiteTensor* output) {
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int column_depth = filter_height * filter_width * input_depth;
+  const int32_t output_offset = output->params.zero_point;
+  const int32_t* bias_data = FoldedBias(data);
+  int16_t* columns = nullptr;
+  TF_LITE_ENSURE_OK(context, get_cmsis_scratch_buffer(
+                                 context, &columns,
+                                 2 * column_depth * sizeof(int16_t)));
+
+  const int pixels = batches * output_height * output_width;
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int pixel = 0; pixel < pixels; pixel += 2) {
+    const int column_count = std::min(2, pixels - pixel);
+    for (int c = 0; c < column_count; ++c) {
+      const int out_x = (pixel + c) % output_width;
+      const int out_y = (pixel + c) / output_width % output_height;
+      const int batch = (pixel + c) / output_width / output_height;
+      FillPackedColumn(params, data, input, input_shape, filter_height,
+                       filter_width, batch, out_y, out_x,
+                       columns + c * column_depth);
+    }
+    const int16_t* column0 = columns;
+    const int16_t* column1 = columns + column_depth;
+    int8_t* output0 = output_data + pixel * output_depth;
+    int8_t* output1 = output0 + output_depth;
+
+    const int16_t* weights = packed_weights;
+    int out_channel = 0;
+    for (; out_channel + 1 < output_depth; out_channel += 2) {
+      const int32_t bias0 = bias_data[out_channel];
+      const int32_t bias1 = bias_data[out_channel + 1];
+      if (column_count == 2) {
+        int32_t acc[4] = {bias0, bias0, bias1, bias1};
+        weights =
+            MultiplyRowPair(weights, column0, column1, column_depth, acc);
+        output0[out_channel] =
+            RequantizePerChannel(data, out_channel, acc[0], output_offset);
+        output1[out_channel] =
+            RequantizePerChannel(data, out_channel, acc[1], output_offset);
+        output0[out_channel + 1] =
+            RequantizePerChannel(data, out_channel + 1, acc[2], output_offset);
+        output1[out_channel + 1] =
+            RequantizePerChannel(data, out_channel + 1, acc[3], output_offset);
+      } else {
+        int32_t acc[2] = {bias0, bias1};
+        weights = MultiplyRowPair(weights, column0, column_depth, acc);
+        output0[out_channel] =
+            RequantizePerChannel(data, out_channel, acc[0], output_offset);
+        output0[out_channel + 1] =
+            RequantizePerChannel(data, out_channel + 1, acc[1], output_offset);
+      }
+    }
+    if (out_channel < output_depth) {
+      const int32_t bias0 = bias_data[out_channel];
+      output0[out_channel] = RequantizePerChannel(
+          data, out_channel,
+          bias0 + DotProductQ15(weights, column0, column_depth),
+          output_offset);
+      if (column_count == 2) {
+        output1[out_channel] = RequantizePerChannel(
+            data, out_channel,
+            bias0 + DotProductQ15(weights, column1, column_depth),
+            output_offset);
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
+// Same loops as EvalQuantizedPerChannelInt16, with int4 weights unpacked
+// within the dot product of each filter tap. Taps in the padding read a pixel
+// of input zero points, which the folded bias cancels.
+TfLiteStatus EvalInt4PerChannel(TfLiteContext* context, TfLiteNode* node,
+                                TfLiteConvParams* params, OpData* data,
+                                const TfLiteTensor* input,
+                                const TfLiteTensor* filter,
+                                TfLiteTensor* output) {
+  const CompressedTensor* weights = GetCompressedTensor(context, filter);
+  TF_LITE_ENSURE(context, weights != nullptr);
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int32_t output_offset = output->params.zero_point;
+  const int32_t* output_multiplier = PerChannelOutputMultiplier(data);
+  const int32_t* output_shift = PerChannelOutputShift(data);
+  int16_t* buf = nullptr;
+  TF_LITE_ENSURE_OK(context,
+                    get_cmsis_scratch_buffer(context, &buf, input_depth));
+  int8_t* padding = reinterpret_cast<int8_t*>(buf);
+  std::fill(padding, padding + input_depth,
+            static_cast<int8_t>(input->params.zero_point));
+
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  const int32_t* bias_data = FoldedBias(data);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin =
+          out_y * params->stride_height - data->padding.height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin =
+            out_x * params->stride_width - data->padding.width;
+        for (int out_channel = 0; out_channel < output_depth; ++out_channel) {
+          int32_t acc = bias_data[out_channel];
+          for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+            const int in_y =
+                in_y_origin + params->dilation_height_factor * filter_y;
+            for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+              const int in_x =
+                  in_x_origin + params->dilation_width_factor * filter_x;
+              const bool inside = in_y >= 0 && in_y < input_height &&
+                                  in_x >= 0 && in_x < input_width;
+              acc += DotProductInt4x8(
+                  weights->indices,
+                  Offset(filter_shape, out_channel, filter_y, filter_x, 0),
+                  inside
+                      ? input_data + Offset(input_shape, batch, in_y, in_x, 0)
+                      : padding,
+                  input_depth);
+            }
+          }
+          acc = MultiplyByQuantizedMultiplier(
+              acc, output_multiplier[out_channel], output_shift[out_channel]);
+          acc += output_offset;
+          acc = std::max(acc, data->output_activation_min);
+          acc = std::min(acc, data->output_activation_max);
+          *output_data++ = static_cast<int8_t>(acc);
+        }
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
+// There is no CMSIS-NN kernel for 16 bit activations. The input channels of
+// one filter tap are contiguous in both the input and the filter, so each tap
+// is a single dot product.
+TfLiteStatus EvalQuantizedPerChannelInt16(TfLiteContext* context,
+                                          TfLiteNode* node,
+                                          TfLiteConvParams* params,
+                                          OpData* data,
+                                          const TfLiteTensor* input,
+                                          const TfLiteTensor* filter,
+                                          const TfLiteTensor* bias,
+                                          TfLiteTensor* output) {
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int32_t* output_multiplier = PerChannelOutputMultiplier(data);
+  const int32_t* output_shift = PerChannelOutputShift(data);
+
+  const int16_t* input_data = GetTensorData<int16_t>(input);
+  const int8_t* filter_data = GetTensorData<int8_t>(filter);
+  const int64_t* bias_data = GetTensorData<int64_t>(bias);
+  int16_t* output_data = GetTensorData<int16_t>(output);
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin =
+          out_y * params->stride_height - data->padding.height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin =
+            out_x * params->stride_width - data->padding.width;
+        for (int out_channel = 0; out_channel < output_depth; ++out_channel) {
+          int64_t acc = 0;
+          for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+            const int in_y =
+                in_y_origin + params->dilation_height_factor * filter_y;
+            if (in_y < 0 || in_y >= input_height) {
+              continue;
+            }
+            for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+              const int in_x =
+                  in_x_origin + params->dilation_width_factor * filter_x;
+              // Zero padding by omitting the areas outside the image.
+              if (in_x < 0 || in_x >= input_width) {
+                continue;
+              }
+              acc += DotProductInt16x8(
+                  input_data + Offset(input_shape, batch, in_y, in_x, 0),
+                  filter_data +
+                      Offset(filter_shape, out_channel, filter_y, filter_x, 0),
+                  input_depth);
+            }
+          }
+          if (bias_data) {
+            acc += bias_data[out_channel];
+          }
+          int32_t scaled = MultiplyByQuantizedMultiplier64(
+              acc, output_multiplier[out_channel], output_shift[out_channel]);
+          scaled = std::max(scaled, data->output_activation_min);
+          scaled = std::min(scaled, data->output_activation_max);
+          *output_data++ = static_cast<int16_t>(scaled);
+        }
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus EvalFloat(TfLiteContext* context, TfLiteNode* node,
                        TfLiteConvParams* params, OpData* data,
                        const TfLiteTensor* input, const TfLiteTensor* filter,
@@ -293,50 +850,40 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteTensor* input = GetInput(context, node, kInputTensor);
   const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
   const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
-
-  int input_width = input->dims->data[2];
-  int input_height = input->dims->data[1];
-  int filter_width = filter->dims->data[2];
-  int filter_height = filter->dims->data[1];
-  int output_width = output->dims->data[2];
-  int output_height = output->dims->data[1];
-
-  OpData data;
-
-  // All per-channel quantized tensors need valid zero point and scale arrays.
-  if (input->type == kTfLiteInt8) {
-    TF_LITE_ENSURE_EQ(context, filter->quantization.type,
-                      kTfLiteAffineQuantization);
-
-    const auto* affine_quantization =
-        reinterpret_cast<TfLiteAffineQuantization*>(
-            filter->quantization.params);
-    TF_LITE_ENSURE(context, affine_quantization);
-    TF_LITE_ENSURE(context, affine_quantization->scale);
-    TF_LITE_ENSURE(context, affine_quantization->zero_point);
-    TF_LITE_ENSURE(context,
-                   affine_quantization->scale->size == 1 ||
-                       affine_quantization->scale->size ==
-                           filter->dims->data[kConvQuantizedDimension]);
-    TF_LITE_ENSURE_EQ(context, affine_quantization->scale->size,
-                      affine_quantization->zero_point->size);
-  }
-
-  TF_LITE_ENSURE_STATUS(CalculateOpData(
-      context, node, params, input_width, input_height, filter_width,
-      filter_height, output_width, output_height, input->type, &data));
+  OpData* data = static_cast<OpData*>(node->user_data);
+  data->padding =
+      GetPatchPadding(context, data->tensor_padding, params->stride_height);
 
   switch (input->type) {  // Already know in/out types are same.
     case kTfLiteFloat32:
-      return EvalFloat(context, node, params, &data, input, filter, bias,
+      return EvalFloat(context, node, params, data, input, filter, bias,
                        nullptr, nullptr, output);
       break;
     case kTfLiteInt8:
-      return EvalQuantizedPerChannel(context, node, params, &data, input,
+      if (data->weights_int4) {
+        return EvalInt4PerChannel(context, node, params, data, input, filter,
+                                  output);
+      }
+      if (filter->sparsity) {
+        return EvalSparsePerChannel(context, node, params, data, input, filter,
+                                    output);
+      }
+      if (const int16_t* packed_weights = GetPackedWeights(
+              data->packed_weights, GetTensorData<int8_t>(filter),
+              data->num_channels, NumElements(filter) / data->num_channels,
+              &data->weights_packed)) {
+        return EvalPackedPerChannel(context, node, params, data,
+                                    packed_weights, input, filter, output);
+      }
+      return EvalQuantizedPerChannel(context, node, params, data, input,
                                      filter, bias, output, nullptr);
       break;
+    case kTfLiteInt16:
+      return EvalQuantizedPerChannelInt16(context, node, params, data, input,
+                                          filter, bias, output);
+      break;
     case kTfLiteUInt8:
-      return EvalQuantized(context, node, params, &data, input, filter, bias,
+      return EvalQuantized(context, node, params, data, input, filter, bias,
                            nullptr, nullptr, output);
       break;
     default:
@@ -25,7 +25,9 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/folded_bias.h"
 #include "tensorflow/lite/micro/kernels/cmsis-nn/scratch_buffer.h"
+#include "tensorflow/lite/micro/patch_execution.h"
 
 namespace tflite {
 namespace ops {
@@ -37,30 +39,50 @@ constexpr int kInputTensor = 0;
 constexpr int kFilterTensor = 1;
 constexpr int kBiasTensor = 2;
 constexpr int kOutputTensor = 0;
-constexpr int kMaxChannels = 256;
 
 // Depthwise conv is quantized along dimension 3:
 // https://www.tensorflow.org/lite/performance/quantization_spec
 constexpr int kDepthwiseConvQuantizedDimension = 3;
 
 struct OpData {
+  // Padding of the full tensors, computed in Prepare, and of the rows the node
+  // runs on, set in Eval. They differ while it runs on a strip of a patched
+  // prefix, see patch_execution.h.
+  TfLitePaddingValues tensor_padding;
   TfLitePaddingValues padding;
   // The scaling factor from input to output (aka the 'real multiplier') can
   // be represented as a fixed point multiplier plus a left shift.
   int32_t output_multiplier;
   int output_shift;
 
-  // Per channel output multiplier and shift.
-  // TODO(b/141139247): Allocate these dynamically when possible.
-  int32_t per_channel_output_multiplier[kMaxChannels];
-  int32_t per_channel_output_shift[kMaxChannels];
-
   // The range of the fused activation layer. For example for kNone and
   // uint8_t these would be 0 and 255.
   int32_t output_activation_min;
   int32_t output_activation_max;
+
+  // Per channel output multipliers and shifts are stored right behind the
+  // struct in the same persistent buffer, `num_channels` of each, so that the
+  // buffer holds no pointers.
+  int num_channels;
+
+  // Int8 kernels take the bias with the input offset folded in, stored after
+  // the per channel parameters, if no filter tap falls into the padding. See
+  // folded_bias.h.
+  bool bias_folded;
 };
 
+int32_t* PerChannelOutputMultiplier(OpData* data) {
+  return reinterpret_cast<int32_t*>(data + 1);
+}
+
+int32_t* PerChannelOutputShift(OpData* data) {
+  return PerChannelOutputMultiplier(data) + data->num_channels;
+}
+
+int32_t* FoldedBias(OpData* data) {
+  return PerChannelOutputShift(data) + data->num_channels;
+}
+
 TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteNode* node,
                              TfLiteDepthwiseConvParams* params, int width,
                              int height, int filter_width, int filter_height,
@@ -71,10 +93,11 @@ TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteNode* node,
   TF_LITE_ENSURE_EQ(context, node->outputs->size, 1);
 
   int unused_output_height, unused_output_width;
-  data->padding = ComputePaddingHeightWidth(
+  data->tensor_padding = ComputePaddingHeightWidth(
       params->stride_height, params->stride_width, 1, 1, height, width,
       filter_height, filter_width, params->padding, &unused_output_height,
       &unused_output_width);
+  data->padding = data->tensor_padding;
 
   // Note that quantized inference requires that all tensors have their
   // parameters set. This is usually done during quantized training.
@@ -84,14 +107,14 @@ TfLiteStatus CalculateOpData(TfLiteContext* context, TfLiteNode* node,
     const TfLiteTensor* bias =
         GetOptionalInputTensor(context, node, kBiasTensor);
     TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
-    int num_channels = filter->dims->data[kDepthwiseConvQuantizedDimension];
 
     TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
         context, input, filter, bias, output, params->activation,
         &data->output_multiplier, &data->output_shift,
         &data->output_activation_min, &data->output_activation_max,
-        data->per_channel_output_multiplier,
-        reinterpret_cast<int*>(data->per_channel_output_shift), num_channels));
+        PerChannelOutputMultiplier(data),
+        reinterpret_cast<int*>(PerChannelOutputShift(data)),
+        data->num_channels));
   }
   return kTfLiteOk;
 }
@@ -104,7 +127,86 @@ void* Init(TfLiteContext* context, const char* buffer, size_t length) {
 
 void Free(TfLiteContext* context, void* buffer) {}
 
+// All quantization parameters are computed here, so that Eval does no
+// floating point math for quantized models.
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  auto* params =
+      reinterpret_cast<TfLiteDepthwiseConvParams*>(node->builtin_data);
+
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
+
+  const TfLiteType data_type = input->type;
+  int width = SizeOfDimension(input, 2);
+  int height = SizeOfDimension(input, 1);
+  int filter_width = SizeOfDimension(filter, 2);
+  int filter_height = SizeOfDimension(filter, 1);
+
+  // All per-channel quantized tensors need valid zero point and scale arrays.
+  if (input->type == kTfLiteInt8 || input->type == kTfLiteInt16) {
+    TF_LITE_ENSURE_EQ(context, filter->quantization.type,
+                      kTfLiteAffineQuantization);
+
+    const auto* affine_quantization =
+        reinterpret_cast<TfLiteAffineQuantization*>(
+            filter->quantization.params);
+    TF_LITE_ENSURE(context, affine_quantization);
+    TF_LITE_ENSURE(context, affine_quantization->scale);
+    TF_LITE_ENSURE(context, affine_quantization->zero_point);
+    TF_LITE_ENSURE(
+        context, affine_quantization->scale->size == 1 ||
+                     affine_quantization->scale->size ==
+                         filter->dims->data[kDepthwiseConvQuantizedDimension]);
+    TF_LITE_ENSURE_EQ(context, affine_quantization->scale->size,
+                      affine_quantization->zero_point->size);
+  }
+
+  // 16 bit activations with 8 bit weights, all symmetric.
+  if (input->type == kTfLiteInt16) {
+    const TfLiteTensor* bias =
+        GetOptionalInputTensor(context, node, kBiasTensor);
+    const TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+    TF_LITE_ENSURE_EQ(context, filter->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, output->type, kTfLiteInt16);
+    TF_LITE_ENSURE_EQ(context, input->params.zero_point, 0);
+    TF_LITE_ENSURE_EQ(context, output->params.zero_point, 0);
+    if (bias) {
+      TF_LITE_ENSURE_EQ(context, bias->type, kTfLiteInt64);
+    }
+  }
+
+  const int num_channels =
+      data_type == kTfLiteFloat32
+          ? 0
+          : filter->dims->data[kDepthwiseConvQuantizedDimension];
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+  const TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  const bool fold =
+      input->type == kTfLiteInt8 && CanFoldInputOffset(context, filter, bias) &&
+      FilterStaysInside(height, filter_height, SizeOfDimension(output, 1),
+                        params->stride_height,
+                        params->dilation_height_factor) &&
+      FilterStaysInside(width, filter_width, SizeOfDimension(output, 2),
+                        params->stride_width, params->dilation_width_factor);
+  const size_t folded_bytes = fold ? num_channels * sizeof(int32_t) : 0;
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context,
+      sizeof(OpData) + 2 * num_channels * sizeof(int32_t) + folded_bytes,
+      &raw));
+  OpData* data = static_cast<OpData*>(raw);
+  data->num_channels = num_channels;
+  data->bias_folded = fold;
+  if (fold) {
+    // Channel c of the filter is every num_channels-th value from c on.
+    TF_LITE_ENSURE_STATUS(FoldInputOffset(
+        context, filter, bias, -input->params.zero_point, num_channels, 1,
+        filter_height * filter_width, num_channels, FoldedBias(data)));
+  }
+  TF_LITE_ENSURE_STATUS(CalculateOpData(context, node, params, width, height,
+                                        filter_width, filter_height, data_type,
+                                        data));
+  node->user_data = data;
   return kTfLiteOk;
 }
 
@@ -137,6 +239,65 @@ TfLiteStatus EvalFloat(TfLiteContext* context, TfLiteNode* node,
   return kTfLiteOk;
 }
 
+// Without padding, the input offset folded into the bias leaves a plain
+// multiply and accumulate per filter tap.
+TfLiteStatus EvalFoldedPerChannel(const DepthwiseParams& op_params,
+                                  OpData* data, const TfLiteTensor* input,
+                                  const TfLiteTensor* filter,
+                                  TfLiteTensor* output) {
+  const RuntimeShape input_shape = GetTensorShape(input);
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const RuntimeShape output_shape = GetTensorShape(output);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = input_shape.Dims(3);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int depth_multiplier = op_params.depth_multiplier;
+  const int32_t* output_multiplier = PerChannelOutputMultiplier(data);
+  const int32_t* output_shift = PerChannelOutputShift(data);
+
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  const int8_t* filter_data = GetTensorData<int8_t>(filter);
+  const int32_t* bias_data = FoldedBias(data);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = out_y * op_params.stride_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = out_x * op_params.stride_width;
+        for (int in_channel = 0; in_channel < input_depth; ++in_channel) {
+          for (int m = 0; m < depth_multiplier; ++m) {
+            const int out_channel = in_channel * depth_multiplier + m;
+            int32_t acc = bias_data[out_channel];
+            for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+              const int in_y =
+                  in_y_origin + op_params.dilation_height_factor * filter_y;
+              for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+                const int in_x =
+                    in_x_origin + op_params.dilation_width_factor * filter_x;
+                acc += input_data[Offset(input_shape, batch, in_y, in_x,
+                                         in_channel)] *
+                       filter_data[Offset(filter_shape, 0, filter_y,
+                                          filter_x, out_channel)];
+              }
+            }
+            acc = MultiplyByQuantizedMultiplier(
+                acc, output_multiplier[out_channel],
+                output_shift[out_channel]);
+            acc += op_params.output_offset;
+            acc = std::max(acc, op_params.quantized_activation_min);
+            acc = std::min(acc, op_params.quantized_activation_max);
+            *output_data++ = static_cast<int8_t>(acc);
+          }
+        }
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
                                      TfLiteDepthwiseConvParams* params,
                                      OpData* data, const TfLiteTensor* input,
@@ -152,12 +313,12 @@ TfLiteStatus EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
   op_params.dilation_width_factor = params->dilation_width_factor;
   op_params.dilation_height_factor = params->dilation_height_factor;
   op_params.depth_multiplier = params->depth_multiplier;
-  op_params.input_offset = -input->params.zero_point;
+  op_params.input_offset =
+      data->bias_folded ? 0 : -input->params.zero_point;
   op_params.weights_offset = 0;
   op_params.output_offset = output->params.zero_point;
-  // TODO(b/130439627): Use calculated value for clamping.
-  op_params.quantized_activation_min = std::numeric_limits<int8_t>::min();
-  op_params.quantized_activation_max = std::numeric_limits<int8_t>::max();
+  op_params.quantized_activation_min = data->output_activation_min;
+  op_params.quantized_activation_max = data->output_activation_max;
 
 #if defined(__ARM_FEATURE_DSP)
   RuntimeShape filter_shape = GetTensorShape(filter);
@@ -170,54 +331,76 @@ TfLiteStatus EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
   RuntimeShape output_shape = GetTensorShape(output);
   const int output_height = output_shape.Dims(1);
   const int output_width = output_shape.Dims(2);
-  RuntimeShape bias_shape = GetTensorShape(bias);
+  const int output_depth = output_shape.Dims(3);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
 
+  if (op_params.depth_multiplier != 1 && data->bias_folded) {
+    // arm_depthwise_conv_s8 adds the input offset to every activation.
+    return EvalFoldedPerChannel(op_params, data, input, filter, output);
+  }
+
+  // The CMSIS-NN depthwise kernels run one batch at a time.
+  int16_t* buf = nullptr;
   if (op_params.depth_multiplier == 1) {
-    int16_t* buf = nullptr;
     const int32_t buf_size = arm_depthwise_conv_s8_opt_get_buffer_size(
         input_depth, filter_width, filter_height);
     TF_LITE_ENSURE_OK(context,
                       get_cmsis_scratch_buffer(context, &buf, buf_size));
-    TF_LITE_ENSURE_EQ(
-        context,
-        arm_depthwise_conv_s8_opt(
-            GetTensorData<int8_t>(input), input_width, input_height,
-            input_depth, GetTensorData<int8_t>(filter), input_depth,
-            filter_width, filter_height, op_params.padding_values.width,
-            op_params.padding_values.height, op_params.stride_width,
-            op_params.stride_height, GetTensorData<int32>(bias),
-            GetTensorData<int8_t>(output), data->per_channel_output_shift,
-            data->per_channel_output_multiplier, output_width, output_height,
-            op_params.output_offset, op_params.input_offset,
-            op_params.quantized_activation_min,
-            op_params.quantized_activation_max, op_params.dilation_width_factor,
-            op_params.dilation_height_factor, buf),
-        ARM_MATH_SUCCESS);
-  } else {
-    TF_LITE_ENSURE_EQ(
-        context,
-        arm_depthwise_conv_s8(
-            GetTensorData<int8_t>(input), input_width, input_height,
-            input_depth, GetTensorData<int8_t>(filter),
-            op_params.depth_multiplier * input_depth,
-            op_params.depth_multiplier, filter_width, filter_height,
-            op_params.padding_values.width, op_params.padding_values.height,
-            op_params.stride_width, op_params.stride_height,
-            GetTensorData<int32>(bias), GetTensorData<int8_t>(output),
-            data->per_channel_output_shift, data->per_channel_output_multiplier,
-            output_width, output_height, op_params.output_offset,
-            op_params.input_offset, op_params.quantized_activation_min,
-            op_params.quantized_activation_max, op_params.dilation_width_factor,
-            op_params.dilation_height_factor, nullptr),
-        ARM_MATH_SUCCESS);
+  }
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int batch = 0; batch < batches; ++batch) {
+    if (op_params.depth_multiplier == 1) {
+      TF_LITE_ENSURE_EQ(
+          context,
+          arm_depthwise_conv_s8_opt(
+              input_data, input_width, input_height, input_depth,
+              GetTensorData<int8_t>(filter), input_depth, filter_width,
+              filter_height, op_params.padding_values.width,
+              op_params.padding_values.height, op_params.stride_width,
+              op_params.stride_height,
+              data->bias_folded ? FoldedBias(data)
+                                : GetTensorData<int32>(bias),
+              output_data, PerChannelOutputShift(data),
+              PerChannelOutputMultiplier(data), output_width, output_height,
+              op_params.output_offset, op_params.input_offset,
+              op_params.quantized_activation_min,
+              op_params.quantized_activation_max,
+              op_params.dilation_width_factor,
+              op_params.dilation_height_factor, buf),
+          ARM_MATH_SUCCESS);
+    } else {
+      TF_LITE_ENSURE_EQ(
+          context,
+          arm_depthwise_conv_s8(
+              input_data, input_width, input_height, input_depth,
+              GetTensorData<int8_t>(filter),
+              op_params.depth_multiplier * input_depth,
+              op_params.depth_multiplier, filter_width, filter_height,
+              op_params.padding_values.width, op_params.padding_values.height,
+              op_params.stride_width, op_params.stride_height,
+              GetTensorData<int32>(bias), output_data,
+              PerChannelOutputShift(data), PerChannelOutputMultiplier(data),
+              output_width, output_height, op_params.output_offset,
+              op_params.input_offset, op_params.quantized_activation_min,
+              op_params.quantized_activation_max,
+              op_params.dilation_width_factor,
+              op_params.dilation_height_factor, nullptr),
+          ARM_MATH_SUCCESS);
+    }
+    input_data += input_height * input_width * input_depth;
+    output_data += output_height * output_width * output_depth;
   }
 #else
 #pragma message( \
     "CMSIS-NN optimization for depthwise_conv not available for this target. Using reference kernel.")
 
+  if (data->bias_folded) {
+    return EvalFoldedPerChannel(op_params, data, input, filter, output);
+  }
   reference_integer_ops::DepthwiseConvPerChannel(
-      op_params, data->per_channel_output_multiplier,
-      data->per_channel_output_shift, GetTensorShape(input),
+      op_params, PerChannelOutputMultiplier(data),
+      PerChannelOutputShift(data), GetTensorShape(input),
       GetTensorData<int8>(input), GetTensorShape(filter),
       GetTensorData<int8>(filter), GetTensorShape(bias),
       GetTensorData<int32>(bias), GetTensorShape(output),
@@ -227,6 +410,32 @@ TfLiteStatus EvalQuantizedPerChannel(TfLiteContext* context, TfLiteNode* node,
   return kTfLiteOk;
 }
 
+TfLiteStatus EvalQuantizedPerChannelInt16(
+    TfLiteContext* context, TfLiteNode* node, TfLiteDepthwiseConvParams* params,
+    OpData* data, const TfLiteTensor* input, const TfLiteTensor* filter,
+    const TfLiteTensor* bias, TfLiteTensor* output) {
+  DepthwiseParams op_params;
+  op_params.padding_type = PaddingType::kSame;
+  op_params.padding_values.width = data->padding.width;
+  op_params.padding_values.height = data->padding.height;
+  op_params.stride_width = params->stride_width;
+  op_params.stride_height = params->stride_height;
+  op_params.dilation_width_factor = params->dilation_width_factor;
+  op_params.dilation_height_factor = params->dilation_height_factor;
+  op_params.depth_multiplier = params->depth_multiplier;
+  op_params.quantized_activation_min = data->output_activation_min;
+  op_params.quantized_activation_max = data->output_activation_max;
+
+  reference_integer_ops::DepthwiseConvPerChannel(
+      op_params, PerChannelOutputMultiplier(data),
+      PerChannelOutputShift(data), GetTensorShape(input),
+      GetTensorData<int16_t>(input), GetTensorShape(filter),
+      GetTensorData<int8_t>(filter), GetTensorShape(bias),
+      GetTensorData<int64_t>(bias), GetTensorShape(output),
+      GetTensorData<int16_t>(output));
+  return kTfLiteOk;
+}
+
 TfLiteStatus EvalQuantized(TfLiteContext* context, TfLiteNode* node,
                            TfLiteDepthwiseConvParams* params, OpData* data,
                            const TfLiteTensor* input,
@@ -269,18 +478,26 @@ TfLiteStatus EvalQuantized(TfLiteContext* context, TfLiteNode* node,
     RuntimeShape output_shape = GetTensorShape(output);
     const int output_height = output_shape.Dims(1);
     const int output_width = output_shape.Dims(2);
-    arm_depthwise_conv_u8_basic_ver1(
-        GetTensorData<uint8_t>(input), input_width, input_height, input_depth,
-        GetTensorData<uint8_t>(filter), filter_width, filter_height,
-        op_params.depth_multiplier, op_params.padding_values.width,
-        op_params.padding_values.height, op_params.stride_width,
-        op_params.stride_height, op_params.dilation_width_factor,
-        op_params.dilation_height_factor, GetTensorData<int32_t>(bias),
-        op_params.input_offset, op_params.weights_offset,
-        op_params.output_offset, GetTensorData<uint8_t>(output), output_width,
-        output_height, op_params.quantized_activation_min,
-        op_params.quantized_activation_max, op_params.output_shift,
-        op_params.output_multiplier);
+    const int output_depth = output_shape.Dims(3);
+    const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+    const uint8_t* input_data = GetTensorData<uint8_t>(input);
+    uint8_t* output_data = GetTensorData<uint8_t>(output);
+    for (int batch = 0; batch < batches; ++batch) {
+      arm_depthwise_conv_u8_basic_ver1(
+          input_data, input_width, input_height, input_depth,
+          GetTensorData<uint8_t>(filter), filter_width, filter_height,
+          op_params.depth_multiplier, op_params.padding_values.width,
+          op_params.padding_values.height, op_params.stride_width,
+          op_params.stride_height, op_params.dilation_width_factor,
+          op_params.dilation_height_factor, GetTensorData<int32_t>(bias),
+          op_params.input_offset, op_params.weights_offset,
+          op_params.output_offset, output_data, output_width, output_height,
+          op_params.quantized_activation_min,
+          op_params.quantized_activation_max, op_params.output_shift,
+          op_params.output_multiplier);
+      input_data += input_height * input_width * input_depth;
+      output_data += output_height * output_width * output_depth;
+    }
   } else
 #endif
 
@@ -303,51 +520,27 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteTensor* filter = GetInput(context, node, kFilterTensor);
   const TfLiteTensor* bias =
       (NumInputs(node) == 3) ? GetInput(context, node, kBiasTensor) : nullptr;
-
-  const TfLiteType data_type = input->type;
-  int width = SizeOfDimension(input, 2);
-  int height = SizeOfDimension(input, 1);
-  int filter_width = SizeOfDimension(filter, 2);
-  int filter_height = SizeOfDimension(filter, 1);
-
-  OpData data;
-
-  // All per-channel quantized tensors need valid zero point and scale arrays.
-  if (input->type == kTfLiteInt8) {
-    TF_LITE_ENSURE_EQ(context, filter->quantization.type,
-                      kTfLiteAffineQuantization);
-
-    const auto* affine_quantization =
-        reinterpret_cast<TfLiteAffineQuantization*>(
-            filter->quantization.params);
-    TF_LITE_ENSURE(context, affine_quantization);
-    TF_LITE_ENSURE(context, affine_quantization->scale);
-    TF_LITE_ENSURE(context, affine_quantization->zero_point);
-    TF_LITE_ENSURE(
-        context, affine_quantization->scale->size == 1 ||
-                     affine_quantization->scale->size ==
-                         filter->dims->data[kDepthwiseConvQuantizedDimension]);
-    TF_LITE_ENSURE_EQ(context, affine_quantization->scale->size,
-                      affine_quantization->zero_point->size);
-  }
-
-  TF_LITE_ENSURE_STATUS(CalculateOpData(context, node, params, width, height,
-                                        filter_width, filter_height, data_type,
-                                        &data));
+  OpData* data = static_cast<OpData*>(node->user_data);
+  data->padding =
+      GetPatchPadding(context, data->tensor_padding, params->stride_height);
 
   // TODO(aselle): Consider whether float conv and quantized conv should be
   // separate ops to avoid dispatch overhead here.
   switch (input->type) {  // Already know in/out types are same.
     case kTfLiteFloat32:
-      return EvalFloat(context, node, params, &data, input, filter, bias,
+      return EvalFloat(context, node, params, data, input, filter, bias,
                        output);
       break;
     case kTfLiteInt8:
-      return EvalQuantizedPerChannel(context, node, params, &data, input,
+      return EvalQuantizedPerChannel(context, node, params, data, input,
                                      filter, bias, output);
       break;
+    case kTfLiteInt16:
+      return EvalQuantizedPerChannelInt16(context, node, params, data, input,
+                                          filter, bias, output);
+      break;
     case kTfLiteUInt8:
-      return EvalQuantized(context, node, params, &data, input, filter, bias,
+      return EvalQuantized(context, node, params, data, input, filter, bias,
                            output);
       break;
     default:
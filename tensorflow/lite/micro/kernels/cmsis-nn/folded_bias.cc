@@ -0,0 +1,85 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/kernels/cmsis-nn/folded_bias.h"
+
+#include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/compressed_weights.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/block_sparse.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+
+bool CanFoldInputOffset(TfLiteContext* context, const TfLiteTensor* filter,
+                        const TfLiteTensor* bias) {
+  if (filter->type != kTfLiteInt8 || filter->params.zero_point != 0) {
+    return false;
+  }
+  if (filter->allocation_type != kTfLiteMmapRo &&
+      GetCompressedTensor(context, filter) == nullptr) {
+    return false;
+  }
+  return bias == nullptr || (bias->type == kTfLiteInt32 &&
+                             bias->allocation_type == kTfLiteMmapRo);
+}
+
+TfLiteStatus FoldInputOffset(TfLiteContext* context, const TfLiteTensor* filter,
+                             const TfLiteTensor* bias, int32_t input_offset,
+                             int channels, int channel_stride, int depth,
+                             int depth_stride, int32_t* folded_bias) {
+  const int32_t* bias_data = GetTensorData<int32_t>(bias);
+  if (filter->sparsity) {
+    // Skipped blocks are all zero.
+    const BlockSparseMatrix matrix = GetBlockSparseMatrix(filter);
+    TF_LITE_ENSURE_EQ(context, matrix.rows, channels);
+    for (int c = 0; c < channels; ++c) {
+      int32_t sum = 0;
+      for (int i = matrix.segments[c] * matrix.block_size;
+           i < matrix.segments[c + 1] * matrix.block_size; ++i) {
+        sum += matrix.values[i];
+      }
+      folded_bias[c] = (bias_data ? bias_data[c] : 0) + input_offset * sum;
+    }
+    return kTfLiteOk;
+  }
+
+  // Compressed weights are only expanded right before Eval, so they are read
+  // one value at a time from their packed form.
+  const CompressedTensor* compressed = GetCompressedTensor(context, filter);
+  const int8_t* weights = GetTensorData<int8_t>(filter);
+  TF_LITE_ENSURE(context, compressed != nullptr || weights != nullptr);
+  for (int c = 0; c < channels; ++c) {
+    int32_t sum = 0;
+    for (int i = 0; i < depth; ++i) {
+      const int index = c * channel_stride + i * depth_stride;
+      int8_t value;
+      if (compressed != nullptr) {
+        DecompressTensor(*compressed, 1, index, 1,
+                         reinterpret_cast<uint8_t*>(&value));
+      } else {
+        value = weights[index];
+      }
+      sum += value;
+    }
+    folded_bias[c] = (bias_data ? bias_data[c] : 0) + input_offset * sum;
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
@@ -0,0 +1,76 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_FOLDED_BIAS_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_FOLDED_BIAS_H_
+
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+
+// Int8 kernels with constant weights fold the input offset into the bias in
+// Prepare, since
+//   sum(w * (x + input_offset)) + bias = sum(w * x) + folded_bias, where
+//   folded_bias = bias + input_offset * sum(w),
+// and then multiply the activations as they are, without an add per weight.
+// For a convolution this only holds if every filter tap meets an activation.
+// The reference kernels skip taps in the padding, so a kernel folds only if
+// no tap can fall into the padding, or if it pads with the input zero point,
+// whose product with the weights the folded bias cancels.
+
+// Whether FoldInputOffset can read the weights of `filter` and `bias` in
+// Prepare: constant int8 weights with a zero point of 0, dense, compressed or
+// block sparse, and a constant bias, if any.
+bool CanFoldInputOffset(TfLiteContext* context, const TfLiteTensor* filter,
+                        const TfLiteTensor* bias);
+
+// Fills `folded_bias` with one value per output channel of `filter`. Channel
+// c sums `depth` weights starting at c * channel_stride, `depth_stride`
+// apart. Block sparse weights are summed row by row and ignore the strides.
+// `bias` may be null.
+TfLiteStatus FoldInputOffset(TfLiteContext* context, const TfLiteTensor* filter,
+                             const TfLiteTensor* bias, int32_t input_offset,
+                             int channels, int channel_stride, int depth,
+                             int depth_stride, int32_t* folded_bias);
+
+// Whether a filter of `filter_size` taps, at each of `output_size` positions,
+// stays within an input of `input_size` along one dimension, so that there is
+// no padding at either end.
+inline bool FilterStaysInside(int input_size, int filter_size,
+                              int output_size, int stride, int dilation) {
+  return (output_size - 1) * stride + (filter_size - 1) * dilation <
+         input_size;
+}
+
+// Dot product of int8 weights and activations, for targets without the
+// CMSIS-NN DSP kernels.
+inline int32_t DotProductInt8(const int8_t* weights, const int8_t* input,
+                              int size) {
+  int32_t acc = 0;
+  for (int i = 0; i < size; ++i) {
+    acc += weights[i] * input[i];
+  }
+  return acc;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_FOLDED_BIAS_H_
@@ -23,6 +23,12 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/compressed_weights.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/block_sparse.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/folded_bias.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/int4.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/packed_weights.h"
+#include "tensorflow/lite/micro/kernels/cmsis-nn/int16x8.h"
 #include "tensorflow/lite/micro/kernels/cmsis-nn/scratch_buffer.h"
 
 namespace tflite {
@@ -42,8 +48,54 @@ struct OpData {
   int32_t output_activation_max;
   // The index of the temporary tensor where the quantized inputs are cached.
   int input_quantized_index;
+  // Palette compressed weights are expanded `weights_tile_rows` rows at a
+  // time into the CMSIS-NN scratch buffer, instead of as a whole before Eval.
+  // Int4 weights are read in their packed form.
+  bool weights_compressed;
+  bool weights_int4;
+  int weights_tile_rows;
+  // Int8 kernels take the bias with the input offset folded in, stored right
+  // behind the struct for `folded_rows` rows, see folded_bias.h. Zero if the
+  // input offset is added in the inner loop instead.
+  int folded_rows;
+  // With TF_LITE_PACK_WEIGHTS, the packed weights if the arena had room for
+  // them, see packed_weights.h.
+  SpareBuffer packed_weights;
+  bool weights_packed;
+  // Batched int8 inputs are multiplied with the weights as a whole, reading
+  // each weight row once for every two batches instead of once per batch.
+  // The kernel takes per channel multipliers and shifts, stored for
+  // `batch_rows` rows behind the folded bias. Zero for a single batch.
+  int batch_rows;
 };
 
+constexpr int kWeightsTileBytes = 1024;
+// Longest input row expanded to q15 for packed weights. Two rows take 8 KB of
+// the CMSIS-NN scratch buffer.
+constexpr int kMaxPackedDepth = 2048;
+
+int32_t* FoldedBias(const OpData* data) {
+  return reinterpret_cast<int32_t*>(const_cast<OpData*>(data) + 1);
+}
+
+int32_t* BatchMultipliers(const OpData* data) {
+  return FoldedBias(data) + data->folded_rows;
+}
+
+int32_t* BatchShifts(const OpData* data) {
+  return BatchMultipliers(data) + data->batch_rows;
+}
+
+// The bias and input offset the int8 kernels apply.
+const int32_t* Int8Bias(const OpData* data, const TfLiteTensor* bias) {
+  return data->folded_rows > 0 ? FoldedBias(data)
+                               : GetTensorData<int32_t>(bias);
+}
+
+int32_t Int8InputOffset(const OpData* data, const TfLiteTensor* input) {
+  return data->folded_rows > 0 ? 0 : -input->params.zero_point;
+}
+
 constexpr int kInputTensor = 0;
 constexpr int kWeightsTensor = 1;
 constexpr int kBiasTensor = 2;
@@ -78,9 +130,116 @@ void* Init(TfLiteContext* context, const char* buffer, size_t length) {
 
 void Free(TfLiteContext* context, void* buffer) {}
 
+// The output multiplier and activation range are computed here, so that Eval
+// does no floating point math for quantized models.
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   // todo: call AllocateTemporaryTensor() instead of using
   // get_cmsis_scratch_buffer()
+  auto* params =
+      reinterpret_cast<TfLiteFullyConnectedParams*>(node->builtin_data);
+
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = GetInput(context, node, kWeightsTensor);
+  const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+
+  // 16 bit activations with 8 bit weights, all symmetric.
+  if (input->type == kTfLiteInt16) {
+    TF_LITE_ENSURE_EQ(context, filter->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, output->type, kTfLiteInt16);
+    TF_LITE_ENSURE_EQ(context, input->params.zero_point, 0);
+    TF_LITE_ENSURE_EQ(context, filter->params.zero_point, 0);
+    TF_LITE_ENSURE_EQ(context, output->params.zero_point, 0);
+    if (bias) {
+      TF_LITE_ENSURE_EQ(context, bias->type, kTfLiteInt64);
+    }
+  }
+
+  const bool fold = input->type == kTfLiteInt8 &&
+                    NumDimensions(filter) == 2 &&
+                    CanFoldInputOffset(context, filter, bias);
+
+  // Pruned weights are used in their compressed form, which is only read with
+  // the input offset folded into the bias.
+  if (filter->sparsity) {
+    TF_LITE_ENSURE_EQ(context, input->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, NumDimensions(filter), 2);
+    TF_LITE_ENSURE_STATUS(ValidateBlockSparseMatrix(
+        context, filter, SizeOfDimension(filter, 1)));
+    TF_LITE_ENSURE(context, fold);
+  }
+
+  // Only weights read in place from the model are packed.
+#if defined(TF_LITE_PACK_WEIGHTS)
+  const bool pack_weights = fold && !filter->sparsity &&
+                            filter->allocation_type == kTfLiteMmapRo &&
+                            SizeOfDimension(filter, 1) <= kMaxPackedDepth;
+#else
+  const bool pack_weights = false;
+#endif
+  const int folded_rows = fold ? SizeOfDimension(filter, 0) : 0;
+
+  // Only plain int8 weights with a bias are read as a matrix, the other
+  // weight formats have their own batch loops. Weights to be packed may not
+  // get their packed copy, and are then read as a matrix too.
+#if defined(__ARM_FEATURE_DSP)
+  const bool batch_weights =
+      input->type == kTfLiteInt8 && filter->type == kTfLiteInt8 &&
+      NumDimensions(filter) == 2 && filter->params.zero_point == 0 &&
+      (fold || bias != nullptr) && !filter->sparsity &&
+      GetCompressedTensor(context, filter) == nullptr &&
+      NumElements(output) > SizeOfDimension(filter, 0);
+#else
+  const bool batch_weights = false;
+#endif
+  const int batch_rows = batch_weights ? SizeOfDimension(filter, 0) : 0;
+
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context,
+      sizeof(OpData) + (folded_rows + 2 * batch_rows) * sizeof(int32_t),
+      &raw));
+  OpData* data = static_cast<OpData*>(raw);
+  TF_LITE_ENSURE_STATUS(CalculateOpData(context, params, input->type, input,
+                                        filter, bias, output, data));
+  node->user_data = data;
+
+  data->folded_rows = folded_rows;
+  data->packed_weights = SpareBuffer();
+  data->weights_packed = false;
+  data->batch_rows = batch_rows;
+  std::fill(BatchMultipliers(data), BatchMultipliers(data) + batch_rows,
+            data->output_multiplier);
+  std::fill(BatchShifts(data), BatchShifts(data) + batch_rows,
+            -data->output_shift);
+  if (fold) {
+    const int accum_depth = SizeOfDimension(filter, 1);
+    TF_LITE_ENSURE_STATUS(FoldInputOffset(
+        context, filter, bias, -input->params.zero_point, folded_rows,
+        accum_depth, accum_depth, 1, FoldedBias(data)));
+  }
+  if (pack_weights) {
+    RequestSpareBuffer(context, NumElements(filter) * sizeof(int16_t),
+                       &data->packed_weights);
+  }
+
+  // Palette rows longer than a tile are left to the interpreter to expand.
+  // Int4 weights are only read with the input offset folded into the bias.
+  data->weights_compressed = false;
+  data->weights_int4 = false;
+  const CompressedTensor* compressed = GetCompressedTensor(context, filter);
+  if (compressed != nullptr && input->type == kTfLiteInt8 &&
+      filter->type == kTfLiteInt8 && NumDimensions(filter) == 2 &&
+      (compressed->palette == nullptr
+           ? fold
+           : SizeOfDimension(filter, 1) <= kWeightsTileBytes) &&
+      ClaimCompressedTensor(context, filter)) {
+    data->weights_compressed = compressed->palette != nullptr;
+    data->weights_int4 = compressed->palette == nullptr;
+    data->weights_tile_rows = std::min(
+        SizeOfDimension(filter, 0),
+        kWeightsTileBytes / SizeOfDimension(filter, 1));
+  }
   return kTfLiteOk;
 }
 
@@ -89,14 +248,26 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
                                const TfLiteTensor* input,
                                const TfLiteTensor* filter,
                                const TfLiteTensor* bias, TfLiteTensor* output) {
-  RuntimeShape output_shape = GetTensorShape(output);
-  const int batches = output_shape.Dims(0);
-  const int output_depth = output_shape.Dims(1);
   RuntimeShape filter_shape = GetTensorShape(filter);
   const int filter_dim_count = filter_shape.DimensionsCount();
+  const int output_depth = filter_shape.Dims(filter_dim_count - 2);
   const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+  const int batches = NumElements(output) / output_depth;
 
 #if defined(__ARM_FEATURE_DSP)
+  if (data->batch_rows > 0) {
+    TF_LITE_ENSURE_EQ(
+        context,
+        arm_nn_mat_mult_nt_t_s8(
+            GetTensorData<int8_t>(input), GetTensorData<int8_t>(filter),
+            Int8Bias(data, bias), GetTensorData<int8_t>(output),
+            BatchMultipliers(data), BatchShifts(data), batches, output_depth,
+            accum_depth, Int8InputOffset(data, input),
+            output->params.zero_point, data->output_activation_min,
+            data->output_activation_max),
+        ARM_MATH_SUCCESS);
+    return kTfLiteOk;
+  }
   const int32_t buf_size = arm_fully_connected_s8_get_buffer_size(accum_depth);
   int16_t* buf = nullptr;
   TF_LITE_ENSURE_OK(context, get_cmsis_scratch_buffer(context, &buf, buf_size));
@@ -104,16 +275,40 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
       context,
       arm_fully_connected_s8(
           GetTensorData<int8_t>(input), GetTensorData<int8_t>(filter),
-          accum_depth, output_depth, batches, -input->params.zero_point,
+          accum_depth, output_depth, batches, Int8InputOffset(data, input),
           -filter->params.zero_point, data->output_multiplier,
           -data->output_shift, output->params.zero_point,
-          GetTensorData<int32_t>(bias), GetTensorData<int8_t>(output),
+          Int8Bias(data, bias), GetTensorData<int8_t>(output),
           data->output_activation_min, data->output_activation_max, buf),
       ARM_MATH_SUCCESS);
 #else
 #pragma message( \
     "CMSIS-NN optimization for fully_connected not available for this target. Using reference kernel.")
 
+  // With the input offset folded into the bias, each output is a plain dot
+  // product of the int8 input and weights.
+  if (data->folded_rows > 0) {
+    const int8_t* input_data = GetTensorData<int8_t>(input);
+    const int32_t* bias_data = FoldedBias(data);
+    int8_t* output_data = GetTensorData<int8_t>(output);
+    for (int b = 0; b < batches; ++b) {
+      const int8_t* weights = GetTensorData<int8_t>(filter);
+      for (int out_c = 0; out_c < output_depth; ++out_c) {
+        int32_t acc =
+            bias_data[out_c] + DotProductInt8(weights, input_data, accum_depth);
+        weights += accum_depth;
+        acc = MultiplyByQuantizedMultiplier(acc, data->output_multiplier,
+                                            -data->output_shift);
+        acc += output->params.zero_point;
+        acc = std::max(acc, data->output_activation_min);
+        acc = std::min(acc, data->output_activation_max);
+        *output_data++ = static_cast<int8_t>(acc);
+      }
+      input_data += accum_depth;
+    }
+    return kTfLiteOk;
+  }
+
   FullyConnectedParams op_params;
   op_params.input_offset = -input->params.zero_point;
   op_params.weights_offset = -filter->params.zero_point;
@@ -133,6 +328,242 @@ TfLiteStatus EvalQuantizedInt8(TfLiteContext* context, TfLiteNode* node,
   return kTfLiteOk;
 }
 
+// Weights are expanded from their palette one tile of rows at a time, and each
+// tile is applied to all batches before the next one is expanded.
+TfLiteStatus EvalCompressedInt8(TfLiteContext* context, TfLiteNode* node,
+                                const OpData* data, const TfLiteTensor* input,
+                                const TfLiteTensor* filter,
+                                const TfLiteTensor* bias,
+                                TfLiteTensor* output) {
+  const CompressedTensor* weights = GetCompressedTensor(context, filter);
+  TF_LITE_ENSURE(context, weights != nullptr);
+  const int output_depth = SizeOfDimension(filter, 0);
+  const int accum_depth = SizeOfDimension(filter, 1);
+  const int batches = NumElements(output) / output_depth;
+
+  // The tile follows the buffer arm_fully_connected_s8 needs, if any.
+#if defined(__ARM_FEATURE_DSP)
+  const int32_t buf_size =
+      (arm_fully_connected_s8_get_buffer_size(accum_depth) + 3) & ~3;
+#else
+  const int32_t buf_size = 0;
+#endif
+  int16_t* buf = nullptr;
+  TF_LITE_ENSURE_OK(context, get_cmsis_scratch_buffer(
+                                 context, &buf, buf_size + kWeightsTileBytes));
+  int8_t* tile = reinterpret_cast<int8_t*>(buf) + buf_size;
+
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  const int32_t* bias_data = Int8Bias(data, bias);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+#if !defined(__ARM_FEATURE_DSP)
+  FullyConnectedParams op_params;
+  op_params.input_offset = Int8InputOffset(data, input);
+  op_params.weights_offset = -filter->params.zero_point;
+  op_params.output_offset = output->params.zero_point;
+  op_params.output_multiplier = data->output_multiplier;
+  op_params.output_shift = -data->output_shift;
+  op_params.quantized_activation_min = data->output_activation_min;
+  op_params.quantized_activation_max = data->output_activation_max;
+  const RuntimeShape input_shape({1, accum_depth});
+#endif
+
+  for (int row = 0; row < output_depth; row += data->weights_tile_rows) {
+    const int rows = std::min(data->weights_tile_rows, output_depth - row);
+    DecompressTensor(*weights, 1, row * accum_depth, rows * accum_depth,
+                     reinterpret_cast<uint8_t*>(tile));
+    const int32_t* tile_bias = bias_data ? bias_data + row : nullptr;
+    for (int b = 0; b < batches; ++b) {
+      const int8_t* batch_input = input_data + b * accum_depth;
+      int8_t* batch_output = output_data + b * output_depth + row;
+#if defined(__ARM_FEATURE_DSP)
+      TF_LITE_ENSURE_EQ(
+          context,
+          arm_fully_connected_s8(
+              batch_input, tile, accum_depth, rows, 1,
+              Int8InputOffset(data, input), -filter->params.zero_point,
+              data->output_multiplier, -data->output_shift,
+              output->params.zero_point, tile_bias, batch_output,
+              data->output_activation_min, data->output_activation_max, buf),
+          ARM_MATH_SUCCESS);
+#else
+      reference_integer_ops::FullyConnected(
+          op_params, input_shape, batch_input,
+          RuntimeShape({rows, accum_depth}), tile,
+          RuntimeShape({rows}), tile_bias,
+          RuntimeShape({1, rows}), batch_output);
+#endif
+    }
+  }
+  return kTfLiteOk;
+}
+
+int8_t RequantizeOutput(const OpData* data, int32_t acc,
+                        int32_t output_offset) {
+  acc = MultiplyByQuantizedMultiplier(acc, data->output_multiplier,
+                                      -data->output_shift);
+  acc += output_offset;
+  acc = std::max(acc, data->output_activation_min);
+  acc = std::min(acc, data->output_activation_max);
+  return static_cast<int8_t>(acc);
+}
+
+// Batches are taken two at a time: both input rows are expanded to q15 and
+// multiplied with the packed weights, two output rows at a time, see
+// packed_weights.h. A single batch reads each row pair once per input row.
+TfLiteStatus EvalPackedInt8(TfLiteContext* context, TfLiteNode* node,
+                            const OpData* data, const int16_t* packed_weights,
+                            const TfLiteTensor* input,
+                            const TfLiteTensor* filter, TfLiteTensor* output) {
+  const int output_depth = data->folded_rows;
+  const int accum_depth = SizeOfDimension(filter, 1);
+  const int batches = NumElements(output) / output_depth;
+  const int32_t output_offset = output->params.zero_point;
+  int16_t* inputs_q15 = nullptr;
+  TF_LITE_ENSURE_OK(context, get_cmsis_scratch_buffer(
+                                 context, &inputs_q15,
+                                 2 * accum_depth * sizeof(int16_t)));
+  const int16_t* input0 = inputs_q15;
+  const int16_t* input1 = inputs_q15 + accum_depth;
+
+  const int32_t* bias_data = FoldedBias(data);
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int b = 0; b < batches; b += 2) {
+    const int input_count = std::min(2, batches - b);
+    arm_q7_to_q15_no_shift(input_data + b * accum_depth, inputs_q15,
+                           input_count * accum_depth);
+    int8_t* output0 = output_data + b * output_depth;
+    int8_t* output1 = output0 + output_depth;
+
+    const int16_t* weights = packed_weights;
+    int out_c = 0;
+    for (; out_c + 1 < output_depth; out_c += 2) {
+      const int32_t bias0 = bias_data[out_c];
+      const int32_t bias1 = bias_data[out_c + 1];
+      if (input_count == 2) {
+        int32_t acc[4] = {bias0, bias0, bias1, bias1};
+        weights = MultiplyRowPair(weights, input0, input1, accum_depth, acc);
+        output0[out_c] = RequantizeOutput(data, acc[0], output_offset);
+        output1[out_c] = RequantizeOutput(data, acc[1], output_offset);
+        output0[out_c + 1] = RequantizeOutput(data, acc[2], output_offset);
+        output1[out_c + 1] = RequantizeOutput(data, acc[3], output_offset);
+      } else {
+        int32_t acc[2] = {bias0, bias1};
+        weights = MultiplyRowPair(weights, input0, accum_depth, acc);
+        output0[out_c] = RequantizeOutput(data, acc[0], output_offset);
+        output0[out_c + 1] = RequantizeOutput(data, acc[1], output_offset);
+      }
+    }
+    if (out_c < output_depth) {
+      output0[out_c] = RequantizeOutput(
+          data, bias_data[out_c] + DotProductQ15(weights, input0, accum_depth),
+          output_offset);
+      if (input_count == 2) {
+        output1[out_c] = RequantizeOutput(
+            data,
+            bias_data[out_c] + DotProductQ15(weights, input1, accum_depth),
+            output_offset);
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
+// Int4 weights are unpacked within the dot product.
+TfLiteStatus EvalInt4(TfLiteContext* context, TfLiteNode* node,
+                      const OpData* data, const TfLiteTensor* input,
+                      const TfLiteTensor* filter, TfLiteTensor* output) {
+  const CompressedTensor* weights = GetCompressedTensor(context, filter);
+  TF_LITE_ENSURE(context, weights != nullptr);
+  const int output_depth = SizeOfDimension(filter, 0);
+  const int accum_depth = SizeOfDimension(filter, 1);
+  const int batches = NumElements(output) / output_depth;
+  const int32_t output_offset = output->params.zero_point;
+
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  const int32_t* bias_data = FoldedBias(data);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int b = 0; b < batches; ++b) {
+    for (int out_c = 0; out_c < output_depth; ++out_c) {
+      int32_t acc =
+          bias_data[out_c] + DotProductInt4x8(weights->indices,
+                                              out_c * accum_depth, input_data,
+                                              accum_depth);
+      acc = MultiplyByQuantizedMultiplier(acc, data->output_multiplier,
+                                          -data->output_shift);
+      acc += output_offset;
+      acc = std::max(acc, data->output_activation_min);
+      acc = std::min(acc, data->output_activation_max);
+      *output_data++ = static_cast<int8_t>(acc);
+    }
+    input_data += accum_depth;
+  }
+  return kTfLiteOk;
+}
+
+// Only the non-zero blocks of the weights are stored and visited.
+TfLiteStatus EvalSparseInt8(TfLiteContext* context, TfLiteNode* node,
+                            const OpData* data, const TfLiteTensor* input,
+                            const TfLiteTensor* filter, TfLiteTensor* output) {
+  const BlockSparseMatrix matrix = GetBlockSparseMatrix(filter);
+  const int output_depth = matrix.rows;
+  const int accum_depth = SizeOfDimension(filter, 1);
+  const int batches = NumElements(output) / output_depth;
+  const int32_t output_offset = output->params.zero_point;
+
+  const int8_t* input_data = GetTensorData<int8_t>(input);
+  const int32_t* bias_data = FoldedBias(data);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int b = 0; b < batches; ++b) {
+    for (int out_c = 0; out_c < output_depth; ++out_c) {
+      int32_t acc =
+          bias_data[out_c] + BlockSparseDotProduct(matrix, out_c, input_data);
+      acc = MultiplyByQuantizedMultiplier(acc, data->output_multiplier,
+                                          -data->output_shift);
+      acc += output_offset;
+      acc = std::max(acc, data->output_activation_min);
+      acc = std::min(acc, data->output_activation_max);
+      *output_data++ = static_cast<int8_t>(acc);
+    }
+    input_data += accum_depth;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus EvalQuantizedInt16(TfLiteContext* context, TfLiteNode* node,
+                                const OpData* data, const TfLiteTensor* input,
+                                const TfLiteTensor* filter,
+                                const TfLiteTensor* bias,
+                                TfLiteTensor* output) {
+  const RuntimeShape filter_shape = GetTensorShape(filter);
+  const int filter_dim_count = filter_shape.DimensionsCount();
+  const int output_depth = filter_shape.Dims(filter_dim_count - 2);
+  const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+  const int batches = NumElements(output) / output_depth;
+
+  const int16_t* input_data = GetTensorData<int16_t>(input);
+  const int8_t* filter_data = GetTensorData<int8_t>(filter);
+  const int64_t* bias_data = GetTensorData<int64_t>(bias);
+  int16_t* output_data = GetTensorData<int16_t>(output);
+  for (int b = 0; b < batches; ++b) {
+    for (int out_c = 0; out_c < output_depth; ++out_c) {
+      int64_t acc = DotProductInt16x8(
+          input_data, filter_data + out_c * accum_depth, accum_depth);
+      if (bias_data) {
+        acc += bias_data[out_c];
+      }
+      int32_t scaled = MultiplyByQuantizedMultiplier64(
+          acc, data->output_multiplier, -data->output_shift);
+      scaled = std::max(scaled, data->output_activation_min);
+      scaled = std::min(scaled, data->output_activation_max);
+      *output_data++ = static_cast<int16_t>(scaled);
+    }
+    input_data += accum_depth;
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus EvalQuantized(TfLiteContext* context, TfLiteNode* node,
                            TfLiteFullyConnectedParams* params, OpData* data,
                            const TfLiteTensor* input,
@@ -202,17 +633,34 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
   TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
 
-  TfLiteType data_type = input->type;
-  OpData local_data_object;
-  OpData* data = &local_data_object;
-  TF_LITE_ENSURE_STATUS(CalculateOpData(context, params, data_type, input,
-                                        filter, bias, output, data));
+  OpData* data = static_cast<OpData*>(node->user_data);
 
   switch (filter->type) {  // Already know in/out types are same.
     case kTfLiteFloat32:
       return EvalFloat(context, node, params, data, input, filter, bias,
                        output);
     case kTfLiteInt8:
+      if (input->type == kTfLiteInt16) {
+        return EvalQuantizedInt16(context, node, data, input, filter, bias,
+                                  output);
+      }
+      if (data->weights_int4) {
+        return EvalInt4(context, node, data, input, filter, output);
+      }
+      if (data->weights_compressed) {
+        return EvalCompressedInt8(context, node, data, input, filter, bias,
+                                  output);
+      }
+      if (filter->sparsity) {
+        return EvalSparseInt8(context, node, data, input, filter, output);
+      }
+      if (const int16_t* packed_weights = GetPackedWeights(
+              data->packed_weights, GetTensorData<int8_t>(filter),
+              data->folded_rows, SizeOfDimension(filter, 1),
+              &data->weights_packed)) {
+        return EvalPackedInt8(context, node, data, packed_weights, input,
+                              filter, output);
+      }
       return EvalQuantizedInt8(context, node, params, data, input, filter, bias,
                                output);
 
@@ -0,0 +1,57 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_INT16X8_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_INT16X8_H_
+
+#include <cstdint>
+
+#include "arm_nnsupportfunctions.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+
+// Dot product of 16 bit activations and 8 bit weights, as used by the 16x8
+// quantized kernels. Both are symmetric, so no offsets are applied. The
+// accumulator has 64 bits, products of a q15 and a q7 value use up to 22 bits
+// and would overflow 32 bits after a few hundred accumulations.
+inline int64_t DotProductInt16x8(const int16_t* input, const int8_t* filter,
+                                 int size) {
+  int64_t acc = 0;
+#if defined(__ARM_FEATURE_DSP)
+  // Same expansion of the weights as arm_nn_mat_mult_kernel_q7_q15, but with
+  // a dual 64 bit multiply-accumulate.
+  for (; size >= 4; size -= 4) {
+    q31_t filter_01;
+    q31_t filter_23;
+    filter = read_and_pad(filter, &filter_01, &filter_23);
+    const q31_t input_01 = arm_nn_read_q15x2_ia(&input);
+    const q31_t input_23 = arm_nn_read_q15x2_ia(&input);
+    acc = static_cast<int64_t>(__SMLALD(input_01, filter_01, acc));
+    acc = static_cast<int64_t>(__SMLALD(input_23, filter_23, acc));
+  }
+#endif
+  for (; size > 0; --size) {
+    acc += static_cast<int32_t>(*input++) * *filter++;
+  }
+  return acc;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_INT16X8_H_
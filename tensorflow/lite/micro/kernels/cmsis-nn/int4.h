@@ -0,0 +1,83 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_INT4_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_INT4_H_
+
+#include <cstdint>
+
+#include "arm_nnsupportfunctions.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+
+// Value `index` of int4 weights packed two per byte, low nibble first.
+inline int32_t GetInt4Value(const uint8_t* packed, int index) {
+  const uint8_t byte = packed[index / 2];
+  return static_cast<int8_t>(index % 2 ? byte & 0xF0 : byte << 4) >> 4;
+}
+
+// Dot product of `size` int4 weights, starting at value `start` of `filter`,
+// and int8 activations, whose offset the caller folds into the bias. The
+// weights are sign extended right in the loop, so they never take more than
+// half a byte in memory.
+inline int32_t DotProductInt4x8(const uint8_t* filter, int start,
+                                const int8_t* input, int size) {
+  int32_t acc = 0;
+  if (start % 2 != 0 && size > 0) {
+    acc += GetInt4Value(filter, start) * *input++;
+    ++start;
+    --size;
+  }
+  filter += start / 2;
+#if defined(__ARM_FEATURE_DSP)
+  // Masking moves the even and the odd values into the top nibble of each
+  // byte, so __SXTB16 yields them times 16. Four of them pair with the
+  // activations of the same index through __PKHBT and __PKHTB.
+  int32_t acc_x16 = 0;
+  for (; size >= 8; size -= 8) {
+    const uint32_t packed =
+        arm_nn_read_q7x4_ia(reinterpret_cast<const q7_t**>(&filter));
+    const q31_t even = (packed << 4) & 0xF0F0F0F0;
+    const q31_t odd = packed & 0xF0F0F0F0;
+    const q31_t input_0123 = arm_nn_read_q7x4_ia(&input);
+    const q31_t input_4567 = arm_nn_read_q7x4_ia(&input);
+    const q31_t input_02 = __SXTB16(input_0123);
+    const q31_t input_46 = __SXTB16(input_4567);
+    const q31_t input_13 = __SXTB16(__ROR(input_0123, 8));
+    const q31_t input_57 = __SXTB16(__ROR(input_4567, 8));
+    acc_x16 = __SMLAD(__SXTB16(even), __PKHBT(input_02, input_46, 16),
+                      acc_x16);
+    acc_x16 = __SMLAD(__SXTB16(__ROR(even, 8)),
+                      __PKHTB(input_46, input_02, 16), acc_x16);
+    acc_x16 = __SMLAD(__SXTB16(odd), __PKHBT(input_13, input_57, 16),
+                      acc_x16);
+    acc_x16 = __SMLAD(__SXTB16(__ROR(odd, 8)),
+                      __PKHTB(input_57, input_13, 16), acc_x16);
+  }
+  acc += acc_x16 >> 4;
+#endif
+  for (int i = 0; i < size; ++i) {
+    acc += GetInt4Value(filter, i) * input[i];
+  }
+  return acc;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_INT4_H_
@@ -0,0 +1,183 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_PACKED_WEIGHTS_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_PACKED_WEIGHTS_H_
+
+#include <cstdint>
+
+#include "arm_nnsupportfunctions.h"
+#include "tensorflow/lite/micro/spare_buffers.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+
+// With TF_LITE_PACK_WEIGHTS, int8 conv and fully connected kernels keep a
+// copy of their weights widened to q15 in a spare buffer, see
+// spare_buffers.h, which costs two bytes of RAM per weight. int8 filters are
+// symmetric, so there is no filter offset to add, and the input offset goes
+// into the folded bias, see folded_bias.h.
+//
+// The kernels follow the 2x2 blocking of arm_nn_mat_mult_kernel_s8_s16: two
+// output channels times two q15 columns (im2col columns or batches) per
+// pass. Rows are packed in pairs, interleaved two weights at a time, so that
+// a pass reads both rows from one pointer as q15 pairs with no sign
+// extension or reordering:
+//
+//   r0[0] r0[1] r1[0] r1[1] r0[2] r0[3] r1[2] r1[3] ...
+//
+// An odd last column is stored as r0[n - 1] r1[n - 1], and an odd last row
+// follows the pairs as is. Kernels whose copy did not fit read the int8
+// weights as usual.
+
+// Fills `packed` with the `rows` x `cols` weights in the layout above.
+inline void PackWeights(const int8_t* weights, int rows, int cols,
+                        int16_t* packed) {
+  for (int row = 0; row + 1 < rows; row += 2) {
+    const int8_t* row0 = weights + row * cols;
+    const int8_t* row1 = row0 + cols;
+    int col = 0;
+    for (; col + 1 < cols; col += 2) {
+      *packed++ = row0[col];
+      *packed++ = row0[col + 1];
+      *packed++ = row1[col];
+      *packed++ = row1[col + 1];
+    }
+    if (col < cols) {
+      *packed++ = row0[col];
+      *packed++ = row1[col];
+    }
+  }
+  if (rows % 2 == 1) {
+    const int8_t* row = weights + (rows - 1) * cols;
+    for (int col = 0; col < cols; ++col) {
+      *packed++ = row[col];
+    }
+  }
+}
+
+// The packed copy of the `rows` x `cols` weights in `buffer`, filled on the
+// first call and flagged in `packed`, or null if the arena had no room for
+// it.
+inline const int16_t* GetPackedWeights(const SpareBuffer& buffer,
+                                       const int8_t* weights, int rows,
+                                       int cols, bool* packed) {
+  int16_t* packed_weights = static_cast<int16_t*>(GetSpareBuffer(buffer));
+  if (packed_weights != nullptr && !*packed) {
+    PackWeights(weights, rows, cols, packed_weights);
+    *packed = true;
+  }
+  return packed_weights;
+}
+
+// Adds the products of a packed row pair with two q15 columns of `size`
+// values to `acc`: row 0 in acc[0] and acc[1], row 1 in acc[2] and acc[3].
+// Returns the next row pair.
+inline const int16_t* MultiplyRowPair(const int16_t* weights,
+                                      const int16_t* column0,
+                                      const int16_t* column1, int size,
+                                      int32_t* acc) {
+  int32_t acc00 = acc[0];
+  int32_t acc01 = acc[1];
+  int32_t acc10 = acc[2];
+  int32_t acc11 = acc[3];
+  for (; size >= 2; size -= 2) {
+#if defined(__ARM_FEATURE_DSP)
+    const int32_t a0 = arm_nn_read_q15x2_ia(&weights);
+    const int32_t a1 = arm_nn_read_q15x2_ia(&weights);
+    const int32_t b0 = arm_nn_read_q15x2_ia(&column0);
+    const int32_t b1 = arm_nn_read_q15x2_ia(&column1);
+    acc00 = __SMLAD(a0, b0, acc00);
+    acc01 = __SMLAD(a0, b1, acc01);
+    acc10 = __SMLAD(a1, b0, acc10);
+    acc11 = __SMLAD(a1, b1, acc11);
+#else
+    acc00 += weights[0] * column0[0] + weights[1] * column0[1];
+    acc01 += weights[0] * column1[0] + weights[1] * column1[1];
+    acc10 += weights[2] * column0[0] + weights[3] * column0[1];
+    acc11 += weights[2] * column1[0] + weights[3] * column1[1];
+    weights += 4;
+    column0 += 2;
+    column1 += 2;
+#endif
+  }
+  if (size > 0) {
+    acc00 += weights[0] * *column0;
+    acc01 += weights[0] * *column1;
+    acc10 += weights[1] * *column0;
+    acc11 += weights[1] * *column1;
+    weights += 2;
+  }
+  acc[0] = acc00;
+  acc[1] = acc01;
+  acc[2] = acc10;
+  acc[3] = acc11;
+  return weights;
+}
+
+// Same with a single column: row 0 in acc[0], row 1 in acc[1].
+inline const int16_t* MultiplyRowPair(const int16_t* weights,
+                                      const int16_t* column, int size,
+                                      int32_t* acc) {
+  int32_t acc0 = acc[0];
+  int32_t acc1 = acc[1];
+  for (; size >= 2; size -= 2) {
+#if defined(__ARM_FEATURE_DSP)
+    const int32_t a0 = arm_nn_read_q15x2_ia(&weights);
+    const int32_t a1 = arm_nn_read_q15x2_ia(&weights);
+    const int32_t b = arm_nn_read_q15x2_ia(&column);
+    acc0 = __SMLAD(a0, b, acc0);
+    acc1 = __SMLAD(a1, b, acc1);
+#else
+    acc0 += weights[0] * column[0] + weights[1] * column[1];
+    acc1 += weights[2] * column[0] + weights[3] * column[1];
+    weights += 4;
+    column += 2;
+#endif
+  }
+  if (size > 0) {
+    acc0 += weights[0] * *column;
+    acc1 += weights[1] * *column;
+    weights += 2;
+  }
+  acc[0] = acc0;
+  acc[1] = acc1;
+  return weights;
+}
+
+// Dot product of the odd last row of packed weights and a q15 column.
+inline int32_t DotProductQ15(const int16_t* weights, const int16_t* input,
+                             int size) {
+  int32_t acc = 0;
+#if defined(__ARM_FEATURE_DSP)
+  for (; size >= 4; size -= 4) {
+    acc = __SMLAD(arm_nn_read_q15x2_ia(&weights), arm_nn_read_q15x2_ia(&input),
+                  acc);
+    acc = __SMLAD(arm_nn_read_q15x2_ia(&weights), arm_nn_read_q15x2_ia(&input),
+                  acc);
+  }
+#endif
+  for (; size > 0; --size) {
+    acc += *weights++ * *input++;
+  }
+  return acc;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_CMSIS_NN_PACKED_WEIGHTS_H_
@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/patch_execution.h"
 
 namespace tflite {
 namespace ops {
@@ -34,25 +35,38 @@ constexpr int kInputTensor = 0;
 constexpr int kOutputTensor = 0;
 
 struct OpData {
+  // Padding of the full tensors, computed in Prepare, and of the rows the node
+  // runs on, set in Eval. They differ while it runs on a strip of a patched
+  // prefix, see patch_execution.h.
+  TfLitePaddingValues tensor_padding;
   TfLitePaddingValues padding;
+  // Quantized range of the fused activation, unused for float.
+  int32_t activation_min;
+  int32_t activation_max;
 };
 
-TfLiteStatus CalculateOpData(const TfLiteContext* context,
+TfLiteStatus CalculateOpData(TfLiteContext* context,
                              const TfLitePoolParams* params,
-                             const TfLiteTensor* input,
-                             const TfLiteTensor* output, OpData* data) {
+                             const TfLiteTensor* input, TfLiteTensor* output,
+                             OpData* data) {
   // input: batch, height, width, channel
   int height = SizeOfDimension(input, 1);
   int width = SizeOfDimension(input, 2);
 
   int out_height, out_width;
 
-  data->padding = ComputePaddingHeightWidth(
+  data->tensor_padding = ComputePaddingHeightWidth(
       params->stride_height, params->stride_width,
       /*dilation_rate_height=*/1,
       /*dilation_rate_width=*/1, height, width, params->filter_height,
       params->filter_width, params->padding, &out_height, &out_width);
+  data->padding = data->tensor_padding;
 
+  if (input->type == kTfLiteUInt8 || input->type == kTfLiteInt8) {
+    TF_LITE_ENSURE_STATUS(CalculateActivationRangeQuantized(
+        context, params->activation, output, &data->activation_min,
+        &data->activation_max));
+  }
   return kTfLiteOk;
 }
 
@@ -80,9 +94,8 @@ void AverageEvalFloat(const TfLiteContext* context, const TfLiteNode* node,
 void AverageEvalUint8(TfLiteContext* context, const TfLiteNode* node,
                       const TfLitePoolParams* params, const OpData* data,
                       const TfLiteTensor* input, TfLiteTensor* output) {
-  int32_t activation_min, activation_max;
-  (void)CalculateActivationRangeQuantized(context, params->activation, output,
-                                          &activation_min, &activation_max);
+  const int32_t activation_min = data->activation_min;
+  const int32_t activation_max = data->activation_max;
 
   PoolParams op_params;
   op_params.stride_height = params->stride_height;
@@ -101,9 +114,8 @@ void AverageEvalUint8(TfLiteContext* context, const TfLiteNode* node,
 TfLiteStatus AverageEvalInt8(TfLiteContext* context, const TfLiteNode* node,
                              const TfLitePoolParams* params, const OpData* data,
                              TfLiteTensor* input, TfLiteTensor* output) {
-  int32_t activation_min, activation_max;
-  (void)CalculateActivationRangeQuantized(context, params->activation, output,
-                                          &activation_min, &activation_max);
+  const int32_t activation_min = data->activation_min;
+  const int32_t activation_max = data->activation_max;
 
   TFLITE_DCHECK_LE(activation_min, activation_max);
 
@@ -133,14 +145,22 @@ TfLiteStatus AverageEvalInt8(TfLiteContext* context, const TfLiteNode* node,
   TF_LITE_ENSURE_OK(
       context, get_cmsis_scratch_buffer(context, &scratch_buffer, buffer_size));
 
-  TF_LITE_ENSURE_EQ(
-      context,
-      arm_avgpool_s8(input_height, input_width, output_height, output_width,
-                     stride_height, stride_width, filter_height, filter_width,
-                     padding_height, padding_width, activation_min,
-                     activation_max, depth, GetTensorData<int8_t>(input),
-                     scratch_buffer, GetTensorData<int8_t>(output)),
-      ARM_MATH_SUCCESS);
+  // arm_avgpool_s8 pools one batch at a time.
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  int8_t* input_data = GetTensorData<int8_t>(input);
+  int8_t* output_data = GetTensorData<int8_t>(output);
+  for (int batch = 0; batch < batches; ++batch) {
+    TF_LITE_ENSURE_EQ(
+        context,
+        arm_avgpool_s8(input_height, input_width, output_height, output_width,
+                       stride_height, stride_width, filter_height,
+                       filter_width, padding_height, padding_width,
+                       activation_min, activation_max, depth, input_data,
+                       scratch_buffer, output_data),
+        ARM_MATH_SUCCESS);
+    input_data += input_height * input_width * depth;
+    output_data += output_height * output_width * depth;
+  }
 #else
 #pragma message( \
     "CMSIS-NN optimization for depthwise_conv not available for this target. Using reference kernel.")
@@ -186,9 +206,8 @@ void MaxEvalFloat(TfLiteContext* context, TfLiteNode* node,
 void MaxEvalQuantizedUInt8(TfLiteContext* context, TfLiteNode* node,
                            TfLitePoolParams* params, OpData* data,
                            const TfLiteTensor* input, TfLiteTensor* output) {
-  int32_t activation_min, activation_max;
-  (void)CalculateActivationRangeQuantized(context, params->activation, output,
-                                          &activation_min, &activation_max);
+  const int32_t activation_min = data->activation_min;
+  const int32_t activation_max = data->activation_max;
 
   tflite::PoolParams op_params;
   op_params.stride_height = params->stride_height;
@@ -212,31 +231,44 @@ void* Init(TfLiteContext* context, const char* buffer, size_t length) {
 
 void Free(TfLiteContext* context, void* buffer) {}
 
+// Padding and activation range are computed here, so that Eval does no
+// floating point math for quantized models.
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  auto* params = reinterpret_cast<TfLitePoolParams*>(node->builtin_data);
+
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(OpData), &raw));
+  OpData* data = static_cast<OpData*>(raw);
+  TF_LITE_ENSURE_STATUS(CalculateOpData(context, params, input, output, data));
+  node->user_data = data;
   return kTfLiteOk;
 }
 
 TfLiteStatus AverageEval(TfLiteContext* context, TfLiteNode* node) {
   auto* params = reinterpret_cast<TfLitePoolParams*>(node->builtin_data);
-  OpData data;
+  OpData* data = static_cast<OpData*>(node->user_data);
+  data->padding =
+      GetPatchPadding(context, data->tensor_padding, params->stride_height);
 
   // Todo: make 'input' const once CMSIS-reuse is fixed
   TfLiteTensor* input = &context->tensors[flatbuffers::EndianScalar(
       node->inputs->data[kInputTensor])];
   TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
 
-  TF_LITE_ENSURE_STATUS(CalculateOpData(context, params, input, output, &data));
-
   // Inputs and outputs share the same type, guarenteed by the converter.
   switch (input->type) {
     case kTfLiteFloat32:
-      AverageEvalFloat(context, node, params, &data, input, output);
+      AverageEvalFloat(context, node, params, data, input, output);
       break;
     case kTfLiteUInt8:
-      AverageEvalUint8(context, node, params, &data, input, output);
+      AverageEvalUint8(context, node, params, data, input, output);
       break;
     case kTfLiteInt8:
-      return AverageEvalInt8(context, node, params, &data, input, output);
+      return AverageEvalInt8(context, node, params, data, input, output);
       break;
     default:
       TF_LITE_KERNEL_LOG(context, "Input type %s is not currently supported",
@@ -248,19 +280,19 @@ TfLiteStatus AverageEval(TfLiteContext* context, TfLiteNode* node) {
 
 TfLiteStatus MaxEval(TfLiteContext* context, TfLiteNode* node) {
   auto* params = reinterpret_cast<TfLitePoolParams*>(node->builtin_data);
-  OpData data;
+  OpData* data = static_cast<OpData*>(node->user_data);
+  data->padding =
+      GetPatchPadding(context, data->tensor_padding, params->stride_height);
 
   const TfLiteTensor* input = GetInput(context, node, kInputTensor);
   TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
 
-  TF_LITE_ENSURE_STATUS(CalculateOpData(context, params, input, output, &data));
-
   switch (input->type) {
     case kTfLiteFloat32:
-      MaxEvalFloat(context, node, params, &data, input, output);
+      MaxEvalFloat(context, node, params, data, input, output);
       break;
     case kTfLiteUInt8:
-      MaxEvalQuantizedUInt8(context, node, params, &data, input, output);
+      MaxEvalQuantizedUInt8(context, node, params, data, input, output);
       break;
     default:
       TF_LITE_KERNEL_LOG(context, "Type %s not currently supported.",
@@ -14,11 +14,19 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/lite/kernels/internal/reference/comparisons.h"
 
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 
+#if defined(__ARM_FEATURE_DSP)
+#include "arm_math.h"
+#endif
+
 namespace tflite {
 namespace ops {
 namespace micro {
@@ -29,271 +37,288 @@ constexpr int kInputTensor1 = 0;
 constexpr int kInputTensor2 = 1;
 constexpr int kOutputTensor = 0;
 
-// TODO(ruic): optimize macros below to using template functions.
-#define TF_LITE_QUANTIZE_COMPARISON(opname)                                    \
-  template <typename input_dtype>                                              \
-  void EvalQuantized##opname(TfLiteContext* context, TfLiteNode* node,         \
-                             const TfLiteTensor* input1,                       \
-                             const TfLiteTensor* input2, TfLiteTensor* output, \
-                             bool requires_broadcast) {                        \
-    if (input1->type == kTfLiteUInt8 || input1->type == kTfLiteInt8) {         \
-      auto input1_offset = -input1->params.zero_point;                         \
-      auto input2_offset = -input2->params.zero_point;                         \
-      const int left_shift = 8;                                                \
-                                                                               \
-      int32 input1_multiplier;                                                 \
-      int input1_shift;                                                        \
-      QuantizeMultiplierSmallerThanOneExp(                                     \
-          static_cast<double>(input1->params.scale), &input1_multiplier,       \
-          &input1_shift);                                                      \
-      int32 input2_multiplier;                                                 \
-      int input2_shift;                                                        \
-      QuantizeMultiplierSmallerThanOneExp(                                     \
-          static_cast<double>(input2->params.scale), &input2_multiplier,       \
-          &input2_shift);                                                      \
-                                                                               \
-      ComparisonParams op_params;                                              \
-      op_params.left_shift = left_shift;                                       \
-      op_params.input1_offset = input1_offset;                                 \
-      op_params.input1_multiplier = input1_multiplier;                         \
-      op_params.input1_shift = input1_shift;                                   \
-      op_params.input2_offset = input2_offset;                                 \
-      op_params.input2_multiplier = input2_multiplier;                         \
-      op_params.input2_shift = input2_shift;                                   \
-      if (requires_broadcast) {                                                \
-        reference_ops::Broadcast4DSlow##opname##WithScaling(                   \
-            op_params, GetTensorShape(input1),                                 \
-            GetTensorData<input_dtype>(input1), GetTensorShape(input2),        \
-            GetTensorData<input_dtype>(input2), GetTensorShape(output),        \
-            GetTensorData<bool>(output));                                      \
-      } else {                                                                 \
-        reference_ops::opname##WithScaling(                                    \
-            op_params, GetTensorShape(input1),                                 \
-            GetTensorData<input_dtype>(input1), GetTensorShape(input2),        \
-            GetTensorData<input_dtype>(input2), GetTensorShape(output),        \
-            GetTensorData<bool>(output));                                      \
-      }                                                                        \
-    }                                                                          \
+// How the inputs line up with each other, decided in Prepare. Only the
+// generic case needs the 4D index arithmetic of the reference kernels.
+enum BroadcastType {
+  kNoBroadcast,
+  // input2 is a single value, e.g. a threshold.
+  kScalarInput2,
+  kGenericBroadcast,
+};
+
+struct OpData {
+  BroadcastType broadcast;
+  // Set for int8 and uint8 inputs with different scales or zero points,
+  // which have to be rescaled with `params` before comparing. With the same
+  // quantization the codes are ordered like the real values and are compared
+  // directly.
+  bool rescale;
+  ComparisonParams params;
+};
+
+#if defined(__ARM_FEATURE_DSP)
+constexpr uint32_t kPackedTrue = 0x01010101u;
+
+// Four 1-byte values per word. SSUB8/USUB8 set the GE flag of every lane
+// where `lhs` is not below `rhs`, and SEL turns the flags into bools.
+template <typename T>
+uint32_t PackedGreaterEqual(uint32_t lhs, uint32_t rhs) {
+  if (std::numeric_limits<T>::is_signed) {
+    __SSUB8(lhs, rhs);
+  } else {
+    __USUB8(lhs, rhs);
   }
-TF_LITE_QUANTIZE_COMPARISON(Equal);
-TF_LITE_QUANTIZE_COMPARISON(NotEqual);
-TF_LITE_QUANTIZE_COMPARISON(Greater);
-TF_LITE_QUANTIZE_COMPARISON(GreaterEqual);
-TF_LITE_QUANTIZE_COMPARISON(Less);
-TF_LITE_QUANTIZE_COMPARISON(LessEqual);
-#undef TF_LITE_QUANTIZE_COMPARISON
-
-#define TF_LITE_COMPARISON(type, opname, requires_broadcast)                  \
-  {                                                                           \
-    ComparisonParams op_params;                                               \
-    requires_broadcast                                                        \
-        ? reference_ops::Broadcast4DSlow##opname##NoScaling(                  \
-              op_params, GetTensorShape(input1), GetTensorData<type>(input1), \
-              GetTensorShape(input2), GetTensorData<type>(input2),            \
-              GetTensorShape(output), GetTensorData<bool>(output))            \
-        : reference_ops::opname##NoScaling(                                   \
-              op_params, GetTensorShape(input1), GetTensorData<type>(input1), \
-              GetTensorShape(input2), GetTensorData<type>(input2),            \
-              GetTensorShape(output), GetTensorData<bool>(output));           \
+  return __SEL(kPackedTrue, 0);
+}
+
+// A lane of `lhs ^ rhs` is only not above 0 if it is 0.
+inline uint32_t PackedEqual(uint32_t lhs, uint32_t rhs) {
+  __USUB8(0, lhs ^ rhs);
+  return __SEL(kPackedTrue, 0);
+}
+#endif
+
+struct EqualOp {
+  template <typename T>
+  static bool op(T lhs, T rhs) {
+    return lhs == rhs;
+  }
+#if defined(__ARM_FEATURE_DSP)
+  template <typename T>
+  static uint32_t packed_op(uint32_t lhs, uint32_t rhs) {
+    return PackedEqual(lhs, rhs);
   }
+#endif
+};
 
-TfLiteStatus EqualEval(TfLiteContext* context, TfLiteNode* node) {
-  const TfLiteTensor* input1 = GetInput(context, node, kInputTensor1);
-  const TfLiteTensor* input2 = GetInput(context, node, kInputTensor2);
-  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
-  bool requires_broadcast = !HaveSameShapes(input1, input2);
-  switch (input1->type) {
-    case kTfLiteBool:
-      TF_LITE_COMPARISON(bool, Equal, requires_broadcast);
-      break;
-    case kTfLiteFloat32:
-      TF_LITE_COMPARISON(float, Equal, requires_broadcast);
-      break;
-    case kTfLiteInt32:
-      TF_LITE_COMPARISON(int32_t, Equal, requires_broadcast);
-      break;
-    case kTfLiteInt64:
-      TF_LITE_COMPARISON(int64_t, Equal, requires_broadcast);
-      break;
-    case kTfLiteUInt8:
-      EvalQuantizedEqual<uint8_t>(context, node, input1, input2, output,
-                                  requires_broadcast);
-      break;
-    case kTfLiteInt8:
-      EvalQuantizedEqual<int8_t>(context, node, input1, input2, output,
-                                 requires_broadcast);
-      break;
-    default:
-      TF_LITE_KERNEL_LOG(
-          context, "Does not support type %d, requires bool|float|int|uint8",
-          input1->type);
-      return kTfLiteError;
+struct NotEqualOp {
+  template <typename T>
+  static bool op(T lhs, T rhs) {
+    return lhs != rhs;
   }
-  return kTfLiteOk;
-}
+#if defined(__ARM_FEATURE_DSP)
+  template <typename T>
+  static uint32_t packed_op(uint32_t lhs, uint32_t rhs) {
+    return PackedEqual(lhs, rhs) ^ kPackedTrue;
+  }
+#endif
+};
 
-// TODO(renjieliu): Refactor the logic to avoid duplications.
-TfLiteStatus NotEqualEval(TfLiteContext* context, TfLiteNode* node) {
-  const TfLiteTensor* input1 = GetInput(context, node, kInputTensor1);
-  const TfLiteTensor* input2 = GetInput(context, node, kInputTensor2);
-  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
-  bool requires_broadcast = !HaveSameShapes(input1, input2);
-  switch (input1->type) {
-    case kTfLiteBool:
-      TF_LITE_COMPARISON(bool, NotEqual, requires_broadcast);
-      break;
-    case kTfLiteFloat32:
-      TF_LITE_COMPARISON(float, NotEqual, requires_broadcast);
-      break;
-    case kTfLiteInt32:
-      TF_LITE_COMPARISON(int32_t, NotEqual, requires_broadcast);
-      break;
-    case kTfLiteInt64:
-      TF_LITE_COMPARISON(int64_t, NotEqual, requires_broadcast);
-      break;
-    case kTfLiteUInt8:
-      EvalQuantizedNotEqual<uint8_t>(context, node, input1, input2, output,
-                                     requires_broadcast);
-      break;
-    case kTfLiteInt8:
-      EvalQuantizedNotEqual<int8_t>(context, node, input1, input2, output,
-                                    requires_broadcast);
-      break;
-    default:
-      TF_LITE_KERNEL_LOG(
-          context, "Does not support type %d, requires bool|float|int|uint8",
-          input1->type);
-      return kTfLiteError;
+struct GreaterOp {
+  template <typename T>
+  static bool op(T lhs, T rhs) {
+    return lhs > rhs;
+  }
+#if defined(__ARM_FEATURE_DSP)
+  template <typename T>
+  static uint32_t packed_op(uint32_t lhs, uint32_t rhs) {
+    return PackedGreaterEqual<T>(rhs, lhs) ^ kPackedTrue;
+  }
+#endif
+};
+
+struct GreaterEqualOp {
+  template <typename T>
+  static bool op(T lhs, T rhs) {
+    return lhs >= rhs;
+  }
+#if defined(__ARM_FEATURE_DSP)
+  template <typename T>
+  static uint32_t packed_op(uint32_t lhs, uint32_t rhs) {
+    return PackedGreaterEqual<T>(lhs, rhs);
+  }
+#endif
+};
+
+struct LessOp {
+  template <typename T>
+  static bool op(T lhs, T rhs) {
+    return lhs < rhs;
+  }
+#if defined(__ARM_FEATURE_DSP)
+  template <typename T>
+  static uint32_t packed_op(uint32_t lhs, uint32_t rhs) {
+    return PackedGreaterEqual<T>(lhs, rhs) ^ kPackedTrue;
+  }
+#endif
+};
+
+struct LessEqualOp {
+  template <typename T>
+  static bool op(T lhs, T rhs) {
+    return lhs <= rhs;
+  }
+#if defined(__ARM_FEATURE_DSP)
+  template <typename T>
+  static uint32_t packed_op(uint32_t lhs, uint32_t rhs) {
+    return PackedGreaterEqual<T>(rhs, lhs);
+  }
+#endif
+};
+
+// Inputs of the same shape, element by element.
+template <typename T, typename OpType>
+void Compare(const T* input1_data, const T* input2_data, bool* output_data,
+             int size) {
+  int i = 0;
+#if defined(__ARM_FEATURE_DSP)
+  if (sizeof(T) == 1) {
+    for (; i <= size - 4; i += 4) {
+      uint32_t lhs;
+      uint32_t rhs;
+      std::memcpy(&lhs, input1_data + i, sizeof(lhs));
+      std::memcpy(&rhs, input2_data + i, sizeof(rhs));
+      const uint32_t result = OpType::template packed_op<T>(lhs, rhs);
+      std::memcpy(output_data + i, &result, sizeof(result));
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    output_data[i] = OpType::template op<T>(input1_data[i], input2_data[i]);
   }
-  return kTfLiteOk;
 }
 
-TfLiteStatus GreaterEval(TfLiteContext* context, TfLiteNode* node) {
-  const TfLiteTensor* input1 = GetInput(context, node, kInputTensor1);
-  const TfLiteTensor* input2 = GetInput(context, node, kInputTensor2);
-  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
-  bool requires_broadcast = !HaveSameShapes(input1, input2);
-  switch (input1->type) {
-    case kTfLiteFloat32:
-      TF_LITE_COMPARISON(float, Greater, requires_broadcast);
-      break;
-    case kTfLiteInt32:
-      TF_LITE_COMPARISON(int32_t, Greater, requires_broadcast);
-      break;
-    case kTfLiteInt64:
-      TF_LITE_COMPARISON(int64_t, Greater, requires_broadcast);
-      break;
-    case kTfLiteUInt8:
-      EvalQuantizedGreater<uint8_t>(context, node, input1, input2, output,
-                                    requires_broadcast);
-      break;
-    case kTfLiteInt8:
-      EvalQuantizedGreater<int8_t>(context, node, input1, input2, output,
-                                   requires_broadcast);
-      break;
-    default:
-      TF_LITE_KERNEL_LOG(context,
-                         "Does not support type %d, requires float|int|uint8",
-                         input1->type);
-      return kTfLiteError;
+// Every element of input1 against the single value of input2.
+template <typename T, typename OpType>
+void CompareWithScalar(const T* input1_data, T scalar, bool* output_data,
+                       int size) {
+  int i = 0;
+#if defined(__ARM_FEATURE_DSP)
+  if (sizeof(T) == 1) {
+    uint32_t rhs;
+    std::memset(&rhs, *reinterpret_cast<const uint8_t*>(&scalar), sizeof(rhs));
+    for (; i <= size - 4; i += 4) {
+      uint32_t lhs;
+      std::memcpy(&lhs, input1_data + i, sizeof(lhs));
+      const uint32_t result = OpType::template packed_op<T>(lhs, rhs);
+      std::memcpy(output_data + i, &result, sizeof(result));
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    output_data[i] = OpType::template op<T>(input1_data[i], scalar);
   }
-  return kTfLiteOk;
 }
 
-TfLiteStatus GreaterEqualEval(TfLiteContext* context, TfLiteNode* node) {
-  const TfLiteTensor* input1 = GetInput(context, node, kInputTensor1);
-  const TfLiteTensor* input2 = GetInput(context, node, kInputTensor2);
-  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
-  bool requires_broadcast = !HaveSameShapes(input1, input2);
-  switch (input1->type) {
-    case kTfLiteFloat32:
-      TF_LITE_COMPARISON(float, GreaterEqual, requires_broadcast);
-      break;
-    case kTfLiteInt32:
-      TF_LITE_COMPARISON(int32_t, GreaterEqual, requires_broadcast);
-      break;
-    case kTfLiteInt64:
-      TF_LITE_COMPARISON(int64_t, GreaterEqual, requires_broadcast);
+template <typename T, typename OpType>
+void EvalComparison(const OpData& data, const TfLiteTensor* input1,
+                    const TfLiteTensor* input2, TfLiteTensor* output) {
+  const T* input1_data = GetTensorData<T>(input1);
+  const T* input2_data = GetTensorData<T>(input2);
+  bool* output_data = GetTensorData<bool>(output);
+  if (data.rescale) {
+    if (data.broadcast == kNoBroadcast) {
+      reference_ops::ComparisonWithScaling<T, OpType::template op<int32>>(
+          data.params, GetTensorShape(input1), input1_data,
+          GetTensorShape(input2), input2_data, GetTensorShape(output),
+          output_data);
+    } else {
+      reference_ops::BroadcastComparison4DSlowWithScaling<
+          T, OpType::template op<int32>>(
+          data.params, GetTensorShape(input1), input1_data,
+          GetTensorShape(input2), input2_data, GetTensorShape(output),
+          output_data);
+    }
+    return;
+  }
+  const int size = static_cast<int>(NumElements(output));
+  switch (data.broadcast) {
+    case kNoBroadcast:
+      Compare<T, OpType>(input1_data, input2_data, output_data, size);
       break;
-    case kTfLiteUInt8:
-      EvalQuantizedGreaterEqual<uint8_t>(context, node, input1, input2, output,
-                                         requires_broadcast);
+    case kScalarInput2:
+      CompareWithScalar<T, OpType>(input1_data, *input2_data, output_data,
+                                   size);
       break;
-    case kTfLiteInt8:
-      EvalQuantizedGreaterEqual<int8_t>(context, node, input1, input2, output,
-                                        requires_broadcast);
+    case kGenericBroadcast:
+      reference_ops::BroadcastComparison4DSlowImpl<T, OpType::template op<T>>(
+          data.params, GetTensorShape(input1), input1_data,
+          GetTensorShape(input2), input2_data, GetTensorShape(output),
+          output_data);
       break;
-    default:
-      TF_LITE_KERNEL_LOG(context,
-                         "Does not support type %d, requires float|int|uint8",
-                         input1->type);
-      return kTfLiteError;
   }
-  return kTfLiteOk;
 }
 
-TfLiteStatus LessEval(TfLiteContext* context, TfLiteNode* node) {
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  TF_LITE_ENSURE_EQ(context, NumInputs(node), 2);
+  TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
   const TfLiteTensor* input1 = GetInput(context, node, kInputTensor1);
   const TfLiteTensor* input2 = GetInput(context, node, kInputTensor2);
-  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
-  bool requires_broadcast = !HaveSameShapes(input1, input2);
-  switch (input1->type) {
-    case kTfLiteFloat32:
-      TF_LITE_COMPARISON(float, Less, requires_broadcast);
-      break;
-    case kTfLiteInt32:
-      TF_LITE_COMPARISON(int32_t, Less, requires_broadcast);
-      break;
-    case kTfLiteInt64:
-      TF_LITE_COMPARISON(int64_t, Less, requires_broadcast);
-      break;
-    case kTfLiteUInt8:
-      EvalQuantizedLess<uint8_t>(context, node, input1, input2, output,
-                                 requires_broadcast);
-      break;
-    case kTfLiteInt8:
-      EvalQuantizedLess<int8_t>(context, node, input1, input2, output,
-                                requires_broadcast);
-      break;
-    default:
-      TF_LITE_KERNEL_LOG(context,
-                         "Does not support type %d, requires float|int|uint8",
-                         input1->type);
-      return kTfLiteError;
+  const TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  TF_LITE_ENSURE_EQ(context, input1->type, input2->type);
+  TF_LITE_ENSURE_EQ(context, output->type, kTfLiteBool);
+
+  void* raw_data = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(OpData), &raw_data));
+  OpData* data = static_cast<OpData*>(raw_data);
+  if (HaveSameShapes(input1, input2)) {
+    data->broadcast = kNoBroadcast;
+  } else if (NumElements(input2) == 1 &&
+             NumElements(input1) == NumElements(output)) {
+    data->broadcast = kScalarInput2;
+  } else {
+    data->broadcast = kGenericBroadcast;
   }
+
+  data->rescale = (input1->type == kTfLiteUInt8 ||
+                   input1->type == kTfLiteInt8) &&
+                  (input1->params.scale != input2->params.scale ||
+                   input1->params.zero_point != input2->params.zero_point);
+  data->params = {};
+  if (data->rescale) {
+    data->params.left_shift = 8;
+    data->params.input1_offset = -input1->params.zero_point;
+    data->params.input2_offset = -input2->params.zero_point;
+    QuantizeMultiplierSmallerThanOneExp(
+        static_cast<double>(input1->params.scale),
+        &data->params.input1_multiplier, &data->params.input1_shift);
+    QuantizeMultiplierSmallerThanOneExp(
+        static_cast<double>(input2->params.scale),
+        &data->params.input2_multiplier, &data->params.input2_shift);
+  }
+  node->user_data = data;
   return kTfLiteOk;
 }
 
-TfLiteStatus LessEqualEval(TfLiteContext* context, TfLiteNode* node) {
+template <typename OpType>
+TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
+  const OpData& data = *static_cast<const OpData*>(node->user_data);
   const TfLiteTensor* input1 = GetInput(context, node, kInputTensor1);
   const TfLiteTensor* input2 = GetInput(context, node, kInputTensor2);
   TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
-  bool requires_broadcast = !HaveSameShapes(input1, input2);
+  // Only (in)equality is defined for bools.
+  constexpr bool kSupportsBool = std::is_same<OpType, EqualOp>::value ||
+                                 std::is_same<OpType, NotEqualOp>::value;
   switch (input1->type) {
+    case kTfLiteBool:
+      if (!kSupportsBool) {
+        break;
+      }
+      EvalComparison<bool, OpType>(data, input1, input2, output);
+      return kTfLiteOk;
     case kTfLiteFloat32:
-      TF_LITE_COMPARISON(float, LessEqual, requires_broadcast);
-      break;
+      EvalComparison<float, OpType>(data, input1, input2, output);
+      return kTfLiteOk;
     case kTfLiteInt32:
-      TF_LITE_COMPARISON(int32_t, LessEqual, requires_broadcast);
-      break;
+      EvalComparison<int32_t, OpType>(data, input1, input2, output);
+      return kTfLiteOk;
     case kTfLiteInt64:
-      TF_LITE_COMPARISON(int64_t, LessEqual, requires_broadcast);
-      break;
+      EvalComparison<int64_t, OpType>(data, input1, input2, output);
+      return kTfLiteOk;
     case kTfLiteUInt8:
-      EvalQuantizedLessEqual<uint8_t>(context, node, input1, input2, output,
-                                      requires_broadcast);
-      break;
+      EvalComparison<uint8_t, OpType>(data, input1, input2, output);
+      return kTfLiteOk;
     case kTfLiteInt8:
-      EvalQuantizedLessEqual<int8_t>(context, node, input1, input2, output,
-                                     requires_broadcast);
-      break;
+      EvalComparison<int8_t, OpType>(data, input1, input2, output);
+      return kTfLiteOk;
     default:
-      TF_LITE_KERNEL_LOG(context,
-                         "Does not support type %d, requires float|int|uint8",
-                         input1->type);
-      return kTfLiteError;
+      break;
   }
-  return kTfLiteOk;
+  TF_LITE_KERNEL_LOG(context, "Does not support type %d, requires %s",
+                     input1->type,
+                     kSupportsBool ? "bool|float|int|uint8" : "float|int|uint8");
+  return kTfLiteError;
 }
 
 }  // namespace
@@ -301,37 +326,43 @@ TfLiteStatus LessEqualEval(TfLiteContext* context, TfLiteNode* node) {
 
 TfLiteRegistration* Register_EQUAL() {
   static TfLiteRegistration r = {};
-  r.invoke = comparisons::EqualEval;
+  r.prepare = comparisons::Prepare;
+  r.invoke = comparisons::Eval<comparisons::EqualOp>;
   return &r;
 }
 
 TfLiteRegistration* Register_NOT_EQUAL() {
   static TfLiteRegistration r = {};
-  r.invoke = comparisons::NotEqualEval;
+  r.prepare = comparisons::Prepare;
+  r.invoke = comparisons::Eval<comparisons::NotEqualOp>;
   return &r;
 }
 
 TfLiteRegistration* Register_GREATER() {
   static TfLiteRegistration r = {};
-  r.invoke = comparisons::GreaterEval;
+  r.prepare = comparisons::Prepare;
+  r.invoke = comparisons::Eval<comparisons::GreaterOp>;
   return &r;
 }
 
 TfLiteRegistration* Register_GREATER_EQUAL() {
   static TfLiteRegistration r = {};
-  r.invoke = comparisons::GreaterEqualEval;
+  r.prepare = comparisons::Prepare;
+  r.invoke = comparisons::Eval<comparisons::GreaterEqualOp>;
   return &r;
 }
 
 TfLiteRegistration* Register_LESS() {
   static TfLiteRegistration r = {};
-  r.invoke = comparisons::LessEval;
+  r.prepare = comparisons::Prepare;
+  r.invoke = comparisons::Eval<comparisons::LessOp>;
   return &r;
 }
 
 TfLiteRegistration* Register_LESS_EQUAL() {
   static TfLiteRegistration r = {};
-  r.invoke = comparisons::LessEqualEval;
+  r.prepare = comparisons::Prepare;
+  r.invoke = comparisons::Eval<comparisons::LessEqualOp>;
   return &r;
 }
 
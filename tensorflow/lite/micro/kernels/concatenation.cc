@@ -49,6 +49,20 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   // Output type must match input type
   TF_LITE_ENSURE_EQ(context, output_type, input_type);
 
+#if defined(TF_LITE_INTEGER_ONLY)
+  // Rescaling uint8 inputs is done in floating point, so all inputs must
+  // share the quantization of the output and are copied as they are.
+  if (output_type == kTfLiteUInt8) {
+    const TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+    for (int i = 0; i < NumInputs(node); ++i) {
+      const TfLiteTensor* input = GetInput(context, node, i);
+      TF_LITE_ENSURE_EQ(context, input->params.zero_point,
+                        output->params.zero_point);
+      TF_LITE_ENSURE(context, input->params.scale == output->params.scale);
+    }
+  }
+#endif
+
   // This implementation does not support large number of input tensors
   const int num_inputs = NumInputs(node);
   TF_LITE_ENSURE(context, num_inputs <= kMaxInputNum);
@@ -192,7 +206,11 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       EvalUnquantized<int32_t>(context, node);
       break;
     case kTfLiteUInt8:
+#if defined(TF_LITE_INTEGER_ONLY)
+      EvalUnquantized<uint8_t>(context, node);
+#else
       EvalQuantizedUInt8(context, node);
+#endif
       break;
     case kTfLiteInt8:
       EvalUnquantized<int8_t>(context, node);
@@ -15,10 +15,11 @@ limitations under the License.
 
 #include "tensorflow/lite/kernels/internal/reference/dequantize.h"
 
+#include <limits>
+
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
-#include "tensorflow/lite/kernels/internal/reference/quantize.h"
 #include "tensorflow/lite/kernels/internal/reference/requantize.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
@@ -28,6 +29,46 @@ namespace ops {
 namespace micro {
 namespace dequantize {
 
+// Int8 and uint8 inputs only have 256 distinct values, so dequantizing them
+// into float is a table gather.
+struct TableOpData {
+  // Float value for each input code, indexed by the raw input byte.
+  float table[256];
+};
+
+// Int8 into int32 is a requantization with a constant multiplier.
+struct RequantizeOpData {
+  int32_t output_multiplier;
+  int output_shift;
+};
+
+template <typename T>
+void PopulateTable(const TfLiteTensor* input, TableOpData* data) {
+  const double scale = static_cast<double>(input->params.scale);
+  const int32_t zero_point = input->params.zero_point;
+  for (int32_t value = std::numeric_limits<T>::min();
+       value <= std::numeric_limits<T>::max(); ++value) {
+    // Same arithmetic as reference_ops::Dequantize.
+    data->table[static_cast<uint8_t>(static_cast<T>(value))] =
+        static_cast<float>(scale * (value - zero_point));
+  }
+}
+
+void DequantizeWithTable(const TableOpData& data, const uint8_t* input_data,
+                         int size, float* output_data) {
+  const float* table = data.table;
+  int i = 0;
+  for (; i <= size - 4; i += 4) {
+    output_data[i] = table[input_data[i]];
+    output_data[i + 1] = table[input_data[i + 1]];
+    output_data[i + 2] = table[input_data[i + 2]];
+    output_data[i + 3] = table[input_data[i + 3]];
+  }
+  for (; i < size; ++i) {
+    output_data[i] = table[input_data[i]];
+  }
+}
+
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_EQ(context, NumInputs(node), 1);
   TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
@@ -42,6 +83,27 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE(
       context, output->type == kTfLiteFloat32 || output->type == kTfLiteInt32);
 
+  void* raw = nullptr;
+  if (output->type == kTfLiteFloat32 && input->type != kTfLiteInt16) {
+    TF_LITE_ENSURE_STATUS(
+        context->AllocatePersistentBuffer(context, sizeof(TableOpData), &raw));
+    if (input->type == kTfLiteInt8) {
+      PopulateTable<int8_t>(input, static_cast<TableOpData*>(raw));
+    } else {
+      PopulateTable<uint8_t>(input, static_cast<TableOpData*>(raw));
+    }
+  } else if (output->type == kTfLiteInt32 && input->type == kTfLiteInt8) {
+    TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+        context, sizeof(RequantizeOpData), &raw));
+    RequantizeOpData* data = static_cast<RequantizeOpData*>(raw);
+    const double effective_output_scale =
+        static_cast<double>(input->params.scale) /
+        static_cast<double>(output->params.scale);
+    QuantizeMultiplier(effective_output_scale, &data->output_multiplier,
+                       &data->output_shift);
+  }
+  node->user_data = raw;
+
   return kTfLiteOk;
 }
 
@@ -56,14 +118,13 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   if (output->type == kTfLiteFloat32) {
     switch (input->type) {
       case kTfLiteUInt8:
-        reference_ops::Dequantize(
-            op_params, GetTensorShape(input), GetTensorData<uint8_t>(input),
-            GetTensorShape(output), GetTensorData<float>(output));
-        break;
       case kTfLiteInt8:
-        reference_ops::Dequantize(
-            op_params, GetTensorShape(input), GetTensorData<int8_t>(input),
-            GetTensorShape(output), GetTensorData<float>(output));
+        // Both are looked up by their raw byte.
+        DequantizeWithTable(
+            *static_cast<const TableOpData*>(node->user_data),
+            reinterpret_cast<const uint8_t*>(input->data.raw),
+            MatchingFlatSize(GetTensorShape(input), GetTensorShape(output)),
+            GetTensorData<float>(output));
         break;
       default:
         TF_LITE_KERNEL_LOG(context, "Input %s, output %s not supported.",
@@ -81,19 +142,14 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
         break;
       }
       case kTfLiteInt8: {
-        int32_t output_multiplier;
-        int output_shift;
-        const double effective_output_scale =
-            static_cast<double>(input->params.scale) /
-            static_cast<double>(output->params.scale);
-        QuantizeMultiplier(effective_output_scale, &output_multiplier,
-                           &output_shift);
+        const RequantizeOpData* data =
+            static_cast<const RequantizeOpData*>(node->user_data);
         int flat_size =
             MatchingFlatSize(GetTensorShape(input), GetTensorShape(output));
         reference_ops::Requantize(
-            GetTensorData<int8_t>(input), flat_size, output_multiplier,
-            output_shift, input->params.zero_point, output->params.zero_point,
-            GetTensorData<int32_t>(output));
+            GetTensorData<int8_t>(input), flat_size, data->output_multiplier,
+            data->output_shift, input->params.zero_point,
+            output->params.zero_point, GetTensorData<int32_t>(output));
         break;
       }
       default:
@@ -0,0 +1,277 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/testing/kernel_test_helpers.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_model_builder.h"
+
+// The int8 conv, depthwise conv and fully connected kernels fold the input
+// offset into the bias when no filter tap reads padding. These tests run them
+// with a non-zero input zero point and compare every output with the
+// reference kernels, which add the offset to each input instead.
+
+namespace tflite {
+namespace testing {
+namespace {
+
+constexpr float kInputScale = 0.5f;
+constexpr int kInputZeroPoint = -7;
+constexpr float kOutputScale = 1.0f;
+constexpr int kOutputZeroPoint = 3;
+constexpr int kMaxElements = 256;
+
+void TestConv(Padding padding, int stride) {
+  constexpr int kBatches = 2;
+  constexpr int kHeight = 5;
+  constexpr int kWidth = 6;
+  constexpr int kInputDepth = 4;
+  constexpr int kFilterSize = 3;
+  constexpr int kOutputDepth = 3;
+  const int out_height =
+      padding == Padding_VALID
+          ? (kHeight - kFilterSize + stride) / stride
+          : (kHeight + stride - 1) / stride;
+  const int out_width = padding == Padding_VALID
+                            ? (kWidth - kFilterSize + stride) / stride
+                            : (kWidth + stride - 1) / stride;
+  const int32_t filter_shape[] = {kOutputDepth, kFilterSize, kFilterSize,
+                                  kInputDepth};
+  const int filter_size = kOutputDepth * kFilterSize * kFilterSize * kInputDepth;
+  Weights weights;
+  FillWeights(filter_size, kOutputDepth, kInputScale, kOutputScale, &weights);
+
+  TestModelBuilder builder;
+  const int conv = builder.AddOperatorCode(BuiltinOperator_CONV_2D, 3);
+  const int input = builder.AddQuantizedTensor(
+      TensorType_INT8, {kBatches, kHeight, kWidth, kInputDepth}, kInputScale,
+      kInputZeroPoint);
+  int bias;
+  const int filter = AddWeights(&builder, filter_shape, 4, filter_size,
+                                kOutputDepth, 0, weights, &bias);
+  const int output = builder.AddQuantizedTensor(
+      TensorType_INT8, {kBatches, out_height, out_width, kOutputDepth},
+      kOutputScale, kOutputZeroPoint);
+  builder.AddOperator(
+      conv, {input, filter, bias}, {output}, BuiltinOptions_Conv2DOptions,
+      CreateConv2DOptions(*builder.builder(), padding, stride, stride)
+          .Union());
+  const int input_size = kBatches * kHeight * kWidth * kInputDepth;
+  const int output_size = kBatches * out_height * out_width * kOutputDepth;
+  int8_t actual[kMaxElements];
+  RunInt8Model(builder.BuildModel({input}, {output}), BuiltinOperator_CONV_2D,
+               ops::micro::Register_CONV_2D(), 3, nullptr, input_size, actual,
+               output_size);
+
+  int8_t input_data[kMaxElements];
+  for (int i = 0; i < input_size; ++i) {
+    input_data[i] = InputValue(i);
+  }
+  ConvParams params;
+  params.input_offset = -kInputZeroPoint;
+  params.output_offset = kOutputZeroPoint;
+  params.stride_height = stride;
+  params.stride_width = stride;
+  params.dilation_height_factor = 1;
+  params.dilation_width_factor = 1;
+  params.padding_values.height =
+      padding == Padding_VALID
+          ? 0
+          : std::max(0, ((out_height - 1) * stride + kFilterSize - kHeight) /
+                            2);
+  params.padding_values.width =
+      padding == Padding_VALID
+          ? 0
+          : std::max(0,
+                     ((out_width - 1) * stride + kFilterSize - kWidth) / 2);
+  params.quantized_activation_min = -128;
+  params.quantized_activation_max = 127;
+  int8_t expected[kMaxElements];
+  reference_integer_ops::ConvPerChannel(
+      params, weights.multipliers, weights.shifts,
+      RuntimeShape({kBatches, kHeight, kWidth, kInputDepth}), input_data,
+      RuntimeShape({kOutputDepth, kFilterSize, kFilterSize, kInputDepth}),
+      weights.filter, RuntimeShape({kOutputDepth}), weights.bias,
+      RuntimeShape({kBatches, out_height, out_width, kOutputDepth}),
+      expected);
+  ExpectEqual(expected, actual, output_size);
+}
+
+void TestDepthwiseConv(int depth_multiplier) {
+  constexpr int kHeight = 5;
+  constexpr int kWidth = 5;
+  constexpr int kInputDepth = 3;
+  constexpr int kFilterSize = 3;
+  constexpr int kOutHeight = kHeight - kFilterSize + 1;
+  constexpr int kOutWidth = kWidth - kFilterSize + 1;
+  const int output_depth = kInputDepth * depth_multiplier;
+  const int32_t filter_shape[] = {1, kFilterSize, kFilterSize, output_depth};
+  const int filter_size = kFilterSize * kFilterSize * output_depth;
+  Weights weights;
+  FillWeights(filter_size, output_depth, kInputScale, kOutputScale, &weights);
+
+  TestModelBuilder builder;
+  const int depthwise =
+      builder.AddOperatorCode(BuiltinOperator_DEPTHWISE_CONV_2D, 3);
+  const int input = builder.AddQuantizedTensor(
+      TensorType_INT8, {1, kHeight, kWidth, kInputDepth}, kInputScale,
+      kInputZeroPoint);
+  int bias;
+  const int filter = AddWeights(&builder, filter_shape, 4, filter_size,
+                                output_depth, 3, weights, &bias);
+  const int output = builder.AddQuantizedTensor(
+      TensorType_INT8, {1, kOutHeight, kOutWidth, output_depth}, kOutputScale,
+      kOutputZeroPoint);
+  builder.AddOperator(depthwise, {input, filter, bias}, {output},
+                      BuiltinOptions_DepthwiseConv2DOptions,
+                      CreateDepthwiseConv2DOptions(*builder.builder(),
+                                                   Padding_VALID, 1, 1,
+                                                   depth_multiplier)
+                          .Union());
+  const int input_size = kHeight * kWidth * kInputDepth;
+  const int output_size = kOutHeight * kOutWidth * output_depth;
+  int8_t actual[kMaxElements];
+  RunInt8Model(builder.BuildModel({input}, {output}),
+               BuiltinOperator_DEPTHWISE_CONV_2D,
+               ops::micro::Register_DEPTHWISE_CONV_2D(), 3, nullptr,
+               input_size, actual, output_size);
+
+  int8_t input_data[kMaxElements];
+  for (int i = 0; i < input_size; ++i) {
+    input_data[i] = InputValue(i);
+  }
+  DepthwiseParams params;
+  params.input_offset = -kInputZeroPoint;
+  params.output_offset = kOutputZeroPoint;
+  params.stride_height = 1;
+  params.stride_width = 1;
+  params.dilation_height_factor = 1;
+  params.dilation_width_factor = 1;
+  params.padding_values.height = 0;
+  params.padding_values.width = 0;
+  params.depth_multiplier = depth_multiplier;
+  params.quantized_activation_min = -128;
+  params.quantized_activation_max = 127;
+  int8_t expected[kMaxElements];
+  reference_integer_ops::DepthwiseConvPerChannel(
+      params, weights.multipliers, weights.shifts,
+      RuntimeShape({1, kHeight, kWidth, kInputDepth}), input_data,
+      RuntimeShape({1, kFilterSize, kFilterSize, output_depth}),
+      weights.filter, RuntimeShape({output_depth}), weights.bias,
+      RuntimeShape({1, kOutHeight, kOutWidth, output_depth}), expected);
+  ExpectEqual(expected, actual, output_size);
+}
+
+void TestFullyConnected(bool with_bias) {
+  constexpr int kBatches = 3;
+  constexpr int kAccumDepth = 10;
+  constexpr int kUnits = 4;
+  const int32_t filter_shape[] = {kUnits, kAccumDepth};
+  Weights weights;
+  FillWeights(kUnits * kAccumDepth, 1, kInputScale, kOutputScale, &weights);
+  for (int c = 0; c < kUnits; ++c) {
+    weights.bias[c] = BiasValue(c);
+  }
+
+  TestModelBuilder builder;
+  const int fc = builder.AddOperatorCode(BuiltinOperator_FULLY_CONNECTED, 4);
+  const int input = builder.AddQuantizedTensor(
+      TensorType_INT8, {kBatches, kAccumDepth}, kInputScale, kInputZeroPoint);
+  const int filter = builder.AddTensor(
+      TensorType_INT8, filter_shape, 2, weights.filter, kUnits * kAccumDepth,
+      weights.filter_scales, weights.zero_points, 1);
+  int bias = -1;
+  if (with_bias) {
+    const int32_t bias_shape[] = {kUnits};
+    bias = builder.AddTensor(TensorType_INT32, bias_shape, 1, weights.bias,
+                             sizeof(int32_t) * kUnits, weights.bias_scales,
+                             weights.zero_points, 1);
+  }
+  const int output = builder.AddQuantizedTensor(
+      TensorType_INT8, {kBatches, kUnits}, kOutputScale, kOutputZeroPoint);
+  builder.AddOperator(
+      fc, {input, filter, bias}, {output},
+      BuiltinOptions_FullyConnectedOptions,
+      CreateFullyConnectedOptions(*builder.builder()).Union());
+  int8_t actual[kBatches * kUnits];
+  RunInt8Model(builder.BuildModel({input}, {output}),
+               BuiltinOperator_FULLY_CONNECTED,
+               ops::micro::Register_FULLY_CONNECTED(), 4, nullptr,
+               kBatches * kAccumDepth, actual, kBatches * kUnits);
+
+  int8_t input_data[kBatches * kAccumDepth];
+  for (int i = 0; i < kBatches * kAccumDepth; ++i) {
+    input_data[i] = InputValue(i);
+  }
+  FullyConnectedParams params;
+  params.input_offset = -kInputZeroPoint;
+  params.weights_offset = 0;
+  params.output_offset = kOutputZeroPoint;
+  params.output_multiplier = weights.multipliers[0];
+  params.output_shift = weights.shifts[0];
+  params.quantized_activation_min = -128;
+  params.quantized_activation_max = 127;
+  int8_t expected[kBatches * kUnits];
+  reference_integer_ops::FullyConnected(
+      params, RuntimeShape({kBatches, kAccumDepth}), input_data,
+      RuntimeShape({kUnits, kAccumDepth}), weights.filter,
+      RuntimeShape({kUnits}), with_bias ? weights.bias : nullptr,
+      RuntimeShape({kBatches, kUnits}), expected);
+  ExpectEqual(expected, actual, kBatches * kUnits);
+}
+
+}  // namespace
+}  // namespace testing
+}  // namespace tflite
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(ConvValidMatchesReference) {
+  tflite::testing::TestConv(tflite::Padding_VALID, 1);
+}
+
+TF_LITE_MICRO_TEST(ConvValidStride2MatchesReference) {
+  tflite::testing::TestConv(tflite::Padding_VALID, 2);
+}
+
+// Not folded, since the border taps read padding.
+TF_LITE_MICRO_TEST(ConvSameMatchesReference) {
+  tflite::testing::TestConv(tflite::Padding_SAME, 1);
+}
+
+TF_LITE_MICRO_TEST(DepthwiseConvMatchesReference) {
+  tflite::testing::TestDepthwiseConv(1);
+}
+
+TF_LITE_MICRO_TEST(DepthwiseConvMultiplier2MatchesReference) {
+  tflite::testing::TestDepthwiseConv(2);
+}
+
+TF_LITE_MICRO_TEST(FullyConnectedMatchesReference) {
+  tflite::testing::TestFullyConnected(true);
+}
+
+TF_LITE_MICRO_TEST(FullyConnectedWithoutBiasMatchesReference) {
+  tflite::testing::TestFullyConnected(false);
+}
+
+TF_LITE_MICRO_TESTS_END
@@ -0,0 +1,190 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/compressed_weights.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/testing/kernel_test_helpers.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_model_builder.h"
+
+namespace tflite {
+namespace testing {
+namespace {
+
+constexpr float kInputScale = 0.5f;
+constexpr int kInputZeroPoint = -3;
+constexpr float kOutputScale = 2.0f;
+constexpr int kOutputZeroPoint = 4;
+
+// Odd element counts, so that rows and filters straddle the bytes of the
+// packed weights and the last byte holds a single nibble.
+constexpr int kBatches = 2;
+constexpr int kAccumDepth = 21;
+constexpr int kUnits = 5;
+constexpr int kFcWeights = kUnits * kAccumDepth;
+
+constexpr int kHeight = 4;
+constexpr int kWidth = 5;
+constexpr int kInputDepth = 3;
+constexpr int kFilterSize = 3;
+constexpr int kOutputDepth = 5;
+constexpr int kConvWeights =
+    kOutputDepth * kFilterSize * kFilterSize * kInputDepth;
+
+// Weights in the int4 range [-8, 7].
+int8_t Int4Weight(int i) { return (i * 5 + 3) % 16 - 8; }
+
+// Packs int8 values in [-8, 7] two per byte, the first in the low nibble.
+void PackInt4(const int8_t* values, int count, uint8_t* packed) {
+  for (int i = 0; i < count; ++i) {
+    const uint8_t nibble = static_cast<uint8_t>(values[i]) & 0x0F;
+    if (i % 2 == 0) {
+      packed[i / 2] = nibble;
+    } else {
+      packed[i / 2] |= nibble << 4;
+    }
+  }
+}
+
+// Adds the filter as plain int8 or as int4 listed in kInt4WeightsMetadata.
+int AddFilter(TestModelBuilder* builder, const int32_t* shape, int rank,
+              const int8_t* weights, int count, const float* scales,
+              const int64_t* zero_points, int num_channels, bool int4) {
+  uint8_t packed[(kConvWeights + 1) / 2];
+  PackInt4(weights, count, packed);
+  const int filter =
+      int4 ? builder->AddTensor(TensorType_INT8, shape, rank, packed,
+                                (count + 1) / 2, scales, zero_points,
+                                num_channels)
+           : builder->AddTensor(TensorType_INT8, shape, rank, weights, count,
+                                scales, zero_points, num_channels);
+  if (int4) {
+    const uint32_t metadata[] = {kInt4WeightsVersion, 1, 0,
+                                 static_cast<uint32_t>(filter)};
+    builder->AddMetadata(kInt4WeightsMetadata, metadata, 4);
+  }
+  return filter;
+}
+
+void RunFullyConnected(bool int4, int8_t* output_data) {
+  TestModelBuilder builder;
+  const int fc = builder.AddOperatorCode(BuiltinOperator_FULLY_CONNECTED, 4);
+  const int input = builder.AddQuantizedTensor(
+      TensorType_INT8, {kBatches, kAccumDepth}, kInputScale, kInputZeroPoint);
+  int8_t weights[kFcWeights];
+  for (int i = 0; i < kFcWeights; ++i) {
+    weights[i] = Int4Weight(i);
+  }
+  const int32_t filter_shape[] = {kUnits, kAccumDepth};
+  const float filter_scale = 0.25f;
+  const int64_t filter_zero_point = 0;
+  const int filter = AddFilter(&builder, filter_shape, 2, weights, kFcWeights,
+                               &filter_scale, &filter_zero_point, 1, int4);
+  int32_t bias_data[kUnits];
+  for (int i = 0; i < kUnits; ++i) {
+    bias_data[i] = i * 40 - 90;
+  }
+  const int32_t bias_shape[] = {kUnits};
+  const float bias_scale = kInputScale * filter_scale;
+  const int bias =
+      builder.AddTensor(TensorType_INT32, bias_shape, 1, bias_data,
+                        sizeof(bias_data), &bias_scale, &filter_zero_point, 1);
+  const int output = builder.AddQuantizedTensor(
+      TensorType_INT8, {kBatches, kUnits}, kOutputScale, kOutputZeroPoint);
+  builder.AddOperator(
+      fc, {input, filter, bias}, {output},
+      BuiltinOptions_FullyConnectedOptions,
+      CreateFullyConnectedOptions(*builder.builder()).Union());
+  RunInt8Model(builder.BuildModel({input}, {output}),
+               BuiltinOperator_FULLY_CONNECTED,
+               ops::micro::Register_FULLY_CONNECTED(), 4, nullptr,
+               kBatches * kAccumDepth, output_data, kBatches * kUnits);
+}
+
+void RunConv(bool int4, int8_t* output_data) {
+  TestModelBuilder builder;
+  const int conv = builder.AddOperatorCode(BuiltinOperator_CONV_2D, 3);
+  const int input = builder.AddQuantizedTensor(
+      TensorType_INT8, {1, kHeight, kWidth, kInputDepth}, kInputScale,
+      kInputZeroPoint);
+  int8_t weights[kConvWeights];
+  for (int i = 0; i < kConvWeights; ++i) {
+    weights[i] = Int4Weight(i);
+  }
+  const int32_t filter_shape[] = {kOutputDepth, kFilterSize, kFilterSize,
+                                  kInputDepth};
+  float filter_scales[kOutputDepth];
+  float bias_scales[kOutputDepth];
+  int64_t zero_points[kOutputDepth];
+  int32_t bias_data[kOutputDepth];
+  for (int c = 0; c < kOutputDepth; ++c) {
+    filter_scales[c] = 0.125f * (c + 1);
+    bias_scales[c] = kInputScale * filter_scales[c];
+    zero_points[c] = 0;
+    bias_data[c] = c * 30 - 60;
+  }
+  const int filter =
+      AddFilter(&builder, filter_shape, 4, weights, kConvWeights,
+                filter_scales, zero_points, kOutputDepth, int4);
+  const int32_t bias_shape[] = {kOutputDepth};
+  const int bias = builder.AddTensor(TensorType_INT32, bias_shape, 1,
+                                     bias_data, sizeof(bias_data), bias_scales,
+                                     zero_points, kOutputDepth);
+  const int output = builder.AddQuantizedTensor(
+      TensorType_INT8, {1, kHeight, kWidth, kOutputDepth}, kOutputScale,
+      kOutputZeroPoint);
+  // SAME padding, so that the border pixels read filter taps in the padding.
+  builder.AddOperator(conv, {input, filter, bias}, {output},
+                      BuiltinOptions_Conv2DOptions,
+                      CreateConv2DOptions(*builder.builder(), Padding_SAME, 1,
+                                          1)
+                          .Union());
+  RunInt8Model(builder.BuildModel({input}, {output}), BuiltinOperator_CONV_2D,
+               ops::micro::Register_CONV_2D(), 3, nullptr,
+               kHeight * kWidth * kInputDepth, output_data,
+               kHeight * kWidth * kOutputDepth);
+}
+
+}  // namespace
+}  // namespace testing
+}  // namespace tflite
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(FullyConnectedInt4MatchesInt8) {
+  constexpr int kSize = tflite::testing::kBatches * tflite::testing::kUnits;
+  int8_t expected[kSize];
+  int8_t actual[kSize];
+  tflite::testing::RunFullyConnected(false, expected);
+  tflite::testing::RunFullyConnected(true, actual);
+  for (int i = 0; i < kSize; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(expected[i], actual[i]);
+  }
+}
+
+TF_LITE_MICRO_TEST(ConvInt4MatchesInt8) {
+  constexpr int kSize = tflite::testing::kHeight * tflite::testing::kWidth *
+                        tflite::testing::kOutputDepth;
+  int8_t expected[kSize];
+  int8_t actual[kSize];
+  tflite::testing::RunConv(false, expected);
+  tflite::testing::RunConv(true, actual);
+  for (int i = 0; i < kSize; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(expected[i], actual[i]);
+  }
+}
+
+TF_LITE_MICRO_TESTS_END
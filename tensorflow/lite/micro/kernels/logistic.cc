@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/lite/kernels/internal/reference/logistic.h"
 
+#include <cmath>
+
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
@@ -22,6 +24,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/op_macros.h"
+#include "tensorflow/lite/micro/kernels/lookup_table.h"
 
 namespace tflite {
 namespace ops {
@@ -31,8 +34,20 @@ namespace activations {
 constexpr int kInputTensor = 0;
 constexpr int kOutputTensor = 0;
 
+// Same approximation as the float reference kernel.
+float LogisticFloat(float value) {
+  const float cutoff_upper = 16.619047164916992188f;
+  const float cutoff_lower = -9.f;
+  if (value > cutoff_upper) {
+    return 1.0f;
+  } else if (value < cutoff_lower) {
+    return std::exp(value);
+  }
+  return 1.f / (1.f + std::exp(-value));
+}
+
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
-  return kTfLiteOk;
+  return LookupTablePrepare(context, node, LogisticFloat);
 }
 
 TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
@@ -53,22 +68,12 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
                            TfLiteTypeGetName(output->type));
         return kTfLiteError;
     }
-  } else if (input->type == kTfLiteInt8) {
-    switch (output->type) {
-      case kTfLiteInt8: {
-        reference_ops::Logistic(
-            GetTensorShape(input), GetTensorData<int8_t>(input),
-            input->params.scale, input->params.zero_point,
-            GetTensorShape(output), GetTensorData<int8_t>(output),
-            output->params.scale, output->params.zero_point);
-        return kTfLiteOk;
-      }
-      default:
-        TF_LITE_KERNEL_LOG(context, "Input %s, output %s not supported.",
-                           TfLiteTypeGetName(input->type),
-                           TfLiteTypeGetName(output->type));
-        return kTfLiteError;
-    }
+  } else if (input->type == kTfLiteInt8 || input->type == kTfLiteUInt8) {
+    // Prepare made sure the output has the same type and built the table.
+    LookupTableEval(input,
+                    static_cast<const LookupTableOpData*>(node->user_data),
+                    output);
+    return kTfLiteOk;
   } else {
     // TODO(b/141211002): Also support other data types once we have supported
     // temporary tensors in TFLM.
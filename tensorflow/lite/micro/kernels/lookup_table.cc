@@ -0,0 +1,101 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/kernels/lookup_table.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/round.h"
+#include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+
+namespace {
+
+constexpr int kInputTensor = 0;
+constexpr int kOutputTensor = 0;
+
+template <typename T>
+void PopulateLookupTable(const TfLiteTensor* input, const TfLiteTensor* output,
+                         LookupTableTransform transform,
+                         LookupTableOpData* data) {
+  const float min = std::numeric_limits<T>::min();
+  const float max = std::numeric_limits<T>::max();
+  const float inverse_output_scale = 1.f / output->params.scale;
+  for (int32_t value = std::numeric_limits<T>::min();
+       value <= std::numeric_limits<T>::max(); ++value) {
+    const float dequantized =
+        input->params.scale * (value - input->params.zero_point);
+    const float transformed = transform(dequantized);
+    const float requantized =
+        TfLiteRound(transformed * inverse_output_scale) +
+        output->params.zero_point;
+    // Clamp as float, a transform like exp() may not fit into an int.
+    const T quantized =
+        static_cast<T>(std::min(std::max(requantized, min), max));
+    data->table[static_cast<uint8_t>(static_cast<T>(value))] =
+        static_cast<uint8_t>(quantized);
+  }
+}
+
+}  // namespace
+
+TfLiteStatus LookupTablePrepare(TfLiteContext* context, TfLiteNode* node,
+                                LookupTableTransform transform) {
+  TF_LITE_ENSURE_EQ(context, NumInputs(node), 1);
+  TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  TF_LITE_ENSURE_EQ(context, input->type, output->type);
+  if (input->type != kTfLiteInt8 && input->type != kTfLiteUInt8) {
+    return kTfLiteOk;
+  }
+  TF_LITE_ENSURE(context, output->params.scale > 0.f);
+
+  void* data = nullptr;
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, sizeof(LookupTableOpData), &data));
+  node->user_data = data;
+  if (input->type == kTfLiteInt8) {
+    PopulateLookupTable<int8_t>(input, output, transform,
+                                static_cast<LookupTableOpData*>(data));
+  } else {
+    PopulateLookupTable<uint8_t>(input, output, transform,
+                                 static_cast<LookupTableOpData*>(data));
+  }
+  return kTfLiteOk;
+}
+
+void LookupTableEval(const TfLiteTensor* input, const LookupTableOpData* data,
+                     TfLiteTensor* output) {
+  const int flat_size =
+      MatchingFlatSize(GetTensorShape(input), GetTensorShape(output));
+  // Both int8 and uint8 data are gathered by their raw byte.
+  const uint8_t* input_data = input->data.uint8;
+  uint8_t* output_data = output->data.uint8;
+  const uint8_t* table = data->table;
+  for (int i = 0; i < flat_size; ++i) {
+    output_data[i] = table[input_data[i]];
+  }
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
@@ -0,0 +1,53 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_KERNELS_LOOKUP_TABLE_H_
+#define TENSORFLOW_LITE_MICRO_KERNELS_LOOKUP_TABLE_H_
+
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+
+// Int8 and uint8 tensors only have 256 distinct values, so any elementwise
+// function of one input can be evaluated for every input code in Prepare,
+// using the quantization parameters of input and output. Eval is then a table
+// gather that needs neither an FPU nor exp() or tanh() at runtime.
+struct LookupTableOpData {
+  // Output code for each input code, indexed by the raw input byte.
+  uint8_t table[256];
+};
+
+// Float function the table is built from, applied to dequantized inputs.
+typedef float (*LookupTableTransform)(float);
+
+// For int8 and uint8 nodes, allocates a LookupTableOpData as node->user_data
+// and fills it. Other types are left alone and have to be handled by the
+// kernel. Input and output have to be of the same type.
+TfLiteStatus LookupTablePrepare(TfLiteContext* context, TfLiteNode* node,
+                                LookupTableTransform transform);
+
+// Maps every element of the int8 or uint8 `input` through the table. `output`
+// may be the same buffer as `input`.
+void LookupTableEval(const TfLiteTensor* input, const LookupTableOpData* data,
+                     TfLiteTensor* output);
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_KERNELS_LOOKUP_TABLE_H_
@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "tensorflow/lite/kernels/internal/reference/maximum_minimum.h"
 
+#include <cstring>
+#include <limits>
+
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
@@ -23,17 +26,16 @@ limitations under the License.
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/op_macros.h"
 
+#if defined(__ARM_FEATURE_DSP)
+#include "arm_math.h"
+#endif
+
 namespace tflite {
 namespace ops {
 namespace micro {
 namespace maximum_minimum {
 namespace {
 
-// This file has a reference implementation of TFMaximum/TFMinimum.
-enum KernelType {
-  kReference,
-};
-
 constexpr int kInputTensor1 = 0;
 constexpr int kInputTensor2 = 1;
 constexpr int kOutputTensor = 0;
@@ -49,11 +51,54 @@ struct OpContext {
   TfLiteTensor* output;
 };
 
+// How the inputs line up with the output, decided in Prepare. Only the
+// generic case needs the 4D index arithmetic of the reference kernel.
+enum BroadcastType {
+  kNoBroadcast,
+  kScalarInput1,
+  kScalarInput2,
+  kGenericBroadcast,
+};
+
+struct OpData {
+  BroadcastType broadcast;
+};
+
+#if defined(__ARM_FEATURE_DSP)
+// Four int8 or uint8 values per word: SSUB8/USUB8 set the GE flag of every
+// lane where `a` is not below `b`, and SEL picks each lane from `a` or `b`.
+template <typename T>
+uint32_t PackedMaximum(uint32_t a, uint32_t b) {
+  if (std::numeric_limits<T>::is_signed) {
+    __SSUB8(a, b);
+  } else {
+    __USUB8(a, b);
+  }
+  return __SEL(a, b);
+}
+
+template <typename T>
+uint32_t PackedMinimum(uint32_t a, uint32_t b) {
+  if (std::numeric_limits<T>::is_signed) {
+    __SSUB8(a, b);
+  } else {
+    __USUB8(a, b);
+  }
+  return __SEL(b, a);
+}
+#endif
+
 struct MaximumOp {
   template <typename data_type>
   static data_type op(data_type el1, data_type el2) {
     return el1 > el2 ? el1 : el2;
   }
+#if defined(__ARM_FEATURE_DSP)
+  template <typename data_type>
+  static uint32_t packed_op(uint32_t el1, uint32_t el2) {
+    return PackedMaximum<data_type>(el1, el2);
+  }
+#endif
 };
 
 struct MinimumOp {
@@ -61,55 +106,151 @@ struct MinimumOp {
   static data_type op(data_type el1, data_type el2) {
     return el1 < el2 ? el1 : el2;
   }
+#if defined(__ARM_FEATURE_DSP)
+  template <typename data_type>
+  static uint32_t packed_op(uint32_t el1, uint32_t el2) {
+    return PackedMinimum<data_type>(el1, el2);
+  }
+#endif
 };
 
+// Inputs of the same shape, element by element.
+template <typename data_type, typename op_type>
+void MaximumMinimum(const data_type* input1_data, const data_type* input2_data,
+                    data_type* output_data, int size) {
+  int i = 0;
+#if defined(__ARM_FEATURE_DSP)
+  if (sizeof(data_type) == 1) {
+    for (; i <= size - 4; i += 4) {
+      uint32_t word1;
+      uint32_t word2;
+      std::memcpy(&word1, input1_data + i, sizeof(word1));
+      std::memcpy(&word2, input2_data + i, sizeof(word2));
+      const uint32_t result =
+          op_type::template packed_op<data_type>(word1, word2);
+      std::memcpy(output_data + i, &result, sizeof(result));
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    output_data[i] =
+        op_type::template op<data_type>(input1_data[i], input2_data[i]);
+  }
+}
+
+// One input is a single value. Maximum and minimum are symmetric, so it
+// doesn't matter which one.
+template <typename data_type, typename op_type>
+void MaximumMinimumWithScalar(const data_type* input_data, data_type scalar,
+                              data_type* output_data, int size) {
+  int i = 0;
+#if defined(__ARM_FEATURE_DSP)
+  if (sizeof(data_type) == 1) {
+    uint32_t scalar_word;
+    std::memset(&scalar_word, *reinterpret_cast<const uint8_t*>(&scalar),
+                sizeof(scalar_word));
+    for (; i <= size - 4; i += 4) {
+      uint32_t word;
+      std::memcpy(&word, input_data + i, sizeof(word));
+      const uint32_t result =
+          op_type::template packed_op<data_type>(word, scalar_word);
+      std::memcpy(output_data + i, &result, sizeof(result));
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    output_data[i] = op_type::template op<data_type>(input_data[i], scalar);
+  }
+}
+
 }  // namespace
 
 template <typename data_type, typename op_type>
 void TFLiteOperation(TfLiteContext* context, TfLiteNode* node,
                      const OpContext& op_context) {
-  reference_ops::MaximumMinimumBroadcast4DSlow(
-      GetTensorShape(op_context.input1),
-      GetTensorData<data_type>(op_context.input1),
-      GetTensorShape(op_context.input2),
-      GetTensorData<data_type>(op_context.input2),
-      GetTensorShape(op_context.output),
-      GetTensorData<data_type>(op_context.output),
-      op_type::template op<data_type>);
+  const OpData& data = *static_cast<const OpData*>(node->user_data);
+  const data_type* input1_data = GetTensorData<data_type>(op_context.input1);
+  const data_type* input2_data = GetTensorData<data_type>(op_context.input2);
+  data_type* output_data = GetTensorData<data_type>(op_context.output);
+  const int size = static_cast<int>(NumElements(op_context.output));
+  switch (data.broadcast) {
+    case kNoBroadcast:
+      MaximumMinimum<data_type, op_type>(input1_data, input2_data, output_data,
+                                         size);
+      break;
+    case kScalarInput1:
+      MaximumMinimumWithScalar<data_type, op_type>(input2_data, *input1_data,
+                                                   output_data, size);
+      break;
+    case kScalarInput2:
+      MaximumMinimumWithScalar<data_type, op_type>(input1_data, *input2_data,
+                                                   output_data, size);
+      break;
+    case kGenericBroadcast:
+      reference_ops::MaximumMinimumBroadcast4DSlow(
+          GetTensorShape(op_context.input1), input1_data,
+          GetTensorShape(op_context.input2), input2_data,
+          GetTensorShape(op_context.output), output_data,
+          op_type::template op<data_type>);
+      break;
+  }
 }
 
-template <KernelType kernel_type, typename OpType>
-TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
+TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
+  TF_LITE_ENSURE_EQ(context, NumInputs(node), 2);
+  TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
   OpContext op_context(context, node);
+  TF_LITE_ENSURE_EQ(context, op_context.input1->type,
+                    op_context.input2->type);
+  TF_LITE_ENSURE_EQ(context, op_context.input1->type,
+                    op_context.output->type);
 
-  if (kernel_type == kReference) {
-    switch (op_context.output->type) {
-      case kTfLiteFloat32:
-        TFLiteOperation<float, OpType>(context, node, op_context);
-        break;
-      case kTfLiteUInt8:
-        TFLiteOperation<uint8_t, OpType>(context, node, op_context);
-        break;
-      case kTfLiteInt8:
-        TFLiteOperation<int8_t, OpType>(context, node, op_context);
-        break;
-      case kTfLiteInt32:
-        TFLiteOperation<int32_t, OpType>(context, node, op_context);
-        break;
-      case kTfLiteInt64:
-        TFLiteOperation<int64_t, OpType>(context, node, op_context);
-        break;
-      default:
-        TF_LITE_KERNEL_LOG(context,
-                           "Type %s (%d) is not supported by Maximum/Minimum.",
-                           TfLiteTypeGetName(op_context.output->type),
-                           op_context.output->type);
-        return kTfLiteError;
-    }
+  void* raw_data = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(OpData), &raw_data));
+  OpData* data = static_cast<OpData*>(raw_data);
+  const int64_t output_size = NumElements(op_context.output);
+  if (HaveSameShapes(op_context.input1, op_context.input2)) {
+    data->broadcast = kNoBroadcast;
+  } else if (NumElements(op_context.input1) == 1 &&
+             NumElements(op_context.input2) == output_size) {
+    data->broadcast = kScalarInput1;
+  } else if (NumElements(op_context.input2) == 1 &&
+             NumElements(op_context.input1) == output_size) {
+    data->broadcast = kScalarInput2;
   } else {
-    TF_LITE_KERNEL_LOG(context,
-                       "Kernel type not supported by Maximum/Minimum.");
-    return kTfLiteError;
+    data->broadcast = kGenericBroadcast;
+  }
+  node->user_data = data;
+  return kTfLiteOk;
+}
+
+template <typename OpType>
+TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
+  OpContext op_context(context, node);
+
+  switch (op_context.output->type) {
+    case kTfLiteFloat32:
+      TFLiteOperation<float, OpType>(context, node, op_context);
+      break;
+    case kTfLiteUInt8:
+      TFLiteOperation<uint8_t, OpType>(context, node, op_context);
+      break;
+    case kTfLiteInt8:
+      TFLiteOperation<int8_t, OpType>(context, node, op_context);
+      break;
+    case kTfLiteInt32:
+      TFLiteOperation<int32_t, OpType>(context, node, op_context);
+      break;
+    case kTfLiteInt64:
+      TFLiteOperation<int64_t, OpType>(context, node, op_context);
+      break;
+    default:
+      TF_LITE_KERNEL_LOG(context,
+                         "Type %s (%d) is not supported by Maximum/Minimum.",
+                         TfLiteTypeGetName(op_context.output->type),
+                         op_context.output->type);
+      return kTfLiteError;
   }
   return kTfLiteOk;
 }
@@ -118,15 +259,15 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
 
 TfLiteRegistration* Register_MAXIMUM() {
   static TfLiteRegistration r = {};
-  r.invoke = maximum_minimum::Eval<maximum_minimum::kReference,
-                                   maximum_minimum::MaximumOp>;
+  r.prepare = maximum_minimum::Prepare;
+  r.invoke = maximum_minimum::Eval<maximum_minimum::MaximumOp>;
   return &r;
 }
 
 TfLiteRegistration* Register_MINIMUM() {
   static TfLiteRegistration r = {};
-  r.invoke = maximum_minimum::Eval<maximum_minimum::kReference,
-                                   maximum_minimum::MinimumOp>;
+  r.prepare = maximum_minimum::Prepare;
+  r.invoke = maximum_minimum::Eval<maximum_minimum::MinimumOp>;
   return &r;
 }
 
@@ -40,11 +40,14 @@ TfLiteRegistration* Register_CONCATENATION();
 TfLiteRegistration* Register_COS();
 TfLiteRegistration* Register_DEPTHWISE_CONV_2D();
 TfLiteRegistration* Register_DEQUANTIZE();
+TfLiteRegistration* Register_ELU();
 TfLiteRegistration* Register_EQUAL();
 TfLiteRegistration* Register_FLOOR();
 TfLiteRegistration* Register_FULLY_CONNECTED();
 TfLiteRegistration* Register_GREATER();
 TfLiteRegistration* Register_GREATER_EQUAL();
+TfLiteRegistration* Register_HARD_SWISH();
+TfLiteRegistration* Register_LEAKY_RELU();
 TfLiteRegistration* Register_LESS();
 TfLiteRegistration* Register_LESS_EQUAL();
 TfLiteRegistration* Register_LOG();
@@ -75,7 +78,9 @@ TfLiteRegistration* Register_SPLIT();
 TfLiteRegistration* Register_SQRT();
 TfLiteRegistration* Register_SQUARE();
 TfLiteRegistration* Register_STRIDED_SLICE();
+TfLiteRegistration* Register_SUM();
 TfLiteRegistration* Register_SVDF();
+TfLiteRegistration* Register_TANH();
 TfLiteRegistration* Register_UNPACK();
 
 }  // namespace micro
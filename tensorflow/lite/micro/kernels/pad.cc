@@ -47,26 +47,97 @@ struct PadContext {
     }
     output = GetOutput(context, node, 0);
     dims = NumDimensions(input);
-
-    resizing_category = ResizingCategory::kGenericResize;
-    const int paddings_total = GetTensorShape(paddings).FlatSize();
-    const int32* paddings_data = GetTensorData<int32>(paddings);
-    // Paddings will be a n,2 array, and we need to detect 4D arrays with the
-    // pattern { {0,0}, {a, b}, {c, d}, {0,0} }.
-    if (IsConstantTensor(paddings) && paddings_total == 8 &&
-        (paddings_data[0] == 0 && paddings_data[1] == 0) &&
-        (paddings_data[6] == 0 && paddings_data[7] == 0)) {
-      resizing_category = ResizingCategory::kImageStyle;
-    }
   }
   const TfLiteTensor* constant_values;
   const TfLiteTensor* input;
   const TfLiteTensor* paddings;
   TfLiteTensor* output;
   int dims;
-  ResizingCategory resizing_category;
 };
 
+// Layout of the padded output, computed in Prepare. Trailing input
+// dimensions without padding are merged into one block, so that Eval writes
+// the output as a sequence of bulk fills and bulk copies.
+struct OpData {
+  // Number of dimensions left after merging, 0 if nothing is padded.
+  int dims;
+  int input_dims[4];
+  int left_padding[4];
+  int right_padding[4];
+  // Output elements per step along each dimension. For the last one this is
+  // the size of the merged block.
+  int output_strides[4];
+  // Input elements copied per step along the last dimension.
+  int block_size;
+};
+
+template <typename T>
+inline void Fill(T* output, int count, T value) {
+  if (sizeof(T) == 1) {
+    memset(output, static_cast<int>(value), count);
+  } else {
+    for (int i = 0; i < count; ++i) {
+      output[i] = value;
+    }
+  }
+}
+
+template <typename T>
+void PadDimension(const OpData& data, int dim, const T** input, T pad_value,
+                  T** output) {
+  const int left = data.left_padding[dim] * data.output_strides[dim];
+  Fill(*output, left, pad_value);
+  *output += left;
+  if (dim == data.dims - 1) {
+    const int count = data.input_dims[dim] * data.block_size;
+    memcpy(*output, *input, count * sizeof(T));
+    *input += count;
+    *output += count;
+  } else {
+    for (int i = 0; i < data.input_dims[dim]; ++i) {
+      PadDimension(data, dim + 1, input, pad_value, output);
+    }
+  }
+  const int right = data.right_padding[dim] * data.output_strides[dim];
+  Fill(*output, right, pad_value);
+  *output += right;
+}
+
+template <typename T>
+void Pad(const OpData& data, const TfLiteTensor* input, T pad_value,
+         TfLiteTensor* output) {
+  const T* input_data = GetTensorData<T>(input);
+  T* output_data = GetTensorData<T>(output);
+  if (data.dims == 0) {
+    memcpy(output_data, input_data, NumElements(input) * sizeof(T));
+    return;
+  }
+  PadDimension(data, 0, &input_data, pad_value, &output_data);
+}
+
+void CalculateOpData(const PadContext& op_context, OpData* data) {
+  const int32* paddings_data = GetTensorData<int32>(op_context.paddings);
+  // The last padded dimension, everything after it is one block.
+  int last = op_context.dims - 1;
+  while (last >= 0 && paddings_data[last * 2] == 0 &&
+         paddings_data[last * 2 + 1] == 0) {
+    --last;
+  }
+  data->dims = last + 1;
+  data->block_size = 1;
+  for (int i = last + 1; i < op_context.dims; ++i) {
+    data->block_size *= op_context.input->dims->data[i];
+  }
+  int output_stride = data->block_size;
+  for (int i = last; i >= 0; --i) {
+    data->input_dims[i] = op_context.input->dims->data[i];
+    data->left_padding[i] = paddings_data[i * 2];
+    data->right_padding[i] = paddings_data[i * 2 + 1];
+    data->output_strides[i] = output_stride;
+    output_stride *= op_context.output->dims->data[i];
+  }
+}
+
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE(context, NumInputs(node) == 2 || NumInputs(node) == 3);
   TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
@@ -76,12 +147,38 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   if (op_context.constant_values != nullptr) {
     TF_LITE_ENSURE_EQ(context, op_context.input->type,
                       op_context.constant_values->type);
+    // Ensure that constant_values is a scalar.
+    TF_LITE_ENSURE_EQ(context, NumElements(op_context.constant_values), 1);
+  }
+
+  if (op_context.output->type == kTfLiteUInt8 ||
+      op_context.output->type == kTfLiteInt8) {
+    if (op_context.constant_values == nullptr) {
+      // Quantized Pad requires that 0 is represented in the quantized range.
+      const int32_t qmin = op_context.output->type == kTfLiteUInt8
+                               ? std::numeric_limits<uint8_t>::min()
+                               : std::numeric_limits<int8_t>::min();
+      const int32_t qmax = op_context.output->type == kTfLiteUInt8
+                               ? std::numeric_limits<uint8_t>::max()
+                               : std::numeric_limits<int8_t>::max();
+      TF_LITE_ENSURE(context, op_context.output->params.zero_point >= qmin);
+      TF_LITE_ENSURE(context, op_context.output->params.zero_point <= qmax);
+    } else {
+      // Quantized Pad requires that 'constant_values' is represented in the
+      // same quantized range as the input and output tensors.
+      TF_LITE_ENSURE_EQ(context, op_context.output->params.zero_point,
+                        op_context.constant_values->params.zero_point);
+      TF_LITE_ENSURE(context, op_context.output->params.scale ==
+                                  op_context.constant_values->params.scale);
+    }
   }
 
   // There must be a pair of paddings for each output dimension.
   TF_LITE_ENSURE_EQ(context, GetTensorShape(op_context.paddings).FlatSize(),
                     op_context.output->dims->size * 2);
 
+  TF_LITE_ENSURE(context, IsConstantTensor(op_context.paddings));
+
   // On Micro, outputs must be properly sized by the converter.
   const int32* paddings_data = GetTensorData<int32>(op_context.paddings);
   for (int i = 0; i < op_context.output->dims->size; i++) {
@@ -94,106 +191,46 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   // Current implementations rely on the inputs being <= 4D.
   TF_LITE_ENSURE(
       context, op_context.dims <= reference_ops::PadKernelMaxDimensionCount());
-  TF_LITE_ENSURE(context, IsConstantTensor(op_context.paddings));
+
+  void* data = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(OpData), &data));
+  CalculateOpData(op_context, static_cast<OpData*>(data));
+  node->user_data = data;
   return kTfLiteOk;
 }
 
 TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   PadContext op_context(context, node);
+  const OpData& data = *static_cast<const OpData*>(node->user_data);
 
-  if (op_context.constant_values != nullptr) {
-    // Ensure that constant_values is a scalar.
-    TF_LITE_ENSURE_EQ(context, NumElements(op_context.constant_values), 1);
-  }
-
-  // Create before and after padding arrays that are accepted by the kernel.
-  const int32* paddings_data = GetTensorData<int32>(op_context.paddings);
-
-  tflite::PadParams op_params;
-  memset(&op_params, 0, sizeof(PadParams));
-  op_params.left_padding_count = op_context.dims;
-  op_params.right_padding_count = op_context.dims;
-
-  for (int idx = op_context.dims - 1; idx >= 0; --idx) {
-    op_params.left_padding[idx] = paddings_data[idx * 2];
-    op_params.right_padding[idx] = paddings_data[idx * 2 + 1];
-  }
-
-#define TF_LITE_PAD(type, op_name, scalar, pad_value)                     \
-  const scalar pad_value_copy = pad_value;                                \
-                                                                          \
-  type::op_name(op_params, GetTensorShape(op_context.input),              \
-                GetTensorData<scalar>(op_context.input), &pad_value_copy, \
-                GetTensorShape(op_context.output),                        \
-                GetTensorData<scalar>(op_context.output))
   switch (op_context.input->type) {
     case kTfLiteFloat32: {
       float pad_value = op_context.constant_values == nullptr
                             ? 0.f
                             : *GetTensorData<float>(op_context.constant_values);
-      if (op_context.resizing_category == ResizingCategory::kImageStyle) {
-        TF_LITE_PAD(reference_ops, PadImageStyle, float, pad_value);
-      } else {
-        TF_LITE_PAD(reference_ops, Pad, float, pad_value);
-      }
+      Pad(data, op_context.input, pad_value, op_context.output);
     } break;
     case kTfLiteUInt8: {
-      uint8_t pad_value;
-      if (op_context.constant_values == nullptr) {
-        // Quantized Pad requires that 0 is represented in the quantized
-        // range.
-        TF_LITE_ENSURE(context, op_context.output->params.zero_point >=
-                                    std::numeric_limits<uint8_t>::min());
-        TF_LITE_ENSURE(context, op_context.output->params.zero_point <=
-                                    std::numeric_limits<uint8_t>::max());
-        pad_value = static_cast<uint8_t>(op_context.output->params.zero_point);
-      } else {
-        // Quantized Pad requires that 'constant_values' is represented in the
-        // same quantized range as the input and output tensors.
-        TF_LITE_ENSURE_EQ(context, op_context.output->params.zero_point,
-                          op_context.constant_values->params.zero_point);
-        TF_LITE_ENSURE_EQ(
-            context, static_cast<double>(op_context.output->params.scale),
-            static_cast<double>(op_context.constant_values->params.scale));
-        pad_value = *GetTensorData<uint8_t>(op_context.constant_values);
-      }
-      if (op_context.resizing_category == ResizingCategory::kImageStyle) {
-        TF_LITE_PAD(reference_ops, PadImageStyle, uint8_t, pad_value);
-      } else {
-        TF_LITE_PAD(reference_ops, Pad, uint8_t, pad_value);
-      }
+      const uint8_t pad_value =
+          op_context.constant_values == nullptr
+              ? static_cast<uint8_t>(op_context.output->params.zero_point)
+              : *GetTensorData<uint8_t>(op_context.constant_values);
+      Pad(data, op_context.input, pad_value, op_context.output);
     } break;
     case kTfLiteInt8: {
-      int8_t pad_value;
-      if (op_context.constant_values == nullptr) {
-        // Quantized Pad requires that 0 is represented in the quantized
-        // range.
-        TF_LITE_ENSURE(context, op_context.output->params.zero_point >=
-                                    std::numeric_limits<int8_t>::min());
-        TF_LITE_ENSURE(context, op_context.output->params.zero_point <=
-                                    std::numeric_limits<int8_t>::max());
-        pad_value = static_cast<int8_t>(op_context.output->params.zero_point);
-      } else {
-        // Quantized Pad requires that 'constant_values' is represented in the
-        // same quantized range as the input and output tensors.
-        TF_LITE_ENSURE_EQ(context, op_context.output->params.zero_point,
-                          op_context.constant_values->params.zero_point);
-        TF_LITE_ENSURE(context, op_context.output->params.scale ==
-                                    op_context.constant_values->params.scale);
-        pad_value = *GetTensorData<int8_t>(op_context.constant_values);
-      }
-      if (op_context.resizing_category == ResizingCategory::kImageStyle) {
-        TF_LITE_PAD(reference_ops, PadImageStyle, int8_t, pad_value);
-      } else {
-        TF_LITE_PAD(reference_ops, Pad, int8_t, pad_value);
-      }
+      const int8_t pad_value =
+          op_context.constant_values == nullptr
+              ? static_cast<int8_t>(op_context.output->params.zero_point)
+              : *GetTensorData<int8_t>(op_context.constant_values);
+      Pad(data, op_context.input, pad_value, op_context.output);
     } break;
     case kTfLiteInt32: {
       int32_t pad_value =
           op_context.constant_values == nullptr
               ? 0
               : *GetTensorData<int32_t>(op_context.constant_values);
-      TF_LITE_PAD(reference_ops, Pad, int32_t, pad_value);
+      Pad(data, op_context.input, pad_value, op_context.output);
     } break;
     default:
 
@@ -201,7 +238,6 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
                          TfLiteTypeGetName(op_context.input->type));
       return kTfLiteError;
   }
-#undef TF_LITE_PAD
   return kTfLiteOk;
 }
 
@@ -15,17 +15,218 @@ limitations under the License.
 
 #include "tensorflow/lite/kernels/internal/reference/prelu.h"
 
+#include <cstring>
+#include <limits>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 
+#if defined(__ARM_FEATURE_DSP)
+#include "arm_math.h"
+#endif
+
 namespace tflite {
 namespace ops {
 namespace micro {
 namespace activations {
 
+// Requantization parameters of the quantized PRELU and LEAKY_RELU kernels,
+// computed in Prepare. LEAKY_RELU is evaluated as a PRELU whose alpha input is
+// a single zero code, with the sign of alpha in alpha_offset.
+struct PreluOpData {
+  int32_t input_offset;
+  int32_t alpha_offset;
+  int32_t output_offset;
+  // Rescales non-negative inputs from the input to the output scale.
+  int32_t output_multiplier_1;
+  int output_shift_1;
+  // Rescales input * alpha for negative inputs.
+  int32_t output_multiplier_2;
+  int output_shift_2;
+  // Whether non-negative inputs can be copied without rescaling.
+  bool identity_non_negative;
+  // Number of alpha values that repeat along the flat input, e.g. the channel
+  // count for per-channel alpha. 0 if alpha needs a general broadcast.
+  int alpha_period;
+};
+
+template <typename T>
+inline T PreluQuantizedValue(const PreluOpData& data, int32_t input,
+                             int32_t alpha) {
+  const int32_t input_value = data.input_offset + input;
+  int32_t output;
+  if (input_value >= 0) {
+    output = data.output_offset +
+             MultiplyByQuantizedMultiplier(
+                 input_value, data.output_multiplier_1, data.output_shift_1);
+  } else {
+    output = data.output_offset +
+             MultiplyByQuantizedMultiplier(
+                 input_value * (data.alpha_offset + alpha),
+                 data.output_multiplier_2, data.output_shift_2);
+  }
+  output = std::max<int32_t>(output, std::numeric_limits<T>::min());
+  output = std::min<int32_t>(output, std::numeric_limits<T>::max());
+  return static_cast<T>(output);
+}
+
+// Applies PRELU to `size` values, with alpha_data[0..alpha_period) repeating
+// along the input.
+template <typename T>
+void PreluQuantized(const PreluOpData& data, const T* input_data,
+                    const T* alpha_data, int size, T* output_data) {
+  const int alpha_period = data.alpha_period;
+  int alpha_index = 0;
+  int i = 0;
+#if defined(__ARM_FEATURE_DSP)
+  if (data.identity_non_negative) {
+    // Works on four values at a time: SSUB8/USUB8 against the zero point set
+    // the GE flag of every lane that is not negative, and SEL turns the flags
+    // into a mask. Words without negative lanes are copied as they are.
+    const uint32_t zero_points =
+        0x01010101u * static_cast<uint8_t>(-data.input_offset);
+    for (; i <= size - 4; i += 4) {
+      uint32_t word;
+      std::memcpy(&word, input_data + i, sizeof(word));
+      if (std::numeric_limits<T>::is_signed) {
+        __SSUB8(word, zero_points);
+      } else {
+        __USUB8(word, zero_points);
+      }
+      if (__SEL(0xFFFFFFFFu, 0u) == 0xFFFFFFFFu) {
+        std::memcpy(output_data + i, &word, sizeof(word));
+        alpha_index += 4;
+        while (alpha_index >= alpha_period) {
+          alpha_index -= alpha_period;
+        }
+        continue;
+      }
+      for (int j = i; j < i + 4; ++j) {
+        output_data[j] = PreluQuantizedValue<T>(data, input_data[j],
+                                                alpha_data[alpha_index]);
+        if (++alpha_index == alpha_period) {
+          alpha_index = 0;
+        }
+      }
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    output_data[i] =
+        PreluQuantizedValue<T>(data, input_data[i], alpha_data[alpha_index]);
+    if (++alpha_index == alpha_period) {
+      alpha_index = 0;
+    }
+  }
+}
+
+template <typename T>
+void BroadcastPreluQuantized(const PreluOpData& data,
+                             const RuntimeShape& input_shape,
+                             const T* input_data,
+                             const RuntimeShape& alpha_shape,
+                             const T* alpha_data,
+                             const RuntimeShape& unextended_output_shape,
+                             T* output_data) {
+  const RuntimeShape output_shape =
+      RuntimeShape::ExtendedShape(4, unextended_output_shape);
+  NdArrayDesc<4> desc1;
+  NdArrayDesc<4> desc2;
+  NdArrayDescsForElementwiseBroadcast(input_shape, alpha_shape, &desc1, &desc2);
+  for (int b = 0; b < output_shape.Dims(0); ++b) {
+    for (int y = 0; y < output_shape.Dims(1); ++y) {
+      for (int x = 0; x < output_shape.Dims(2); ++x) {
+        for (int c = 0; c < output_shape.Dims(3); ++c) {
+          output_data[Offset(output_shape, b, y, x, c)] =
+              PreluQuantizedValue<T>(
+                  data, input_data[SubscriptToIndex(desc1, b, y, x, c)],
+                  alpha_data[SubscriptToIndex(desc2, b, y, x, c)]);
+        }
+      }
+    }
+  }
+}
+
+// Returns how many alpha values repeat along the flat input, or 0 if alpha
+// does not line up with the innermost input dimensions.
+int AlphaPeriod(const TfLiteTensor* input, const TfLiteTensor* alpha,
+                const TfLiteTensor* output) {
+  if (!HaveSameShapes(input, output)) {
+    return 0;
+  }
+  const int input_dims = NumDimensions(input);
+  const int alpha_dims = NumDimensions(alpha);
+  if (alpha_dims > input_dims) {
+    return 0;
+  }
+  // Leading ones of alpha broadcast, the rest has to match the input.
+  int i = 0;
+  while (i < alpha_dims && SizeOfDimension(alpha, i) == 1) {
+    ++i;
+  }
+  for (; i < alpha_dims; ++i) {
+    if (SizeOfDimension(alpha, i) !=
+        SizeOfDimension(input, input_dims - alpha_dims + i)) {
+      return 0;
+    }
+  }
+  return NumElements(alpha);
+}
+
+TfLiteStatus CalculatePreluOpData(TfLiteContext* context,
+                                  const TfLiteTensor* input,
+                                  const TfLiteTensor* output,
+                                  double alpha_scale, PreluOpData* data) {
+  TF_LITE_ENSURE(context, output->params.scale > 0.f);
+  data->input_offset = -input->params.zero_point;
+  data->output_offset = output->params.zero_point;
+  const double input_scale = static_cast<double>(input->params.scale);
+  const double output_scale = static_cast<double>(output->params.scale);
+  QuantizeMultiplier(input_scale / output_scale, &data->output_multiplier_1,
+                     &data->output_shift_1);
+  QuantizeMultiplier(input_scale * alpha_scale / output_scale,
+                     &data->output_multiplier_2, &data->output_shift_2);
+  data->identity_non_negative =
+      input->params.scale == output->params.scale &&
+      input->params.zero_point == output->params.zero_point;
+  return kTfLiteOk;
+}
+
 TfLiteStatus PreluPrepare(TfLiteContext* context, TfLiteNode* node) {
+  TF_LITE_ENSURE_EQ(context, NumInputs(node), 2);
+  TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
+  const TfLiteTensor* input = GetInput(context, node, 0);
+  const TfLiteTensor* alpha = GetInput(context, node, 1);
+  TfLiteTensor* output = GetOutput(context, node, 0);
+  if (input->type != kTfLiteInt8 && input->type != kTfLiteUInt8) {
+    return kTfLiteOk;
+  }
+  TF_LITE_ENSURE_EQ(context, alpha->type, input->type);
+  TF_LITE_ENSURE_EQ(context, output->type, input->type);
+
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(PreluOpData), &raw));
+  PreluOpData* data = static_cast<PreluOpData*>(raw);
+  TF_LITE_ENSURE_STATUS(CalculatePreluOpData(
+      context, input, output, static_cast<double>(alpha->params.scale), data));
+  data->alpha_offset = -alpha->params.zero_point;
+  if (input->type == kTfLiteUInt8) {
+    // The uint8 kernel copies non-negative inputs and uses the older multiplier
+    // format for the negative ones.
+    const double real_multiplier = static_cast<double>(input->params.scale) *
+                                   static_cast<double>(alpha->params.scale) /
+                                   static_cast<double>(output->params.scale);
+    QuantizeMultiplierSmallerThanOneExp(real_multiplier,
+                                        &data->output_multiplier_2,
+                                        &data->output_shift_2);
+  }
+  data->alpha_period = AlphaPeriod(input, alpha, output);
+  node->user_data = data;
   return kTfLiteOk;
 }
 
@@ -64,15 +265,6 @@ TfLiteStatus PreluEval(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteTensor* input = GetInput(context, node, 0);
   const TfLiteTensor* alpha = GetInput(context, node, 1);
   TfLiteTensor* output = GetOutput(context, node, 0);
-  int32_t output_multiplier = 0;
-  int output_shift = 0;
-  if (output->type == kTfLiteUInt8 || output->type == kTfLiteInt16) {
-    double real_multiplier = static_cast<double>(input->params.scale) *
-                             static_cast<double>(alpha->params.scale) /
-                             static_cast<double>(output->params.scale);
-    QuantizeMultiplierSmallerThanOneExp(real_multiplier, &output_multiplier,
-                                        &output_shift);
-  }
   switch (input->type) {
     case kTfLiteFloat32: {
       BroadcastPrelu4DSlowFloat(
@@ -82,22 +274,106 @@ TfLiteStatus PreluEval(TfLiteContext* context, TfLiteNode* node) {
       return kTfLiteOk;
     } break;
     case kTfLiteUInt8: {
+      const PreluOpData* data =
+          static_cast<const PreluOpData*>(node->user_data);
       PreluParams op_params;
-      op_params.input_offset = -input->params.zero_point;
-      op_params.alpha_offset = -alpha->params.zero_point;
-      op_params.output_offset = output->params.zero_point;
-      op_params.output_multiplier = output_multiplier;
-      op_params.output_shift = output_shift;
+      op_params.input_offset = data->input_offset;
+      op_params.alpha_offset = data->alpha_offset;
+      op_params.output_offset = data->output_offset;
+      op_params.output_multiplier = data->output_multiplier_2;
+      op_params.output_shift = data->output_shift_2;
       reference_ops::BroadcastPrelu4DSlow(
           op_params, GetTensorShape(input), GetTensorData<uint8_t>(input),
           GetTensorShape(alpha), GetTensorData<uint8_t>(alpha),
           GetTensorShape(output), GetTensorData<uint8_t>(output));
       return kTfLiteOk;
     } break;
+    case kTfLiteInt8: {
+      const PreluOpData& data =
+          *static_cast<const PreluOpData*>(node->user_data);
+      if (data.alpha_period > 0) {
+        PreluQuantized(data, GetTensorData<int8_t>(input),
+                       GetTensorData<int8_t>(alpha),
+                       NumElements(input), GetTensorData<int8_t>(output));
+      } else {
+        BroadcastPreluQuantized(
+            data, GetTensorShape(input), GetTensorData<int8_t>(input),
+            GetTensorShape(alpha), GetTensorData<int8_t>(alpha),
+            GetTensorShape(output), GetTensorData<int8_t>(output));
+      }
+      return kTfLiteOk;
+    } break;
     default:
-      TF_LITE_KERNEL_LOG(
-          context, "Only float32 and uint8 are supported currently, got %d.",
-          TfLiteTypeGetName(input->type));
+      TF_LITE_KERNEL_LOG(context,
+                         "Only float32, uint8 and int8 are supported "
+                         "currently, got %s.",
+                         TfLiteTypeGetName(input->type));
+      return kTfLiteError;
+  }
+}
+
+TfLiteStatus LeakyReluPrepare(TfLiteContext* context, TfLiteNode* node) {
+  TF_LITE_ENSURE_EQ(context, NumInputs(node), 1);
+  TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
+  const TfLiteTensor* input = GetInput(context, node, 0);
+  TfLiteTensor* output = GetOutput(context, node, 0);
+  TF_LITE_ENSURE_EQ(context, input->type, output->type);
+  if (input->type != kTfLiteInt8 && input->type != kTfLiteUInt8) {
+    return kTfLiteOk;
+  }
+
+  const auto* params =
+      reinterpret_cast<const TfLiteLeakyReluParams*>(node->builtin_data);
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(PreluOpData), &raw));
+  PreluOpData* data = static_cast<PreluOpData*>(raw);
+  const double alpha = static_cast<double>(params->alpha);
+  TF_LITE_ENSURE_STATUS(CalculatePreluOpData(
+      context, input, output, alpha < 0 ? -alpha : alpha, data));
+  data->alpha_offset = alpha < 0 ? -1 : 1;
+  data->alpha_period = 1;
+  node->user_data = data;
+  return kTfLiteOk;
+}
+
+TfLiteStatus LeakyReluEval(TfLiteContext* context, TfLiteNode* node) {
+  const TfLiteTensor* input = GetInput(context, node, 0);
+  TfLiteTensor* output = GetOutput(context, node, 0);
+  const int flat_size =
+      MatchingFlatSize(GetTensorShape(input), GetTensorShape(output));
+  switch (input->type) {
+    case kTfLiteFloat32: {
+      const auto* params =
+          reinterpret_cast<const TfLiteLeakyReluParams*>(node->builtin_data);
+      const float* input_data = GetTensorData<float>(input);
+      float* output_data = GetTensorData<float>(output);
+      for (int i = 0; i < flat_size; ++i) {
+        const float value = input_data[i];
+        output_data[i] = value >= 0.f ? value : value * params->alpha;
+      }
+      return kTfLiteOk;
+    }
+    case kTfLiteInt8: {
+      // Alpha is folded into the multiplier, see LeakyReluPrepare.
+      static const int8_t kZeroAlpha = 0;
+      PreluQuantized(*static_cast<const PreluOpData*>(node->user_data),
+                     GetTensorData<int8_t>(input), &kZeroAlpha, flat_size,
+                     GetTensorData<int8_t>(output));
+      return kTfLiteOk;
+    }
+    case kTfLiteUInt8: {
+      static const uint8_t kZeroAlpha = 0;
+      PreluQuantized(*static_cast<const PreluOpData*>(node->user_data),
+                     GetTensorData<uint8_t>(input), &kZeroAlpha, flat_size,
+                     GetTensorData<uint8_t>(output));
+      return kTfLiteOk;
+    }
+    default:
+      TF_LITE_KERNEL_LOG(context,
+                         "Only float32, uint8 and int8 are supported "
+                         "currently, got %s.",
+                         TfLiteTypeGetName(input->type));
       return kTfLiteError;
   }
 }
@@ -111,6 +387,13 @@ TfLiteRegistration* Register_PRELU() {
   return &r;
 }
 
+TfLiteRegistration* Register_LEAKY_RELU() {
+  static TfLiteRegistration r = {};
+  r.prepare = activations::LeakyReluPrepare;
+  r.invoke = activations::LeakyReluEval;
+  return &r;
+}
+
 }  // namespace micro
 }  // namespace ops
 }  // namespace tflite
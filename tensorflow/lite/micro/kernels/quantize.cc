@@ -12,18 +12,106 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
-#include "tensorflow/lite/kernels/internal/reference/quantize.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/round.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 
+#if defined(__ARM_FEATURE_DSP)
+#include "arm_math.h"
+#endif
+
 namespace tflite {
 namespace ops {
 namespace micro {
 namespace quantize {
 
+struct OpData {
+  // 1 / output scale, so that Eval multiplies instead of dividing.
+  float inverse_scale;
+  int32_t zero_point;
+  // Input to output scale for requantizing int16 input, so that this path
+  // needs no floating point math.
+  int32_t input_zero_point;
+  int32_t requantize_multiplier;
+  int requantize_shift;
+};
+
+template <typename OutputT>
+inline int32_t Saturate(int32_t value) {
+#if defined(__ARM_FEATURE_DSP)
+  return std::numeric_limits<OutputT>::is_signed
+             ? __SSAT(value, 8)
+             : static_cast<int32_t>(__USAT(value, 8));
+#else
+  return std::min<int32_t>(
+      std::max<int32_t>(value, std::numeric_limits<OutputT>::min()),
+      std::numeric_limits<OutputT>::max());
+#endif
+}
+
+template <typename InputT>
+inline int32_t QuantizeValue(InputT value, float inverse_scale,
+                             int32_t zero_point) {
+  return static_cast<int32_t>(
+             TfLiteRound(static_cast<float>(value) * inverse_scale)) +
+         zero_point;
+}
+
+// Same as reference_ops::AffineQuantize, but with a multiplication by the
+// precomputed reciprocal and four elements per iteration.
+template <typename InputT, typename OutputT>
+void AffineQuantize(const OpData& data, const InputT* input_data, int size,
+                    OutputT* output_data) {
+  const float inverse_scale = data.inverse_scale;
+  const int32_t zero_point = data.zero_point;
+  int i = 0;
+  for (; i <= size - 4; i += 4) {
+    const int32_t q0 = Saturate<OutputT>(
+        QuantizeValue(input_data[i], inverse_scale, zero_point));
+    const int32_t q1 = Saturate<OutputT>(
+        QuantizeValue(input_data[i + 1], inverse_scale, zero_point));
+    const int32_t q2 = Saturate<OutputT>(
+        QuantizeValue(input_data[i + 2], inverse_scale, zero_point));
+    const int32_t q3 = Saturate<OutputT>(
+        QuantizeValue(input_data[i + 3], inverse_scale, zero_point));
+#if defined(__ARM_FEATURE_DSP)
+    // One word store instead of four byte stores.
+    const int32_t packed = __PACKq7(q0, q1, q2, q3);
+    std::memcpy(output_data + i, &packed, sizeof(packed));
+#else
+    output_data[i] = static_cast<OutputT>(q0);
+    output_data[i + 1] = static_cast<OutputT>(q1);
+    output_data[i + 2] = static_cast<OutputT>(q2);
+    output_data[i + 3] = static_cast<OutputT>(q3);
+#endif
+  }
+  for (; i < size; ++i) {
+    output_data[i] = static_cast<OutputT>(Saturate<OutputT>(
+        QuantizeValue(input_data[i], inverse_scale, zero_point)));
+  }
+}
+
+// Integer rescaling of already quantized input.
+template <typename InputT, typename OutputT>
+void Requantize(const OpData& data, const InputT* input_data, int size,
+                OutputT* output_data) {
+  for (int i = 0; i < size; ++i) {
+    const int32_t value =
+        MultiplyByQuantizedMultiplier(input_data[i] - data.input_zero_point,
+                                      data.requantize_multiplier,
+                                      data.requantize_shift) +
+        data.zero_point;
+    output_data[i] = static_cast<OutputT>(Saturate<OutputT>(value));
+  }
+}
+
 void* Init(TfLiteContext* context, const char* buffer, size_t length) {
   return nullptr;
 }
@@ -51,6 +139,21 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
                  input->type == kTfLiteFloat32 || input->type == kTfLiteInt16);
   TF_LITE_ENSURE(context,
                  output->type == kTfLiteUInt8 || output->type == kTfLiteInt8);
+  TF_LITE_ENSURE(context, output->params.scale > 0.f);
+
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(OpData), &raw));
+  OpData* data = static_cast<OpData*>(raw);
+  data->inverse_scale = 1.f / output->params.scale;
+  data->zero_point = output->params.zero_point;
+  if (input->type == kTfLiteInt16) {
+    data->input_zero_point = input->params.zero_point;
+    QuantizeMultiplier(static_cast<double>(input->params.scale) /
+                           static_cast<double>(output->params.scale),
+                       &data->requantize_multiplier, &data->requantize_shift);
+  }
+  node->user_data = data;
 
   return kTfLiteOk;
 }
@@ -59,21 +162,19 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   TfLiteTensor* input = &context->tensors[node->inputs->data[0]];
   TfLiteTensor* output = &context->tensors[node->outputs->data[0]];
 
-  tflite::QuantizationParams op_params;
-  op_params.zero_point = output->params.zero_point;
-  op_params.scale = static_cast<double>(output->params.scale);
+  const OpData& data = *static_cast<const OpData*>(node->user_data);
+  const int flat_size =
+      MatchingFlatSize(GetTensorShape(input), GetTensorShape(output));
 
   if (input->type == kTfLiteFloat32) {
     switch (output->type) {
       case kTfLiteInt8:
-        reference_ops::AffineQuantize(
-            op_params, GetTensorShape(input), GetTensorData<float>(input),
-            GetTensorShape(output), GetTensorData<int8_t>(output));
+        AffineQuantize(data, GetTensorData<float>(input), flat_size,
+                       GetTensorData<int8_t>(output));
         break;
       case kTfLiteUInt8:
-        reference_ops::AffineQuantize(
-            op_params, GetTensorShape(input), GetTensorData<float>(input),
-            GetTensorShape(output), GetTensorData<uint8_t>(output));
+        AffineQuantize(data, GetTensorData<float>(input), flat_size,
+                       GetTensorData<uint8_t>(output));
         break;
       default:
         TF_LITE_KERNEL_LOG(context, "Input %s, output %s not supported.",
@@ -84,9 +185,8 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   } else if (input->type == kTfLiteInt16) {
     switch (output->type) {
       case kTfLiteInt8:
-        reference_ops::AffineQuantize(
-            op_params, GetTensorShape(input), GetTensorData<int16_t>(input),
-            GetTensorShape(output), GetTensorData<int8_t>(output));
+        Requantize(data, GetTensorData<int16_t>(input), flat_size,
+                   GetTensorData<int8_t>(output));
         break;
 
       default:
@@ -109,7 +209,8 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
 
 // This Op (QUANTIZE) quantizes the input and produces quantized output.
 // AffineQuantize takes scale and zero point and quantizes the float value to
-// quantized output, in int8 or uint8 format.
+// quantized output, in int8 or uint8 format. The reciprocal of the scale is
+// computed once in Prepare.
 TfLiteRegistration* Register_QUANTIZE() {
   static TfLiteRegistration r = {};
   r.init = quantize::Init;
@@ -15,8 +15,12 @@ limitations under the License.
 
 #include "tensorflow/lite/kernels/internal/reference/reduce.h"
 
+#include <cstring>
+#include <limits>
+
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
 #include "tensorflow/lite/kernels/internal/types.h"
@@ -28,7 +32,25 @@ namespace micro {
 namespace reduce {
 
 constexpr int kMaxNumberOfAxis = 4;
-constexpr int kMaxNumberOfReducedAxis = 2;
+
+// Everything about the reduction that only depends on shapes, axes and
+// quantization, resolved once in Prepare.
+struct OpData {
+  int resolved_axis[kMaxNumberOfAxis];
+  int num_resolved_axis;
+  // Number of input elements summed into each output element.
+  int num_elements_in_axis;
+  // Quantized types only: accumulators are requantized with
+  // (sum - num_elements_in_axis * input_zero_point) * multiplier + output_zp.
+  int32_t multiplier;
+  int shift;
+  int32_t input_zero_point;
+  int32_t output_zero_point;
+  // Index of the int32 accumulator scratch buffer.
+  int accumulator_buffer_idx;
+  // 4D input reduced over height and width, i.e. global average pooling.
+  bool is_global_pool;
+};
 
 TfLiteStatus PrepareSimple(TfLiteContext* context, TfLiteNode* node) {
   // Inputs Tensor (dtype depends on quantization):
@@ -48,12 +70,71 @@ TfLiteStatus PrepareSimple(TfLiteContext* context, TfLiteNode* node) {
   return kTfLiteOk;
 }
 
-TfLiteStatus PrepareMeanOrSum(TfLiteContext* context, TfLiteNode* node) {
+TfLiteStatus PrepareMeanOrSum(TfLiteContext* context, TfLiteNode* node,
+                              bool compute_sum) {
   TF_LITE_ENSURE_OK(context, PrepareSimple(context, node));
-  // TODO(b/144955155): Support uint8(b/144955155) and int8(b/144955018)
+  const TfLiteTensor* input = &context->tensors[node->inputs->data[0]];
+  const TfLiteTensor* axis = &context->tensors[node->inputs->data[1]];
+  const TfLiteTensor* output = &context->tensors[node->outputs->data[0]];
+  TF_LITE_ENSURE_TYPES_EQ(context, input->type, output->type);
+  // Output shapes are fixed in TFLM, so the axes have to be as well.
+  TF_LITE_ENSURE(context, IsConstantTensor(axis));
+  TF_LITE_ENSURE(context, NumDimensions(input) <= kMaxNumberOfAxis);
+  TF_LITE_ENSURE(context, NumElements(axis) <= kMaxNumberOfAxis);
+
+  // The op data is filled in on the stack and only copied to the persistent
+  // area after the scratch buffer has been requested, so that the request
+  // directly follows the previous one in the tail.
+  OpData data = {};
+  TF_LITE_ENSURE(context,
+                 reference_ops::ResolveAxis(
+                     NumDimensions(input), GetTensorData<int>(axis),
+                     NumElements(axis), data.resolved_axis,
+                     &data.num_resolved_axis));
+  data.num_elements_in_axis = 1;
+  for (int i = 0; i < data.num_resolved_axis; ++i) {
+    data.num_elements_in_axis *= input->dims->data[data.resolved_axis[i]];
+  }
+  data.is_global_pool =
+      NumDimensions(input) == 4 && data.num_resolved_axis == 2 &&
+      ((data.resolved_axis[0] == 1 && data.resolved_axis[1] == 2) ||
+       (data.resolved_axis[0] == 2 && data.resolved_axis[1] == 1));
+
+  if (input->type == kTfLiteInt8 || input->type == kTfLiteUInt8) {
+    TF_LITE_ENSURE(context, data.num_elements_in_axis > 0);
+    data.input_zero_point = input->params.zero_point;
+    data.output_zero_point = output->params.zero_point;
+    double real_multiplier =
+        static_cast<double>(input->params.scale) / output->params.scale;
+    if (!compute_sum) {
+      real_multiplier /= data.num_elements_in_axis;
+    }
+    QuantizeMultiplier(real_multiplier, &data.multiplier, &data.shift);
+
+    // Global pooling accumulates one batch at a time.
+    const int accumulators =
+        data.is_global_pool ? input->dims->data[3] : NumElements(output);
+    TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+        context, accumulators * sizeof(int32_t),
+        &data.accumulator_buffer_idx));
+  }
+
+  void* raw_data = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(OpData), &raw_data));
+  *static_cast<OpData*>(raw_data) = data;
+  node->user_data = raw_data;
   return kTfLiteOk;
 }
 
+TfLiteStatus PrepareMean(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareMeanOrSum(context, node, /*compute_sum=*/false);
+}
+
+TfLiteStatus PrepareSum(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareMeanOrSum(context, node, /*compute_sum=*/true);
+}
+
 void ResolveAxis(const int* axis_data, int axis_count,
                  tflite::MeanParams* op_params) {
   int i = 0;
@@ -66,39 +147,93 @@ void ResolveAxis(const int* axis_data, int axis_count,
   op_params->axis_count = axis_count;
 }
 
+template <typename T>
+inline T Requantize(int32_t sum, const OpData* data) {
+  int32_t result = MultiplyByQuantizedMultiplier(
+      sum - data->num_elements_in_axis * data->input_zero_point,
+      data->multiplier, data->shift);
+  result += data->output_zero_point;
+  result = std::max<int32_t>(result, std::numeric_limits<T>::min());
+  result = std::min<int32_t>(result, std::numeric_limits<T>::max());
+  return static_cast<T>(result);
+}
+
+// Sums over height and width of a NHWC tensor. Channels are contiguous, so
+// every input row is added to one row of accumulators.
+template <typename T>
+void GlobalPoolQuantized(const TfLiteTensor* input, const OpData* data,
+                         int32_t* accumulators, TfLiteTensor* output) {
+  const int batches = input->dims->data[0];
+  const int spatial_size = input->dims->data[1] * input->dims->data[2];
+  const int depth = input->dims->data[3];
+  const T* input_data = GetTensorData<T>(input);
+  T* output_data = GetTensorData<T>(output);
+  for (int b = 0; b < batches; ++b) {
+    memset(accumulators, 0, depth * sizeof(int32_t));
+    for (int i = 0; i < spatial_size; ++i) {
+      for (int c = 0; c < depth; ++c) {
+        accumulators[c] += input_data[c];
+      }
+      input_data += depth;
+    }
+    for (int c = 0; c < depth; ++c) {
+      output_data[c] = Requantize<T>(accumulators[c], data);
+    }
+    output_data += depth;
+  }
+}
+
+template <typename T>
+void MeanOrSumQuantized(const TfLiteTensor* input, const OpData* data,
+                        int32_t* accumulators, TfLiteTensor* output) {
+  const int num_outputs = NumElements(output);
+  memset(accumulators, 0, num_outputs * sizeof(int32_t));
+  int temp_index[kMaxNumberOfAxis];
+  reference_ops::ReduceSumImpl<T, int32_t>(
+      GetTensorData<T>(input), input->dims->data, output->dims->data,
+      input->dims->size, output->dims->size, data->resolved_axis,
+      data->num_resolved_axis, temp_index, accumulators);
+  T* output_data = GetTensorData<T>(output);
+  for (int i = 0; i < num_outputs; ++i) {
+    output_data[i] = Requantize<T>(accumulators[i], data);
+  }
+}
+
+template <typename T>
+void EvalQuantized(TfLiteContext* context, const TfLiteTensor* input,
+                   const OpData* data, TfLiteTensor* output) {
+  int32_t* accumulators = static_cast<int32_t*>(
+      context->GetScratchBuffer(context, data->accumulator_buffer_idx));
+  if (data->is_global_pool) {
+    GlobalPoolQuantized<T>(input, data, accumulators, output);
+  } else {
+    MeanOrSumQuantized<T>(input, data, accumulators, output);
+  }
+}
+
 TfLiteStatus EvalMean(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteTensor* input = &context->tensors[node->inputs->data[0]];
   const TfLiteTensor* axis = &context->tensors[node->inputs->data[1]];
   TfLiteTensor* output = &context->tensors[node->outputs->data[0]];
   TfLiteReducerParams* params =
       reinterpret_cast<TfLiteReducerParams*>(node->builtin_data);
+  const OpData* data = static_cast<const OpData*>(node->user_data);
 
   int num_axis = static_cast<int>(NumElements(axis));
   int temp_index[kMaxNumberOfAxis];
-  int resolved_axis[kMaxNumberOfReducedAxis];
+  int resolved_axis[kMaxNumberOfAxis];
 
   switch (input->type) {
     case kTfLiteFloat32: {
-      tflite::MeanParams op_params;
-      ResolveAxis(GetTensorData<int>(axis), num_axis, &op_params);
-      // TODO(b/146571391): Support only 4D Input and 2D Axis for Mean until
-      // scratch tensor allocation has been implemented in (b/132070898)
-      bool is_valid_inputs =
-          (NumDimensions(input) == 4 && op_params.axis_count == 2 &&
-           ((op_params.axis[0] == 1 && op_params.axis[1] == 2) ||
-            (op_params.axis[0] == 2 && op_params.axis[1] == 1)));
-      TF_LITE_ENSURE_MSG(
-          context, is_valid_inputs == true,
-          "Number of Input "
-          "dimensions != 4 OR the Axis is not either [1, 2] or [2, 1]");
-      // TODO(b/139102329): Handle the below special case in the combined
-      // reference method.
       // Defer to specialized implementation for 4D Mean across axes 1 & 2.
-      if (params->keep_dims) {
+      if (data->is_global_pool && params->keep_dims) {
+        tflite::MeanParams op_params;
+        ResolveAxis(data->resolved_axis, data->num_resolved_axis, &op_params);
         reference_ops::Mean(op_params, GetTensorShape(input),
                             GetTensorData<float>(input), GetTensorShape(output),
                             GetTensorData<float>(output));
       } else {
+        // The output is large enough to hold the float sums.
         TF_LITE_ENSURE(
             context,
             reference_ops::Mean(GetTensorData<float>(input), input->dims->data,
@@ -109,11 +244,48 @@ TfLiteStatus EvalMean(TfLiteContext* context, TfLiteNode* node) {
                                 GetTensorData<float>(output)));
       }
     } break;
+    case kTfLiteInt8:
+      EvalQuantized<int8_t>(context, input, data, output);
+      break;
+    case kTfLiteUInt8:
+      EvalQuantized<uint8_t>(context, input, data, output);
+      break;
+    default:
+      TF_LITE_KERNEL_LOG(context, "Type %s not supported by MEAN.",
+                         TfLiteTypeGetName(input->type));
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus EvalSum(TfLiteContext* context, TfLiteNode* node) {
+  const TfLiteTensor* input = &context->tensors[node->inputs->data[0]];
+  TfLiteTensor* output = &context->tensors[node->outputs->data[0]];
+  const OpData* data = static_cast<const OpData*>(node->user_data);
+
+  switch (input->type) {
+    case kTfLiteFloat32: {
+      float* output_data = GetTensorData<float>(output);
+      const int num_outputs = NumElements(output);
+      for (int i = 0; i < num_outputs; ++i) {
+        output_data[i] = 0.f;
+      }
+      int temp_index[kMaxNumberOfAxis];
+      reference_ops::ReduceSumImpl<float, float>(
+          GetTensorData<float>(input), input->dims->data, output->dims->data,
+          input->dims->size, output->dims->size, data->resolved_axis,
+          data->num_resolved_axis, temp_index, output_data);
+    } break;
+    case kTfLiteInt8:
+      EvalQuantized<int8_t>(context, input, data, output);
+      break;
+    case kTfLiteUInt8:
+      EvalQuantized<uint8_t>(context, input, data, output);
+      break;
     default:
-      // TODO(b/144955155): Support uint8(b/144955155) and int8(b/144955018)
-      TF_LITE_ENSURE_MSG(context, false,
-                         "Currently, only float32 input type "
-                         "is supported.");
+      TF_LITE_KERNEL_LOG(context, "Type %s not supported by SUM.",
+                         TfLiteTypeGetName(input->type));
+      return kTfLiteError;
   }
   return kTfLiteOk;
 }
@@ -123,10 +295,19 @@ TfLiteRegistration* Register_MEAN() {
   static TfLiteRegistration r = {};
   r.init = nullptr;
   r.free = nullptr;
-  r.prepare = reduce::PrepareMeanOrSum;
+  r.prepare = reduce::PrepareMean;
   r.invoke = reduce::EvalMean;
   return &r;
 }
+
+TfLiteRegistration* Register_SUM() {
+  static TfLiteRegistration r = {};
+  r.init = nullptr;
+  r.free = nullptr;
+  r.prepare = reduce::PrepareSum;
+  r.invoke = reduce::EvalSum;
+  return &r;
+}
 }  // namespace micro
 }  // namespace ops
 }  // namespace tflite
@@ -0,0 +1,126 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_model_builder.h"
+
+namespace tflite {
+namespace testing {
+namespace {
+
+constexpr int kHeight = 4;
+constexpr int kWidth = 4;
+constexpr int kDepth = 3;
+constexpr int kZeroPoint = 5;
+constexpr int kChannelBase[kDepth] = {-10, 0, 10};
+
+// Alternates in sign along height and width, so that it averages to zero over
+// either of them.
+int SpatialPattern(int h, int w) {
+  return (h % 2 == 0 ? 1 : -1) * (w % 2 == 0 ? 2 : -2);
+}
+
+}  // namespace
+}  // namespace testing
+}  // namespace tflite
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(SeveralQuantizedMeanOps) {
+  using tflite::testing::kDepth;
+  using tflite::testing::kHeight;
+  using tflite::testing::kWidth;
+  using tflite::testing::kZeroPoint;
+
+  // Three int8 MEAN ops, each with its own accumulator scratch buffer:
+  //   input [1, 4, 4, 3] -- axes {1, 2} --> pooled [1, 1, 1, 3]
+  //   input [1, 4, 4, 3] -- axis {3} ----> depth_mean [1, 4, 4]
+  //   depth_mean ---------- axis {1} ----> column_mean [1, 4]
+  // All tensors share scale 1 and one zero point, so every mean is exact.
+  tflite::testing::TestModelBuilder builder;
+  const int mean = builder.AddOperatorCode(tflite::BuiltinOperator_MEAN, 2);
+  const int input = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kHeight, kWidth, kDepth}, 1.0f, kZeroPoint);
+  const int pooled = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, 1, 1, kDepth}, 1.0f, kZeroPoint);
+  const int depth_mean = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kHeight, kWidth}, 1.0f, kZeroPoint);
+  const int column_mean = builder.AddQuantizedTensor(
+      tflite::TensorType_INT8, {1, kWidth}, 1.0f, kZeroPoint);
+  const int32_t axes_shape[] = {2};
+  const int32_t spatial_axes[] = {1, 2};
+  const int32_t depth_axis[] = {3};
+  const int32_t height_axis[] = {1};
+  const int spatial = builder.AddTensor(tflite::TensorType_INT32, axes_shape,
+                                        1, spatial_axes, sizeof(spatial_axes));
+  const int32_t axis_shape[] = {1};
+  const int depth = builder.AddTensor(tflite::TensorType_INT32, axis_shape, 1,
+                                      depth_axis, sizeof(depth_axis));
+  const int height = builder.AddTensor(tflite::TensorType_INT32, axis_shape, 1,
+                                       height_axis, sizeof(height_axis));
+  flatbuffers::FlatBufferBuilder* fbb = builder.builder();
+  builder.AddOperator(
+      mean, {input, spatial}, {pooled}, tflite::BuiltinOptions_ReducerOptions,
+      tflite::CreateReducerOptions(*fbb, /*keep_dims=*/true).Union());
+  builder.AddOperator(mean, {input, depth}, {depth_mean},
+                      tflite::BuiltinOptions_ReducerOptions,
+                      tflite::CreateReducerOptions(*fbb, false).Union());
+  builder.AddOperator(mean, {depth_mean, height}, {column_mean},
+                      tflite::BuiltinOptions_ReducerOptions,
+                      tflite::CreateReducerOptions(*fbb, false).Union());
+  const tflite::Model* model =
+      builder.BuildModel({input}, {pooled, depth_mean, column_mean});
+
+  tflite::MicroMutableOpResolver resolver;
+  resolver.AddBuiltin(tflite::BuiltinOperator_MEAN,
+                      tflite::ops::micro::Register_MEAN(), 1, 2);
+  constexpr size_t kArenaSize = 8192;
+  alignas(16) uint8_t arena[kArenaSize];
+  tflite::MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                                       micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+
+  int8_t* input_data = interpreter.input(0)->data.int8;
+  for (int h = 0; h < kHeight; ++h) {
+    for (int w = 0; w < kWidth; ++w) {
+      for (int c = 0; c < kDepth; ++c) {
+        *input_data++ = tflite::testing::kChannelBase[c] +
+                        tflite::testing::SpatialPattern(h, w) + kZeroPoint;
+      }
+    }
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+
+  for (int c = 0; c < kDepth; ++c) {
+    TF_LITE_MICRO_EXPECT_EQ(tflite::testing::kChannelBase[c] + kZeroPoint,
+                            interpreter.output(0)->data.int8[c]);
+  }
+  for (int h = 0; h < kHeight; ++h) {
+    for (int w = 0; w < kWidth; ++w) {
+      TF_LITE_MICRO_EXPECT_EQ(
+          tflite::testing::SpatialPattern(h, w) + kZeroPoint,
+          interpreter.output(1)->data.int8[h * kWidth + w]);
+    }
+  }
+  for (int w = 0; w < kWidth; ++w) {
+    TF_LITE_MICRO_EXPECT_EQ(kZeroPoint, interpreter.output(2)->data.int8[w]);
+  }
+}
+
+TF_LITE_MICRO_TESTS_END
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/lite/kernels/internal/reference/softmax.h"
 
+#include <cmath>
+
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
@@ -37,6 +39,21 @@ struct OpData {
   int diff_min = 0;
 };
 
+// For int16 input, OpData is followed by the exp() and 1 / (1 + x) tables,
+// kInt16SoftmaxLUTSize entries each. They are found from OpData rather than
+// kept as pointers, so that they move with it when a snapshot is restored.
+int16_t* ExpLut(const OpData* data) {
+  return reinterpret_cast<int16_t*>(const_cast<OpData*>(data) + 1);
+}
+
+int16_t* OneOverOnePlusXLut(const OpData* data) {
+  return ExpLut(data) + reference_ops::kInt16SoftmaxLUTSize;
+}
+
+double Exp(double x) { return std::exp(x); }
+
+double OneOverOnePlusX(double x) { return 1.0 / (1.0 + x); }
+
 TfLiteStatus CalculateSoftmaxOpData(TfLiteContext* context,
                                     const TfLiteTensor* input,
                                     TfLiteTensor* output,
@@ -64,6 +81,25 @@ TfLiteStatus CalculateSoftmaxOpData(TfLiteContext* context,
         &data->input_multiplier, &data->input_left_shift);
     data->diff_min = -1.0 * tflite::CalculateInputRadius(
                                 kScaledDiffIntegerBits, data->input_left_shift);
+  } else if (input->type == kTfLiteInt16) {
+    TF_LITE_ENSURE_TYPES_EQ(context, output->type, kTfLiteInt16);
+    TF_LITE_ENSURE_EQ(context, input->params.zero_point, 0);
+    TF_LITE_ENSURE_EQ(context, output->params.zero_point, 0);
+    TF_LITE_ENSURE(context, std::abs(output->params.scale - 1.f / 32768) <
+                                0.001f / 32768);
+
+    // exp() is only looked up for differences to the row maximum. Below
+    // exp(-10) they do not add to the sum in 16 bits.
+    reference_ops::gen_lut(Exp, -10.0, 0.0, ExpLut(data),
+                           reference_ops::kInt16SoftmaxLUTSize);
+    reference_ops::gen_lut(OneOverOnePlusX, 0.0, 1.0, OneOverOnePlusXLut(data),
+                           reference_ops::kInt16SoftmaxLUTSize);
+
+    // Scales the differences such that [-65535, 0] covers [-10.0, 0.0].
+    QuantizeMultiplier(static_cast<double>(input->params.scale) *
+                           static_cast<double>(params->beta) /
+                           (10.0 / 65535.0),
+                       &data->input_multiplier, &data->input_left_shift);
   }
   return kTfLiteOk;
 }
@@ -77,6 +113,23 @@ void* Init(TfLiteContext* context, const char* buffer, size_t length) {
 void Free(TfLiteContext* context, void* buffer) {}
 
 TfLiteStatus SoftmaxPrepare(TfLiteContext* context, TfLiteNode* node) {
+  auto* params = static_cast<TfLiteSoftmaxParams*>(node->builtin_data);
+
+  const TfLiteTensor* input = GetInput(context, node, 0);
+  TfLiteTensor* output = GetOutput(context, node, 0);
+
+  const size_t lut_bytes =
+      input->type == kTfLiteInt16
+          ? 2 * reference_ops::kInt16SoftmaxLUTSize * sizeof(int16_t)
+          : 0;
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(context->AllocatePersistentBuffer(
+      context, sizeof(OpData) + lut_bytes, &raw));
+  OpData* data = static_cast<OpData*>(raw);
+  *data = OpData();
+  TF_LITE_ENSURE_STATUS(
+      CalculateSoftmaxOpData(context, input, output, params, data));
+  node->user_data = data;
   return kTfLiteOk;
 }
 
@@ -191,16 +244,26 @@ void Softmax4DQuantized(const TfLiteTensor* input, TfLiteTensor* output,
   }
 }
 
+// Performs softmax along the last dimension of an int16 tensor of any rank.
+void SoftmaxInt16(const TfLiteTensor* input, TfLiteTensor* output,
+                  const OpData* data) {
+  SoftmaxParams op_params;
+  op_params.input_multiplier = data->input_multiplier;
+  op_params.input_left_shift = data->input_left_shift;
+  op_params.exp_lut = ExpLut(data);
+  op_params.one_over_one_plus_x_lut = OneOverOnePlusXLut(data);
+  tflite::reference_ops::SoftmaxInt16(
+      op_params, GetTensorShape(input), GetTensorData<int16_t>(input),
+      GetTensorShape(output), GetTensorData<int16_t>(output));
+}
+
 TfLiteStatus SoftmaxEval(TfLiteContext* context, TfLiteNode* node) {
   auto* params = reinterpret_cast<TfLiteSoftmaxParams*>(node->builtin_data);
 
   const TfLiteTensor* input = GetInput(context, node, 0);
   TfLiteTensor* output = GetOutput(context, node, 0);
 
-  OpData local_data_object;
-  OpData* data = &local_data_object;
-  TF_LITE_ENSURE_STATUS(
-      CalculateSoftmaxOpData(context, input, output, params, data));
+  OpData* data = static_cast<OpData*>(node->user_data);
 
   // TODO(ahentz): consider an implementation that works for many (all?)
   // dimensions.
@@ -242,10 +305,15 @@ TfLiteStatus SoftmaxEval(TfLiteContext* context, TfLiteNode* node) {
                          NumDimensions(input));
       return kTfLiteError;
     }
+    case kTfLiteInt16: {
+      SoftmaxInt16(input, output, data);
+      return kTfLiteOk;
+    }
     default:
       TF_LITE_KERNEL_LOG(
           context,
-          "Only float32, uint8_t and int8_t supported currently, got %d.",
+          "Only float32, uint8_t, int8_t and int16_t supported currently, "
+          "got %d.",
           input->type);
       return kTfLiteError;
   }
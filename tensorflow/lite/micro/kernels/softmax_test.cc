@@ -0,0 +1,103 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_model_builder.h"
+
+namespace tflite {
+namespace testing {
+namespace {
+
+constexpr int kBatches = 3;
+constexpr int kDepth = 10;
+constexpr float kOutputScale = 1.0f / 32768;
+
+// Runs an int16 SOFTMAX over [kBatches, kDepth] and compares it with a float
+// softmax of the dequantized input.
+void TestSoftmaxInt16(float input_scale, float beta, float tolerance) {
+  TestModelBuilder builder;
+  const int softmax = builder.AddOperatorCode(BuiltinOperator_SOFTMAX, 3);
+  const int input = builder.AddQuantizedTensor(
+      TensorType_INT16, {kBatches, kDepth}, input_scale, 0);
+  const int output = builder.AddQuantizedTensor(
+      TensorType_INT16, {kBatches, kDepth}, kOutputScale, 0);
+  builder.AddOperator(
+      softmax, {input}, {output}, BuiltinOptions_SoftmaxOptions,
+      CreateSoftmaxOptions(*builder.builder(), beta).Union());
+  const Model* model = builder.BuildModel({input}, {output});
+
+  MicroMutableOpResolver resolver;
+  resolver.AddBuiltin(BuiltinOperator_SOFTMAX, ops::micro::Register_SOFTMAX(),
+                      1, 3);
+  constexpr size_t kArenaSize = 8192;
+  alignas(16) uint8_t arena[kArenaSize];
+  MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                               micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+
+  // Rows with small and large spreads, including saturated inputs.
+  int16_t* input_data = interpreter.input(0)->data.i16;
+  for (int b = 0; b < kBatches; ++b) {
+    for (int i = 0; i < kDepth; ++i) {
+      const int value = (i * 7919 + b * 104729) % 65536 - 32768;
+      input_data[b * kDepth + i] = static_cast<int16_t>(value >> (4 * b));
+    }
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+
+  const int16_t* output_data = interpreter.output(0)->data.i16;
+  for (int b = 0; b < kBatches; ++b) {
+    const int16_t* row = input_data + b * kDepth;
+    float max = row[0];
+    for (int i = 1; i < kDepth; ++i) {
+      max = std::fmax(max, row[i]);
+    }
+    float sum = 0.f;
+    for (int i = 0; i < kDepth; ++i) {
+      sum += std::exp((row[i] - max) * input_scale * beta);
+    }
+    for (int i = 0; i < kDepth; ++i) {
+      const float expected =
+          std::exp((row[i] - max) * input_scale * beta) / sum;
+      TF_LITE_MICRO_EXPECT_NEAR(expected,
+                                output_data[b * kDepth + i] * kOutputScale,
+                                tolerance);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace testing
+}  // namespace tflite
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(SoftmaxInt16) {
+  tflite::testing::TestSoftmaxInt16(/*input_scale=*/0.0005f, /*beta=*/1.0f,
+                                    /*tolerance=*/0.0005f);
+}
+
+TF_LITE_MICRO_TEST(SoftmaxInt16WithBeta) {
+  tflite::testing::TestSoftmaxInt16(/*input_scale=*/0.0001f, /*beta=*/3.0f,
+                                    /*tolerance=*/0.0005f);
+}
+
+TF_LITE_MICRO_TESTS_END
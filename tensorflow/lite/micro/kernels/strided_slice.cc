@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/reference/strided_slice.h"
 
 #include <cmath>
+#include <cstring>
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
@@ -27,11 +28,6 @@ namespace ops {
 namespace micro {
 namespace strided_slice {
 
-enum KernelType {
-  kReference,
-  // TODO(soroosh): add kGenericOptimized
-};
-
 constexpr int kInputTensor = 0;
 constexpr int kBeginTensor = 1;
 constexpr int kEndTensor = 2;
@@ -57,8 +53,7 @@ struct StridedSliceContext {
   int dims;
 };
 
-// This Op only supports 1-4D cases and since we use the reference 4D
-// implementation, the 1-3D tensors are mapped to 4D.
+// This Op only supports 1-4D cases, the 1-3D tensors are mapped to 4D.
 const int kMaxDim = 4;
 
 tflite::StridedSliceParams BuildStridedSliceParams(
@@ -120,50 +115,165 @@ TfLiteStatus CheckOutputSize(TfLiteContext* context,
   return kTfLiteOk;
 }
 
+// The slice as a sequence of rows, computed in Prepare. Trailing axes that
+// are taken completely are merged into the row, so a row is usually one
+// contiguous block of the input.
+struct OpData {
+  // Number of axes iterated outside of the row, at most kMaxDim.
+  int outer_dims;
+  // Output size along each outer axis, and the input offset of one step.
+  int outer_sizes[kMaxDim];
+  int outer_steps[kMaxDim];
+  // Input offset of the first element.
+  int start_offset;
+  // Elements per row, and the input offset between them (1 if contiguous).
+  int row_size;
+  int row_step;
+};
+
+// Number of iterations of the reference loop from start to stop.
+int AxisSize(int start, int stop, int stride) {
+  if (stride > 0) {
+    return stop > start ? (stop - start + stride - 1) / stride : 0;
+  }
+  return start > stop ? (start - stop - stride - 1) / -stride : 0;
+}
+
+void CalculateOpData(StridedSliceContext* op_context, OpData* data) {
+  using ::tflite::strided_slice::StartForAxis;
+  using ::tflite::strided_slice::StopForAxis;
+  auto op_params = BuildStridedSliceParams(op_context);
+  ::tflite::strided_slice::StridedSlicePadIndices(&op_params, kMaxDim);
+  const RuntimeShape input_shape =
+      RuntimeShape::ExtendedShape(kMaxDim, GetTensorShape(op_context->input));
+
+  int starts[kMaxDim];
+  int sizes[kMaxDim];
+  int input_strides[kMaxDim];
+  int input_stride = 1;
+  data->start_offset = 0;
+  for (int axis = kMaxDim - 1; axis >= 0; --axis) {
+    starts[axis] = StartForAxis(op_params, input_shape, axis);
+    const int stop = StopForAxis(op_params, input_shape, axis, starts[axis]);
+    // Like CheckOutputSize, a shrunk axis always has one element, even if
+    // end_mask is set for it.
+    sizes[axis] = (op_params.shrink_axis_mask & (1 << axis))
+                      ? 1
+                      : AxisSize(starts[axis], stop, op_params.strides[axis]);
+    input_strides[axis] = input_stride;
+    data->start_offset += starts[axis] * input_stride;
+    input_stride *= input_shape.Dims(axis);
+  }
+
+  // Merge trailing axes that are taken completely and in order.
+  int row_axis = kMaxDim - 1;
+  int merged_size = 1;
+  while (row_axis > 0 && starts[row_axis] == 0 &&
+         sizes[row_axis] == input_shape.Dims(row_axis) &&
+         op_params.strides[row_axis] == 1) {
+    merged_size *= sizes[row_axis];
+    --row_axis;
+  }
+  if (merged_size == 1) {
+    // Only the last axis, possibly strided.
+    data->row_size = sizes[row_axis];
+    data->row_step = op_params.strides[row_axis];
+  } else if (op_params.strides[row_axis] == 1) {
+    data->row_size = sizes[row_axis] * merged_size;
+    data->row_step = 1;
+  } else {
+    // The row axis is strided, so only the merged axes are contiguous.
+    data->row_size = merged_size;
+    data->row_step = 1;
+    ++row_axis;
+  }
+  data->outer_dims = row_axis;
+  for (int axis = 0; axis < row_axis; ++axis) {
+    data->outer_sizes[axis] = sizes[axis];
+    data->outer_steps[axis] = op_params.strides[axis] * input_strides[axis];
+  }
+}
+
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_EQ(context, NumInputs(node), 4);
   TF_LITE_ENSURE_EQ(context, NumOutputs(node), 1);
   StridedSliceContext op_context(context, node);
   TF_LITE_ENSURE_MSG(context, op_context.dims <= kMaxDim,
                      "input dim should not exceed 4");
-  return CheckOutputSize(context, &op_context);
+  TF_LITE_ENSURE_STATUS(CheckOutputSize(context, &op_context));
+
+  void* data = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(OpData), &data));
+  CalculateOpData(&op_context, static_cast<OpData*>(data));
+  node->user_data = data;
+  return kTfLiteOk;
 }
 
-template <KernelType kernel_type>
-TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
-  StridedSliceContext op_context(context, node);
-  auto op_params = BuildStridedSliceParams(&op_context);
+// Copies the slice row by row, with the outer axes counted like an odometer.
+template <typename T>
+void StridedSlice(const OpData& data, const T* input_data, T* output_data) {
+  if (data.row_size == 0) {
+    return;
+  }
+  for (int axis = 0; axis < data.outer_dims; ++axis) {
+    if (data.outer_sizes[axis] == 0) {
+      return;
+    }
+  }
+  int index[kMaxDim] = {0};
+  int offset = data.start_offset;
+  while (true) {
+    if (data.row_step == 1) {
+      memcpy(output_data, input_data + offset, data.row_size * sizeof(T));
+    } else {
+      const T* row = input_data + offset;
+      for (int i = 0; i < data.row_size; ++i) {
+        output_data[i] = row[i * data.row_step];
+      }
+    }
+    output_data += data.row_size;
+
+    int axis = data.outer_dims - 1;
+    for (; axis >= 0; --axis) {
+      offset += data.outer_steps[axis];
+      if (++index[axis] < data.outer_sizes[axis]) {
+        break;
+      }
+      offset -= data.outer_steps[axis] * data.outer_sizes[axis];
+      index[axis] = 0;
+    }
+    if (axis < 0) {
+      return;
+    }
+  }
+}
 
-#define TF_LITE_STRIDED_SLICE(kernel_type, data_type)                    \
-  kernel_type::StridedSlice(op_params, GetTensorShape(op_context.input), \
-                            GetTensorData<data_type>(op_context.input),  \
-                            GetTensorShape(op_context.output),           \
-                            GetTensorData<data_type>(op_context.output))
+TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+  const OpData& data = *static_cast<const OpData*>(node->user_data);
 
-  switch (op_context.input->type) {
+  switch (input->type) {
     case kTfLiteFloat32:
-      if (kernel_type == kReference) {
-        TF_LITE_STRIDED_SLICE(reference_ops, float);
-      }
+      StridedSlice(data, GetTensorData<float>(input),
+                   GetTensorData<float>(output));
       break;
     case kTfLiteUInt8:
-      if (kernel_type == kReference) {
-        TF_LITE_STRIDED_SLICE(reference_ops, uint8_t);
-      }
+      StridedSlice(data, GetTensorData<uint8_t>(input),
+                   GetTensorData<uint8_t>(output));
       break;
     case kTfLiteInt8:
-      if (kernel_type == kReference) {
-        TF_LITE_STRIDED_SLICE(reference_ops, int8_t);
-      }
+      StridedSlice(data, GetTensorData<int8_t>(input),
+                   GetTensorData<int8_t>(output));
       break;
     default:
       TF_LITE_KERNEL_LOG(context,
                          "Type %d is currently not supported "
                          "by StridedSlice.",
-                         op_context.input->type);
+                         input->type);
       return kTfLiteError;
   }
-#undef TF_LITE_STRIDED_SLICE
   return kTfLiteOk;
 }
 }  // namespace strided_slice
@@ -171,7 +281,7 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
 TfLiteRegistration* Register_STRIDED_SLICE() {
   static TfLiteRegistration r = {};
   r.prepare = strided_slice::Prepare;
-  r.invoke = strided_slice::Eval<strided_slice::kReference>;
+  r.invoke = strided_slice::Eval;
   return &r;
 }
 
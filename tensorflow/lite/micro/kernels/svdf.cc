@@ -420,6 +420,23 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
 
     // Validate output tensor:
     TF_LITE_ENSURE_EQ(context, output->type, kTfLiteInt8);
+
+    // Calculate effective scales.
+    const double effective_scale_1 = static_cast<double>(
+        input->params.scale * weights_feature->params.scale /
+        activation_state->params.scale);
+    const double effective_scale_2 = static_cast<double>(
+        activation_state->params.scale * weights_time->params.scale /
+        output->params.scale);
+    void* raw = nullptr;
+    TF_LITE_ENSURE_STATUS(
+        context->AllocatePersistentBuffer(context, sizeof(OpData), &raw));
+    OpData* op_data = static_cast<OpData*>(raw);
+    QuantizeMultiplier(effective_scale_1, &op_data->effective_scale_1_a,
+                       &op_data->effective_scale_1_b);
+    QuantizeMultiplier(effective_scale_2, &op_data->effective_scale_2_a,
+                       &op_data->effective_scale_2_b);
+    node->user_data = op_data;
   } else {
     TF_LITE_ENSURE_EQ(context, node->inputs->size, 6);
 
@@ -486,39 +503,13 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
 
     case kTfLiteInt8: {
       if (is_full_integer) {
-        // TODO(b/132070898): Store these values in ::Prepare() instead of
-        // ::Eval():
-        // Calculate effective scales.
-        OpData op_data;
-        auto* input_params = reinterpret_cast<TfLiteAffineQuantization*>(
-            input->quantization.params);
-        auto* weights_feature_params =
-            reinterpret_cast<TfLiteAffineQuantization*>(
-                weights_feature->quantization.params);
-        auto* state_params = reinterpret_cast<TfLiteAffineQuantization*>(
-            activation_state->quantization.params);
-        auto* weight_time_params = reinterpret_cast<TfLiteAffineQuantization*>(
-            weights_time->quantization.params);
-        auto* output_params = reinterpret_cast<TfLiteAffineQuantization*>(
-            output->quantization.params);
-        const double effective_scale_1 =
-            static_cast<double>(input_params->scale->data[0] *
-                                weights_feature_params->scale->data[0] /
-                                state_params->scale->data[0]);
-        const double effective_scale_2 = static_cast<double>(
-            state_params->scale->data[0] * weight_time_params->scale->data[0] /
-            output_params->scale->data[0]);
-        QuantizeMultiplier(effective_scale_1, &op_data.effective_scale_1_a,
-                           &op_data.effective_scale_1_b);
-        QuantizeMultiplier(effective_scale_2, &op_data.effective_scale_2_a,
-                           &op_data.effective_scale_2_b);
-
+        const OpData* op_data = static_cast<const OpData*>(node->user_data);
         TF_LITE_ENSURE_EQ(context, params->activation, kTfLiteActRelu);
         EvalIntegerSVDF(
             context, node, input, weights_feature, weights_time, bias, params,
-            activation_state, output, op_data.effective_scale_1_a,
-            op_data.effective_scale_1_b, op_data.effective_scale_2_a,
-            op_data.effective_scale_2_b, input->params.zero_point,
+            activation_state, output, op_data->effective_scale_1_a,
+            op_data->effective_scale_1_b, op_data->effective_scale_2_a,
+            op_data->effective_scale_2_b, input->params.zero_point,
             output->params.zero_point);
         return kTfLiteOk;
       }
@@ -0,0 +1,83 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/kernels/lookup_table.h"
+
+namespace tflite {
+namespace ops {
+namespace micro {
+namespace activations {
+namespace {
+
+constexpr int kInputTensor = 0;
+constexpr int kOutputTensor = 0;
+
+float TanhFloat(float value) { return std::tanh(value); }
+
+}  // namespace
+
+// Int8 and uint8 use the lookup table, so TANH in quantized LSTMs needs no
+// float math at runtime.
+TfLiteStatus TanhPrepare(TfLiteContext* context, TfLiteNode* node) {
+  return LookupTablePrepare(context, node, TanhFloat);
+}
+
+TfLiteStatus TanhEval(TfLiteContext* context, TfLiteNode* node) {
+  const TfLiteTensor* input = GetInput(context, node, kInputTensor);
+  TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
+
+  switch (input->type) {
+    case kTfLiteFloat32: {
+      const int flat_size =
+          MatchingFlatSize(GetTensorShape(input), GetTensorShape(output));
+      const float* input_data = GetTensorData<float>(input);
+      float* output_data = GetTensorData<float>(output);
+      for (int i = 0; i < flat_size; ++i) {
+        output_data[i] = TanhFloat(input_data[i]);
+      }
+      return kTfLiteOk;
+    }
+    case kTfLiteInt8:
+    case kTfLiteUInt8: {
+      LookupTableEval(input,
+                      static_cast<const LookupTableOpData*>(node->user_data),
+                      output);
+      return kTfLiteOk;
+    }
+    default: {
+      TF_LITE_KERNEL_LOG(context, "Type %s not supported.",
+                         TfLiteTypeGetName(input->type));
+      return kTfLiteError;
+    }
+  }
+}
+
+}  // namespace activations
+
+TfLiteRegistration* Register_TANH() {
+  static TfLiteRegistration r = {};
+  r.prepare = activations::TanhPrepare;
+  r.invoke = activations::TanhEval;
+  return &r;
+}
+
+}  // namespace micro
+}  // namespace ops
+}  // namespace tflite
@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/lite/micro/micro_allocator.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstring>
 
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/core/api/error_reporter.h"
@@ -23,8 +25,11 @@ limitations under the License.
 #include "tensorflow/lite/core/api/op_resolver.h"
 #include "tensorflow/lite/core/api/tensor_utils.h"
 #include "tensorflow/lite/micro/compatibility.h"
+#include "tensorflow/lite/micro/compressed_weights.h"
 #include "tensorflow/lite/micro/memory_helpers.h"
 #include "tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
+#include "tensorflow/lite/micro/operator_scheduler.h"
+#include "tensorflow/lite/micro/patch_execution.h"
 #include "tensorflow/lite/micro/simple_memory_allocator.h"
 
 namespace tflite {
@@ -37,12 +42,25 @@ struct AllocationInfo {
   int last_used;
   bool needs_allocating;
   void** output_ptr;
+  // Set for outputs that are computed in place, in the buffer of this tensor.
+  AllocationInfo* shared_buffer;
 };
 
 // We align tensor buffers to 16-byte boundaries, since this is a common
 // requirement for SIMD extensions.
 constexpr int kBufferAlignment = 16;
 
+#if defined(TF_LITE_SCHEDULE_OPERATORS)
+// Search steps per subgraph if TF_LITE_SCHEDULE_OPERATORS has no value, in
+// which case the compiler defines it as 1.
+constexpr int kDefaultScheduleSteps = 10000;
+#endif
+
+#if defined(TF_LITE_PATCH_EXECUTION)
+// Most strips per patched prefix if TF_LITE_PATCH_EXECUTION has no value.
+constexpr int kDefaultMaxPatches = 8;
+#endif
+
 // If building with GNU clib from GCC 4.8.x or lower, `max_align_t` is not a
 // member of `std`. If using a newer version of clib, we import `max_align_t`
 // into the local anonymous namespace to be able to use it like the global
@@ -62,18 +80,27 @@ class MicroBuiltinDataAllocator : public BuiltinDataAllocator {
       : memory_allocator_(memory_allocator) {}
 
   void* Allocate(size_t size) override {
+    last_mark_ = memory_allocator_->GetTailMark();
     // Align to an address that is proper for all primitive types, but no more
     // than the size.
-    return memory_allocator_->AllocateFromTail(
+    last_allocation_ = memory_allocator_->AllocateFromTail(
         size, std::min(size, alignof(max_align_t)));
+    return last_allocation_;
   }
   void Deallocate(void* data) override {
-    // Do not deallocate, builtin data needs to be available for the life time
-    // of the model.
+    // Builtin data needs to be available for the life time of the model, so
+    // this only happens when parsing failed. The tail is a stack, only the
+    // most recent allocation can be given back.
+    if (data != nullptr && data == last_allocation_) {
+      memory_allocator_->ResetTailToMark(last_mark_);
+      last_allocation_ = nullptr;
+    }
   }
 
  private:
   SimpleMemoryAllocator* memory_allocator_;
+  size_t last_mark_ = 0;
+  void* last_allocation_ = nullptr;
 
   TF_LITE_REMOVE_VIRTUAL_DELETE
 };
@@ -112,14 +139,26 @@ class AllocationInfoBuilder {
     return Allocate();
   }
 
-  // Add allocaiton information for the tensors.
-  TfLiteStatus AddTensors(const SubGraph* subgraph,
+  // Add allocaiton information for the tensors of one subgraph. Its operators
+  // are placed on the timeline starting at `operator_offset`, in the order of
+  // `operator_order` or of the model if that is null. Subgraphs have to be
+  // added in order.
+  TfLiteStatus AddTensors(const SubGraph* subgraph, int operator_offset,
+                          const int* operator_order,
                           TfLiteTensor* runtime_tensors);
-  // Add allocation information for the scratch buffers.
-  TfLiteStatus AddScratchBuffers(internal::ScratchBufferHandle* buffer_handles);
+  // Compressed constant tensors that are not claimed by a kernel get an arena
+  // buffer from the first to the last operator reading them. Has to be called
+  // after AddTensors.
+  TfLiteStatus AddCompressedTensors(const internal::CompressedTensorUse* uses,
+                                    size_t use_count,
+                                    const TfLiteTensor* runtime_tensors);
+  // Add allocation information for the scratch buffers. The planned addresses
+  // are written to `buffers`, which has one entry per handle.
+  TfLiteStatus AddScratchBuffers(internal::ScratchBufferHandle* buffer_handles,
+                                 uint8_t** buffers);
 
   // Returns a pointer to the built AllocationInfo array.
-  const AllocationInfo* Finish() const { return info_; }
+  AllocationInfo* Finish() const { return info_; }
   size_t Size() const { return tensor_count_ + buffer_count_; }
 
  private:
@@ -130,6 +169,8 @@ class AllocationInfoBuilder {
   SimpleMemoryAllocator* allocator_ = nullptr;
   size_t tensor_count_ = 0;
   size_t buffer_count_ = 0;
+  // Number of tensors added so far by AddTensors.
+  size_t tensors_added_ = 0;
   AllocationInfo* info_ = nullptr;
 };
 
@@ -148,10 +189,23 @@ TfLiteStatus AllocationInfoBuilder::Allocate() {
 }
 
 TfLiteStatus AllocationInfoBuilder::AddTensors(const SubGraph* subgraph,
+                                               int operator_offset,
+                                               const int* operator_order,
                                                TfLiteTensor* runtime_tensors) {
+  const size_t subgraph_tensor_count = subgraph->tensors()->size();
+  if (tensors_added_ + subgraph_tensor_count > tensor_count_) {
+    TF_LITE_REPORT_ERROR(reporter_,
+                         "More tensors added than allocation info reserved");
+    return kTfLiteError;
+  }
+  AllocationInfo* info = &info_[tensors_added_];
+  tensors_added_ += subgraph_tensor_count;
+  const int first_operator = operator_offset;
+  const int last_operator = operator_offset + subgraph->operators()->size() - 1;
+
   // Set up allocation info for all tensors.
-  for (size_t i = 0; i < tensor_count_; ++i) {
-    AllocationInfo* current = &info_[i];
+  for (size_t i = 0; i < subgraph_tensor_count; ++i) {
+    AllocationInfo* current = &info[i];
     // TfLiteTensor.uint8 field is deprecated so use .data field instead.
     current->output_ptr = &(runtime_tensors[i].data.data);
     current->bytes = runtime_tensors[i].bytes;
@@ -159,34 +213,41 @@ TfLiteStatus AllocationInfoBuilder::AddTensors(const SubGraph* subgraph,
     current->last_used = -1;
     current->needs_allocating = (runtime_tensors[i].data.raw == nullptr) &&
                                 (!subgraph->tensors()->Get(i)->is_variable());
+    current->shared_buffer = nullptr;
   }
 
+  // The inputs of a subgraph are written while the outputs of the previous
+  // one may still be read, e.g. when chaining heads, so they are created at
+  // the last operator of the previous subgraph.
+  const int inputs_created = first_operator > 0 ? first_operator - 1 : 0;
   for (size_t i = 0; i < subgraph->inputs()->size(); ++i) {
     const int tensor_index = subgraph->inputs()->Get(i);
-    AllocationInfo* current = &info_[tensor_index];
-    current->first_created = 0;
+    AllocationInfo* current = &info[tensor_index];
+    current->first_created = inputs_created;
   }
 
   // Mark all outputs as persistent to the end of the invocation.
   for (size_t i = 0; i < subgraph->outputs()->size(); ++i) {
     const int tensor_index = subgraph->outputs()->Get(i);
-    AllocationInfo* current = &info_[tensor_index];
-    current->last_used = subgraph->operators()->size() - 1;
+    AllocationInfo* current = &info[tensor_index];
+    current->last_used = last_operator;
   }
 
   // Figure out when the first and last use of each tensor is.
-  for (int i = (subgraph->operators()->size() - 1); i >= 0; --i) {
-    const auto* op = subgraph->operators()->Get(i);
+  for (int i = last_operator; i >= first_operator; --i) {
+    const int position = i - operator_offset;
+    const auto* op = subgraph->operators()->Get(
+        operator_order == nullptr ? position : operator_order[position]);
     for (size_t n = 0; n < op->inputs()->size(); ++n) {
       const int tensor_index = op->inputs()->Get(n);
-      AllocationInfo* current = &info_[tensor_index];
+      AllocationInfo* current = &info[tensor_index];
       if (((current->last_used == -1) || (current->last_used < i))) {
         current->last_used = i;
       }
     }
     for (size_t n = 0; n < op->outputs()->size(); ++n) {
       const int tensor_index = op->outputs()->Get(n);
-      AllocationInfo* current = &info_[tensor_index];
+      AllocationInfo* current = &info[tensor_index];
       if ((current->first_created == -1) || (current->first_created > i)) {
         current->first_created = i;
       }
@@ -194,8 +255,8 @@ TfLiteStatus AllocationInfoBuilder::AddTensors(const SubGraph* subgraph,
   }
 
   // Work out which tensors need to be allocated.
-  for (size_t i = 0; i < tensor_count_; ++i) {
-    AllocationInfo* current = &info_[i];
+  for (size_t i = 0; i < subgraph_tensor_count; ++i) {
+    AllocationInfo* current = &info[i];
     const bool is_read_only =
         (current->first_created == -1) && (current->last_used != -1);
     if (is_read_only) {
@@ -216,18 +277,37 @@ TfLiteStatus AllocationInfoBuilder::AddTensors(const SubGraph* subgraph,
   return kTfLiteOk;
 }
 
+TfLiteStatus AllocationInfoBuilder::AddCompressedTensors(
+    const internal::CompressedTensorUse* uses, size_t use_count,
+    const TfLiteTensor* runtime_tensors) {
+  // AddTensors already set last_used from the operator inputs. The uses are
+  // sorted, so the first one is the earliest reader.
+  for (size_t i = 0; i < use_count; ++i) {
+    if (uses[i].claimed) {
+      continue;
+    }
+    AllocationInfo* current = &info_[uses[i].tensor - runtime_tensors];
+    if (current->first_created == -1) {
+      current->first_created = uses[i].node_idx;
+    }
+    current->needs_allocating = true;
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus AllocationInfoBuilder::AddScratchBuffers(
-    internal::ScratchBufferHandle* buffer_handles) {
+    internal::ScratchBufferHandle* buffer_handles, uint8_t** buffers) {
   // Set up allocation info for buffers.
   for (size_t i = tensor_count_; i < tensor_count_ + buffer_count_; ++i) {
     AllocationInfo* current = &info_[i];
     internal::ScratchBufferHandle* handle =
         &(buffer_handles[i - tensor_count_]);
-    current->output_ptr = reinterpret_cast<void**>(&handle->data);
+    current->output_ptr = reinterpret_cast<void**>(&buffers[i - tensor_count_]);
     current->bytes = handle->bytes;
     current->first_created = handle->node_idx;
     current->last_used = handle->node_idx;
     current->needs_allocating = true;
+    current->shared_buffer = nullptr;
   }
   return kTfLiteOk;
 }
@@ -265,8 +345,635 @@ TfLiteStatus CommitPlan(ErrorReporter* error_reporter, MemoryPlanner* planner,
       ++planner_index;
     }
   }
+  for (size_t i = 0; i < allocation_info_size; ++i) {
+    const AllocationInfo* current = &allocation_info[i];
+    if (current->shared_buffer != nullptr) {
+      *current->output_ptr = *current->shared_buffer->output_ptr;
+    }
+  }
+  return kTfLiteOk;
+}
+
+bool IsSubgraphInputOrOutput(const SubGraph* subgraph, int tensor) {
+  for (const int32_t input : *subgraph->inputs()) {
+    if (input == tensor) {
+      return true;
+    }
+  }
+  for (const int32_t output : *subgraph->outputs()) {
+    if (output == tensor) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// RELU and RELU6 clamp element by element, so their output can be written
+// over their input if no other operator reads it. The input then lives until
+// the output is last used. Inputs and outputs of the subgraph are not written
+// over, since the caller writes or reads them around Invoke().
+void ShareInPlaceBuffers(const NodeAndRegistration* nodes, int nodes_size,
+                         const SubGraph* subgraph, AllocationInfo* info) {
+  for (int position = 0; position < nodes_size; ++position) {
+    const TfLiteNode& node = nodes[position].node;
+    const int32_t code = nodes[position].registration->builtin_code;
+    if ((code != BuiltinOperator_RELU && code != BuiltinOperator_RELU6) ||
+        node.inputs->size != 1 || node.outputs->size != 1) {
+      continue;
+    }
+    const int input = node.inputs->data[0];
+    const int output = node.outputs->data[0];
+    // The input may itself be the output of an in-place RELU.
+    AllocationInfo* buffer = info[input].shared_buffer != nullptr
+                                 ? info[input].shared_buffer
+                                 : &info[input];
+    if (!buffer->needs_allocating || !info[output].needs_allocating ||
+        info[input].bytes != info[output].bytes ||
+        IsSubgraphInputOrOutput(subgraph, input)) {
+      continue;
+    }
+    int reads = 0;
+    for (int i = 0; i < nodes_size; ++i) {
+      const TfLiteIntArray* inputs = nodes[i].node.inputs;
+      for (int j = 0; j < inputs->size; ++j) {
+        reads += inputs->data[j] == input ? 1 : 0;
+      }
+    }
+    if (reads != 1) {
+      continue;
+    }
+    buffer->last_used = std::max(buffer->last_used, info[output].last_used);
+    info[output].needs_allocating = false;
+    info[output].shared_buffer = buffer;
+  }
+}
+
+#if defined(TF_LITE_PATCH_EXECUTION) || defined(TF_LITE_FUSE_OPERATORS)
+// Every strip reads the input of the chain and writes its output, so both
+// are alive while any of its operators runs. The tensors in between only hold
+// the rows of one strip.
+void ApplyPatchPlan(const PatchPlan& plan, const TfLiteTensor* tensors,
+                    AllocationInfo* info) {
+  const int last_node = plan.first_node + plan.operators - 1;
+  AllocationInfo* input = &info[plan.tensors[0]];
+  input->last_used = std::max(input->last_used, last_node);
+  info[plan.tensors[plan.operators]].first_created = plan.first_node;
+  for (int i = 1; i < plan.operators; ++i) {
+    const int tensor = plan.tensors[i];
+    info[tensor].bytes =
+        tensors[tensor].bytes / plan.heights[i] * plan.patch_heights[i];
+  }
+  for (int i = 0; i < plan.operators; ++i) {
+    const int tensor = plan.side_tensors[i];
+    if (tensor >= 0) {
+      info[tensor].first_created =
+          std::min(info[tensor].first_created, plan.first_node);
+    }
+  }
+}
+
+// Weights and biases stay where they are while operators run in strips.
+bool HasConstantInputs(const MicroAllocator& allocator, const TfLiteNode& node,
+                       const TfLiteTensor* tensors) {
+  for (int i = 1; i < node.inputs->size; ++i) {
+    const int tensor = node.inputs->data[i];
+    if (tensor >= 0 && tensors[tensor].allocation_type != kTfLiteMmapRo &&
+        allocator.GetCompressedTensor(&tensors[tensor]) == nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+#endif
+
+#if defined(TF_LITE_PATCH_EXECUTION)
+// Arena bytes the greedy memory planner needs for `allocation_info`.
+TfLiteStatus PlannedBytes(ErrorReporter* error_reporter, uint8_t* arena,
+                          size_t arena_size,
+                          const AllocationInfo* allocation_info,
+                          size_t allocation_info_size, size_t* bytes) {
+  GreedyMemoryPlanner planner(arena, arena_size);
+  TF_LITE_ENSURE_STATUS(CreatePlan(error_reporter, &planner, allocation_info,
+                                   allocation_info_size));
+  *bytes = planner.GetMaximumMemorySize();
+  return kTfLiteOk;
+}
+
+// Looks for the patched prefix of subgraph 0 that needs the least arena. The
+// longest chain of operators that can run in strips is found first, then
+// each of its prefixes is planned with 2 to `max_patches` strips. `info`
+// holds the lifetimes of the unpatched model and is changed to those of the
+// best plan, if one needs less arena than running unpatched. Otherwise
+// plan->operators is 0.
+TfLiteStatus ChoosePatchPlan(const MicroAllocator& allocator,
+                             ErrorReporter* error_reporter,
+                             const NodeAndRegistration* nodes,
+                             const SubGraph* subgraph, uint8_t* arena,
+                             size_t arena_size, int max_patches,
+                             AllocationInfo* info, size_t info_size,
+                             PatchPlan* plan) {
+  plan->operators = 0;
+  const TfLiteTensor* tensors = allocator.GetTensor(0, 0);
+  const int operators_size =
+      std::min<int>(subgraph->operators()->size(), kMaxPatchOperators);
+
+  // Inside the chain each operator reads only the output of the previous one,
+  // which nothing else reads.
+  PatchPlan chain = {};
+  std::fill(chain.side_tensors, chain.side_tensors + kMaxPatchOperators, -1);
+  int length = 0;
+  for (; length < operators_size; ++length) {
+    const TfLiteNode& node = nodes[length].node;
+    if (!GetPatchWindow(node, *nodes[length].registration, tensors,
+                        &chain.windows[length])) {
+      break;
+    }
+    const int input = node.inputs->data[0];
+    const int output = node.outputs->data[0];
+    if (!info[input].needs_allocating || !info[output].needs_allocating) {
+      break;
+    }
+    if (length > 0) {
+      bool is_subgraph_output = false;
+      for (const int32_t tensor : *subgraph->outputs()) {
+        is_subgraph_output |= tensor == input;
+      }
+      if (input != chain.tensors[length] || is_subgraph_output ||
+          info[input].last_used != length) {
+        break;
+      }
+    }
+    if (!HasConstantInputs(allocator, node, tensors)) {
+      break;
+    }
+    chain.tensors[length] = input;
+    chain.tensors[length + 1] = output;
+    chain.heights[length] = tensors[input].dims->data[1];
+    chain.heights[length + 1] = tensors[output].dims->data[1];
+  }
+  if (length < 2) {
+    return kTfLiteOk;
+  }
+
+  size_t best_bytes;
+  TF_LITE_ENSURE_STATUS(PlannedBytes(error_reporter, arena, arena_size, info,
+                                     info_size, &best_bytes));
+  AllocationInfo saved[kMaxPatchOperators + 1];
+  for (int operators = 2; operators <= length; ++operators) {
+    chain.operators = operators;
+    int previous_rows = 0;
+    for (int patches = 2; patches <= max_patches; ++patches) {
+      const int height = chain.heights[operators];
+      chain.output_rows = (height + patches - 1) / patches;
+      if (chain.output_rows == previous_rows) {
+        continue;
+      }
+      previous_rows = chain.output_rows;
+      SetPatchHeights(&chain);
+      for (int i = 0; i <= operators; ++i) {
+        saved[i] = info[chain.tensors[i]];
+      }
+      ApplyPatchPlan(chain, tensors, info);
+      size_t bytes;
+      TF_LITE_ENSURE_STATUS(PlannedBytes(error_reporter, arena, arena_size,
+                                         info, info_size, &bytes));
+      for (int i = 0; i <= operators; ++i) {
+        info[chain.tensors[i]] = saved[i];
+      }
+      if (bytes < best_bytes) {
+        best_bytes = bytes;
+        *plan = chain;
+      }
+    }
+  }
+  if (plan->operators > 0) {
+    ApplyPatchPlan(*plan, tensors, info);
+  }
   return kTfLiteOk;
 }
+#endif
+
+#if defined(TF_LITE_FUSE_OPERATORS)
+// Returns true and fills `plan` if node `position` of a subgraph is a
+// CONV_2D whose output is only read by the next node, which is either a
+// pooling operator with windows that do not overlap or an ADD of that output
+// and another tensor of its shape.
+bool GetFusedOperators(const MicroAllocator& allocator,
+                       const NodeAndRegistration* nodes, int nodes_size,
+                       int position, const SubGraph* subgraph,
+                       const TfLiteTensor* tensors, PatchPlan* plan) {
+  if (position + 1 >= nodes_size) {
+    return false;
+  }
+  const NodeAndRegistration& conv = nodes[position];
+  const NodeAndRegistration& next = nodes[position + 1];
+  PatchPlan pair = {};
+  if (conv.registration->builtin_code != BuiltinOperator_CONV_2D ||
+      !GetPatchWindow(conv.node, *conv.registration, tensors,
+                      &pair.windows[0]) ||
+      !HasConstantInputs(allocator, conv.node, tensors)) {
+    return false;
+  }
+  const int input = conv.node.inputs->data[0];
+  const int intermediate = conv.node.outputs->data[0];
+  if (tensors[intermediate].allocation_type != kTfLiteArenaRw ||
+      tensors[intermediate].is_variable) {
+    return false;
+  }
+  bool input_is_read_later = false;
+  for (const int32_t tensor : *subgraph->outputs()) {
+    if (tensor == intermediate) {
+      return false;
+    }
+    input_is_read_later |= tensor == input;
+  }
+  int reads = 0;
+  bool read_by_next = false;
+  for (int i = 0; i < nodes_size; ++i) {
+    const TfLiteIntArray* inputs = nodes[i].node.inputs;
+    for (int j = 0; j < inputs->size; ++j) {
+      if (inputs->data[j] == intermediate) {
+        ++reads;
+        read_by_next |= i == position + 1;
+      }
+      input_is_read_later |= i > position && inputs->data[j] == input;
+    }
+  }
+  if (reads != 1 || !read_by_next || next.node.outputs->size != 1) {
+    return false;
+  }
+
+  const int output = next.node.outputs->data[0];
+  int side_tensor = -1;
+  switch (next.registration->builtin_code) {
+    case BuiltinOperator_AVERAGE_POOL_2D:
+    case BuiltinOperator_MAX_POOL_2D: {
+      PatchWindow* window = &pair.windows[1];
+      if (!GetPatchWindow(next.node, *next.registration, tensors, window) ||
+          window->filter_height > window->stride_height) {
+        return false;
+      }
+      break;
+    }
+    case BuiltinOperator_ADD: {
+      if (next.node.inputs->size != 2) {
+        return false;
+      }
+      side_tensor = next.node.inputs->data[0] == intermediate
+                        ? next.node.inputs->data[1]
+                        : next.node.inputs->data[0];
+      if (side_tensor < 0 ||
+          !TfLiteIntArrayEqual(tensors[side_tensor].dims,
+                               tensors[intermediate].dims) ||
+          !TfLiteIntArrayEqual(tensors[output].dims,
+                               tensors[intermediate].dims)) {
+        return false;
+      }
+      pair.windows[1] = {/*filter_height=*/1, /*stride_height=*/1,
+                         /*dilation_height_factor=*/1, /*padding_height=*/0};
+      break;
+    }
+    default:
+      return false;
+  }
+
+  pair.operators = 2;
+  pair.output_rows = 1;
+  pair.tensors[0] = input;
+  pair.tensors[1] = intermediate;
+  pair.tensors[2] = output;
+  for (int i = 0; i <= 2; ++i) {
+    pair.heights[i] = tensors[pair.tensors[i]].dims->data[1];
+  }
+  pair.side_tensors[0] = -1;
+  pair.side_tensors[1] = side_tensor;
+  SetPatchHeights(&pair);
+
+  // Fused, the input, the rows of one window and the output are alive at the
+  // same time. One after the other, the full intermediate is alive with the
+  // input and then with the output. Fusing must not need more memory.
+  const size_t input_bytes = tensors[input].bytes;
+  const size_t intermediate_bytes = tensors[intermediate].bytes;
+  const size_t output_bytes = tensors[output].bytes;
+  const size_t window_bytes =
+      intermediate_bytes / pair.heights[1] * pair.patch_heights[1];
+  const size_t unfused_bytes =
+      intermediate_bytes +
+      std::max(input_bytes,
+               output_bytes + (input_is_read_later ? input_bytes : 0));
+  if (input_bytes + window_bytes + output_bytes > unfused_bytes) {
+    return false;
+  }
+  *plan = pair;
+  return true;
+}
+
+// Finds the pairs of operators to fuse in nodes `first_position` and up of a
+// subgraph and returns their number. Unless they are null, the pairs are
+// applied to `info`, which starts at the first tensor of the subgraph, and
+// written to `plans`. The result only depends on the model, so the pairs can
+// be counted while planning and written once their memory is allocated.
+int FuseOperators(const MicroAllocator& allocator,
+                  const NodeAndRegistration* nodes, int nodes_size,
+                  int first_position, int operator_offset,
+                  const SubGraph* subgraph, const TfLiteTensor* tensors,
+                  AllocationInfo* info, PatchPlan* plans) {
+  int count = 0;
+  for (int position = first_position; position < nodes_size; ++position) {
+    PatchPlan pair;
+    if (!GetFusedOperators(allocator, nodes, nodes_size, position, subgraph,
+                           tensors, &pair)) {
+      continue;
+    }
+    pair.first_node = operator_offset + position;
+    if (info != nullptr) {
+      ApplyPatchPlan(pair, tensors, info);
+    }
+    if (plans != nullptr) {
+      plans[count] = pair;
+    }
+    ++count;
+    ++position;
+  }
+  return count;
+}
+#endif
+
+// Written by SaveSnapshot in front of a copy of the persistent area. Arrays
+// the allocator keeps in the persistent area are stored as offsets from the
+// start of the arena, the old arena and model addresses are kept to relocate
+// pointers stored inside the copy. The checksum covers the copy.
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  uintptr_t arena_base;
+  uintptr_t model_base;
+  uint32_t arena_size;
+  uint32_t persistent_bytes;
+  uint32_t activation_bytes;
+  uint32_t subgraphs_size;
+  uint32_t tensors_size;
+  uint32_t operators_size;
+  uint32_t tensors_offset;
+  uint32_t tensor_offsets_offset;
+  uint32_t operator_offsets_offset;
+  uint32_t node_and_registrations_offset;
+  uint32_t scratch_buffers_offset;
+  uint32_t scratch_buffer_count;
+  uint32_t compressed_tensor_uses_offset;
+  uint32_t compressed_tensor_use_count;
+  uint32_t operator_order_offset;
+  uint32_t patch_plans_offset;
+  uint32_t patch_plan_count;
+  uint32_t checksum;
+};
+
+constexpr uint32_t kSnapshotMagic = 0x534D4654;  // "TFMS"
+// Bump whenever the layout of anything in the persistent area changes.
+constexpr uint32_t kSnapshotVersion = 8;
+
+// 32 bit FNV-1a hash, enough to catch a torn or corrupted snapshot.
+uint32_t SnapshotChecksum(const uint8_t* data, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// Whether `count` elements of type T at `offset` lie within the restored
+// persistent area [persistent_start, arena_size). Empty arrays are not read.
+template <typename T>
+bool IsInPersistentArea(uint32_t offset, size_t count,
+                        size_t persistent_start, size_t arena_size) {
+  if (count == 0) {
+    return true;
+  }
+  return offset >= persistent_start && offset < arena_size &&
+         offset % alignof(T) == 0 &&
+         count <= (arena_size - offset) / sizeof(T);
+}
+
+// Moves pointers of a restored persistent area from the addresses at save time
+// to the current arena and model.
+class SnapshotRelocator {
+ public:
+  SnapshotRelocator(const SnapshotHeader& header, uint8_t* arena,
+                    const Model* model)
+      : old_arena_(header.arena_base),
+        old_model_(header.model_base),
+        arena_size_(header.arena_size),
+        arena_(reinterpret_cast<uintptr_t>(arena)),
+        model_(reinterpret_cast<uintptr_t>(model)) {}
+
+  bool IsNeeded() const { return old_arena_ != arena_ || old_model_ != model_; }
+
+  // For pointers that are either into the arena or not owned by the
+  // interpreter at all (e.g. user_data of a kernel pointing to a static).
+  template <typename T>
+  void Arena(T** ptr) const {
+    const uintptr_t address = reinterpret_cast<uintptr_t>(*ptr);
+    if (InOldArena(address)) {
+      *ptr = reinterpret_cast<T*>(address - old_arena_ + arena_);
+    }
+  }
+
+  // For pointers that are either into the arena or into the model.
+  template <typename T>
+  void ArenaOrModel(T** ptr) const {
+    const uintptr_t address = reinterpret_cast<uintptr_t>(*ptr);
+    if (address == 0) {
+      return;
+    }
+    if (InOldArena(address)) {
+      *ptr = reinterpret_cast<T*>(address - old_arena_ + arena_);
+    } else {
+      *ptr = reinterpret_cast<T*>(address - old_model_ + model_);
+    }
+  }
+
+ private:
+  bool InOldArena(uintptr_t address) const {
+    return address >= old_arena_ && address < old_arena_ + arena_size_;
+  }
+
+  uintptr_t old_arena_;
+  uintptr_t old_model_;
+  uintptr_t arena_size_;
+  uintptr_t arena_;
+  uintptr_t model_;
+};
+
+void RelocateTensor(const SnapshotRelocator& relocator, TfLiteTensor* tensor) {
+  relocator.ArenaOrModel(&tensor->data.raw);
+  relocator.ArenaOrModel(&tensor->dims);
+  relocator.ArenaOrModel(&tensor->name);
+  relocator.Arena(&tensor->quantization.params);
+  if (tensor->quantization.type == kTfLiteAffineQuantization &&
+      tensor->quantization.params != nullptr) {
+    auto* quantization = reinterpret_cast<TfLiteAffineQuantization*>(
+        tensor->quantization.params);
+    relocator.Arena(&quantization->scale);
+    relocator.Arena(&quantization->zero_point);
+  }
+  relocator.Arena(&tensor->sparsity);
+  if (TfLiteSparsity* sparsity = tensor->sparsity) {
+    relocator.ArenaOrModel(&sparsity->traversal_order);
+    relocator.ArenaOrModel(&sparsity->block_map);
+    relocator.Arena(&sparsity->dim_metadata);
+    for (int i = 0; i < sparsity->dim_metadata_size; ++i) {
+      relocator.ArenaOrModel(&sparsity->dim_metadata[i].array_segments);
+      relocator.ArenaOrModel(&sparsity->dim_metadata[i].array_indices);
+    }
+  }
+}
+
+void RelocateNode(const SnapshotRelocator& relocator, TfLiteNode* node) {
+  relocator.ArenaOrModel(&node->inputs);
+  relocator.ArenaOrModel(&node->outputs);
+  relocator.ArenaOrModel(&node->intermediates);
+  relocator.ArenaOrModel(&node->temporaries);
+  relocator.ArenaOrModel(&node->custom_initial_data);
+  relocator.Arena(&node->builtin_data);
+  relocator.Arena(&node->user_data);
+}
+
+// Int32 vectors are used in place like the tensor shape, narrower ones are
+// widened into the persistent area since kernels take a TfLiteIntArray.
+TfLiteStatus InitializeSparseIndexVector(SimpleMemoryAllocator* allocator,
+                                         SparseIndexVector type,
+                                         const void* vector,
+                                         ErrorReporter* error_reporter,
+                                         TfLiteIntArray** result) {
+  const flatbuffers::Vector<uint16_t>* uint16_values = nullptr;
+  const flatbuffers::Vector<uint8_t>* uint8_values = nullptr;
+  int size = 0;
+  switch (type) {
+    case SparseIndexVector_Int32Vector:
+      *result =
+          const_cast<TfLiteIntArray*>(reinterpret_cast<const TfLiteIntArray*>(
+              static_cast<const Int32Vector*>(vector)->values()));
+      return kTfLiteOk;
+    case SparseIndexVector_Uint16Vector:
+      uint16_values = static_cast<const Uint16Vector*>(vector)->values();
+      size = uint16_values->size();
+      break;
+    case SparseIndexVector_Uint8Vector:
+      uint8_values = static_cast<const Uint8Vector*>(vector)->values();
+      size = uint8_values->size();
+      break;
+    default:
+      *result = nullptr;
+      return kTfLiteOk;
+  }
+  *result = reinterpret_cast<TfLiteIntArray*>(allocator->AllocateFromTail(
+      TfLiteIntArrayGetSizeInBytes(size), alignof(TfLiteIntArray)));
+  if (*result == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Failed to allocate memory for sparse indices");
+    return kTfLiteError;
+  }
+  (*result)->size = size;
+  for (int i = 0; i < size; ++i) {
+    (*result)->data[i] =
+        uint16_values ? uint16_values->Get(i) : uint8_values->Get(i);
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus InitializeSparsity(SimpleMemoryAllocator* allocator,
+                                const SparsityParameters& src_sparsity,
+                                ErrorReporter* error_reporter,
+                                TfLiteSparsity** result) {
+  const auto* src_dim_metadata = src_sparsity.dim_metadata();
+  const int dim_metadata_size =
+      src_dim_metadata != nullptr ? src_dim_metadata->size() : 0;
+  TfLiteSparsity* sparsity = reinterpret_cast<TfLiteSparsity*>(
+      allocator->AllocateFromTail(sizeof(TfLiteSparsity),
+                                  alignof(TfLiteSparsity)));
+  TfLiteDimensionMetadata* dim_metadata =
+      reinterpret_cast<TfLiteDimensionMetadata*>(allocator->AllocateFromTail(
+          sizeof(TfLiteDimensionMetadata) * dim_metadata_size,
+          alignof(TfLiteDimensionMetadata)));
+  if (sparsity == nullptr || dim_metadata == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Failed to allocate memory for sparsity parameters");
+    return kTfLiteError;
+  }
+  sparsity->traversal_order =
+      const_cast<TfLiteIntArray*>(reinterpret_cast<const TfLiteIntArray*>(
+          src_sparsity.traversal_order()));
+  sparsity->block_map = const_cast<TfLiteIntArray*>(
+      reinterpret_cast<const TfLiteIntArray*>(src_sparsity.block_map()));
+  sparsity->dim_metadata = dim_metadata;
+  sparsity->dim_metadata_size = dim_metadata_size;
+  for (int i = 0; i < dim_metadata_size; ++i) {
+    const DimensionMetadata* src = src_dim_metadata->Get(i);
+    dim_metadata[i].format = src->format() == DimensionType_SPARSE_CSR
+                                 ? kTfLiteDimSparseCSR
+                                 : kTfLiteDimDense;
+    dim_metadata[i].dense_size = src->dense_size();
+    TF_LITE_ENSURE_STATUS(InitializeSparseIndexVector(
+        allocator, src->array_segments_type(), src->array_segments(),
+        error_reporter, &dim_metadata[i].array_segments));
+    TF_LITE_ENSURE_STATUS(InitializeSparseIndexVector(
+        allocator, src->array_indices_type(), src->array_indices(),
+        error_reporter, &dim_metadata[i].array_indices));
+  }
+  *result = sparsity;
+  return kTfLiteOk;
+}
+
+// One of the metadata tables listing compressed tensors, see
+// compressed_weights.h. Behind the version and the number of entries, each
+// entry has `entry_words` words.
+class CompressedTensorTable {
+ public:
+  CompressedTensorTable(const Model* model, const char* name,
+                        size_t entry_words)
+      : entry_words_(entry_words) {
+    const auto* metadata = model->metadata();
+    const auto* buffers = model->buffers();
+    if (metadata == nullptr) {
+      return;
+    }
+    for (const Metadata* entry : *metadata) {
+      if (entry->name() != nullptr &&
+          strcmp(entry->name()->c_str(), name) == 0 &&
+          entry->buffer() < buffers->size()) {
+        table_ = buffers->Get(entry->buffer())->data();
+      }
+    }
+  }
+
+  // A missing table is valid and empty.
+  bool IsValid(uint32_t version) const {
+    return table_ == nullptr ||
+           (table_->size() >= kHeaderWords * sizeof(uint32_t) &&
+            Word(0) == version &&
+            table_->size() >=
+                (kHeaderWords + entry_words_ * Word(1)) * sizeof(uint32_t));
+  }
+
+  uint32_t size() const { return table_ == nullptr ? 0 : Word(1); }
+
+  uint32_t Get(uint32_t entry, size_t word) const {
+    return Word(kHeaderWords + entry * entry_words_ + word);
+  }
+
+ private:
+  static constexpr size_t kHeaderWords = 2;
+
+  // The table is not necessarily aligned in the model.
+  uint32_t Word(size_t i) const {
+    uint32_t value;
+    memcpy(&value, table_->data() + i * sizeof(uint32_t), sizeof(value));
+    return value;
+  }
+
+  const flatbuffers::Vector<uint8_t>* table_ = nullptr;
+  size_t entry_words_;
+};
 }  // namespace
 
 namespace internal {
@@ -280,6 +987,18 @@ TfLiteStatus InitializeRuntimeTensor(
   // it from a flatbuffer enum into a constant used by the kernel C API.
   TF_LITE_ENSURE_STATUS(ConvertTensorType(flatbuffer_tensor.type(),
                                           &result->type, error_reporter));
+#if defined(TF_LITE_INTEGER_ONLY)
+  // Kernels only do integer math on quantized tensors, a floating point
+  // tensor anywhere in the graph means some op would compute in float.
+  if (result->type == kTfLiteFloat32 || result->type == kTfLiteFloat16 ||
+      result->type == kTfLiteComplex64) {
+    TF_LITE_REPORT_ERROR(
+        error_reporter,
+        "Tensor of type %s is not supported with TF_LITE_INTEGER_ONLY.",
+        TfLiteTypeGetName(result->type));
+    return kTfLiteError;
+  }
+#endif
   // Make sure we remember if the serialized tensor is designated as a variable.
   result->is_variable = flatbuffer_tensor.is_variable();
 
@@ -371,6 +1090,15 @@ TfLiteStatus InitializeRuntimeTensor(
 
     result->quantization = {kTfLiteAffineQuantization, quantization};
   }
+  // Only the non-zero values of a sparse tensor are stored, kernels that
+  // support it walk the sparsity parameters instead of the dense shape.
+  if (const auto* src_sparsity = flatbuffer_tensor.sparsity()) {
+    TF_LITE_ENSURE_STATUS(InitializeSparsity(
+        allocator, *src_sparsity, error_reporter, &result->sparsity));
+    if (result->allocation_type == kTfLiteMmapRo) {
+      result->bytes = (*buffers)[flatbuffer_tensor.buffer()]->data()->size();
+    }
+  }
   if (flatbuffer_tensor.name() != nullptr) {
     result->name = flatbuffer_tensor.name()->c_str();
   }
@@ -379,44 +1107,296 @@ TfLiteStatus InitializeRuntimeTensor(
 }  // namespace internal
 
 TfLiteStatus MicroAllocator::Init() {
-  auto* subgraphs = model_->subgraphs();
-  if (subgraphs->size() != 1) {
+  subgraphs_ = model_->subgraphs();
+  const size_t subgraphs_size = subgraphs_->size();
+  if (subgraphs_size == 0) {
+    TF_LITE_REPORT_ERROR(error_reporter_, "Model has no subgraphs.\n");
+    return kTfLiteError;
+  }
+
+  tensor_offsets_ = reinterpret_cast<int*>(memory_allocator_->AllocateFromTail(
+      sizeof(int) * (subgraphs_size + 1), alignof(int)));
+  operator_offsets_ =
+      reinterpret_cast<int*>(memory_allocator_->AllocateFromTail(
+          sizeof(int) * (subgraphs_size + 1), alignof(int)));
+  if (tensor_offsets_ == nullptr || operator_offsets_ == nullptr) {
     TF_LITE_REPORT_ERROR(error_reporter_,
-                         "Only 1 subgraph is currently supported.\n");
+                         "Failed to allocate memory for subgraph offsets");
     return kTfLiteError;
   }
-  subgraph_ = (*subgraphs)[0];
-  tensors_ = subgraph_->tensors();
-  operators_ = subgraph_->operators();
+  tensor_offsets_[0] = 0;
+  operator_offsets_[0] = 0;
+  for (size_t s = 0; s < subgraphs_size; ++s) {
+    const SubGraph* subgraph = subgraphs_->Get(s);
+    if (subgraph->operators()->size() == 0) {
+      TF_LITE_REPORT_ERROR(error_reporter_, "Subgraph %d has no operators.\n",
+                           s);
+      return kTfLiteError;
+    }
+    tensor_offsets_[s + 1] = tensor_offsets_[s] + subgraph->tensors()->size();
+    operator_offsets_[s + 1] =
+        operator_offsets_[s] + subgraph->operators()->size();
+  }
 
-  context_->tensors_size = tensors_->size();
-  context_->tensors =
-      reinterpret_cast<TfLiteTensor*>(memory_allocator_->AllocateFromTail(
-          sizeof(TfLiteTensor) * context_->tensors_size,
-          alignof(TfLiteTensor)));
-  if (context_->tensors == nullptr) {
+  const size_t tensors_size = tensor_offsets_[subgraphs_size];
+  tensors_ = reinterpret_cast<TfLiteTensor*>(
+      memory_allocator_->AllocateFromTail(sizeof(TfLiteTensor) * tensors_size,
+                                          alignof(TfLiteTensor)));
+  if (tensors_ == nullptr) {
     TF_LITE_REPORT_ERROR(
         error_reporter_,
         "Failed to allocate memory for context->tensors, %d bytes required",
-        sizeof(TfLiteTensor) * context_->tensors_size);
+        sizeof(TfLiteTensor) * tensors_size);
+    return kTfLiteError;
+  }
+
+  // Initialize runtime tensors of every subgraph using the flatbuffer.
+  for (size_t s = 0; s < subgraphs_size; ++s) {
+    const auto* tensors = subgraphs_->Get(s)->tensors();
+    for (size_t i = 0; i < tensors->size(); ++i) {
+      TfLiteStatus status = internal::InitializeRuntimeTensor(
+          memory_allocator_, *tensors->Get(i), model_->buffers(),
+          error_reporter_, &tensors_[tensor_offsets_[s] + i]);
+      if (status == kTfLiteError) {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "Failed to initialize tensor %d of subgraph %d",
+                             i, s);
+        return kTfLiteError;
+      }
+    }
+  }
+  TF_LITE_ENSURE_STATUS(InitializeCompressedTensors());
+
+  return SetActiveSubgraph(0);
+}
+
+TfLiteStatus MicroAllocator::InitializeCompressedTensors() {
+  const CompressedTensorTable palette_table(model_, kCompressedWeightsMetadata,
+                                            4);
+  const CompressedTensorTable int4_table(model_, kInt4WeightsMetadata, 2);
+  if (!palette_table.IsValid(kCompressedWeightsVersion) ||
+      !int4_table.IsValid(kInt4WeightsVersion)) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Unsupported compressed weights metadata.");
     return kTfLiteError;
   }
+  const auto* buffers = model_->buffers();
+  const uint32_t entry_count = palette_table.size() + int4_table.size();
 
-  // Initialize runtime tensors in context_ using the flatbuffer.
-  for (size_t i = 0; i < tensors_->size(); ++i) {
-    TfLiteStatus status = internal::InitializeRuntimeTensor(
-        memory_allocator_, *tensors_->Get(i), model_->buffers(),
-        error_reporter_, &context_->tensors[i]);
-    if (status == kTfLiteError) {
-      TF_LITE_REPORT_ERROR(error_reporter_, "Failed to initialize tensor %d",
-                           i);
+  // Reads entry `e` of both tables, palette entries first, and checks that
+  // the tensor can be expanded without reading past its buffers.
+  auto read_entry = [&](uint32_t e, uint32_t* subgraph_idx,
+                        uint32_t* tensor_idx,
+                        CompressedTensor* compressed) -> TfLiteStatus {
+    const bool is_int4 = e >= palette_table.size();
+    const CompressedTensorTable& table = is_int4 ? int4_table : palette_table;
+    if (is_int4) {
+      e -= palette_table.size();
+    }
+    *subgraph_idx = table.Get(e, 0);
+    *tensor_idx = table.Get(e, 1);
+    const uint32_t palette_idx = is_int4 ? 0 : table.Get(e, 2);
+    compressed->bits = is_int4 ? 4 : table.Get(e, 3);
+    if (*subgraph_idx >= subgraphs_size() ||
+        *tensor_idx >= subgraphs_->Get(*subgraph_idx)->tensors()->size() ||
+        palette_idx >= buffers->size() ||
+        (compressed->bits != 1 && compressed->bits != 2 &&
+         compressed->bits != 4 && compressed->bits != 8)) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Invalid compressed tensor entry %d.", e);
+      return kTfLiteError;
+    }
+    const TfLiteTensor* tensor = GetTensor(*subgraph_idx, *tensor_idx);
+    size_t element_size;
+    TF_LITE_ENSURE_STATUS(
+        TfLiteTypeSizeOf(tensor->type, &element_size, error_reporter_));
+    const size_t count = tensor->bytes / element_size;
+    const auto* indices =
+        buffers->Get(subgraphs_->Get(*subgraph_idx)
+                         ->tensors()
+                         ->Get(*tensor_idx)
+                         ->buffer())
+            ->data();
+    const auto* palette = is_int4 ? nullptr : buffers->Get(palette_idx)->data();
+    const bool valid_palette =
+        is_int4 ? tensor->type == kTfLiteInt8
+                : palette != nullptr && palette->size() != 0 &&
+                      palette->size() % element_size == 0 &&
+                      palette->size() / element_size <=
+                          (1u << compressed->bits);
+    if (tensor->allocation_type != kTfLiteMmapRo ||
+        tensor->sparsity != nullptr || indices == nullptr ||
+        indices->size() < (count * compressed->bits + 7) / 8 ||
+        !valid_palette) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Tensor %d of subgraph %d can not be compressed.",
+                           *tensor_idx, *subgraph_idx);
       return kTfLiteError;
     }
+    compressed->indices = indices->data();
+    compressed->palette = is_int4 ? nullptr : palette->data();
+    if (is_int4) {
+      return kTfLiteOk;
+    }
+    // Out of range indices would read past the palette when expanding.
+    const int palette_size = palette->size() / element_size;
+    const int per_byte = 8 / compressed->bits;
+    for (size_t i = 0; i < count; ++i) {
+      const int index =
+          (indices->Get(i / per_byte) >> ((i % per_byte) * compressed->bits)) &
+          ((1 << compressed->bits) - 1);
+      if (index >= palette_size) {
+        TF_LITE_REPORT_ERROR(
+            error_reporter_,
+            "Palette index %d out of range for tensor %d of subgraph %d.",
+            index, *tensor_idx, *subgraph_idx);
+        return kTfLiteError;
+      }
+    }
+    return kTfLiteOk;
+  };
+
+  // Validates all entries and counts the operator inputs reading them.
+  size_t use_count = 0;
+  for (uint32_t e = 0; e < entry_count; ++e) {
+    uint32_t subgraph_idx;
+    uint32_t tensor_idx;
+    CompressedTensor compressed;
+    TF_LITE_ENSURE_STATUS(
+        read_entry(e, &subgraph_idx, &tensor_idx, &compressed));
+    for (const Operator* op : *subgraphs_->Get(subgraph_idx)->operators()) {
+      for (int32_t input : *op->inputs()) {
+        use_count += input == static_cast<int32_t>(tensor_idx);
+      }
+    }
+  }
+  if (use_count == 0) {
+    return kTfLiteOk;
   }
 
+  compressed_tensor_uses_ = reinterpret_cast<internal::CompressedTensorUse*>(
+      memory_allocator_->AllocateFromTail(
+          sizeof(internal::CompressedTensorUse) * use_count,
+          alignof(internal::CompressedTensorUse)));
+  if (compressed_tensor_uses_ == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Failed to allocate memory for compressed tensors");
+    return kTfLiteError;
+  }
+  for (uint32_t e = 0; e < entry_count; ++e) {
+    uint32_t subgraph_idx;
+    uint32_t tensor_idx;
+    CompressedTensor compressed;
+    TF_LITE_ENSURE_STATUS(
+        read_entry(e, &subgraph_idx, &tensor_idx, &compressed));
+    TfLiteTensor* tensor = GetTensor(subgraph_idx, tensor_idx);
+    if (tensor->allocation_type != kTfLiteMmapRo) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Tensor %d of subgraph %d is listed twice.",
+                           tensor_idx, subgraph_idx);
+      return kTfLiteError;
+    }
+    bool used = false;
+    const auto* operators = subgraphs_->Get(subgraph_idx)->operators();
+    for (size_t i = 0; i < operators->size(); ++i) {
+      for (int32_t input : *operators->Get(i)->inputs()) {
+        if (input != static_cast<int32_t>(tensor_idx)) {
+          continue;
+        }
+        internal::CompressedTensorUse use;
+        use.node_idx = operator_offsets_[subgraph_idx] + i;
+        use.claimed = false;
+        use.tensor = tensor;
+        use.compressed = compressed;
+        // Insertion sort by operator, there are only a few uses.
+        size_t pos = compressed_tensor_use_count_++;
+        while (pos > 0 &&
+               compressed_tensor_uses_[pos - 1].node_idx > use.node_idx) {
+          compressed_tensor_uses_[pos] = compressed_tensor_uses_[pos - 1];
+          --pos;
+        }
+        compressed_tensor_uses_[pos] = use;
+        used = true;
+      }
+    }
+    // Unused tensors keep pointing at their packed indices.
+    if (used) {
+      tensor->data.raw = nullptr;
+      tensor->allocation_type = kTfLiteArenaRw;
+    }
+  }
   return kTfLiteOk;
 }
 
+void MicroAllocator::DecompressInputs(int node_idx) const {
+  // Binary search for the first use by `node_idx`.
+  size_t begin = 0;
+  size_t end = compressed_tensor_use_count_;
+  while (begin < end) {
+    const size_t middle = (begin + end) / 2;
+    if (compressed_tensor_uses_[middle].node_idx < node_idx) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  for (size_t i = begin; i < compressed_tensor_use_count_ &&
+                         compressed_tensor_uses_[i].node_idx == node_idx;
+       ++i) {
+    const internal::CompressedTensorUse& use = compressed_tensor_uses_[i];
+    if (use.claimed) {
+      continue;
+    }
+    size_t element_size;
+    TfLiteTypeSizeOf(use.tensor->type, &element_size, error_reporter_);
+    DecompressTensor(use.compressed, element_size, 0,
+                     use.tensor->bytes / element_size,
+                     reinterpret_cast<uint8_t*>(use.tensor->data.raw));
+  }
+}
+
+bool MicroAllocator::ClaimCompressedTensor(int node_idx,
+                                           const TfLiteTensor* tensor) {
+  bool found = false;
+  for (size_t i = 0; i < compressed_tensor_use_count_; ++i) {
+    if (compressed_tensor_uses_[i].tensor != tensor) {
+      continue;
+    }
+    if (compressed_tensor_uses_[i].node_idx != node_idx) {
+      return false;
+    }
+    found = true;
+  }
+  for (size_t i = 0; found && i < compressed_tensor_use_count_; ++i) {
+    if (compressed_tensor_uses_[i].tensor == tensor) {
+      compressed_tensor_uses_[i].claimed = true;
+    }
+  }
+  return found;
+}
+
+const CompressedTensor* MicroAllocator::GetCompressedTensor(
+    const TfLiteTensor* tensor) const {
+  for (size_t i = 0; i < compressed_tensor_use_count_; ++i) {
+    if (compressed_tensor_uses_[i].tensor == tensor) {
+      return &compressed_tensor_uses_[i].compressed;
+    }
+  }
+  return nullptr;
+}
+
+void MicroAllocator::RequestSpareBuffer(size_t bytes, SpareBuffer* buffer) {
+  buffer->bytes = bytes;
+  buffer->offset = 0;
+  buffer->next = nullptr;
+  if (last_spare_buffer_ == nullptr) {
+    spare_buffers_ = buffer;
+  } else {
+    last_spare_buffer_->next = buffer;
+  }
+  last_spare_buffer_ = buffer;
+}
+
 MicroAllocator::MicroAllocator(TfLiteContext* context, const Model* model,
                                uint8_t* tensor_arena, size_t arena_size,
                                ErrorReporter* error_reporter)
@@ -442,6 +1422,44 @@ MicroAllocator::MicroAllocator(TfLiteContext* context, const Model* model,
   }
 }
 
+TfLiteStatus MicroAllocator::ScheduleOperators(int max_steps) {
+  operator_order_ = reinterpret_cast<int*>(memory_allocator_->AllocateFromTail(
+      sizeof(int) * GetOperatorCount(), alignof(int)));
+  if (operator_order_ == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Failed to allocate memory for the operator order");
+    return kTfLiteError;
+  }
+  for (size_t s = 0; s < subgraphs_size(); ++s) {
+    TF_LITE_ENSURE_STATUS(tflite::ScheduleOperators(
+        error_reporter_, memory_allocator_, subgraphs_->Get(s),
+        &tensors_[tensor_offsets_[s]], max_steps,
+        &operator_order_[operator_offsets_[s]]));
+  }
+
+  // Compressed tensor uses were numbered in model order, move them to the
+  // position their operator runs at and sort them again.
+  for (size_t u = 0; u < compressed_tensor_use_count_; ++u) {
+    internal::CompressedTensorUse use = compressed_tensor_uses_[u];
+    size_t s = 0;
+    while (use.node_idx >= operator_offsets_[s + 1]) {
+      ++s;
+    }
+    int i = operator_offsets_[s];
+    while (operator_order_[i] != use.node_idx - operator_offsets_[s]) {
+      ++i;
+    }
+    use.node_idx = i;
+    size_t pos = u;
+    while (pos > 0 && compressed_tensor_uses_[pos - 1].node_idx > i) {
+      compressed_tensor_uses_[pos] = compressed_tensor_uses_[pos - 1];
+      --pos;
+    }
+    compressed_tensor_uses_[pos] = use;
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus MicroAllocator::AllocateNodeAndRegistrations(
     const OpResolver& op_resolver,
     NodeAndRegistration** node_and_registrations) {
@@ -449,9 +1467,15 @@ TfLiteStatus MicroAllocator::AllocateNodeAndRegistrations(
     return kTfLiteError;
   }
 
+#if defined(TF_LITE_SCHEDULE_OPERATORS)
+  TF_LITE_ENSURE_STATUS(ScheduleOperators(
+      TF_LITE_SCHEDULE_OPERATORS > 1 ? TF_LITE_SCHEDULE_OPERATORS
+                                     : kDefaultScheduleSteps));
+#endif
+
   auto* output = reinterpret_cast<NodeAndRegistration*>(
       memory_allocator_->AllocateFromTail(
-          sizeof(NodeAndRegistration) * operators_->size(),
+          sizeof(NodeAndRegistration) * GetOperatorCount(),
           alignof(NodeAndRegistration)));
   if (output == nullptr) {
     TF_LITE_REPORT_ERROR(
@@ -459,11 +1483,36 @@ TfLiteStatus MicroAllocator::AllocateNodeAndRegistrations(
         "Failed to allocate memory for node_and_registrations.");
     return kTfLiteError;
   }
+  // The outputs of a subgraph are read as dense tensors by the caller.
+  for (size_t s = 0; s < subgraphs_->size(); ++s) {
+    const auto* subgraph_outputs = subgraphs_->Get(s)->outputs();
+    const int tensor_count = tensor_offsets_[s + 1] - tensor_offsets_[s];
+    for (size_t n = 0; n < subgraph_outputs->size(); ++n) {
+      const int tensor_index = subgraph_outputs->Get(n);
+      if (tensor_index >= 0 && tensor_index < tensor_count &&
+          GetTensor(s, tensor_index)->sparsity != nullptr) {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "Sparse tensor %d is an output of subgraph %d.",
+                             tensor_index, static_cast<int>(s));
+        return kTfLiteError;
+      }
+    }
+  }
   TfLiteStatus status = kTfLiteOk;
   auto* opcodes = model_->operator_codes();
   MicroBuiltinDataAllocator builtin_data_allocator(memory_allocator_);
-  for (size_t i = 0; i < operators_->size(); ++i) {
-    const auto* op = operators_->Get(i);
+  int subgraph_idx = 0;
+  for (int i = 0; i < GetOperatorCount(); ++i) {
+    // Operators of all subgraphs are numbered consecutively.
+    while (i >= operator_offsets_[subgraph_idx + 1]) {
+      ++subgraph_idx;
+    }
+    const int position = i - operator_offsets_[subgraph_idx];
+    const auto* op =
+        subgraphs_->Get(subgraph_idx)
+            ->operators()
+            ->Get(operator_order_ == nullptr ? position
+                                             : operator_order_[i]);
     size_t index = op->opcode_index();
     if (index >= opcodes->size()) {
       TF_LITE_REPORT_ERROR(error_reporter_,
@@ -471,6 +1520,17 @@ TfLiteStatus MicroAllocator::AllocateNodeAndRegistrations(
       return kTfLiteError;
     }
     auto* opcode = (*opcodes)[index];
+    // Subgraphs are planned one after the other, so a subgraph run from
+    // within another one would overwrite the tensors of its caller.
+    if ((opcode->builtin_code() == BuiltinOperator_IF ||
+         opcode->builtin_code() == BuiltinOperator_WHILE) &&
+        subgraphs_->size() > 1) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Control flow operator %s is not supported in "
+                           "models with several subgraphs.",
+                           EnumNameBuiltinOperator(opcode->builtin_code()));
+      return kTfLiteError;
+    }
     status = GetRegistrationFromOpCode(opcode, op_resolver, error_reporter_,
                                        &(output[i].registration));
     if (status != kTfLiteOk) {
@@ -497,6 +1557,28 @@ TfLiteStatus MicroAllocator::AllocateNodeAndRegistrations(
       return kTfLiteError;
     }
 
+    // Only the non-zero values of a sparse tensor are stored. Kernels other
+    // than those walking the sparsity parameters would read past them.
+    const int tensor_count =
+        tensor_offsets_[subgraph_idx + 1] - tensor_offsets_[subgraph_idx];
+    for (size_t n = 0; n < op->inputs()->size(); ++n) {
+      const int tensor_index = op->inputs()->Get(n);
+      if (tensor_index < 0 || tensor_index >= tensor_count ||
+          GetTensor(subgraph_idx, tensor_index)->sparsity == nullptr) {
+        continue;
+      }
+      if (n != 1 || (op_type != BuiltinOperator_FULLY_CONNECTED &&
+                     op_type != BuiltinOperator_CONV_2D)) {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "Sparse tensor %d is input %d of %s. Only the "
+                             "weights of FULLY_CONNECTED and CONV_2D can be "
+                             "sparse.",
+                             tensor_index, static_cast<int>(n),
+                             EnumNameBuiltinOperator(op_type));
+        return kTfLiteError;
+      }
+    }
+
     const char* custom_data = nullptr;
     size_t custom_data_size = 0;
     unsigned char* builtin_data = nullptr;
@@ -527,7 +1609,8 @@ TfLiteStatus MicroAllocator::AllocateNodeAndRegistrations(
   return kTfLiteOk;
 }
 
-TfLiteStatus MicroAllocator::FinishTensorAllocation() {
+TfLiteStatus MicroAllocator::FinishTensorAllocation(
+    const NodeAndRegistration* node_and_registrations) {
   if (!active_) {
     return kTfLiteError;
   }
@@ -539,54 +1622,175 @@ TfLiteStatus MicroAllocator::FinishTensorAllocation() {
   // 4. Set tensor/buffer pointers based on the offsets from the previous step.
   // Note that AllocationInfo is only needed for creating the plan. It will be
   // thrown away when the child allocator (tmp_allocator) goes out of scope.
+  uint8_t* aligned_arena = memory_allocator_->GetBuffer();
+  const size_t arena_size = memory_allocator_->GetMaxBufferSize();
+
+  // Scratch buffer handles are only needed to make the plan, which produces
+  // one address per buffer. If the handles are at the end of the tail, the
+  // addresses are packed into the upper end of the handle array and the rest
+  // of it is given back once the plan is committed.
+  size_t persistent_mark = memory_allocator_->GetTailMark();
+  if (scratch_buffer_count_ > 0) {
+    static_assert(
+        sizeof(internal::ScratchBufferHandle) >= sizeof(uint8_t*),
+        "Scratch buffer addresses have to fit into their handles.");
+    uint8_t* tail_start = aligned_arena + arena_size - persistent_mark;
+    if (reinterpret_cast<uint8_t*>(scratch_buffer_handles_) == tail_start) {
+      scratch_buffers_ = reinterpret_cast<uint8_t**>(scratch_buffer_handles_ +
+                                                     scratch_buffer_count_) -
+                         scratch_buffer_count_;
+      persistent_mark -= reinterpret_cast<uint8_t*>(scratch_buffers_) -
+                         tail_start;
+    } else {
+      scratch_buffers_ =
+          reinterpret_cast<uint8_t**>(memory_allocator_->AllocateFromTail(
+              sizeof(uint8_t*) * scratch_buffer_count_, alignof(uint8_t*)));
+      if (scratch_buffers_ == nullptr) {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "Failed to allocate memory for scratch buffers");
+        return kTfLiteError;
+      }
+      persistent_mark = memory_allocator_->GetTailMark();
+    }
+  }
+
+#if defined(TF_LITE_PATCH_EXECUTION) || defined(TF_LITE_FUSE_OPERATORS)
+  PatchPlan patch_plan = {};
+  int fused_operators = 0;
+#endif
   {
     SimpleMemoryAllocator tmp_allocator =
         memory_allocator_->CreateChildAllocator();
 
     AllocationInfoBuilder builder(error_reporter_, &tmp_allocator);
+    TF_LITE_ENSURE_STATUS(builder.Init(tensor_offsets_[subgraphs_size()],
+                                       scratch_buffer_count_));
+    for (size_t s = 0; s < subgraphs_size(); ++s) {
+      TF_LITE_ENSURE_STATUS(builder.AddTensors(
+          subgraphs_->Get(s), operator_offsets_[s],
+          operator_order_ == nullptr ? nullptr
+                                     : &operator_order_[operator_offsets_[s]],
+          &tensors_[tensor_offsets_[s]]));
+    }
+    TF_LITE_ENSURE_STATUS(builder.AddCompressedTensors(
+        compressed_tensor_uses_, compressed_tensor_use_count_, tensors_));
     TF_LITE_ENSURE_STATUS(
-        builder.Init(tensors_->size(), scratch_buffer_count_));
-    TF_LITE_ENSURE_STATUS(builder.AddTensors(subgraph_, context_->tensors));
-    TF_LITE_ENSURE_STATUS(builder.AddScratchBuffers(scratch_buffer_handles_));
-    const AllocationInfo* allocation_info = builder.Finish();
+        builder.AddScratchBuffers(scratch_buffer_handles_, scratch_buffers_));
+    AllocationInfo* allocation_info = builder.Finish();
 
-    uint8_t* aligned_arena = memory_allocator_->GetBuffer();
-    size_t arena_size = memory_allocator_->GetMaxBufferSize();
     // Remaining arena size that memory planner can use for calculating offsets.
     // The remaining size should always be a positive number since the parent
     // allocator is always bigger than the child allocator.
     size_t remaining_arena_size = arena_size - tmp_allocator.GetDataSize();
+#if defined(TF_LITE_PATCH_EXECUTION)
+    TF_LITE_ENSURE_STATUS(ChoosePatchPlan(
+        *this, error_reporter_, node_and_registrations, subgraphs_->Get(0),
+        aligned_arena, remaining_arena_size,
+        TF_LITE_PATCH_EXECUTION > 1 ? TF_LITE_PATCH_EXECUTION
+                                    : kDefaultMaxPatches,
+        allocation_info, builder.Size(), &patch_plan));
+#endif
+#if defined(TF_LITE_FUSE_OPERATORS)
+    for (size_t s = 0; s < subgraphs_size(); ++s) {
+      fused_operators += FuseOperators(
+          *this, &node_and_registrations[operator_offsets_[s]],
+          operator_offsets_[s + 1] - operator_offsets_[s],
+          s == 0 ? patch_plan.operators : 0, operator_offsets_[s],
+          subgraphs_->Get(s), &tensors_[tensor_offsets_[s]],
+          &allocation_info[tensor_offsets_[s]], nullptr);
+    }
+#endif
+    for (size_t s = 0; s < subgraphs_size(); ++s) {
+      ShareInPlaceBuffers(&node_and_registrations[operator_offsets_[s]],
+                          operator_offsets_[s + 1] - operator_offsets_[s],
+                          subgraphs_->Get(s),
+                          &allocation_info[tensor_offsets_[s]]);
+    }
     GreedyMemoryPlanner planner(aligned_arena, remaining_arena_size);
     TF_LITE_ENSURE_STATUS(
         CreatePlan(error_reporter_, &planner, allocation_info, builder.Size()));
-    // Actual size available for placing tensors. This includes memory held by
-    // the tensor info array, which will be released.
-    size_t actual_available_arena_size =
-        arena_size - memory_allocator_->GetDataSize();
-    // Make sure we have enough arena size.
-    if (planner.GetMaximumMemorySize() > actual_available_arena_size) {
+    // Only pointers are written here, so the plan can be committed before it
+    // is known to fit.
+    TF_LITE_ENSURE_STATUS(CommitPlan(error_reporter_, &planner, aligned_arena,
+                                     allocation_info, builder.Size()));
+    activation_bytes_ = planner.GetMaximumMemorySize();
+  }
+  scratch_buffer_handles_ = nullptr;
+  memory_allocator_->ResetTailToMark(persistent_mark);
+
+#if defined(TF_LITE_PATCH_EXECUTION) || defined(TF_LITE_FUSE_OPERATORS)
+  patch_plan_count_ = (patch_plan.operators > 0 ? 1 : 0) + fused_operators;
+  if (patch_plan_count_ > 0) {
+    patch_plans_ = reinterpret_cast<PatchPlan*>(
+        memory_allocator_->AllocateFromTail(
+            sizeof(PatchPlan) * patch_plan_count_, alignof(PatchPlan)));
+    if (patch_plans_ == nullptr) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Failed to allocate memory for the patch plans.");
+      return kTfLiteError;
+    }
+    PatchPlan* plan = patch_plans_;
+    if (patch_plan.operators > 0) {
+      *plan++ = patch_plan;
+    }
+#if defined(TF_LITE_FUSE_OPERATORS)
+    // The pairs were applied to the plan above, this only writes them.
+    for (size_t s = 0; s < subgraphs_size(); ++s) {
+      plan += FuseOperators(
+          *this, &node_and_registrations[operator_offsets_[s]],
+          operator_offsets_[s + 1] - operator_offsets_[s],
+          s == 0 ? patch_plan.operators : 0, operator_offsets_[s],
+          subgraphs_->Get(s), &tensors_[tensor_offsets_[s]], nullptr, plan);
+    }
+#endif
+  }
+#endif
+
+  // Data in variables need to be kept for the next invocation so allocating
+  // them from the tail (persistent area). They may reuse the memory released
+  // above.
+  for (size_t s = 0; s < subgraphs_size(); ++s) {
+    if (AllocateVariables(subgraphs_->Get(s)->tensors(),
+                          &tensors_[tensor_offsets_[s]],
+                          memory_allocator_) != kTfLiteOk) {
       TF_LITE_REPORT_ERROR(
           error_reporter_,
-          "Arena size is too small for activation buffers. Needed %d but only "
-          "%d was available.",
-          planner.GetMaximumMemorySize(), remaining_arena_size);
+          "Failed to allocate variables. Please increase arena size.");
       return kTfLiteError;
     }
-
-    TF_LITE_ENSURE_STATUS(CommitPlan(error_reporter_, &planner, aligned_arena,
-                                     allocation_info, builder.Size()));
   }
 
-  // Data in variables need to be kept for the next invocation so allocating
-  // them from the tail (persistent area).
-  if (AllocateVariables(tensors_, context_->tensors, memory_allocator_) !=
-      kTfLiteOk) {
+  // The persistent area is final now, make sure the plan fits below it.
+  const size_t available_arena_size =
+      arena_size - memory_allocator_->GetDataSize();
+  if (activation_bytes_ > available_arena_size) {
     TF_LITE_REPORT_ERROR(
         error_reporter_,
-        "Failed to allocate variables. Please increase arena size.");
+        "Arena size is too small for activation buffers. Needed %d but only "
+        "%d was available.",
+        activation_bytes_, available_arena_size);
     return kTfLiteError;
   }
 
+  // Spare buffers get what is left between the plan, or the reserved
+  // activation bytes if they are more, and the persistent area.
+  const size_t kept_activation_bytes =
+      std::max(activation_bytes_, reserved_activation_bytes_);
+  for (SpareBuffer* buffer = spare_buffers_; buffer != nullptr;
+       buffer = buffer->next) {
+    const size_t mark = memory_allocator_->GetTailMark();
+    uint8_t* data =
+        memory_allocator_->AllocateFromTail(buffer->bytes, kBufferAlignment);
+    if (data == nullptr || kept_activation_bytes >
+                               arena_size - memory_allocator_->GetDataSize()) {
+      memory_allocator_->ResetTailToMark(mark);
+      continue;
+    }
+    buffer->offset = data - reinterpret_cast<uint8_t*>(buffer);
+  }
+  spare_buffers_ = nullptr;
+  last_spare_buffer_ = nullptr;
+
   active_ = false;
   return kTfLiteOk;
 }
@@ -607,25 +1811,31 @@ TfLiteStatus MicroAllocator::AllocatePersistentBuffer(size_t bytes,
 TfLiteStatus MicroAllocator::RequestScratchBufferInArena(int node_id,
                                                          size_t bytes,
                                                          int* buffer_idx) {
-  // A sanity check to make sure scratch_buffer_handles_ is contiguous.
-  if (reinterpret_cast<uint8_t*>(scratch_buffer_handles_) !=
-      memory_allocator_->GetBuffer() - memory_allocator_->GetDataSize()) {
-    TF_LITE_REPORT_ERROR(error_reporter_,
-                         "Internal error: AllocateFromTail can not be called "
-                         "between two RequestScratchBufferInArena calls.");
-  }
-
+  // The handles are kept as one array at the start of the tail. If something
+  // else was allocated from the tail since the last request, the array is
+  // moved next to the new handle. The old copy stays behind in the tail.
+  uint8_t* tail_start = memory_allocator_->GetBuffer() +
+                        memory_allocator_->GetMaxBufferSize() -
+                        memory_allocator_->GetDataSize();
+  const size_t moved_count =
+      reinterpret_cast<uint8_t*>(scratch_buffer_handles_) == tail_start
+          ? 0
+          : scratch_buffer_count_;
   internal::ScratchBufferHandle* handle =
       reinterpret_cast<internal::ScratchBufferHandle*>(
           memory_allocator_->AllocateFromTail(
-              sizeof(internal::ScratchBufferHandle),
+              sizeof(internal::ScratchBufferHandle) * (moved_count + 1),
               alignof(internal::ScratchBufferHandle)));
   if (handle == nullptr) {
     TF_LITE_REPORT_ERROR(error_reporter_,
-                         "Failed to register scratch buffer handle for node %s",
+                         "Failed to register scratch buffer handle for node %d",
                          node_id);
     return kTfLiteError;
   }
+  if (moved_count > 0) {
+    std::memcpy(handle + 1, scratch_buffer_handles_,
+                sizeof(internal::ScratchBufferHandle) * moved_count);
+  }
   *handle = {};
   handle->bytes = bytes;
   handle->node_idx = node_id;
@@ -637,6 +1847,266 @@ TfLiteStatus MicroAllocator::RequestScratchBufferInArena(int node_id,
   return kTfLiteOk;
 }
 
+TfLiteStatus MicroAllocator::SetActiveSubgraph(int subgraph_idx) {
+  if (subgraph_idx < 0 ||
+      static_cast<size_t>(subgraph_idx) >= subgraphs_size()) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Subgraph %d out of range (length is %d)",
+                         subgraph_idx, subgraphs_size());
+    return kTfLiteError;
+  }
+  context_->tensors = &tensors_[tensor_offsets_[subgraph_idx]];
+  context_->tensors_size =
+      tensor_offsets_[subgraph_idx + 1] - tensor_offsets_[subgraph_idx];
+  return kTfLiteOk;
+}
+
+size_t MicroAllocator::GetSnapshotSize() const {
+  return sizeof(SnapshotHeader) + memory_allocator_->GetDataSize();
+}
+
+TfLiteStatus MicroAllocator::SaveSnapshot(
+    const NodeAndRegistration* node_and_registrations, uint8_t* buffer,
+    size_t buffer_size) const {
+  if (active_ || node_and_registrations == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Tensors have to be allocated before saving a "
+                         "snapshot.");
+    return kTfLiteError;
+  }
+  if (buffer_size < GetSnapshotSize()) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Snapshot buffer is too small. Needed %d but only %d "
+                         "was available.",
+                         GetSnapshotSize(), buffer_size);
+    return kTfLiteError;
+  }
+
+  uint8_t* arena = memory_allocator_->GetBuffer();
+  const size_t arena_size = memory_allocator_->GetMaxBufferSize();
+  const size_t persistent_bytes = memory_allocator_->GetDataSize();
+  auto offset = [arena](const void* ptr) -> uint32_t {
+    return ptr == nullptr ? 0 : reinterpret_cast<const uint8_t*>(ptr) - arena;
+  };
+
+  SnapshotHeader header = {};
+  header.magic = kSnapshotMagic;
+  header.version = kSnapshotVersion;
+  header.arena_base = reinterpret_cast<uintptr_t>(arena);
+  header.model_base = reinterpret_cast<uintptr_t>(model_);
+  header.arena_size = arena_size;
+  header.persistent_bytes = persistent_bytes;
+  header.activation_bytes = activation_bytes_;
+  header.subgraphs_size = subgraphs_size();
+  header.tensors_size = tensor_offsets_[subgraphs_size()];
+  header.operators_size = GetOperatorCount();
+  header.tensors_offset = offset(tensors_);
+  header.tensor_offsets_offset = offset(tensor_offsets_);
+  header.operator_offsets_offset = offset(operator_offsets_);
+  header.node_and_registrations_offset = offset(node_and_registrations);
+  header.scratch_buffers_offset = offset(scratch_buffers_);
+  header.scratch_buffer_count = scratch_buffer_count_;
+  header.compressed_tensor_uses_offset = offset(compressed_tensor_uses_);
+  header.compressed_tensor_use_count = compressed_tensor_use_count_;
+  header.operator_order_offset = offset(operator_order_);
+  header.patch_plans_offset = offset(patch_plans_);
+  header.patch_plan_count = patch_plan_count_;
+  header.checksum =
+      SnapshotChecksum(arena + arena_size - persistent_bytes, persistent_bytes);
+
+  memcpy(buffer, &header, sizeof(header));
+  memcpy(buffer + sizeof(header), arena + arena_size - persistent_bytes,
+         persistent_bytes);
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroAllocator::RestoreSnapshot(
+    const OpResolver& op_resolver, const uint8_t* snapshot,
+    size_t snapshot_size, NodeAndRegistration** node_and_registrations) {
+  if (!active_) {
+    return kTfLiteError;
+  }
+
+  SnapshotHeader header;
+  if (snapshot_size < sizeof(header)) {
+    TF_LITE_REPORT_ERROR(error_reporter_, "Snapshot is truncated.");
+    return kTfLiteError;
+  }
+  memcpy(&header, snapshot, sizeof(header));
+  if (header.magic != kSnapshotMagic || header.version != kSnapshotVersion) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Not a snapshot of this version of the runtime.");
+    return kTfLiteError;
+  }
+
+  uint8_t* arena = memory_allocator_->GetBuffer();
+  const size_t arena_size = memory_allocator_->GetMaxBufferSize();
+  if (header.arena_size != arena_size ||
+      header.subgraphs_size != subgraphs_size() ||
+      header.tensors_size !=
+          static_cast<uint32_t>(tensor_offsets_[subgraphs_size()]) ||
+      header.operators_size != static_cast<uint32_t>(GetOperatorCount())) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Snapshot was saved for a different model or arena "
+                         "size.");
+    return kTfLiteError;
+  }
+  const size_t persistent_start = arena_size - header.persistent_bytes;
+  if (header.persistent_bytes > arena_size ||
+      header.activation_bytes > persistent_start ||
+      snapshot_size < sizeof(header) + header.persistent_bytes) {
+    TF_LITE_REPORT_ERROR(error_reporter_, "Snapshot is truncated.");
+    return kTfLiteError;
+  }
+  // Every array the header points to has to lie in the restored area.
+  const size_t operators_size = header.operators_size;
+  if (!IsInPersistentArea<TfLiteTensor>(header.tensors_offset,
+                                        header.tensors_size, persistent_start,
+                                        arena_size) ||
+      !IsInPersistentArea<int>(header.tensor_offsets_offset,
+                               subgraphs_size() + 1, persistent_start,
+                               arena_size) ||
+      !IsInPersistentArea<int>(header.operator_offsets_offset,
+                               subgraphs_size() + 1, persistent_start,
+                               arena_size) ||
+      !IsInPersistentArea<NodeAndRegistration>(
+          header.node_and_registrations_offset, operators_size,
+          persistent_start, arena_size) ||
+      !IsInPersistentArea<uint8_t*>(header.scratch_buffers_offset,
+                                    header.scratch_buffer_count,
+                                    persistent_start, arena_size) ||
+      !IsInPersistentArea<internal::CompressedTensorUse>(
+          header.compressed_tensor_uses_offset,
+          header.compressed_tensor_use_count, persistent_start, arena_size) ||
+      !IsInPersistentArea<int>(
+          header.operator_order_offset,
+          header.operator_order_offset == 0 ? 0 : operators_size,
+          persistent_start, arena_size) ||
+      !IsInPersistentArea<PatchPlan>(
+          header.patch_plans_offset,
+          header.patch_plans_offset == 0 ? 0 : header.patch_plan_count,
+          persistent_start, arena_size)) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Snapshot points outside of its persistent area.");
+    return kTfLiteError;
+  }
+  const uint8_t* persistent = snapshot + sizeof(header);
+  if (SnapshotChecksum(persistent, header.persistent_bytes) !=
+      header.checksum) {
+    TF_LITE_REPORT_ERROR(error_reporter_, "Snapshot is corrupted.");
+    return kTfLiteError;
+  }
+  // The subgraph offsets index the tensors and nodes, Init computed them from
+  // the model already.
+  for (size_t s = 0; s <= subgraphs_size(); ++s) {
+    int tensor_offset;
+    int operator_offset;
+    memcpy(&tensor_offset,
+           persistent + header.tensor_offsets_offset - persistent_start +
+               s * sizeof(int),
+           sizeof(int));
+    memcpy(&operator_offset,
+           persistent + header.operator_offsets_offset - persistent_start +
+               s * sizeof(int),
+           sizeof(int));
+    if (tensor_offset != tensor_offsets_[s] ||
+        operator_offset != operator_offsets_[s]) {
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "Snapshot was saved for a different model.");
+      return kTfLiteError;
+    }
+  }
+
+  memcpy(arena + persistent_start, persistent, header.persistent_bytes);
+  // The allocator itself was copied as part of the persistent area, rebuild it
+  // for this arena with the restored persistent size.
+  SimpleMemoryAllocator restored(arena, arena_size);
+  restored.AllocateFromTail(header.persistent_bytes, 1);
+  *memory_allocator_ = restored;
+
+  tensors_ = reinterpret_cast<TfLiteTensor*>(arena + header.tensors_offset);
+  tensor_offsets_ =
+      reinterpret_cast<int*>(arena + header.tensor_offsets_offset);
+  operator_offsets_ =
+      reinterpret_cast<int*>(arena + header.operator_offsets_offset);
+  NodeAndRegistration* output = reinterpret_cast<NodeAndRegistration*>(
+      arena + header.node_and_registrations_offset);
+  scratch_buffer_count_ = header.scratch_buffer_count;
+  scratch_buffers_ = scratch_buffer_count_ == 0
+                         ? nullptr
+                         : reinterpret_cast<uint8_t**>(
+                               arena + header.scratch_buffers_offset);
+  compressed_tensor_use_count_ = header.compressed_tensor_use_count;
+  compressed_tensor_uses_ =
+      compressed_tensor_use_count_ == 0
+          ? nullptr
+          : reinterpret_cast<internal::CompressedTensorUse*>(
+                arena + header.compressed_tensor_uses_offset);
+  operator_order_ =
+      header.operator_order_offset == 0
+          ? nullptr
+          : reinterpret_cast<int*>(arena + header.operator_order_offset);
+  patch_plans_ =
+      header.patch_plans_offset == 0
+          ? nullptr
+          : reinterpret_cast<PatchPlan*>(arena + header.patch_plans_offset);
+  patch_plan_count_ = header.patch_plan_count;
+  activation_bytes_ = header.activation_bytes;
+
+  SnapshotRelocator relocator(header, arena, model_);
+  if (relocator.IsNeeded()) {
+    for (uint32_t i = 0; i < header.tensors_size; ++i) {
+      RelocateTensor(relocator, &tensors_[i]);
+    }
+    for (uint32_t i = 0; i < header.operators_size; ++i) {
+      RelocateNode(relocator, &output[i].node);
+    }
+    for (size_t i = 0; i < scratch_buffer_count_; ++i) {
+      relocator.Arena(&scratch_buffers_[i]);
+    }
+    for (size_t i = 0; i < compressed_tensor_use_count_; ++i) {
+      internal::CompressedTensorUse* use = &compressed_tensor_uses_[i];
+      relocator.Arena(&use->tensor);
+      relocator.ArenaOrModel(&use->compressed.indices);
+      relocator.ArenaOrModel(&use->compressed.palette);
+    }
+  }
+
+  auto* opcodes = model_->operator_codes();
+  for (size_t s = 0; s < subgraphs_size(); ++s) {
+    const auto* operators = subgraphs_->Get(s)->operators();
+    for (size_t i = 0; i < operators->size(); ++i) {
+      NodeAndRegistration* current = &output[operator_offsets_[s] + i];
+      const size_t position = operator_order_ == nullptr
+                                  ? i
+                                  : operator_order_[operator_offsets_[s] + i];
+      if (position >= operators->size()) {
+        TF_LITE_REPORT_ERROR(error_reporter_, "Snapshot is corrupted.");
+        return kTfLiteError;
+      }
+      const size_t index = operators->Get(position)->opcode_index();
+      if (index >= opcodes->size()) {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "Missing registration for opcode_index %d\n",
+                             index);
+        return kTfLiteError;
+      }
+      TF_LITE_ENSURE_STATUS(GetRegistrationFromOpCode(
+          (*opcodes)[index], op_resolver, error_reporter_,
+          &current->registration));
+      if (current->registration == nullptr) {
+        TF_LITE_REPORT_ERROR(error_reporter_,
+                             "Skipping op for opcode_index %d\n", index);
+        return kTfLiteError;
+      }
+    }
+  }
+
+  *node_and_registrations = output;
+  active_ = false;
+  return SetActiveSubgraph(0);
+}
+
 void* MicroAllocator::GetScratchBuffer(int buffer_idx) const {
   if (static_cast<size_t>(buffer_idx) >= scratch_buffer_count_) {
     TF_LITE_REPORT_ERROR(error_reporter_,
@@ -644,8 +2114,8 @@ void* MicroAllocator::GetScratchBuffer(int buffer_idx) const {
                          buffer_idx, scratch_buffer_count_);
     return nullptr;
   }
-  // scratch_buffer_handles_ is in reverse order.
-  return scratch_buffer_handles_[scratch_buffer_count_ - buffer_idx - 1].data;
+  // scratch_buffers_ is in reverse order.
+  return scratch_buffers_[scratch_buffer_count_ - buffer_idx - 1];
 }
 
 }  // namespace tflite
@@ -18,7 +18,10 @@ limitations under the License.
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/core/api/error_reporter.h"
 #include "tensorflow/lite/core/api/flatbuffer_conversions.h"
+#include "tensorflow/lite/micro/compressed_weights.h"
+#include "tensorflow/lite/micro/patch_execution.h"
 #include "tensorflow/lite/micro/simple_memory_allocator.h"
+#include "tensorflow/lite/micro/spare_buffers.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 
 namespace tflite {
@@ -34,14 +37,9 @@ TfLiteStatus InitializeRuntimeTensor(
     ErrorReporter* error_reporter, TfLiteTensor* result);
 
 // A handle tracking scratch buffer allocation. This handle is created by
-// `RequestScratchBufferInArena`. `data` field is populated in
-// `FinishTensorAllocation` after static memory planning.
-// TODO(b/150257460) As a future optimization, this struct could be replaced by
-// a union, since once `data` is populated, `bytes` and `node_idx` is not
-// needed.
+// `RequestScratchBufferInArena` and only lives until the memory plan is made
+// in `FinishTensorAllocation`, which keeps just the planned addresses.
 typedef struct {
-  // Pointer to the scratch buffer.
-  uint8_t* data;
   // Number of bytes required by the buffer. The actual allocated size might be
   // greater than `bytes` due to buffer alignment.
   size_t bytes;
@@ -50,6 +48,16 @@ typedef struct {
   // have `before` = node_idx and `after` = node_idx.
   int node_idx;
 } ScratchBufferHandle;
+
+// An operator reading a compressed constant tensor, see compressed_weights.h.
+// The tensor is expanded into its arena buffer before the operator runs.
+typedef struct {
+  int node_idx;
+  // Set if the kernel expands the tensor itself.
+  bool claimed;
+  TfLiteTensor* tensor;
+  CompressedTensor compressed;
+} CompressedTensorUse;
 }  // namespace internal
 
 typedef struct {
@@ -60,6 +68,17 @@ typedef struct {
 // Allocator responsible for allocating memory for all intermediate tensors
 // necessary to invoke a model.
 
+// All subgraphs of the model share one arena. Their runtime tensors and nodes
+// are stored back to back, and their activations are planned on one timeline
+// where subgraph N starts after the last operator of subgraph N-1. Subgraphs
+// that don't run at the same time therefore reuse the same activation memory.
+// The inputs of subgraph N are kept apart from the outputs of subgraph N-1,
+// so the outputs of subgraph N-1 can be copied into them and stay valid until
+// subgraph N is invoked. Outputs of any other subgraph may be overwritten as
+// soon as the inputs of subgraph N are written. Models with several subgraphs
+// must not contain IF or WHILE, which run a subgraph while the tensors of
+// their caller are live; AllocateTensors fails for them.
+
 // Memory layout to help understand how it works
 // This information could change in the future version.
 // ************** .memory_allocator->GetBuffer()
@@ -82,14 +101,22 @@ class MicroAllocator {
                  ErrorReporter* error_reporter);
 
   // Runs through the model and allocates all necessary input, output and
-  // intermediate tensors.
+  // intermediate tensors. Bookkeeping that was only needed until the plan is
+  // made is given back to the arena first. With TF_LITE_PATCH_EXECUTION and
+  // TF_LITE_FUSE_OPERATORS, some operators may be planned to run in strips,
+  // see GetPatchPlans().
   // WARNING: doing any allocation after calling this method has the risk of
   // corrupting tensor data so this method should be the last non-const method
   // called in this class.
-  TfLiteStatus FinishTensorAllocation();
+  TfLiteStatus FinishTensorAllocation(
+      const NodeAndRegistration* node_and_registrations);
 
   // Run through the model to allocate nodes and registrations. We need to keep
   // them for the entire life time of the model to allow persistent tensors.
+  // The nodes of all subgraphs are returned in one array, see
+  // GetOperatorOffset(), in the order they run. With
+  // TF_LITE_SCHEDULE_OPERATORS that order is chosen here to need less arena,
+  // otherwise it is the order of the model.
   // This method needs to be called before FinishTensorAllocation method.
   TfLiteStatus AllocateNodeAndRegistrations(
       const OpResolver& op_resolver,
@@ -104,15 +131,105 @@ class MicroAllocator {
   // This method only allocates a BufferHandle holding information for memory
   // planning. The buffer ptr is ready after `FinishTensorAllocation` and can
   // be retrieved by `GetScratchBuffer` method using the returned buffer_idx.
-  // Note that there should be no tail allocation between two consecutive
-  // `RequestScratchBufferInArena` calls.
+  // Persistent allocations may be made between two requests, at the cost of
+  // leaving a copy of the earlier handles in the tail.
   TfLiteStatus RequestScratchBufferInArena(int node_id, size_t bytes,
                                            int* buffer_idx);
   // Returns the pointer to the planned scratch buffer.
   void* GetScratchBuffer(int buffer_idx) const;
 
+  // Expands the compressed tensors read by operator `node_idx`, in the
+  // numbering of GetOperatorOffset(), into their arena buffers.
+  void DecompressInputs(int node_idx) const;
+
+  // Marks `tensor` as expanded by the kernel of operator `node_idx`, if that
+  // is the only operator reading it. See compressed_weights.h.
+  bool ClaimCompressedTensor(int node_idx, const TfLiteTensor* tensor);
+  const CompressedTensor* GetCompressedTensor(
+      const TfLiteTensor* tensor) const;
+
+  // Queues `buffer` to be allocated by FinishTensorAllocation if the arena
+  // has room for it. See spare_buffers.h.
+  void RequestSpareBuffer(size_t bytes, SpareBuffer* buffer);
+
+  // Spare buffers leave at least `bytes` at the start of the arena to the
+  // memory plan, even if it is smaller, e.g. for the activations of other
+  // models sharing the arena. Set before FinishTensorAllocation.
+  void ReserveActivationBytes(size_t bytes) {
+    reserved_activation_bytes_ = bytes;
+  }
+
+  // Number of subgraphs in the model.
+  size_t subgraphs_size() const { return subgraphs_->size(); }
+
+  // Points context->tensors at the runtime tensors of `subgraph_idx`. Tensor
+  // indices in nodes are local to their subgraph, so this has to be called
+  // before running kernels of a subgraph. Subgraph 0 is active after
+  // construction.
+  TfLiteStatus SetActiveSubgraph(int subgraph_idx);
+
+  // Runtime tensor `tensor_idx` of subgraph `subgraph_idx`, independent of
+  // the active subgraph.
+  TfLiteTensor* GetTensor(int subgraph_idx, int tensor_idx) const {
+    return &tensors_[tensor_offsets_[subgraph_idx] + tensor_idx];
+  }
+
+  // Index of the first operator of `subgraph_idx` in the node and
+  // registration array. Node indices passed to RequestScratchBufferInArena are
+  // in the same global numbering.
+  int GetOperatorOffset(int subgraph_idx) const {
+    return operator_offsets_[subgraph_idx];
+  }
+
+  // Total number of operators across all subgraphs.
+  int GetOperatorCount() const { return operator_offsets_[subgraphs_size()]; }
+
+  // Bytes taken from the end of the arena for persistent data, including the
+  // allocator itself. Only final once FinishTensorAllocation has returned.
+  size_t GetPersistentBytes() const { return memory_allocator_->GetDataSize(); }
+
+  // Bytes at the start of the (aligned) arena used by the memory plan for
+  // activations and scratch buffers. Set by FinishTensorAllocation.
+  size_t GetActivationBytes() const { return activation_bytes_; }
+
+  // The chains of operators that have to run in strips, because the tensors
+  // inside them only have room for one strip, ordered by their first node.
+  // See patch_execution.h.
+  const PatchPlan* GetPatchPlans() const { return patch_plans_; }
+  int GetPatchPlanCount() const { return patch_plan_count_; }
+
+  // Snapshots capture the persistent area after FinishTensorAllocation:
+  // runtime tensors, quantization parameters, nodes, builtin data, scratch
+  // buffer addresses, compressed tensors, the operator order, the patch plans,
+  // variables and persistent buffers of kernels. Restoring one replaces
+  // AllocateNodeAndRegistrations, the kernels' Init and Prepare and
+  // FinishTensorAllocation.
+  //
+  // The snapshot may be restored into an arena at another address and with
+  // the model at another address, pointers are relocated. The model, the
+  // aligned arena size and the firmware have to be the same. Persistent
+  // buffers of kernels are copied as they are, so they must not hold pointers
+  // into the arena.
+
+  // Size of the buffer needed by SaveSnapshot.
+  size_t GetSnapshotSize() const;
+
+  TfLiteStatus SaveSnapshot(const NodeAndRegistration* node_and_registrations,
+                            uint8_t* buffer, size_t buffer_size) const;
+
+  // Has to be called on a freshly constructed allocator. Registrations are
+  // looked up again in `op_resolver`, since they live outside the arena.
+  // Snapshots with a wrong checksum, or arrays outside of their persistent
+  // area, are rejected before the arena is written.
+  TfLiteStatus RestoreSnapshot(const OpResolver& op_resolver,
+                               const uint8_t* snapshot, size_t snapshot_size,
+                               NodeAndRegistration** node_and_registrations);
+
  private:
   TfLiteStatus Init();
+  TfLiteStatus InitializeCompressedTensors();
+  // Fills operator_order_, see operator_scheduler.h.
+  TfLiteStatus ScheduleOperators(int max_steps);
 
   const Model* model_;
   SimpleMemoryAllocator* memory_allocator_;
@@ -123,14 +240,38 @@ class MicroAllocator {
 
   // In reverse order for efficiency.
   // i.e. scratch_buffer_handles_[0] is the handle for the last buffer,
-  // corresponding to the last RequestScratchBufferInArena call.
+  // corresponding to the last RequestScratchBufferInArena call. Released by
+  // FinishTensorAllocation.
   internal::ScratchBufferHandle* scratch_buffer_handles_ = nullptr;
+  // Planned addresses of the scratch buffers, same order as the handles.
+  uint8_t** scratch_buffers_ = nullptr;
   // How many scratch buffers have been allocated.
   size_t scratch_buffer_count_ = 0;
+  // Operators reading compressed tensors, sorted by node_idx.
+  internal::CompressedTensorUse* compressed_tensor_uses_ = nullptr;
+  size_t compressed_tensor_use_count_ = 0;
+  // High-water mark of the memory plan.
+  size_t activation_bytes_ = 0;
+  // Spare buffers in the order they were requested. Released by
+  // FinishTensorAllocation.
+  SpareBuffer* spare_buffers_ = nullptr;
+  SpareBuffer* last_spare_buffer_ = nullptr;
+  size_t reserved_activation_bytes_ = 0;
 
-  const SubGraph* subgraph_;
-  const flatbuffers::Vector<flatbuffers::Offset<Operator>>* operators_;
-  const flatbuffers::Vector<flatbuffers::Offset<Tensor>>* tensors_;
+  const flatbuffers::Vector<flatbuffers::Offset<SubGraph>>* subgraphs_;
+  // Runtime tensors of all subgraphs, subgraph N starts at
+  // tensors_[tensor_offsets_[N]].
+  TfLiteTensor* tensors_ = nullptr;
+  // Both have subgraphs_size() + 1 entries, the last one being the total.
+  int* tensor_offsets_ = nullptr;
+  int* operator_offsets_ = nullptr;
+  // With TF_LITE_SCHEDULE_OPERATORS, node i runs operator operator_order_[i]
+  // of its subgraph. Null if the nodes are in model order.
+  int* operator_order_ = nullptr;
+  // Set by FinishTensorAllocation with TF_LITE_PATCH_EXECUTION or
+  // TF_LITE_FUSE_OPERATORS.
+  PatchPlan* patch_plans_ = nullptr;
+  int patch_plan_count_ = 0;
 };
 
 }  // namespace tflite
@@ -14,6 +14,9 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/lite/micro/micro_interpreter.h"
 
+#include <cmath>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/core/api/flatbuffer_conversions.h"
 #include "tensorflow/lite/core/api/tensor_utils.h"
@@ -41,6 +44,79 @@ const char* OpNameFromRegistration(const TfLiteRegistration* registration) {
   }
 }
 
+// Keeps the indices of the k largest values seen so far in `classes`, sorted
+// from largest to smallest. Earlier classes win ties, like in ARG_MAX.
+template <typename T>
+void SelectTopK(const T* logits, int size, int k, int* classes) {
+  int found = 0;
+  for (int i = 0; i < size; ++i) {
+    int position = found;
+    while (position > 0 && logits[i] > logits[classes[position - 1]]) {
+      --position;
+    }
+    if (position >= k) {
+      continue;
+    }
+    if (found < k) {
+      ++found;
+    }
+    for (int j = found - 1; j > position; --j) {
+      classes[j] = classes[j - 1];
+    }
+    classes[position] = i;
+  }
+}
+
+// Softmax probability of class `top`, with the input scale folded into
+// `beta`. Zero points cancel out.
+template <typename T>
+float SoftmaxOfClass(const T* logits, int size, int top, float beta) {
+  const float top_logit = static_cast<float>(logits[top]);
+  float sum = 0.f;
+  for (int i = 0; i < size; ++i) {
+    sum += std::exp(beta * (static_cast<float>(logits[i]) - top_logit));
+  }
+  return 1.f / sum;
+}
+
+// A tensor of batch 1 that InvokePatches() swaps for views of some of its
+// rows.
+struct RowView {
+  void Init(TfLiteTensor* viewed) {
+    tensor = viewed;
+    data = viewed->data.uint8;
+    dims = viewed->dims;
+    bytes = viewed->bytes;
+    view_dims[0] = 4;
+    for (int d = 0; d < 4; ++d) {
+      view_dims[d + 1] = dims->data[d];
+    }
+  }
+
+  // Shows rows [first_row, last_row), either at their place in the tensor or
+  // at the start of its buffer.
+  void Set(int first_row, int last_row, bool in_place) {
+    const size_t row_bytes = bytes / dims->data[1];
+    view_dims[2] = last_row - first_row;
+    tensor->dims = reinterpret_cast<TfLiteIntArray*>(view_dims);
+    tensor->bytes = (last_row - first_row) * row_bytes;
+    tensor->data.uint8 = data + (in_place ? first_row * row_bytes : 0);
+  }
+
+  void Restore() {
+    tensor->data.uint8 = data;
+    tensor->dims = dims;
+    tensor->bytes = bytes;
+  }
+
+  TfLiteTensor* tensor;
+  uint8_t* data;
+  TfLiteIntArray* dims;
+  size_t bytes;
+  // TfLiteIntArray of 4 dimensions.
+  int view_dims[5];
+};
+
 }  // namespace
 
 namespace internal {
@@ -89,12 +165,13 @@ MicroInterpreter::MicroInterpreter(const Model* model,
       context_helper_(error_reporter_, &allocator_) {
   const flatbuffers::Vector<flatbuffers::Offset<SubGraph>>* subgraphs =
       model->subgraphs();
-  if (subgraphs->size() != 1) {
-    TF_LITE_REPORT_ERROR(error_reporter,
-                         "Only 1 subgraph is currently supported.\n");
+  if (subgraphs->size() < 1) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Model has no subgraphs.\n");
     initialization_status_ = kTfLiteError;
     return;
   }
+  // Subgraph 0 is the one run by Invoke() and addressed by input(), output()
+  // and tensor().
   subgraph_ = (*subgraphs)[0];
   tensors_ = subgraph_->tensors();
   operators_ = subgraph_->operators();
@@ -109,10 +186,12 @@ MicroInterpreter::MicroInterpreter(const Model* model,
   // NOTE: This requires that the flatbuffer is held in memory which can be
   // modified by this process.
   if (!FLATBUFFERS_LITTLEENDIAN) {
-    for (size_t t = 0; t < tensors_size(); ++t) {
-      TfLiteTensor* thisTensor = &context_.tensors[t];
-      if (thisTensor->allocation_type == kTfLiteMmapRo)
-        CorrectTensorEndianness(thisTensor);
+    for (size_t s = 0; s < subgraphs->size(); ++s) {
+      for (size_t t = 0; t < subgraphs->Get(s)->tensors()->size(); ++t) {
+        TfLiteTensor* thisTensor = allocator_.GetTensor(s, t);
+        if (thisTensor->allocation_type == kTfLiteMmapRo)
+          CorrectTensorEndianness(thisTensor);
+      }
     }
   }
 
@@ -129,7 +208,7 @@ MicroInterpreter::MicroInterpreter(const Model* model,
 
 MicroInterpreter::~MicroInterpreter() {
   if (node_and_registrations_ != nullptr) {
-    for (size_t i = 0; i < operators_->size(); ++i) {
+    for (int i = 0; i < allocator_.GetOperatorCount(); ++i) {
       TfLiteNode* node = &(node_and_registrations_[i].node);
       const TfLiteRegistration* registration =
           node_and_registrations_[i].registration;
@@ -188,22 +267,28 @@ TfLiteStatus MicroInterpreter::AllocateTensors() {
   context_.RequestScratchBufferInArena = nullptr;
   context_.GetScratchBuffer = nullptr;
 
-  for (size_t i = 0; i < operators_->size(); ++i) {
-    context_helper_.SetNodeIndex(i);
-    auto* node = &(node_and_registrations_[i].node);
-    auto* registration = node_and_registrations_[i].registration;
-    size_t init_data_size;
-    const char* init_data;
-    if (registration->builtin_code == BuiltinOperator_CUSTOM) {
-      init_data = reinterpret_cast<const char*>(node->custom_initial_data);
-      init_data_size = node->custom_initial_data_size;
-    } else {
-      init_data = reinterpret_cast<const char*>(node->builtin_data);
-      init_data_size = 0;
-    }
-    if (registration->init) {
-      node->user_data =
-          registration->init(&context_, init_data, init_data_size);
+  // Nodes of all subgraphs are stored back to back, so `i` is a global node
+  // index. Kernels address tensors relative to their own subgraph.
+  for (size_t s = 0; s < subgraphs_size(); ++s) {
+    TF_LITE_ENSURE_OK(&context_, allocator_.SetActiveSubgraph(s));
+    for (int i = allocator_.GetOperatorOffset(s);
+         i < allocator_.GetOperatorOffset(s + 1); ++i) {
+      context_helper_.SetNodeIndex(i);
+      auto* node = &(node_and_registrations_[i].node);
+      auto* registration = node_and_registrations_[i].registration;
+      size_t init_data_size;
+      const char* init_data;
+      if (registration->builtin_code == BuiltinOperator_CUSTOM) {
+        init_data = reinterpret_cast<const char*>(node->custom_initial_data);
+        init_data_size = node->custom_initial_data_size;
+      } else {
+        init_data = reinterpret_cast<const char*>(node->builtin_data);
+        init_data_size = 0;
+      }
+      if (registration->init) {
+        node->user_data =
+            registration->init(&context_, init_data, init_data_size);
+      }
     }
   }
   context_helper_.SetNodeIndex(-1);
@@ -212,23 +297,28 @@ TfLiteStatus MicroInterpreter::AllocateTensors() {
   // in Prepare stage.
   context_.RequestScratchBufferInArena =
       context_helper_.RequestScratchBufferInArena;
-  for (size_t i = 0; i < operators_->size(); ++i) {
-    // Set node idx to annotate the lifetime for scratch buffers.
-    context_helper_.SetNodeIndex(i);
-    auto* node = &(node_and_registrations_[i].node);
-    auto* registration = node_and_registrations_[i].registration;
-    if (registration->prepare) {
-      TfLiteStatus prepare_status = registration->prepare(&context_, node);
-      if (prepare_status != kTfLiteOk) {
-        TF_LITE_REPORT_ERROR(
-            error_reporter_,
-            "Node %s (number %df) failed to prepare with status %d",
-            OpNameFromRegistration(registration), i, prepare_status);
-        return kTfLiteError;
+  for (size_t s = 0; s < subgraphs_size(); ++s) {
+    TF_LITE_ENSURE_OK(&context_, allocator_.SetActiveSubgraph(s));
+    for (int i = allocator_.GetOperatorOffset(s);
+         i < allocator_.GetOperatorOffset(s + 1); ++i) {
+      // Set node idx to annotate the lifetime for scratch buffers.
+      context_helper_.SetNodeIndex(i);
+      auto* node = &(node_and_registrations_[i].node);
+      auto* registration = node_and_registrations_[i].registration;
+      if (registration->prepare) {
+        TfLiteStatus prepare_status = registration->prepare(&context_, node);
+        if (prepare_status != kTfLiteOk) {
+          TF_LITE_REPORT_ERROR(
+              error_reporter_,
+              "Node %s (number %df) failed to prepare with status %d",
+              OpNameFromRegistration(registration), i, prepare_status);
+          return kTfLiteError;
+        }
       }
     }
   }
   context_helper_.SetNodeIndex(-1);
+  TF_LITE_ENSURE_OK(&context_, allocator_.SetActiveSubgraph(0));
 
   // Prepare is done, we're ready for Invoke. Memory allocation is no longer
   // allowed. Kernels can only fetch scratch buffers via GetScratchBuffer.
@@ -236,11 +326,150 @@ TfLiteStatus MicroInterpreter::AllocateTensors() {
   context_.RequestScratchBufferInArena = nullptr;
   context_.GetScratchBuffer = context_helper_.GetScratchBuffer;
 
-  TF_LITE_ENSURE_OK(&context_, allocator_.FinishTensorAllocation());
+  TF_LITE_ENSURE_OK(&context_,
+                    allocator_.FinishTensorAllocation(node_and_registrations_));
+  tensors_allocated_ = true;
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroInterpreter::SaveSnapshot(uint8_t* buffer,
+                                            size_t buffer_size) {
+  if (!tensors_allocated_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "SaveSnapshot() called before AllocateTensors()\n");
+    return kTfLiteError;
+  }
+  return allocator_.SaveSnapshot(node_and_registrations_, buffer, buffer_size);
+}
+
+TfLiteStatus MicroInterpreter::RestoreSnapshot(const uint8_t* snapshot,
+                                               size_t snapshot_size) {
+  if (initialization_status_ != kTfLiteOk || tensors_allocated_) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "RestoreSnapshot() needs a freshly initialized "
+                         "interpreter\n");
+    return kTfLiteError;
+  }
+  TF_LITE_ENSURE_OK(&context_, allocator_.RestoreSnapshot(
+                                   op_resolver_, snapshot, snapshot_size,
+                                   &node_and_registrations_));
+
+  // Same state as at the end of AllocateTensors().
+  context_.AllocatePersistentBuffer = nullptr;
+  context_.RequestScratchBufferInArena = nullptr;
+  context_.GetScratchBuffer = context_helper_.GetScratchBuffer;
   tensors_allocated_ = true;
   return kTfLiteOk;
 }
-TfLiteStatus MicroInterpreter::Invoke() {
+
+TfLiteStatus MicroInterpreter::Invoke() { return InvokeSubgraph(0); }
+
+TfLiteStatus MicroInterpreter::InvokeSubgraph(size_t subgraph_index) {
+  return InvokeNodes(subgraph_index, -1);
+}
+
+TfLiteStatus MicroInterpreter::InvokeTopK(int k, int* classes,
+                                          float* top_confidence) {
+  if (!tensors_allocated_) {
+    TF_LITE_ENSURE_STATUS(AllocateTensors());
+  }
+  if (outputs_size() != 1) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "InvokeTopK() needs a model with one output.");
+    return kTfLiteError;
+  }
+
+  // Walk back from the output over the operators that don't change the order
+  // of the classes, up to the SOFTMAX.
+  int tensor_index = outputs().Get(0);
+  int softmax_node = -1;
+  for (int i = allocator_.GetOperatorOffset(1) - 1; i >= 0; --i) {
+    const TfLiteNode& node = node_and_registrations_[i].node;
+    const int32_t op = node_and_registrations_[i].registration->builtin_code;
+    if (node.outputs->size != 1 || node.outputs->data[0] != tensor_index) {
+      break;
+    }
+    tensor_index = node.inputs->data[0];
+    if (op == BuiltinOperator_SOFTMAX) {
+      softmax_node = i;
+      break;
+    }
+    if (op != BuiltinOperator_DEQUANTIZE && op != BuiltinOperator_ARG_MAX) {
+      break;
+    }
+  }
+  if (softmax_node < 0) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "InvokeTopK() needs a model ending in SOFTMAX.");
+    return kTfLiteError;
+  }
+  const float beta = static_cast<const TfLiteSoftmaxParams*>(
+                         node_and_registrations_[softmax_node].node.builtin_data)
+                         ->beta;
+  const TfLiteTensor* logits = allocator_.GetTensor(0, tensor_index);
+  const int size = logits->dims->size > 0
+                       ? logits->dims->data[logits->dims->size - 1]
+                       : 1;
+  int elements = 1;
+  for (int i = 0; i < logits->dims->size; ++i) {
+    elements *= logits->dims->data[i];
+  }
+  if (beta <= 0.f || elements != size || k < 1 || k > size) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "InvokeTopK() needs a single batch of at least %d "
+                         "classes and a positive softmax beta.",
+                         k);
+    return kTfLiteError;
+  }
+
+  TfLiteStatus status = InvokeNodes(0, softmax_node);
+  if (status != kTfLiteOk) {
+    return status;
+  }
+
+  float confidence = 0.f;
+  switch (logits->type) {
+    case kTfLiteFloat32:
+      SelectTopK(logits->data.f, size, k, classes);
+      if (top_confidence != nullptr) {
+        confidence = SoftmaxOfClass(logits->data.f, size, classes[0], beta);
+      }
+      break;
+    case kTfLiteInt8:
+      SelectTopK(logits->data.int8, size, k, classes);
+      if (top_confidence != nullptr) {
+        confidence = SoftmaxOfClass(logits->data.int8, size, classes[0],
+                                    beta * logits->params.scale);
+      }
+      break;
+    case kTfLiteUInt8:
+      SelectTopK(logits->data.uint8, size, k, classes);
+      if (top_confidence != nullptr) {
+        confidence = SoftmaxOfClass(logits->data.uint8, size, classes[0],
+                                    beta * logits->params.scale);
+      }
+      break;
+    case kTfLiteInt16:
+      SelectTopK(logits->data.i16, size, k, classes);
+      if (top_confidence != nullptr) {
+        confidence = SoftmaxOfClass(logits->data.i16, size, classes[0],
+                                    beta * logits->params.scale);
+      }
+      break;
+    default:
+      TF_LITE_REPORT_ERROR(error_reporter_,
+                           "InvokeTopK() does not support %s logits.",
+                           TfLiteTypeGetName(logits->type));
+      return kTfLiteError;
+  }
+  if (top_confidence != nullptr) {
+    *top_confidence = confidence;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroInterpreter::InvokeNodes(size_t subgraph_index,
+                                           int nodes_size) {
   if (initialization_status_ != kTfLiteOk) {
     TF_LITE_REPORT_ERROR(error_reporter_,
                          "Invoke() called after initialization failed\n");
@@ -259,7 +488,20 @@ TfLiteStatus MicroInterpreter::Invoke() {
     AllocateTensors();
   }
 
-  for (size_t i = 0; i < operators_->size(); ++i) {
+  TF_LITE_ENSURE_OK(&context_, allocator_.SetActiveSubgraph(subgraph_index));
+  const int first_node = allocator_.GetOperatorOffset(subgraph_index);
+  const int last_node =
+      nodes_size < 0 ? allocator_.GetOperatorOffset(subgraph_index + 1)
+                     : first_node + nodes_size;
+  TfLiteStatus status = kTfLiteOk;
+  // The tensors inside a patched prefix or a pair of fused operators are too
+  // small to run their operators one after the other.
+  const PatchPlan* patches = allocator_.GetPatchPlans();
+  const PatchPlan* patches_end = patches + allocator_.GetPatchPlanCount();
+  while (patches != patches_end && patches->first_node < first_node) {
+    ++patches;
+  }
+  for (int i = first_node; i < last_node && status == kTfLiteOk; ++i) {
     #ifdef BENCHMARK_LAYERS
       benchmark_layers.start();
       #ifdef ENERGY_MEASUREMENT
@@ -267,8 +509,23 @@ TfLiteStatus MicroInterpreter::Invoke() {
       #endif // ENERGY_MEASUREMENT
     #endif // BENCHMARK_LAYERS
 
+    if (patches != patches_end && patches->first_node == i) {
+      status = InvokePatches(subgraph_index, *patches);
+      #ifdef BENCHMARK_LAYERS
+        benchmark_layers.stop();
+        #ifndef NO_REPORTING
+          TF_LITE_REPORT_ERROR(error_reporter_, "\t\tLayer_%d-%d_patches\n\t\t%u", i, i + patches->operators - 1, benchmark_layers.read());
+        #endif
+        benchmark_layers.clear();
+      #endif // BENCHMARK_LAYERS
+      i += patches->operators - 1;
+      ++patches;
+      continue;
+    }
+
     auto* node = &(node_and_registrations_[i].node);
     auto* registration = node_and_registrations_[i].registration;
+    allocator_.DecompressInputs(i);
 
     if (registration->invoke) {
       TfLiteStatus invoke_status = registration->invoke(&context_, node);
@@ -292,10 +549,8 @@ TfLiteStatus MicroInterpreter::Invoke() {
             error_reporter_,
             "Node %s (number %d) failed to invoke with status %d",
             OpNameFromRegistration(registration), i, invoke_status);
-        return kTfLiteError;
-      } else if (invoke_status != kTfLiteOk) {
-        return invoke_status;
       }
+      status = invoke_status;
     }
   }
   #ifdef BENCHMARK_LAYERS
@@ -303,36 +558,122 @@ TfLiteStatus MicroInterpreter::Invoke() {
      layer_gpio = 0;
     #endif // ENERGY_MEASUREMENT
   #endif // BENCHMARK_LAYERS
-  return kTfLiteOk;
+
+  // Keep tensor() and the kernels' view consistent with subgraph 0 between
+  // invocations.
+  allocator_.SetActiveSubgraph(0);
+  return status;
+}
+
+TfLiteStatus MicroInterpreter::InvokePatches(size_t subgraph_index,
+                                             const PatchPlan& plan) {
+  // The tensors of the chain are swapped for views of the rows of one strip:
+  // the input and output of the chain and the side inputs in place, the
+  // tensors in between at the start of their buffers. Views 0 to `operators`
+  // are the tensors of the chain, the others the side inputs. A side input
+  // may also be the input of the chain, so views are set before each use.
+  const int operators = plan.operators;
+  RowView views[2 * kMaxPatchOperators + 1];
+  int views_size = operators + 1;
+  int side_views[kMaxPatchOperators];
+  for (int i = 0; i <= operators; ++i) {
+    views[i].Init(allocator_.GetTensor(subgraph_index, plan.tensors[i]));
+  }
+  for (int i = 0; i < operators; ++i) {
+    side_views[i] = -1;
+    if (plan.side_tensors[i] >= 0) {
+      side_views[i] = views_size++;
+      views[side_views[i]].Init(
+          allocator_.GetTensor(subgraph_index, plan.side_tensors[i]));
+    }
+  }
+
+  int first[kMaxPatchOperators + 1];
+  int last[kMaxPatchOperators + 1];
+  TfLiteStatus status = kTfLiteOk;
+  for (int row = 0; row < plan.heights[operators] && status == kTfLiteOk;
+       row += plan.output_rows) {
+    GetPatchRows(plan, row, first, last);
+    for (int i = 0; i <= operators; ++i) {
+      views[i].Set(first[i], last[i], i == 0 || i == operators);
+    }
+    for (int i = 0; i < operators && status == kTfLiteOk; ++i) {
+      const int node_index = plan.first_node + i;
+      auto* node = &(node_and_registrations_[node_index].node);
+      auto* registration = node_and_registrations_[node_index].registration;
+      if (side_views[i] >= 0) {
+        views[side_views[i]].Set(first[i + 1], last[i + 1], true);
+      }
+      context_helper_.SetPatchRows(first[i], first[i + 1]);
+      allocator_.DecompressInputs(node_index);
+      status = registration->invoke(&context_, node);
+      if (status == kTfLiteError) {
+        TF_LITE_REPORT_ERROR(
+            error_reporter_,
+            "Node %s (number %d) failed to invoke with status %d",
+            OpNameFromRegistration(registration), node_index, status);
+      }
+    }
+  }
+  context_helper_.SetPatchRows(0, 0);
+
+  for (int i = 0; i < views_size; ++i) {
+    views[i].Restore();
+  }
+  return status;
 }
 
 TfLiteTensor* MicroInterpreter::input(size_t index) {
-  const flatbuffers::Vector<int32_t>* inputs = subgraph_->inputs();
+  return subgraph_input(0, index);
+}
+
+TfLiteTensor* MicroInterpreter::output(size_t index) {
+  return subgraph_output(0, index);
+}
+
+TfLiteTensor* MicroInterpreter::subgraph_input(size_t subgraph_index,
+                                               size_t index) {
+  if (subgraph_index >= subgraphs_size()) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Subgraph index %d out of range (length is %d)",
+                         subgraph_index, subgraphs_size());
+    return nullptr;
+  }
+  const flatbuffers::Vector<int32_t>* inputs =
+      model_->subgraphs()->Get(subgraph_index)->inputs();
   const size_t length = inputs->size();
-  if ((index < 0) || (index >= length)) {
+  if (index >= length) {
     TF_LITE_REPORT_ERROR(error_reporter_,
                          "Input index %d out of range (length is %d)", index,
                          length);
     return nullptr;
   }
-  return &(context_.tensors[inputs->Get(index)]);
+  return allocator_.GetTensor(subgraph_index, inputs->Get(index));
 }
 
-TfLiteTensor* MicroInterpreter::output(size_t index) {
-  const flatbuffers::Vector<int32_t>* outputs = subgraph_->outputs();
+TfLiteTensor* MicroInterpreter::subgraph_output(size_t subgraph_index,
+                                                size_t index) {
+  if (subgraph_index >= subgraphs_size()) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "Subgraph index %d out of range (length is %d)",
+                         subgraph_index, subgraphs_size());
+    return nullptr;
+  }
+  const flatbuffers::Vector<int32_t>* outputs =
+      model_->subgraphs()->Get(subgraph_index)->outputs();
   const size_t length = outputs->size();
-  if ((index < 0) || (index >= outputs->size())) {
+  if (index >= length) {
     TF_LITE_REPORT_ERROR(error_reporter_,
                          "Output index %d out of range (length is %d)", index,
                          length);
     return nullptr;
   }
-  return &(context_.tensors[outputs->Get(index)]);
+  return allocator_.GetTensor(subgraph_index, outputs->Get(index));
 }
 
 TfLiteTensor* MicroInterpreter::tensor(size_t index) {
   const size_t length = tensors_size();
-  if ((index < 0) || (index >= tensors_size())) {
+  if (index >= length) {
     TF_LITE_REPORT_ERROR(error_reporter_,
                          "Tensor index %d out of range (length is %d)", index,
                          length);
@@ -342,15 +683,18 @@ TfLiteTensor* MicroInterpreter::tensor(size_t index) {
 }
 
 TfLiteStatus MicroInterpreter::ResetVariableTensors() {
-  const size_t length = tensors_size();
-  for (size_t i = 0; i < length; ++i) {
-    TfLiteTensor* cur_tensor = tensor(i);
-    if (cur_tensor->is_variable) {
-      TfLiteStatus status = tflite::ResetVariableTensor(cur_tensor);
-      if (status != kTfLiteOk) {
-        TF_LITE_REPORT_ERROR(error_reporter_,
-                             "Failed to reset variable tensor at index: %d", i);
-        return status;
+  for (size_t s = 0; s < subgraphs_size(); ++s) {
+    const size_t length = model_->subgraphs()->Get(s)->tensors()->size();
+    for (size_t i = 0; i < length; ++i) {
+      TfLiteTensor* cur_tensor = allocator_.GetTensor(s, i);
+      if (cur_tensor->is_variable) {
+        TfLiteStatus status = tflite::ResetVariableTensor(cur_tensor);
+        if (status != kTfLiteOk) {
+          TF_LITE_REPORT_ERROR(
+              error_reporter_,
+              "Failed to reset variable tensor %d of subgraph %d", i, s);
+          return status;
+        }
       }
     }
   }
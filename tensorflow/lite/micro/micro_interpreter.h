@@ -50,10 +50,39 @@ class ContextHelper {
 
   void SetNodeIndex(int idx) { current_node_idx_ = idx; }
 
+  // See compressed_weights.h.
+  bool ClaimCompressedTensor(const TfLiteTensor* tensor) {
+    return allocator_->ClaimCompressedTensor(current_node_idx_, tensor);
+  }
+  const CompressedTensor* GetCompressedTensor(
+      const TfLiteTensor* tensor) const {
+    return allocator_->GetCompressedTensor(tensor);
+  }
+
+  // See spare_buffers.h.
+  void RequestSpareBuffer(size_t bytes, SpareBuffer* buffer) {
+    allocator_->RequestSpareBuffer(bytes, buffer);
+  }
+
+  // See patch_execution.h. While a node runs on a strip, the rows of its
+  // input and output start at these rows of the full tensors.
+  void SetPatchRows(int input_row, int output_row) {
+    patch_input_row_ = input_row;
+    patch_output_row_ = output_row;
+  }
+  TfLitePaddingValues GetPatchPadding(const TfLitePaddingValues& padding,
+                                      int stride_height) const {
+    TfLitePaddingValues result = padding;
+    result.height += patch_input_row_ - patch_output_row_ * stride_height;
+    return result;
+  }
+
  private:
   MicroAllocator* allocator_;
   ErrorReporter* error_reporter_;
   int current_node_idx_ = -1;
+  int patch_input_row_ = 0;
+  int patch_output_row_ = 0;
 };
 
 }  // namespace internal
@@ -78,11 +107,51 @@ class MicroInterpreter {
   // intermediate tensors.
   TfLiteStatus AllocateTensors();
 
+  // Keeps spare buffers (see spare_buffers.h) out of the first `bytes` of the
+  // arena, even if the model's own activations need less, e.g. to leave room
+  // for other models sharing the arena. Call before AllocateTensors().
+  void ReserveActivationBytes(size_t bytes) {
+    allocator_.ReserveActivationBytes(bytes);
+  }
+
+  // Start-up shortcut for devices that reboot often: after AllocateTensors(),
+  // SaveSnapshot() copies the persistent part of the arena into `buffer`
+  // (e.g. flash or retained RAM). On the next boot, RestoreSnapshot() on a
+  // freshly constructed interpreter for the same model, op resolver and arena
+  // size replaces AllocateTensors(), skipping op lookup, builtin data parsing,
+  // the kernels' Init and Prepare and memory planning. The arena and model
+  // may be at different addresses than when the snapshot was saved.
+  // Variable tensors keep the values they had when the snapshot was saved.
+  size_t snapshot_size() const { return allocator_.GetSnapshotSize(); }
+  TfLiteStatus SaveSnapshot(uint8_t* buffer, size_t buffer_size);
+  TfLiteStatus RestoreSnapshot(const uint8_t* snapshot, size_t snapshot_size);
+
   // In order to support partial graph runs for strided models, this can return
   // values other than kTfLiteOk and kTfLiteError.
   // TODO(b/149795762): Add this to the TfLiteStatus enum.
+  // Runs subgraph 0.
   TfLiteStatus Invoke();
 
+  // Runs one subgraph of a model with several subgraphs, e.g. one head of a
+  // multi-head model. All subgraphs share the activation area of the arena,
+  // so the outputs of a subgraph have to be read before another one is
+  // invoked. Only the inputs of the next subgraph, N+1 after N, are kept
+  // apart from them, so a cascade can copy the outputs of one head into the
+  // inputs of the next.
+  TfLiteStatus InvokeSubgraph(size_t subgraph_index);
+
+  // Shortcut for classifiers that only need their best classes. If subgraph
+  // 0 ends in a SOFTMAX, optionally followed by DEQUANTIZE and/or ARG_MAX,
+  // this runs the model up to the SOFTMAX and picks the `k` largest of its
+  // input logits instead, since softmax does not change their order. The
+  // class indices are written to `classes` from best to worst. If
+  // `top_confidence` is given, it receives the softmax probability of the
+  // best class. The model output is not written. Fails for other models.
+  TfLiteStatus InvokeTopK(int k, int* classes,
+                          float* top_confidence = nullptr);
+
+  size_t subgraphs_size() const { return allocator_.subgraphs_size(); }
+
   size_t tensors_size() const { return context_.tensors_size; }
   TfLiteTensor* tensor(size_t tensor_index);
   template <class T>
@@ -127,6 +196,11 @@ class MicroInterpreter {
     return nullptr;
   }
 
+  // Inputs and outputs of an arbitrary subgraph. input() and output() refer to
+  // subgraph 0.
+  TfLiteTensor* subgraph_input(size_t subgraph_index, size_t index);
+  TfLiteTensor* subgraph_output(size_t subgraph_index, size_t index);
+
   // Reset all variable tensors to the default value.
   TfLiteStatus ResetVariableTensors();
 
@@ -134,12 +208,29 @@ class MicroInterpreter {
 
   size_t operators_size() const { return operators_->size(); }
 
+  // Arena usage after AllocateTensors(): activations and scratch buffers at
+  // the start of the arena, persistent data at its end.
+  size_t arena_activation_bytes() const {
+    return allocator_.GetActivationBytes();
+  }
+  size_t arena_persistent_bytes() const {
+    return allocator_.GetPersistentBytes();
+  }
+
   // For debugging only.
   const NodeAndRegistration node_and_registration(int node_index) const {
     return node_and_registrations_[node_index];
   }
 
  private:
+  // Runs the first `nodes_size` operators of a subgraph, or all of them if
+  // `nodes_size` is negative.
+  TfLiteStatus InvokeNodes(size_t subgraph_index, int nodes_size);
+
+  // Runs a patched prefix or a pair of fused operators one strip at a time,
+  // see patch_execution.h.
+  TfLiteStatus InvokePatches(size_t subgraph_index, const PatchPlan& plan);
+
   void CorrectTensorEndianness(TfLiteTensor* tensorCorr);
 
   template <class T>
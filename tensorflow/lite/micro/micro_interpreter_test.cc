@@ -0,0 +1,455 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/spare_buffers.h"
+#include "tensorflow/lite/micro/test_helpers.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_model_builder.h"
+
+namespace tflite {
+namespace testing {
+namespace {
+
+constexpr int kScratchBuffersPerNode = 3;
+constexpr size_t kScratchBufferBytes = 48;
+
+struct ScratchOpData {
+  int buffer_indices[kScratchBuffersPerNode];
+};
+
+// Requests several scratch buffers with persistent allocations in between,
+// like kernels that allocate their op data before asking for scratch space.
+TfLiteStatus ScratchOpPrepare(TfLiteContext* context, TfLiteNode* node) {
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(ScratchOpData), &raw));
+  ScratchOpData* data = static_cast<ScratchOpData*>(raw);
+  node->user_data = data;
+  for (int i = 0; i < kScratchBuffersPerNode; ++i) {
+    TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+        context, kScratchBufferBytes, &data->buffer_indices[i]));
+    void* unused = nullptr;
+    TF_LITE_ENSURE_STATUS(
+        context->AllocatePersistentBuffer(context, 4 * (i + 1), &unused));
+  }
+  return kTfLiteOk;
+}
+
+// Fills each scratch buffer of the node and checks that none of them was
+// overwritten by another.
+TfLiteStatus ScratchOpInvoke(TfLiteContext* context, TfLiteNode* node) {
+  const ScratchOpData* data = static_cast<ScratchOpData*>(node->user_data);
+  uint8_t* buffers[kScratchBuffersPerNode];
+  for (int i = 0; i < kScratchBuffersPerNode; ++i) {
+    buffers[i] = static_cast<uint8_t*>(
+        context->GetScratchBuffer(context, data->buffer_indices[i]));
+    TF_LITE_ENSURE(context, buffers[i] != nullptr);
+    for (size_t j = 0; j < kScratchBufferBytes; ++j) {
+      buffers[i][j] = static_cast<uint8_t>(i + 1);
+    }
+  }
+  for (int i = 0; i < kScratchBuffersPerNode; ++i) {
+    for (size_t j = 0; j < kScratchBufferBytes; ++j) {
+      TF_LITE_ENSURE_EQ(context, buffers[i][j], i + 1);
+    }
+  }
+  return kTfLiteOk;
+}
+
+TfLiteRegistration* RegisterScratchOp() {
+  static TfLiteRegistration r = {nullptr, nullptr, ScratchOpPrepare,
+                                 ScratchOpInvoke};
+  return &r;
+}
+
+constexpr size_t kSpareBufferBytes = 64;
+
+struct SpareOpData {
+  SpareBuffer too_large;
+  SpareBuffer small;
+};
+
+// Requests one spare buffer larger than the arena and one that fits.
+TfLiteStatus SpareOpPrepare(TfLiteContext* context, TfLiteNode* node) {
+  void* raw = nullptr;
+  TF_LITE_ENSURE_STATUS(
+      context->AllocatePersistentBuffer(context, sizeof(SpareOpData), &raw));
+  SpareOpData* data = static_cast<SpareOpData*>(raw);
+  node->user_data = data;
+  RequestSpareBuffer(context, 1 << 20, &data->too_large);
+  RequestSpareBuffer(context, kSpareBufferBytes, &data->small);
+  return kTfLiteOk;
+}
+
+bool Overlaps(const uint8_t* buffer, size_t bytes, const TfLiteTensor& tensor) {
+  return buffer < tensor.data.uint8 + tensor.bytes &&
+         tensor.data.uint8 < buffer + bytes;
+}
+
+// Only the small buffer exists, and it is clear of the node's tensors.
+TfLiteStatus SpareOpInvoke(TfLiteContext* context, TfLiteNode* node) {
+  const SpareOpData* data = static_cast<SpareOpData*>(node->user_data);
+  TF_LITE_ENSURE(context, GetSpareBuffer(data->too_large) == nullptr);
+  uint8_t* buffer = static_cast<uint8_t*>(GetSpareBuffer(data->small));
+  TF_LITE_ENSURE(context, buffer != nullptr);
+  for (int i = 0; i < node->inputs->size; ++i) {
+    TF_LITE_ENSURE(context,
+                   !Overlaps(buffer, kSpareBufferBytes,
+                             context->tensors[node->inputs->data[i]]));
+  }
+  for (int i = 0; i < node->outputs->size; ++i) {
+    TF_LITE_ENSURE(context,
+                   !Overlaps(buffer, kSpareBufferBytes,
+                             context->tensors[node->outputs->data[i]]));
+  }
+  return kTfLiteOk;
+}
+
+TfLiteRegistration* RegisterSpareOp() {
+  static TfLiteRegistration r = {nullptr, nullptr, SpareOpPrepare,
+                                 SpareOpInvoke};
+  return &r;
+}
+
+constexpr int kHeadSize = 64;
+
+// Two heads that each apply a RELU. The second head is larger, so its input
+// is planned before the output of the first head.
+const Model* BuildCascadeModel(TestModelBuilder* builder) {
+  const int relu = builder->AddOperatorCode(BuiltinOperator_RELU);
+  const int32_t first_shape[] = {1, kHeadSize};
+  const int first_input =
+      builder->AddTensor(TensorType_FLOAT32, first_shape, 2);
+  const int first_output =
+      builder->AddTensor(TensorType_FLOAT32, first_shape, 2);
+  builder->AddOperator(relu, {first_input}, {first_output});
+  builder->FinishSubgraph({first_input}, {first_output});
+  const int32_t second_shape[] = {1, 2 * kHeadSize};
+  const int second_input =
+      builder->AddTensor(TensorType_FLOAT32, second_shape, 2);
+  const int second_output =
+      builder->AddTensor(TensorType_FLOAT32, second_shape, 2);
+  builder->AddOperator(relu, {second_input}, {second_output});
+  return builder->BuildModel({second_input}, {second_output});
+}
+
+// RELU, RELU6 and RELU on a float tensor of kHeadSize values. The first RELU
+// reads the model input, the others can run in place.
+const Model* BuildReluChainModel(TestModelBuilder* builder) {
+  const int relu = builder->AddOperatorCode(BuiltinOperator_RELU);
+  const int relu6 = builder->AddOperatorCode(BuiltinOperator_RELU6);
+  const int32_t shape[] = {1, kHeadSize};
+  int tensors[4];
+  for (int i = 0; i < 4; ++i) {
+    tensors[i] = builder->AddTensor(TensorType_FLOAT32, shape, 2);
+  }
+  builder->AddOperator(relu, {tensors[0]}, {tensors[1]});
+  builder->AddOperator(relu6, {tensors[1]}, {tensors[2]});
+  builder->AddOperator(relu, {tensors[2]}, {tensors[3]});
+  return builder->BuildModel({tensors[0]}, {tensors[3]});
+}
+
+constexpr int kSparseUnits = 4;
+constexpr int kSparseDepth = 8;
+constexpr int kSparseBlockSize = 4;
+constexpr int kSparseBlocks = 3;
+constexpr int32_t kSparseSegments[] = {0, 1, 1, 2, 3};
+constexpr int32_t kSparseIndices[] = {0, 1, 0};
+
+// The non-zero blocks of a [kSparseUnits, kSparseDepth] weight matrix, as
+// listed by kSparseSegments and kSparseIndices.
+int8_t SparseValue(int i) { return (i * 7 + 3) % 19 - 9; }
+
+// FULLY_CONNECTED with the weights above, stored block sparse if `sparse` is
+// set and dense otherwise.
+const Model* BuildSparseFullyConnectedModel(TestModelBuilder* builder,
+                                            bool sparse) {
+  static int8_t values[kSparseBlocks * kSparseBlockSize];
+  static int8_t dense[kSparseUnits * kSparseDepth];
+  static int32_t bias[kSparseUnits] = {-20, 5, 13, 0};
+  for (int i = 0; i < kSparseBlocks * kSparseBlockSize; ++i) {
+    values[i] = SparseValue(i);
+  }
+  for (int row = 0; row < kSparseUnits; ++row) {
+    for (int k = kSparseSegments[row]; k < kSparseSegments[row + 1]; ++k) {
+      for (int i = 0; i < kSparseBlockSize; ++i) {
+        dense[row * kSparseDepth + kSparseIndices[k] * kSparseBlockSize + i] =
+            values[k * kSparseBlockSize + i];
+      }
+    }
+  }
+  const float filter_scale = 0.25f;
+  const float bias_scale = 0.125f;
+  const int64_t zero_point = 0;
+  const int32_t filter_shape[] = {kSparseUnits, kSparseDepth};
+  const int32_t bias_shape[] = {kSparseUnits};
+  const int fc = builder->AddOperatorCode(BuiltinOperator_FULLY_CONNECTED);
+  const int input = builder->AddQuantizedTensor(TensorType_INT8,
+                                                {1, kSparseDepth}, 0.5f, -1);
+  const int filter =
+      sparse ? builder->AddTensor(
+                   TensorType_INT8, filter_shape, 2, values, sizeof(values),
+                   &filter_scale, &zero_point, 1, 0,
+                   builder->CreateBlockSparsity(
+                       kSparseUnits, kSparseDepth, kSparseBlockSize,
+                       kSparseSegments, kSparseIndices, kSparseBlocks))
+             : builder->AddTensor(TensorType_INT8, filter_shape, 2, dense,
+                                  sizeof(dense), &filter_scale, &zero_point,
+                                  1);
+  const int bias_tensor =
+      builder->AddTensor(TensorType_INT32, bias_shape, 1, bias, sizeof(bias),
+                         &bias_scale, &zero_point, 1);
+  const int output = builder->AddQuantizedTensor(TensorType_INT8,
+                                                 {1, kSparseUnits}, 1.0f, 0);
+  builder->AddOperator(
+      fc, {input, filter, bias_tensor}, {output},
+      BuiltinOptions_FullyConnectedOptions,
+      CreateFullyConnectedOptions(*builder->builder()).Union());
+  return builder->BuildModel({input}, {output});
+}
+
+// ADD of an activation and the sparse weights above, which ADD would read
+// as a dense [kSparseUnits, kSparseDepth] tensor.
+const Model* BuildSparseAddModel(TestModelBuilder* builder) {
+  static int8_t values[kSparseBlocks * kSparseBlockSize];
+  const float scale = 0.25f;
+  const int64_t zero_point = 0;
+  const int32_t shape[] = {kSparseUnits, kSparseDepth};
+  const int add = builder->AddOperatorCode(BuiltinOperator_ADD);
+  const int input = builder->AddTensor(TensorType_INT8, shape, 2, nullptr, 0,
+                                       &scale, &zero_point, 1);
+  const int weights = builder->AddTensor(
+      TensorType_INT8, shape, 2, values, sizeof(values), &scale, &zero_point,
+      1, 0,
+      builder->CreateBlockSparsity(kSparseUnits, kSparseDepth,
+                                   kSparseBlockSize, kSparseSegments,
+                                   kSparseIndices, kSparseBlocks));
+  const int output = builder->AddTensor(TensorType_INT8, shape, 2, nullptr, 0,
+                                        &scale, &zero_point, 1);
+  builder->AddOperator(add, {input, weights}, {output},
+                       BuiltinOptions_AddOptions,
+                       CreateAddOptions(*builder->builder()).Union());
+  return builder->BuildModel({input}, {output});
+}
+
+}  // namespace
+}  // namespace testing
+}  // namespace tflite
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(TestScratchBuffersBetweenPersistentAllocations) {
+  // Three nodes of the same custom op, each requesting several scratch
+  // buffers with persistent allocations between the requests.
+  const tflite::Model* model = tflite::testing::GetSimpleModelWithBranch();
+  tflite::MicroMutableOpResolver resolver;
+  resolver.AddCustom("mock_custom", tflite::testing::RegisterScratchOp(), 0,
+                     0);
+  constexpr size_t kArenaSize = 4096;
+  alignas(16) uint8_t arena[kArenaSize];
+  tflite::MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                                       micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+  // Scratch buffers of one node are live at the same time.
+  TF_LITE_MICRO_EXPECT_GE(
+      interpreter.arena_activation_bytes(),
+      tflite::testing::kScratchBuffersPerNode *
+          tflite::testing::kScratchBufferBytes);
+}
+
+TF_LITE_MICRO_TEST(TestSpareBuffersThatDoNotFitStayEmpty) {
+  const tflite::Model* model = tflite::testing::GetSimpleModelWithBranch();
+  tflite::MicroMutableOpResolver resolver;
+  resolver.AddCustom("mock_custom", tflite::testing::RegisterSpareOp(), 0, 0);
+  constexpr size_t kArenaSize = 4096;
+  alignas(16) uint8_t arena[kArenaSize];
+  tflite::MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                                       micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+  TF_LITE_MICRO_EXPECT_LE(interpreter.arena_activation_bytes() +
+                              interpreter.arena_persistent_bytes(),
+                          kArenaSize);
+}
+
+TF_LITE_MICRO_TEST(TestSubgraphInputsKeepPreviousOutputs) {
+  using tflite::testing::kHeadSize;
+  tflite::testing::TestModelBuilder builder;
+  const tflite::Model* model = tflite::testing::BuildCascadeModel(&builder);
+  tflite::MicroMutableOpResolver resolver;
+  resolver.AddBuiltin(tflite::BuiltinOperator_RELU,
+                      tflite::ops::micro::Register_RELU());
+  constexpr size_t kArenaSize = 4096;
+  alignas(16) uint8_t arena[kArenaSize];
+  tflite::MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                                       micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(2, interpreter.subgraphs_size());
+  const TfLiteTensor* first_output = interpreter.output(0);
+  TfLiteTensor* second_input = interpreter.subgraph_input(1, 0);
+  TF_LITE_MICRO_EXPECT_FALSE(tflite::testing::Overlaps(
+      second_input->data.uint8, second_input->bytes, *first_output));
+
+  for (int i = 0; i < kHeadSize; ++i) {
+    interpreter.input(0)->data.f[i] = i - kHeadSize / 2;
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+  // Feeds the output of the first head, and the output minus 1, to the
+  // second head. Copying from the back overwrites outputs that were not read
+  // yet if the two tensors overlap.
+  for (int i = kHeadSize - 1; i >= 0; --i) {
+    second_input->data.f[2 * i] = first_output->data.f[i];
+    second_input->data.f[2 * i + 1] = first_output->data.f[i] - 1;
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.InvokeSubgraph(1));
+  const float* second_output = interpreter.subgraph_output(1, 0)->data.f;
+  for (int i = 0; i < kHeadSize; ++i) {
+    const float value = i - kHeadSize / 2;
+    TF_LITE_MICRO_EXPECT_EQ(value > 0 ? value : 0, second_output[2 * i]);
+    TF_LITE_MICRO_EXPECT_EQ(value > 1 ? value - 1 : 0,
+                            second_output[2 * i + 1]);
+  }
+}
+
+TF_LITE_MICRO_TEST(TestRestoreSnapshotRejectsCorruptSnapshots) {
+  using tflite::testing::kHeadSize;
+  tflite::testing::TestModelBuilder builder;
+  const tflite::Model* model = tflite::testing::BuildCascadeModel(&builder);
+  tflite::MicroMutableOpResolver resolver;
+  resolver.AddBuiltin(tflite::BuiltinOperator_RELU,
+                      tflite::ops::micro::Register_RELU());
+  constexpr size_t kArenaSize = 4096;
+  constexpr size_t kSnapshotSize = 4096;
+  alignas(16) static uint8_t arena[kArenaSize];
+  static uint8_t snapshot[kSnapshotSize];
+  size_t snapshot_size = 0;
+  {
+    tflite::MicroInterpreter saved(model, resolver, arena, kArenaSize,
+                                   micro_test::reporter);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, saved.AllocateTensors());
+    snapshot_size = saved.snapshot_size();
+    TF_LITE_MICRO_EXPECT_LE(snapshot_size, kSnapshotSize);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                            saved.SaveSnapshot(snapshot, kSnapshotSize));
+  }
+
+  // A failed restore leaves the interpreter as it was, so it can be retried.
+  tflite::MicroInterpreter restored(model, resolver, arena, kArenaSize,
+                                    micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(
+      kTfLiteError, restored.RestoreSnapshot(snapshot, snapshot_size - 1));
+  snapshot[snapshot_size - 1] ^= 1;
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError,
+                          restored.RestoreSnapshot(snapshot, snapshot_size));
+  snapshot[snapshot_size - 1] ^= 1;
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          restored.RestoreSnapshot(snapshot, snapshot_size));
+  for (int i = 0; i < kHeadSize; ++i) {
+    restored.input(0)->data.f[i] = i - kHeadSize / 2;
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, restored.Invoke());
+  for (int i = 0; i < kHeadSize; ++i) {
+    const float value = i - kHeadSize / 2;
+    TF_LITE_MICRO_EXPECT_EQ(value > 0 ? value : 0,
+                            restored.output(0)->data.f[i]);
+  }
+}
+
+TF_LITE_MICRO_TEST(TestReluRunsInPlace) {
+  using tflite::testing::kHeadSize;
+  tflite::testing::TestModelBuilder builder;
+  const tflite::Model* model = tflite::testing::BuildReluChainModel(&builder);
+  tflite::MicroMutableOpResolver resolver;
+  resolver.AddBuiltin(tflite::BuiltinOperator_RELU,
+                      tflite::ops::micro::Register_RELU());
+  resolver.AddBuiltin(tflite::BuiltinOperator_RELU6,
+                      tflite::ops::micro::Register_RELU6());
+  constexpr size_t kArenaSize = 4096;
+  alignas(16) uint8_t arena[kArenaSize];
+  tflite::MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                                       micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+  // The model input and one buffer for the three outputs.
+  TF_LITE_MICRO_EXPECT_EQ(2 * kHeadSize * sizeof(float),
+                          interpreter.arena_activation_bytes());
+  TF_LITE_MICRO_EXPECT_TRUE(interpreter.tensor(1)->data.raw ==
+                            interpreter.tensor(3)->data.raw);
+  TF_LITE_MICRO_EXPECT_TRUE(interpreter.tensor(0)->data.raw !=
+                            interpreter.tensor(1)->data.raw);
+
+  for (int i = 0; i < kHeadSize; ++i) {
+    interpreter.input(0)->data.f[i] = (i - kHeadSize / 2) * 0.25f;
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+  for (int i = 0; i < kHeadSize; ++i) {
+    const float value = (i - kHeadSize / 2) * 0.25f;
+    TF_LITE_MICRO_EXPECT_EQ(value, interpreter.input(0)->data.f[i]);
+    TF_LITE_MICRO_EXPECT_EQ(value < 0 ? 0 : value > 6 ? 6 : value,
+                            interpreter.output(0)->data.f[i]);
+  }
+}
+
+TF_LITE_MICRO_TEST(TestSparseWeightsOnlyFeedSparseKernels) {
+  tflite::MicroMutableOpResolver resolver;
+  resolver.AddBuiltin(tflite::BuiltinOperator_FULLY_CONNECTED,
+                      tflite::ops::micro::Register_FULLY_CONNECTED());
+  resolver.AddBuiltin(tflite::BuiltinOperator_ADD,
+                      tflite::ops::micro::Register_ADD());
+  constexpr size_t kArenaSize = 4096;
+  alignas(16) uint8_t arena[kArenaSize];
+
+  // Fully connected with sparse weights gives the same result as with the
+  // dense ones.
+  int8_t expected[tflite::testing::kSparseUnits];
+  for (int sparse = 0; sparse < 2; ++sparse) {
+    tflite::testing::TestModelBuilder builder;
+    const tflite::Model* model =
+        tflite::testing::BuildSparseFullyConnectedModel(&builder, sparse);
+    tflite::MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                                         micro_test::reporter);
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+    if (micro_test::did_test_fail) {
+      break;
+    }
+    TF_LITE_MICRO_EXPECT_EQ(sparse != 0,
+                            interpreter.tensor(1)->sparsity != nullptr);
+    for (int i = 0; i < tflite::testing::kSparseDepth; ++i) {
+      interpreter.input(0)->data.int8[i] = i * 5 - 17;
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+    for (int i = 0; i < tflite::testing::kSparseUnits; ++i) {
+      if (sparse) {
+        TF_LITE_MICRO_EXPECT_EQ(expected[i],
+                                interpreter.output(0)->data.int8[i]);
+      } else {
+        expected[i] = interpreter.output(0)->data.int8[i];
+      }
+    }
+  }
+
+  // Other kernels would read the sparse weights as a dense tensor.
+  tflite::testing::TestModelBuilder builder;
+  const tflite::Model* model = tflite::testing::BuildSparseAddModel(&builder);
+  tflite::MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                                       micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteError, interpreter.AllocateTensors());
+}
+
+TF_LITE_MICRO_TESTS_END
@@ -0,0 +1,77 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/micro_multi_tenant_arena.h"
+
+#include <algorithm>
+
+#include "tensorflow/lite/micro/memory_helpers.h"
+
+namespace tflite {
+
+namespace {
+// Same alignment MicroAllocator applies to the start of its arena, so that all
+// tenants plan their activations from exactly the same address.
+constexpr int kBufferAlignment = 16;
+}  // namespace
+
+MicroMultiTenantArena::MicroMultiTenantArena(uint8_t* arena, size_t arena_size,
+                                             ErrorReporter* error_reporter,
+                                             size_t reserved_activation_bytes)
+    : arena_(AlignPointerUp(arena, kBufferAlignment)),
+      arena_end_(arena + arena_size),
+      persistent_start_(arena + arena_size),
+      reserved_activation_bytes_(reserved_activation_bytes),
+      error_reporter_(error_reporter) {}
+
+TfLiteStatus MicroMultiTenantArena::AllocateTenant(
+    MicroInterpreter* interpreter) {
+  TF_LITE_ENSURE_STATUS(interpreter->initialization_status());
+  interpreter->ReserveActivationBytes(
+      std::max(activation_bytes_, reserved_activation_bytes_));
+  if (interpreter->AllocateTensors() != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(error_reporter_,
+                         "AllocateTensors() failed for tenant %d",
+                         tenants_size_);
+    return kTfLiteError;
+  }
+
+  // The interpreter was given [arena_, persistent_start_), so its persistent
+  // region ends where the previous tenant's begins.
+  uint8_t* tenant_persistent_start =
+      persistent_start_ - interpreter->arena_persistent_bytes();
+  size_t activation_bytes = activation_bytes_;
+  if (interpreter->arena_activation_bytes() > activation_bytes) {
+    activation_bytes = interpreter->arena_activation_bytes();
+  }
+  // The interpreter itself checked that its own plan fits, but the plans of
+  // earlier tenants may be larger than the space it left.
+  if (arena_ + activation_bytes > tenant_persistent_start) {
+    TF_LITE_REPORT_ERROR(
+        error_reporter_,
+        "Arena size is too small for %d tenants. Needed %d bytes of "
+        "activations, but only %d are left below the persistent regions.",
+        tenants_size_ + 1, activation_bytes,
+        tenant_persistent_start - arena_);
+    return kTfLiteError;
+  }
+
+  persistent_start_ = tenant_persistent_start;
+  activation_bytes_ = activation_bytes;
+  ++tenants_size_;
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
@@ -0,0 +1,92 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_MULTI_TENANT_ARENA_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_MULTI_TENANT_ARENA_H_
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/api/error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+namespace tflite {
+
+// Lets several interpreters (e.g. a wake-word model and a classifier) share
+// one tensor arena. Every interpreter keeps its own persistent region, stacked
+// downwards from the end of the arena, while all of them plan their
+// activations and scratch buffers from the same start address:
+//
+// ************** arena start
+// activations of whichever model is running (max over all tenants)
+// **************
+// unused memory
+// ************** persistent region of tenant N-1
+// ...
+// ************** persistent region of tenant 0
+// ************** arena end
+//
+// Tensor pointers stay bound to the shared region, so switching to another
+// model needs no re-allocation. Its inputs only have to be written after the
+// previous model's outputs were consumed, since the activations overlap.
+//
+// Spare buffers of a tenant (see spare_buffers.h, e.g. packed weights with
+// TF_LITE_PACK_WEIGHTS) only take memory above the largest plan of the
+// tenants allocated so far and above `reserved_activation_bytes`. Tenants
+// allocated later cannot take that memory back, so if they plan more
+// activations, pass their largest plan (arena_activation_bytes() of each
+// model on its own) as `reserved_activation_bytes`.
+//
+// Usage, tenant by tenant:
+//   MicroMultiTenantArena shared(arena, arena_size, error_reporter);
+//   static MicroInterpreter first(model_a, resolver, shared.tenant_arena(),
+//                                 shared.tenant_arena_size(), error_reporter);
+//   shared.AllocateTenant(&first);
+//   static MicroInterpreter second(model_b, resolver, shared.tenant_arena(),
+//                                  shared.tenant_arena_size(), error_reporter);
+//   shared.AllocateTenant(&second);
+class MicroMultiTenantArena {
+ public:
+  MicroMultiTenantArena(uint8_t* arena, size_t arena_size,
+                        ErrorReporter* error_reporter,
+                        size_t reserved_activation_bytes = 0);
+
+  // Buffer to construct the next interpreter on. It ends right below the
+  // persistent region of the last allocated tenant.
+  uint8_t* tenant_arena() const { return arena_; }
+  size_t tenant_arena_size() const { return persistent_start_ - arena_; }
+
+  // Calls AllocateTensors() on an interpreter constructed on tenant_arena()
+  // and reserves its persistent region. Fails if the activations of any
+  // tenant would overlap a persistent region.
+  TfLiteStatus AllocateTenant(MicroInterpreter* interpreter);
+
+  // Size of the shared activation region, the largest plan of all tenants.
+  size_t activation_bytes() const { return activation_bytes_; }
+  // Bytes used by all persistent regions together.
+  size_t persistent_bytes() const { return arena_end_ - persistent_start_; }
+  int tenants_size() const { return tenants_size_; }
+
+ private:
+  uint8_t* arena_;
+  uint8_t* arena_end_;
+  // Start of the lowest persistent region.
+  uint8_t* persistent_start_;
+  size_t activation_bytes_ = 0;
+  size_t reserved_activation_bytes_;
+  int tenants_size_ = 0;
+  ErrorReporter* error_reporter_;
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_MULTI_TENANT_ARENA_H_
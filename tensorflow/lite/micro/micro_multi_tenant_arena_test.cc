@@ -0,0 +1,174 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/micro_multi_tenant_arena.h"
+
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_model_builder.h"
+
+// Shares one arena between a fully connected model, whose weights get a
+// packed copy with TF_LITE_PACK_WEIGHTS, and a RELU model that plans more
+// activations. The arena only fits both if the packed copy of the first
+// tenant stays out of the activations of the second.
+
+namespace tflite {
+namespace testing {
+namespace {
+
+constexpr int kUnits = 16;
+constexpr int kAccumDepth = 64;
+constexpr int kReluSize = 2048;
+constexpr float kScale = 0.5f;
+constexpr int kZeroPoint = -3;
+constexpr size_t kArenaSize = 16384;
+// Room for the alignment of the tenant arenas and regions.
+constexpr size_t kAlignmentSlack = 64;
+
+int8_t InputValue(int i) { return (i * 37 + 11) % 256 - 128; }
+
+const Model* BuildFullyConnectedModel(TestModelBuilder* builder) {
+  static int8_t weights[kUnits * kAccumDepth];
+  static int32_t bias[kUnits];
+  for (int i = 0; i < kUnits * kAccumDepth; ++i) {
+    weights[i] = (i * 13 + 5) % 255 - 127;
+  }
+  for (int i = 0; i < kUnits; ++i) {
+    bias[i] = (i * 997) % 4001 - 2000;
+  }
+  const float filter_scale = 0.01f;
+  const float bias_scale = kScale * filter_scale;
+  const int64_t zero_point = 0;
+  const int32_t filter_shape[] = {kUnits, kAccumDepth};
+  const int32_t bias_shape[] = {kUnits};
+  const int fc = builder->AddOperatorCode(BuiltinOperator_FULLY_CONNECTED, 4);
+  const int input = builder->AddQuantizedTensor(
+      TensorType_INT8, {1, kAccumDepth}, kScale, kZeroPoint);
+  const int filter = builder->AddTensor(TensorType_INT8, filter_shape, 2,
+                                        weights, sizeof(weights),
+                                        &filter_scale, &zero_point, 1);
+  const int bias_tensor =
+      builder->AddTensor(TensorType_INT32, bias_shape, 1, bias, sizeof(bias),
+                         &bias_scale, &zero_point, 1);
+  const int output = builder->AddQuantizedTensor(
+      TensorType_INT8, {1, kUnits}, kScale, kZeroPoint);
+  builder->AddOperator(
+      fc, {input, filter, bias_tensor}, {output},
+      BuiltinOptions_FullyConnectedOptions,
+      CreateFullyConnectedOptions(*builder->builder()).Union());
+  return builder->BuildModel({input}, {output});
+}
+
+const Model* BuildReluModel(TestModelBuilder* builder) {
+  const int relu = builder->AddOperatorCode(BuiltinOperator_RELU, 2);
+  const int input = builder->AddQuantizedTensor(
+      TensorType_INT8, {1, kReluSize}, kScale, kZeroPoint);
+  const int output = builder->AddQuantizedTensor(
+      TensorType_INT8, {1, kReluSize}, kScale, kZeroPoint);
+  builder->AddOperator(relu, {input}, {output}, BuiltinOptions_NONE, 0);
+  return builder->BuildModel({input}, {output});
+}
+
+void AddOps(MicroMutableOpResolver* resolver) {
+  resolver->AddBuiltin(BuiltinOperator_FULLY_CONNECTED,
+                       ops::micro::Register_FULLY_CONNECTED(), 1, 4);
+  resolver->AddBuiltin(BuiltinOperator_RELU, ops::micro::Register_RELU(), 1,
+                       2);
+}
+
+TfLiteStatus InvokeWithInput(MicroInterpreter* interpreter) {
+  TfLiteTensor* input = interpreter->input(0);
+  for (size_t i = 0; i < input->bytes; ++i) {
+    input->data.int8[i] = InputValue(i);
+  }
+  return interpreter->Invoke();
+}
+
+}  // namespace
+}  // namespace testing
+}  // namespace tflite
+
+TF_LITE_MICRO_TESTS_BEGIN
+
+TF_LITE_MICRO_TEST(TestSpareBuffersStayOutOfLaterTenantsActivations) {
+  using tflite::MicroInterpreter;
+  using tflite::MicroMultiTenantArena;
+  using tflite::testing::kArenaSize;
+  tflite::testing::TestModelBuilder fc_builder;
+  tflite::testing::TestModelBuilder relu_builder;
+  const tflite::Model* fc_model =
+      tflite::testing::BuildFullyConnectedModel(&fc_builder);
+  const tflite::Model* relu_model =
+      tflite::testing::BuildReluModel(&relu_builder);
+  tflite::MicroMutableOpResolver resolver;
+  tflite::testing::AddOps(&resolver);
+
+  // Each model on its own. Reserving the whole arena keeps the weights of the
+  // fully connected model from being packed.
+  alignas(16) static uint8_t single_arena[kArenaSize];
+  MicroInterpreter fc_alone(fc_model, resolver, single_arena, kArenaSize,
+                            micro_test::reporter);
+  fc_alone.ReserveActivationBytes(kArenaSize);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, fc_alone.AllocateTensors());
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk,
+                          tflite::testing::InvokeWithInput(&fc_alone));
+  int8_t expected[tflite::testing::kUnits];
+  for (int i = 0; i < tflite::testing::kUnits; ++i) {
+    expected[i] = fc_alone.output(0)->data.int8[i];
+  }
+  const size_t fc_persistent_bytes = fc_alone.arena_persistent_bytes();
+
+  MicroInterpreter relu_alone(relu_model, resolver, single_arena, kArenaSize,
+                              micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, relu_alone.AllocateTensors());
+  const size_t relu_activation_bytes = relu_alone.arena_activation_bytes();
+  const size_t relu_persistent_bytes = relu_alone.arena_persistent_bytes();
+
+  // Too small for a packed copy (2 KB) next to both models.
+  const size_t shared_size = relu_activation_bytes + relu_persistent_bytes +
+                             fc_persistent_bytes +
+                             tflite::testing::kAlignmentSlack;
+  TF_LITE_MICRO_EXPECT_LE(shared_size, kArenaSize);
+  alignas(16) static uint8_t shared_arena[kArenaSize];
+  MicroMultiTenantArena shared(shared_arena, shared_size, micro_test::reporter,
+                               relu_activation_bytes);
+  MicroInterpreter fc(fc_model, resolver, shared.tenant_arena(),
+                      shared.tenant_arena_size(), micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, shared.AllocateTenant(&fc));
+  MicroInterpreter relu(relu_model, resolver, shared.tenant_arena(),
+                        shared.tenant_arena_size(), micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, shared.AllocateTenant(&relu));
+  TF_LITE_MICRO_EXPECT_EQ(2, shared.tenants_size());
+  TF_LITE_MICRO_EXPECT_EQ(relu_activation_bytes, shared.activation_bytes());
+
+  // Tenants that were not allocated cannot be invoked.
+  if (!micro_test::did_test_fail) {
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, tflite::testing::InvokeWithInput(&relu));
+    for (int i = 0; i < tflite::testing::kReluSize; ++i) {
+      const int8_t input = tflite::testing::InputValue(i);
+      const int8_t zero_point = tflite::testing::kZeroPoint;
+      TF_LITE_MICRO_EXPECT_EQ(input > zero_point ? input : zero_point,
+                              relu.output(0)->data.int8[i]);
+    }
+    TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, tflite::testing::InvokeWithInput(&fc));
+    for (int i = 0; i < tflite::testing::kUnits; ++i) {
+      TF_LITE_MICRO_EXPECT_EQ(expected[i], fc.output(0)->data.int8[i]);
+    }
+  }
+}
+
+TF_LITE_MICRO_TESTS_END
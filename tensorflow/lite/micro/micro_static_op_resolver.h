@@ -0,0 +1,134 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_STATIC_OP_RESOLVER_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_STATIC_OP_RESOLVER_H_
+
+#include <cstring>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/api/op_resolver.h"
+#include "tensorflow/lite/micro/compatibility.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+
+// One operator known to a MicroStaticOpResolver. Tables of these are meant to
+// be emitted as constexpr arrays (see tools/generate_op_resolver) so that they
+// live in flash rather than RAM.
+struct MicroStaticOpEntry {
+  int32_t builtin_code;
+  // Only used when builtin_code is BuiltinOperator_CUSTOM.
+  const char* custom_name;
+  int min_version;
+  int max_version;
+  TfLiteRegistration* (*registration)();
+};
+
+// Marks a builtin code that has no entry in the index table.
+constexpr uint8_t kMicroStaticOpNotFound = 0xFF;
+
+// Op resolver backed by a fixed, model-specific table. `op_index` has
+// BuiltinOperator_MAX + 1 entries and maps each builtin code to its position
+// in `entries` (or kMicroStaticOpNotFound), which makes FindOp for builtins a
+// single table lookup instead of a linear scan.
+//
+// Each version between min_version and max_version of an entry gets its own
+// registration, which reports that version to the kernels. Only these
+// tRegistrationCount registrations are copied into RAM, compared to
+// TFLITE_REGISTRATIONS_MAX copies for MicroMutableOpResolver. Versions that do
+// not fit into tRegistrationCount are not found.
+template <unsigned int tOpCount, unsigned int tRegistrationCount = tOpCount>
+class MicroStaticOpResolver : public OpResolver {
+ public:
+  MicroStaticOpResolver(const uint8_t* op_index,
+                        const MicroStaticOpEntry* entries)
+      : op_index_(op_index), entries_(entries) {
+    static_assert(tOpCount < kMicroStaticOpNotFound,
+                  "Too many ops for an 8-bit index table.");
+    static_assert(tRegistrationCount < kMicroStaticOpNotFound,
+                  "Too many op versions for an 8-bit index table.");
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < tOpCount; ++i) {
+      const MicroStaticOpEntry& entry = entries_[i];
+      first_registrations_[i] = count;
+      for (int version = entry.min_version;
+           version <= entry.max_version && count < tRegistrationCount;
+           ++version) {
+        TfLiteRegistration& registration = registrations_[count++];
+        registration = *entry.registration();
+        registration.builtin_code = entry.builtin_code;
+        registration.custom_name = entry.custom_name;
+        registration.version = version;
+      }
+    }
+    registration_count_ = count;
+  }
+
+  const TfLiteRegistration* FindOp(tflite::BuiltinOperator op,
+                                   int version) const override {
+    if (op < BuiltinOperator_MIN || op > BuiltinOperator_MAX) {
+      return nullptr;
+    }
+    const uint8_t index = op_index_[op];
+    if (index == kMicroStaticOpNotFound || index >= tOpCount) {
+      return nullptr;
+    }
+    return MatchVersion(index, version);
+  }
+
+  const TfLiteRegistration* FindOp(const char* op, int version) const override {
+    // Custom ops are not indexed, but a generated table only holds the few
+    // the model uses.
+    for (unsigned int i = 0; i < tOpCount; ++i) {
+      if ((entries_[i].builtin_code == BuiltinOperator_CUSTOM) &&
+          (strcmp(entries_[i].custom_name, op) == 0)) {
+        const TfLiteRegistration* registration = MatchVersion(i, version);
+        if (registration != nullptr) {
+          return registration;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  unsigned int GetRegistrationLength() { return tOpCount; }
+
+ private:
+  const TfLiteRegistration* MatchVersion(unsigned int index,
+                                         int version) const {
+    const MicroStaticOpEntry& entry = entries_[index];
+    if ((version < entry.min_version) || (version > entry.max_version)) {
+      return nullptr;
+    }
+    const unsigned int position =
+        first_registrations_[index] + version - entry.min_version;
+    if (position >= registration_count_) {
+      return nullptr;
+    }
+    return &registrations_[position];
+  }
+
+  const uint8_t* op_index_;
+  const MicroStaticOpEntry* entries_;
+  TfLiteRegistration registrations_[tRegistrationCount];
+  uint8_t first_registrations_[tOpCount];
+  unsigned int registration_count_;
+
+  TF_LITE_REMOVE_VIRTUAL_DELETE
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_STATIC_OP_RESOLVER_H_
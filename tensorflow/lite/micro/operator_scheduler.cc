@@ -0,0 +1,381 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/operator_scheduler.h"
+
+#include "tensorflow/lite/micro/memory_helpers.h"
+#include "tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
+
+namespace tflite {
+
+namespace {
+
+// Same alignment as the buffers planned by MicroAllocator.
+constexpr size_t kBufferAlignment = 16;
+
+// Bits in Scheduler::flags_.
+constexpr uint8_t kSubgraphInput = 1;
+constexpr uint8_t kSubgraphOutput = 2;
+constexpr uint8_t kLive = 4;
+
+// Tracks the live activation bytes while operators are run and undone one at
+// a time. A tensor is allocated when the first operator writing or reading it
+// runs, subgraph inputs before the first operator, and freed after the last
+// operator reading it unless it is a subgraph output. This matches the
+// lifetimes AllocationInfoBuilder gives the memory planner.
+class Scheduler {
+ public:
+  Scheduler(const SubGraph* subgraph, const TfLiteTensor* tensors)
+      : subgraph_(subgraph),
+        tensors_(tensors),
+        operators_size_(subgraph->operators()->size()),
+        tensors_size_(subgraph->tensors()->size()) {}
+
+  TfLiteStatus Init(ErrorReporter* error_reporter,
+                    SimpleMemoryAllocator* allocator) {
+    bytes_ = Allocate<size_t>(allocator, tensors_size_);
+    producer_ = Allocate<int>(allocator, tensors_size_);
+    total_uses_ = Allocate<int>(allocator, tensors_size_);
+    uses_ = Allocate<int>(allocator, tensors_size_);
+    first_ = Allocate<int>(allocator, tensors_size_);
+    last_ = Allocate<int>(allocator, tensors_size_);
+    flags_ = Allocate<uint8_t>(allocator, tensors_size_);
+    scheduled_ = Allocate<uint8_t>(allocator, operators_size_);
+    order_ = Allocate<int>(allocator, operators_size_);
+    peaks_ = Allocate<size_t>(allocator, operators_size_ + 1);
+    if (bytes_ == nullptr || producer_ == nullptr || total_uses_ == nullptr ||
+        uses_ == nullptr || first_ == nullptr || last_ == nullptr ||
+        flags_ == nullptr || scheduled_ == nullptr || order_ == nullptr ||
+        peaks_ == nullptr) {
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Failed to allocate memory for operator "
+                           "scheduling");
+      return kTfLiteError;
+    }
+
+    for (int t = 0; t < tensors_size_; ++t) {
+      const TfLiteTensor& tensor = tensors_[t];
+      bytes_[t] = tensor.data.raw == nullptr && !tensor.is_variable
+                      ? AlignSizeUp(tensor.bytes, kBufferAlignment)
+                      : 0;
+      producer_[t] = -1;
+      total_uses_[t] = 0;
+      flags_[t] = 0;
+    }
+    for (int32_t t : *subgraph_->inputs()) {
+      flags_[t] |= kSubgraphInput;
+    }
+    for (int32_t t : *subgraph_->outputs()) {
+      flags_[t] |= kSubgraphOutput;
+    }
+    for (int i = 0; i < operators_size_; ++i) {
+      const Operator* op = subgraph_->operators()->Get(i);
+      for (int32_t t : *op->outputs()) {
+        producer_[t] = i;
+      }
+      for (int32_t t : *op->inputs()) {
+        if (t >= 0) {
+          ++total_uses_[t];
+        }
+      }
+    }
+    return kTfLiteOk;
+  }
+
+  // Peak live bytes of running the operators in `order`.
+  size_t Peak(const int* order) {
+    Reset();
+    size_t peak = live_bytes_;
+    for (int i = 0; i < operators_size_; ++i) {
+      peak = Max(peak, Run(order[i]));
+    }
+    return peak;
+  }
+
+  // Builds an order in `order` by always running the ready operator that
+  // leaves the fewest live bytes behind, and returns its peak.
+  size_t Greedy(int* order) {
+    Reset();
+    size_t peak = live_bytes_;
+    for (int i = 0; i < operators_size_; ++i) {
+      int best = -1;
+      size_t best_live_bytes = 0;
+      for (int op = 0; op < operators_size_; ++op) {
+        if (!Ready(op)) {
+          continue;
+        }
+        Run(op);
+        if (best < 0 || live_bytes_ < best_live_bytes) {
+          best = op;
+          best_live_bytes = live_bytes_;
+        }
+        Undo(op);
+      }
+      if (best < 0) {
+        // The model has a cycle, there is no valid order.
+        return ~static_cast<size_t>(0);
+      }
+      order[i] = best;
+      peak = Max(peak, Run(best));
+    }
+    return peak;
+  }
+
+  // Depth first search over all orders, skipping partial orders whose peak
+  // is already no better than `*best_peak`. Improved orders are written to
+  // `best`. Gives up after `max_steps` operators were tried.
+  void Search(int max_steps, int* best, size_t* best_peak) {
+    Reset();
+    int depth = 0;
+    int next = 0;
+    peaks_[0] = live_bytes_;
+    for (int steps = 0; steps < max_steps;) {
+      int op = next;
+      while (op < operators_size_ && !Ready(op)) {
+        ++op;
+      }
+      if (op == operators_size_) {
+        // All choices at this depth are done, backtrack.
+        if (depth == 0) {
+          break;
+        }
+        --depth;
+        Undo(order_[depth]);
+        next = order_[depth] + 1;
+        continue;
+      }
+      ++steps;
+      order_[depth] = op;
+      const size_t peak = Max(peaks_[depth], Run(op));
+      if (peak < *best_peak && depth + 1 < operators_size_) {
+        peaks_[++depth] = peak;
+        next = 0;
+        continue;
+      }
+      if (peak < *best_peak) {
+        *best_peak = peak;
+        for (int i = 0; i < operators_size_; ++i) {
+          best[i] = order_[i];
+        }
+      }
+      Undo(op);
+      next = op + 1;
+    }
+  }
+
+  // Plans the activations for `order` like MicroAllocator does, with
+  // `buffer` as the planner's scratch memory. Returns false if that doesn't
+  // fit into `buffer`.
+  bool PlannedBytes(ErrorReporter* error_reporter, const int* order,
+                    uint8_t* buffer, size_t buffer_size, size_t* bytes) {
+    for (int t = 0; t < tensors_size_; ++t) {
+      first_[t] = flags_[t] & kSubgraphInput ? 0 : -1;
+      last_[t] = flags_[t] & kSubgraphOutput ? operators_size_ - 1 : -1;
+    }
+    for (int i = 0; i < operators_size_; ++i) {
+      const Operator* op = subgraph_->operators()->Get(order[i]);
+      for (int32_t t : *op->inputs()) {
+        if (t >= 0) {
+          first_[t] = first_[t] == -1 ? i : first_[t];
+          last_[t] = Max(last_[t], i);
+        }
+      }
+      for (int32_t t : *op->outputs()) {
+        first_[t] = first_[t] == -1 ? i : first_[t];
+      }
+    }
+    GreedyMemoryPlanner planner(buffer, buffer_size);
+    for (int t = 0; t < tensors_size_; ++t) {
+      if (bytes_[t] > 0 && first_[t] != -1 && last_[t] != -1 &&
+          planner.AddBuffer(error_reporter, bytes_[t], first_[t], last_[t]) !=
+              kTfLiteOk) {
+        return false;
+      }
+    }
+    *bytes = planner.GetMaximumMemorySize();
+    return true;
+  }
+
+ private:
+  template <typename T>
+  static T* Allocate(SimpleMemoryAllocator* allocator, int count) {
+    return reinterpret_cast<T*>(
+        allocator->AllocateFromTail(sizeof(T) * count, alignof(T)));
+  }
+
+  template <typename T>
+  static T Max(T a, T b) {
+    return a > b ? a : b;
+  }
+
+  void Reset() {
+    live_bytes_ = 0;
+    for (int t = 0; t < tensors_size_; ++t) {
+      uses_[t] = total_uses_[t];
+      flags_[t] &= ~kLive;
+      if (flags_[t] & kSubgraphInput) {
+        Alloc(t);
+      }
+    }
+    for (int i = 0; i < operators_size_; ++i) {
+      scheduled_[i] = false;
+    }
+  }
+
+  void Alloc(int t) {
+    if (bytes_[t] > 0 && !(flags_[t] & kLive)) {
+      flags_[t] |= kLive;
+      live_bytes_ += bytes_[t];
+    }
+  }
+
+  void Free(int t) {
+    if (flags_[t] & kLive) {
+      flags_[t] &= ~kLive;
+      live_bytes_ -= bytes_[t];
+    }
+  }
+
+  bool Ready(int op) const {
+    if (scheduled_[op]) {
+      return false;
+    }
+    for (int32_t t : *subgraph_->operators()->Get(op)->inputs()) {
+      if (t >= 0 && producer_[t] >= 0 && !scheduled_[producer_[t]]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Runs `op` and returns the live bytes while it runs.
+  size_t Run(int op) {
+    const Operator* node = subgraph_->operators()->Get(op);
+    scheduled_[op] = true;
+    // Inputs without a producer, e.g. compressed weights, are expanded into
+    // the arena right before their first reader.
+    for (int32_t t : *node->inputs()) {
+      if (t >= 0 && producer_[t] < 0 && uses_[t] == total_uses_[t]) {
+        Alloc(t);
+      }
+    }
+    for (int32_t t : *node->outputs()) {
+      Alloc(t);
+    }
+    const size_t live_bytes = live_bytes_;
+    for (int32_t t : *node->inputs()) {
+      if (t >= 0 && --uses_[t] == 0 && !(flags_[t] & kSubgraphOutput)) {
+        Free(t);
+      }
+    }
+    return live_bytes;
+  }
+
+  void Undo(int op) {
+    const Operator* node = subgraph_->operators()->Get(op);
+    for (int32_t t : *node->inputs()) {
+      if (t >= 0 && uses_[t]++ == 0 && !(flags_[t] & kSubgraphOutput)) {
+        Alloc(t);
+      }
+    }
+    for (int32_t t : *node->outputs()) {
+      Free(t);
+    }
+    for (int32_t t : *node->inputs()) {
+      if (t >= 0 && producer_[t] < 0 && uses_[t] == total_uses_[t] &&
+          !(flags_[t] & kSubgraphInput)) {
+        Free(t);
+      }
+    }
+    scheduled_[op] = false;
+  }
+
+  const SubGraph* subgraph_;
+  const TfLiteTensor* tensors_;
+  const int operators_size_;
+  const int tensors_size_;
+  // Arena bytes of each tensor, 0 for tensors that aren't planned.
+  size_t* bytes_ = nullptr;
+  int* producer_ = nullptr;
+  int* total_uses_ = nullptr;
+  // Readers that haven't run yet.
+  int* uses_ = nullptr;
+  // Lifetimes for PlannedBytes().
+  int* first_ = nullptr;
+  int* last_ = nullptr;
+  uint8_t* flags_ = nullptr;
+  uint8_t* scheduled_ = nullptr;
+  // Current partial order of Search() and the peak before each position.
+  int* order_ = nullptr;
+  size_t* peaks_ = nullptr;
+  size_t live_bytes_ = 0;
+};
+
+}  // namespace
+
+TfLiteStatus ScheduleOperators(ErrorReporter* error_reporter,
+                               SimpleMemoryAllocator* allocator,
+                               const SubGraph* subgraph,
+                               const TfLiteTensor* tensors, int max_steps,
+                               int* order) {
+  const int operators_size = subgraph->operators()->size();
+  for (int i = 0; i < operators_size; ++i) {
+    order[i] = i;
+  }
+
+  const size_t mark = allocator->GetTailMark();
+  Scheduler scheduler(subgraph, tensors);
+  int* candidate = reinterpret_cast<int*>(allocator->AllocateFromTail(
+      sizeof(int) * operators_size, alignof(int)));
+  TfLiteStatus status = candidate == nullptr
+                            ? kTfLiteError
+                            : scheduler.Init(error_reporter, allocator);
+  if (status != kTfLiteOk) {
+    allocator->ResetTailToMark(mark);
+    return status;
+  }
+
+  const size_t model_peak = scheduler.Peak(order);
+  size_t peak = scheduler.Greedy(candidate);
+  if (peak >= model_peak) {
+    peak = model_peak;
+    for (int i = 0; i < operators_size; ++i) {
+      candidate[i] = i;
+    }
+  }
+  scheduler.Search(max_steps, candidate, &peak);
+
+  // Nothing but temporary data lives at the start of the arena yet, so the
+  // planner can use all of the free space.
+  uint8_t* buffer = allocator->GetBuffer();
+  const size_t buffer_size =
+      allocator->GetMaxBufferSize() - allocator->GetDataSize();
+  size_t model_bytes;
+  size_t candidate_bytes;
+  if (peak < model_peak &&
+      scheduler.PlannedBytes(error_reporter, order, buffer, buffer_size,
+                             &model_bytes) &&
+      scheduler.PlannedBytes(error_reporter, candidate, buffer, buffer_size,
+                             &candidate_bytes) &&
+      candidate_bytes < model_bytes) {
+    for (int i = 0; i < operators_size; ++i) {
+      order[i] = candidate[i];
+    }
+  }
+  allocator->ResetTailToMark(mark);
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
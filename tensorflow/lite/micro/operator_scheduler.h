@@ -0,0 +1,47 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_OPERATOR_SCHEDULER_H_
+#define TENSORFLOW_LITE_MICRO_OPERATOR_SCHEDULER_H_
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/api/error_reporter.h"
+#include "tensorflow/lite/micro/simple_memory_allocator.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+
+// Operators run in the order of the model, and the memory planner derives the
+// lifetime of every activation from that order. In branched models (e.g.
+// inception or residual blocks) another valid order can keep fewer
+// activations alive at the same time.
+//
+// Looks for the order of the operators of `subgraph` that needs the smallest
+// activation arena. A greedy order and a depth first search bounded by
+// `max_steps` partial orders are tried, and the best order is kept only if
+// the greedy memory planner packs it into fewer bytes than the model order.
+// Kernel scratch buffers are not known yet at this point and are left out.
+//
+// `tensors` are the runtime tensors of the subgraph. On return, `order` holds
+// for each position the index of the operator running there. Temporary
+// memory is taken from the free part of `allocator` and given back.
+TfLiteStatus ScheduleOperators(ErrorReporter* error_reporter,
+                               SimpleMemoryAllocator* allocator,
+                               const SubGraph* subgraph,
+                               const TfLiteTensor* tensors, int max_steps,
+                               int* order);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_OPERATOR_SCHEDULER_H_
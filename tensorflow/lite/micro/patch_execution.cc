@@ -0,0 +1,148 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/micro/patch_execution.h"
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+namespace tflite {
+
+bool GetPatchWindow(const TfLiteNode& node,
+                    const TfLiteRegistration& registration,
+                    const TfLiteTensor* tensors, PatchWindow* window) {
+  if (node.inputs->size < 1 || node.outputs->size != 1) {
+    return false;
+  }
+  const TfLiteTensor& input = tensors[node.inputs->data[0]];
+  const TfLiteTensor& output = tensors[node.outputs->data[0]];
+  if (input.dims->size != 4 || output.dims->size != 4 ||
+      input.dims->data[0] != 1 || output.dims->data[0] != 1) {
+    return false;
+  }
+
+  TfLitePadding padding;
+  int filter_height, filter_width, stride_width, dilation_width_factor;
+  switch (registration.builtin_code) {
+    case BuiltinOperator_CONV_2D:
+    case BuiltinOperator_DEPTHWISE_CONV_2D: {
+      // Both filters are laid out as [x, height, width, y].
+      if (node.inputs->size < 2) {
+        return false;
+      }
+      const TfLiteIntArray* filter_dims =
+          tensors[node.inputs->data[1]].dims;
+      if (filter_dims->size != 4) {
+        return false;
+      }
+      filter_height = filter_dims->data[1];
+      filter_width = filter_dims->data[2];
+      if (registration.builtin_code == BuiltinOperator_CONV_2D) {
+        const auto* params =
+            static_cast<const TfLiteConvParams*>(node.builtin_data);
+        padding = params->padding;
+        window->stride_height = params->stride_height;
+        window->dilation_height_factor = params->dilation_height_factor;
+        stride_width = params->stride_width;
+        dilation_width_factor = params->dilation_width_factor;
+      } else {
+        const auto* params =
+            static_cast<const TfLiteDepthwiseConvParams*>(node.builtin_data);
+        padding = params->padding;
+        window->stride_height = params->stride_height;
+        window->dilation_height_factor = params->dilation_height_factor;
+        stride_width = params->stride_width;
+        dilation_width_factor = params->dilation_width_factor;
+        // The depthwise kernels pad as if there was no dilation, which only
+        // matters with SAME padding.
+        if (padding == kTfLitePaddingSame &&
+            (window->dilation_height_factor != 1 ||
+             dilation_width_factor != 1)) {
+          return false;
+        }
+      }
+      break;
+    }
+    case BuiltinOperator_AVERAGE_POOL_2D:
+    case BuiltinOperator_MAX_POOL_2D: {
+      const auto* params =
+          static_cast<const TfLitePoolParams*>(node.builtin_data);
+      padding = params->padding;
+      filter_height = params->filter_height;
+      filter_width = params->filter_width;
+      window->stride_height = params->stride_height;
+      window->dilation_height_factor = 1;
+      stride_width = params->stride_width;
+      dilation_width_factor = 1;
+      break;
+    }
+    default:
+      return false;
+  }
+
+  int output_height, output_width;
+  const TfLitePaddingValues padding_values = ComputePaddingHeightWidth(
+      window->stride_height, stride_width, window->dilation_height_factor,
+      dilation_width_factor, input.dims->data[1], input.dims->data[2],
+      filter_height, filter_width, padding, &output_height, &output_width);
+  window->filter_height = filter_height;
+  window->padding_height = padding_values.height;
+  return output_height == output.dims->data[1];
+}
+
+void GetPatchRows(const PatchPlan& plan, int output_row, int* first,
+                  int* last) {
+  const int operators = plan.operators;
+  first[operators] = output_row;
+  last[operators] =
+      std::min(output_row + plan.output_rows, plan.heights[operators]);
+  for (int i = operators - 1; i >= 0; --i) {
+    const PatchWindow& window = plan.windows[i];
+    first[i] = std::max(
+        first[i + 1] * window.stride_height - window.padding_height, 0);
+    last[i] = std::min((last[i + 1] - 1) * window.stride_height -
+                           window.padding_height +
+                           (window.filter_height - 1) *
+                               window.dilation_height_factor +
+                           1,
+                       plan.heights[i]);
+  }
+}
+
+void SetPatchHeights(PatchPlan* plan) {
+  int first[kMaxPatchOperators + 1];
+  int last[kMaxPatchOperators + 1];
+  std::fill(plan->patch_heights, plan->patch_heights + kMaxPatchOperators + 1,
+            0);
+  for (int row = 0; row < plan->heights[plan->operators];
+       row += plan->output_rows) {
+    GetPatchRows(*plan, row, first, last);
+    for (int i = 0; i <= plan->operators; ++i) {
+      plan->patch_heights[i] =
+          std::max(plan->patch_heights[i], last[i] - first[i]);
+    }
+  }
+}
+
+TfLitePaddingValues GetPatchPadding(TfLiteContext* context,
+                                    const TfLitePaddingValues& padding,
+                                    int stride_height) {
+  return static_cast<internal::ContextHelper*>(context->impl_)
+      ->GetPatchPadding(padding, stride_height);
+}
+
+}  // namespace tflite
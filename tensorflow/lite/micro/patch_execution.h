@@ -0,0 +1,97 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_PATCH_EXECUTION_H_
+#define TENSORFLOW_LITE_MICRO_PATCH_EXECUTION_H_
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+
+namespace tflite {
+
+// The arena of image models is dominated by the large activations between
+// their first few layers. With TF_LITE_PATCH_EXECUTION, MicroAllocator looks
+// for a chain of CONV_2D, DEPTHWISE_CONV_2D, AVERAGE_POOL_2D and MAX_POOL_2D
+// operators at the start of subgraph 0 that can run patch by patch, and
+// MicroInterpreter then computes the output of that prefix in horizontal
+// strips of rows. Each strip runs the whole prefix on just the rows it needs
+// of every tensor, so only the input and the output of the prefix take their
+// full size in the arena and the tensors in between take the size of a strip.
+// Rows that the windows of neighbouring strips share (the halo) are computed
+// once per strip.
+//
+// Strips span the full width and batch 1, so that the rows of the prefix
+// input and output a strip reads and writes are contiguous and used in place.
+// Kernels of these operators see tensors of the height of the strip and take
+// their padding from GetPatchPadding().
+//
+// With TF_LITE_FUSE_OPERATORS, a CONV_2D followed by a pooling operator with
+// windows that do not overlap, or by an ADD of its output and another tensor
+// of the same shape, runs the same way anywhere in the model. Such a pair
+// runs one output row at a time, so no row is computed twice and the output
+// of the CONV_2D only takes the rows of one window.
+constexpr int kMaxPatchOperators = 8;
+
+// How the rows of the output of an operator map to rows of its input.
+struct PatchWindow {
+  int filter_height;
+  int stride_height;
+  int dilation_height_factor;
+  // Top padding of the full tensors.
+  int padding_height;
+};
+
+// A chain of operators that runs in strips, the patched prefix of subgraph 0
+// or a pair of fused operators. Stored in the persistent area.
+struct PatchPlan {
+  // Node of the first operator, counted over all subgraphs.
+  int first_node;
+  int operators;
+  // Rows of the output of the chain computed by each strip.
+  int output_rows;
+  // Operator i reads tensors[i] and writes tensors[i + 1].
+  int tensors[kMaxPatchOperators + 1];
+  // Full height of these tensors, and the most rows any strip uses.
+  int heights[kMaxPatchOperators + 1];
+  int patch_heights[kMaxPatchOperators + 1];
+  // Another input of operator i that is read at the rows of its output, like
+  // the residual of a fused ADD, or -1.
+  int side_tensors[kMaxPatchOperators];
+  PatchWindow windows[kMaxPatchOperators];
+};
+
+// Fills `window` and returns true if the node can run on a strip of rows of
+// its input and output.
+bool GetPatchWindow(const TfLiteNode& node,
+                    const TfLiteRegistration& registration,
+                    const TfLiteTensor* tensors, PatchWindow* window);
+
+// Rows [first[i], last[i]) of every tensor of `plan` that the strip starting
+// at row `output_row` of the output of the chain needs.
+void GetPatchRows(const PatchPlan& plan, int output_row, int* first,
+                  int* last);
+
+// Sets plan->patch_heights from the other fields.
+void SetPatchHeights(PatchPlan* plan);
+
+// Called in Eval by kernels with a window. Turns the padding computed in
+// Prepare for the full tensors into the padding of the rows the node runs
+// on, which only differs while it runs on a strip.
+TfLitePaddingValues GetPatchPadding(TfLiteContext* context,
+                                    const TfLitePaddingValues& padding,
+                                    int stride_height);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_PATCH_EXECUTION_H_
@@ -50,6 +50,15 @@ uint8_t* SimpleMemoryAllocator::AllocateFromTail(size_t size,
   return aligned_result;
 }
 
+void SimpleMemoryAllocator::ResetTailToMark(size_t mark) {
+  // A locked allocator must not release memory its child may still use, and
+  // a mark above the current size would hand out memory that isn't free.
+  if (has_child_allocator_ || mark > data_size_) {
+    return;
+  }
+  data_size_ = mark;
+}
+
 SimpleMemoryAllocator SimpleMemoryAllocator::CreateChildAllocator() {
   // Note that the parameterized constructor initializes data_size_ to 0 which
   // is not what we expected.
@@ -39,6 +39,12 @@ class SimpleMemoryAllocator {
   uint8_t* GetBuffer() const { return data_; }
   size_t GetMaxBufferSize() const { return data_size_max_; }
 
+  // Stack-style release of tail memory. GetTailMark() remembers how much of
+  // the tail is in use, ResetTailToMark() gives back everything allocated from
+  // the tail since then. Marks have to be reset in reverse order.
+  size_t GetTailMark() const { return data_size_; }
+  void ResetTailToMark(size_t mark);
+
   // Child allocator is something like a temporary allocator. Memory allocated
   // by the child allocator will be freed once the child allocator is
   // deallocated. Child allocator could be cascaded to have for example
@@ -0,0 +1,57 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_SPARE_BUFFERS_H_
+#define TENSORFLOW_LITE_MICRO_SPARE_BUFFERS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+
+namespace tflite {
+
+// Kernels can keep data they are able to run without, e.g. a copy of their
+// weights in a faster layout, in whatever the arena has left over. A kernel
+// requests a spare buffer in Prepare, with a SpareBuffer inside its own
+// persistent buffer. Once tensors, scratch buffers, variables and persistent
+// buffers all have their place, FinishTensorAllocation takes the spare
+// buffers from the tail of the arena in the order they were requested, as
+// long as they fit. The others stay empty and AllocateTensors() succeeds all
+// the same. Their content is undefined, kernels fill them during Eval.
+struct SpareBuffer {
+  size_t bytes;
+  // From this struct to the buffer, 0 while there is none. Both live in the
+  // persistent area, so a restored snapshot needs no relocation.
+  ptrdiff_t offset;
+  // Next request, only used until FinishTensorAllocation.
+  SpareBuffer* next;
+};
+
+// Called in Prepare. `buffer` has to be in a persistent buffer.
+void RequestSpareBuffer(TfLiteContext* context, size_t bytes,
+                        SpareBuffer* buffer);
+
+// The buffer, or null if it was not requested or did not fit.
+inline void* GetSpareBuffer(const SpareBuffer& buffer) {
+  if (buffer.offset == 0) {
+    return nullptr;
+  }
+  return const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(&buffer)) +
+         buffer.offset;
+}
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_SPARE_BUFFERS_H_
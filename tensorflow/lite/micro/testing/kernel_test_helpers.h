@@ -0,0 +1,132 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_TESTING_KERNEL_TEST_HELPERS_H_
+#define TENSORFLOW_LITE_MICRO_TESTING_KERNEL_TEST_HELPERS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/compatibility.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/testing/micro_test.h"
+#include "tensorflow/lite/micro/testing/test_model_builder.h"
+
+// Weights, bias and a runner for tests that compare a single int8 operator
+// model, built with TestModelBuilder, against the reference kernels.
+
+namespace tflite {
+namespace testing {
+
+inline int8_t InputValue(int i) { return (i * 37 + 11) % 256 - 128; }
+
+inline int8_t Weight(int i) { return (i * 13 + 5) % 255 - 127; }
+
+inline int32_t BiasValue(int i) { return (i * 997) % 4001 - 2000; }
+
+inline float FilterScale(int channel) { return 0.002f * (channel + 1); }
+
+// Constant int8 weights and int32 bias with one scale per channel, and the
+// matching per channel output multipliers.
+struct Weights {
+  static constexpr int kMaxWeights = 256;
+  static constexpr int kMaxChannels = 8;
+
+  int8_t filter[kMaxWeights];
+  int32_t bias[kMaxChannels];
+  float filter_scales[kMaxChannels];
+  float bias_scales[kMaxChannels];
+  int64_t zero_points[kMaxChannels];
+  int32_t multipliers[kMaxChannels];
+  int32_t shifts[kMaxChannels];
+};
+
+// Fills `filter_size` weights and `channels` biases, scales and multipliers
+// for an operator from `input_scale` to `output_scale`.
+inline void FillWeights(int filter_size, int channels, float input_scale,
+                        float output_scale, Weights* weights) {
+  TFLITE_DCHECK(filter_size <= Weights::kMaxWeights &&
+                channels <= Weights::kMaxChannels);
+  for (int i = 0; i < filter_size; ++i) {
+    weights->filter[i] = Weight(i);
+  }
+  for (int c = 0; c < channels; ++c) {
+    weights->bias[c] = BiasValue(c);
+    weights->filter_scales[c] = FilterScale(c);
+    weights->bias_scales[c] = input_scale * FilterScale(c);
+    weights->zero_points[c] = 0;
+    QuantizeMultiplier(static_cast<double>(input_scale) *
+                           static_cast<double>(FilterScale(c)) /
+                           static_cast<double>(output_scale),
+                       &weights->multipliers[c], &weights->shifts[c]);
+  }
+}
+
+// Adds the filter and bias of `weights` to `builder`, returns the filter and
+// sets `bias`. The filter has `channels` scales along `quantized_dimension`,
+// the bias one value per entry of that dimension.
+inline int AddWeights(TestModelBuilder* builder, const int32_t* filter_shape,
+                      int rank, int filter_size, int channels,
+                      int quantized_dimension, const Weights& weights,
+                      int* bias) {
+  const int filter = builder->AddTensor(
+      TensorType_INT8, filter_shape, rank, weights.filter, filter_size,
+      weights.filter_scales, weights.zero_points, channels,
+      quantized_dimension);
+  const int32_t bias_shape[] = {filter_shape[quantized_dimension]};
+  *bias = builder->AddTensor(TensorType_INT32, bias_shape, 1, weights.bias,
+                             filter_shape[quantized_dimension] *
+                                 sizeof(int32_t),
+                             weights.bias_scales, weights.zero_points,
+                             channels);
+  return filter;
+}
+
+// Runs the single operator model on `input_size` values of `input_data`, or
+// of InputValue if it is null, and copies `output_size` output values.
+inline void RunInt8Model(const Model* model, BuiltinOperator op,
+                         TfLiteRegistration* registration, int max_version,
+                         const int8_t* input_data, int input_size,
+                         int8_t* output_data, int output_size) {
+  MicroMutableOpResolver resolver;
+  resolver.AddBuiltin(op, registration, 1, max_version);
+  constexpr size_t kArenaSize = 24576;
+  alignas(16) uint8_t arena[kArenaSize];
+  MicroInterpreter interpreter(model, resolver, arena, kArenaSize,
+                               micro_test::reporter);
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.AllocateTensors());
+  for (int i = 0; i < input_size; ++i) {
+    interpreter.input(0)->data.int8[i] =
+        input_data != nullptr ? input_data[i] : InputValue(i);
+  }
+  TF_LITE_MICRO_EXPECT_EQ(kTfLiteOk, interpreter.Invoke());
+  for (int i = 0; i < output_size; ++i) {
+    output_data[i] = interpreter.output(0)->data.int8[i];
+  }
+}
+
+inline void ExpectEqual(const int8_t* expected, const int8_t* actual,
+                        int size) {
+  for (int i = 0; i < size; ++i) {
+    TF_LITE_MICRO_EXPECT_EQ(expected[i], actual[i]);
+  }
+}
+
+}  // namespace testing
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_TESTING_KERNEL_TEST_HELPERS_H_
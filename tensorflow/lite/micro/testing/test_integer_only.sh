@@ -0,0 +1,89 @@
+#!/usr/bin/env bash
+# Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+#
+# Checks that int8 models built with TF_LITE_INTEGER_ONLY run Invoke() without
+# a single soft-float call. Builds tensorflow/lite/micro/integer_only_test.cc
+# with the library for a Cortex-M3 without FPU, wraps every __aeabi float
+# helper so that the test can count the calls, and runs it in QEMU user mode.
+#
+# Needs the GNU Arm Embedded toolchain (arm-none-eabi-g++) and qemu-arm.
+# Run from the repository root:
+#   tensorflow/lite/micro/testing/test_integer_only.sh
+
+set -e
+
+CXX=${CXX:-arm-none-eabi-g++}
+CC=${CC:-arm-none-eabi-gcc}
+QEMU=${QEMU:-qemu-arm}
+OUT=${OUT:-/tmp/tflm_integer_only}
+CMSIS=tensorflow/lite/micro/tools/make/downloads/cmsis/CMSIS
+
+mkdir -p "${OUT}/obj"
+
+# debug_log.h expects mbed's Serial. Semihosting stdout stands in for it.
+cat > "${OUT}/mbed.h" <<EOF
+#include <cstdio>
+struct Serial {};
+EOF
+cat > "${OUT}/debug_log.cc" <<EOF
+#include "tensorflow/lite/micro/debug_log.h"
+Serial pc;
+extern "C" void DebugLog(const char* s) { fputs(s, stdout); }
+EOF
+
+FLAGS="-mcpu=cortex-m3 -mthumb -mfloat-abi=soft -O2 -DNDEBUG \
+  -DTF_LITE_STATIC_MEMORY -DTF_LITE_INTEGER_ONLY -DTF_LITE_TRAP_SOFT_FLOAT \
+  -I. -I${OUT} -Ithird_party/flatbuffers/include -Ithird_party/gemmlowp \
+  -I${CMSIS}/NN/Include -I${CMSIS}/DSP/Include -I${CMSIS}/Core/Include"
+
+SOURCES=$(find tensorflow -name '*.cc' -not -path '*/mbed/*' \
+  -not -path '*/tools/*' -not -name '*_test.cc')
+OBJECTS=""
+for src in ${SOURCES} tensorflow/lite/micro/integer_only_test.cc \
+    "${OUT}/debug_log.cc"; do
+  obj="${OUT}/obj/$(echo "${src}" | tr / _).o"
+  ${CXX} -std=c++11 -fno-rtti -fno-exceptions ${FLAGS} -c "${src}" -o "${obj}"
+  OBJECTS="${OBJECTS} ${obj}"
+done
+for src in $(find ${CMSIS}/NN/Source -name '*.c') tensorflow/lite/c/common.c; do
+  obj="${OUT}/obj/$(echo "${src}" | tr / _).o"
+  ${CC} -std=c99 ${FLAGS} -c "${src}" -o "${obj}"
+  OBJECTS="${OBJECTS} ${obj}"
+done
+
+# Every helper wrapped in integer_only_test.cc.
+WRAPS=""
+for type in f d; do
+  for helper in add sub rsub mul div cmpeq cmplt cmple cmpge cmpgt cmpun \
+      2iz 2uiz 2lz 2ulz; do
+    WRAPS="${WRAPS} -Wl,--wrap=__aeabi_${type}${helper}"
+  done
+  for helper in i2 ui2 l2 ul2; do
+    WRAPS="${WRAPS} -Wl,--wrap=__aeabi_${helper}${type}"
+  done
+done
+WRAPS="${WRAPS} -Wl,--wrap=__aeabi_f2d -Wl,--wrap=__aeabi_d2f"
+
+${CXX} ${FLAGS} --specs=rdimon.specs ${OBJECTS} ${WRAPS} -lm \
+  -o "${OUT}/integer_only_test"
+
+${QEMU} -cpu cortex-m3 "${OUT}/integer_only_test" 2>&1 | tee "${OUT}/log.txt"
+if grep -q "~~~ALL TESTS PASSED~~~" "${OUT}/log.txt"; then
+  echo "PASS"
+else
+  echo "FAIL"
+  exit 1
+fi
@@ -0,0 +1,87 @@
+#!/usr/bin/env bash
+# Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+#
+# Runs the CMSIS-NN kernel tests on a Cortex-M4, where __ARM_FEATURE_DSP
+# selects the DSP paths of the kernels (batched fully connected through
+# arm_nn_mat_mult_nt_t_s8, the per-batch depthwise and average pool calls,
+# the folded bias kernels). A host build only covers the plain C paths.
+# Builds the library and each test for the Cortex-M4 and runs the tests in
+# QEMU user mode.
+#
+# Needs the GNU Arm Embedded toolchain (arm-none-eabi-g++) and qemu-arm.
+# Run from the repository root:
+#   tensorflow/lite/micro/testing/test_kernels_dsp.sh
+
+set -e
+
+CXX=${CXX:-arm-none-eabi-g++}
+CC=${CC:-arm-none-eabi-gcc}
+QEMU=${QEMU:-qemu-arm}
+OUT=${OUT:-/tmp/tflm_kernels_dsp}
+CMSIS=tensorflow/lite/micro/tools/make/downloads/cmsis/CMSIS
+TESTS="tensorflow/lite/micro/kernels/batch_test.cc
+  tensorflow/lite/micro/kernels/folded_bias_test.cc
+  tensorflow/lite/micro/kernels/int4_weights_test.cc"
+
+mkdir -p "${OUT}/obj"
+
+# debug_log.h expects mbed's Serial. Semihosting stdout stands in for it.
+cat > "${OUT}/mbed.h" <<EOF
+#include <cstdio>
+struct Serial {};
+EOF
+cat > "${OUT}/debug_log.cc" <<EOF
+#include "tensorflow/lite/micro/debug_log.h"
+Serial pc;
+extern "C" void DebugLog(const char* s) { fputs(s, stdout); }
+EOF
+
+FLAGS="-mcpu=cortex-m4 -mthumb -mfloat-abi=soft -O2 -DNDEBUG \
+  -DTF_LITE_STATIC_MEMORY \
+  -I. -I${OUT} -Ithird_party/flatbuffers/include -Ithird_party/gemmlowp \
+  -I${CMSIS}/NN/Include -I${CMSIS}/DSP/Include -I${CMSIS}/Core/Include"
+
+SOURCES=$(find tensorflow -name '*.cc' -not -path '*/mbed/*' \
+  -not -path '*/tools/*' -not -name '*_test.cc')
+OBJECTS=""
+for src in ${SOURCES} "${OUT}/debug_log.cc"; do
+  obj="${OUT}/obj/$(echo "${src}" | tr / _).o"
+  ${CXX} -std=c++11 -fno-rtti -fno-exceptions ${FLAGS} -c "${src}" -o "${obj}"
+  OBJECTS="${OBJECTS} ${obj}"
+done
+for src in $(find ${CMSIS}/NN/Source -name '*.c') tensorflow/lite/c/common.c; do
+  obj="${OUT}/obj/$(echo "${src}" | tr / _).o"
+  ${CC} -std=c99 ${FLAGS} -c "${src}" -o "${obj}"
+  OBJECTS="${OBJECTS} ${obj}"
+done
+
+FAILED=""
+for test in ${TESTS}; do
+  name=$(basename "${test}" .cc)
+  ${CXX} -std=c++11 -fno-rtti -fno-exceptions ${FLAGS} --specs=rdimon.specs \
+    "${test}" ${OBJECTS} -lm -o "${OUT}/${name}"
+  ${QEMU} -cpu cortex-m4 "${OUT}/${name}" 2>&1 | tee "${OUT}/${name}.txt"
+  if ! grep -q "~~~ALL TESTS PASSED~~~" "${OUT}/${name}.txt"; then
+    FAILED="${FAILED} ${name}"
+  fi
+done
+
+if [ -z "${FAILED}" ]; then
+  echo "PASS"
+else
+  echo "FAIL:${FAILED}"
+  exit 1
+fi
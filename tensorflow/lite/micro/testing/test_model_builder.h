@@ -0,0 +1,194 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_TESTING_TEST_MODEL_BUILDER_H_
+#define TENSORFLOW_LITE_MICRO_TESTING_TEST_MODEL_BUILDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+#include "tensorflow/lite/kernels/internal/compatibility.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/version.h"
+
+namespace tflite {
+namespace testing {
+
+// Builds models with constant and quantized tensors, builtin options and
+// metadata, for kernel tests that run through MicroInterpreter.
+// The model lives in the builder's heap allocated buffer, so this is meant
+// for host tests only.
+class TestModelBuilder {
+ public:
+  TestModelBuilder() { buffers_[next_buffer_id_++] = CreateBuffer(builder_); }
+
+  flatbuffers::FlatBufferBuilder* builder() { return &builder_; }
+
+  int AddOperatorCode(BuiltinOperator op, int32_t version = 1) {
+    TFLITE_DCHECK(next_operator_code_id_ < kMaxOperatorCodes);
+    operator_codes_[next_operator_code_id_] =
+        CreateOperatorCode(builder_, op, 0, version);
+    return next_operator_code_id_++;
+  }
+
+  // Adds a tensor. Tensors with `data` are constant, the others activations.
+  // `scales` and `zero_points` hold `num_channels` entries when quantized.
+  int AddTensor(TensorType type, const int32_t* shape, int rank,
+                const void* data = nullptr, size_t bytes = 0,
+                const float* scales = nullptr,
+                const int64_t* zero_points = nullptr, int num_channels = 0,
+                int quantized_dimension = 0,
+                flatbuffers::Offset<SparsityParameters> sparsity = 0) {
+    TFLITE_DCHECK(next_tensor_id_ < kMaxTensors);
+    const int buffer = data == nullptr ? 0 : AddBuffer(data, bytes);
+    flatbuffers::Offset<QuantizationParameters> quantization = 0;
+    if (num_channels > 0) {
+      quantization = CreateQuantizationParameters(
+          builder_, 0, 0, builder_.CreateVector(scales, num_channels),
+          builder_.CreateVector(zero_points, num_channels),
+          QuantizationDetails_NONE, 0, quantized_dimension);
+    }
+    tensors_[next_tensor_id_] =
+        CreateTensor(builder_, builder_.CreateVector(shape, rank), type,
+                     buffer, 0, quantization, false, sparsity);
+    return next_tensor_id_++;
+  }
+
+  // Sparsity parameters of a [rows, cols] matrix whose non-zero values are
+  // stored in `blocks` blocks of `block_size` columns. `segments` holds the
+  // rows + 1 CSR offsets and `indices` the block column of each block.
+  flatbuffers::Offset<SparsityParameters> CreateBlockSparsity(
+      int rows, int cols, int block_size, const int32_t* segments,
+      const int32_t* indices, int blocks) {
+    const int32_t traversal_order[] = {0, 1, 2};
+    const int32_t block_map[] = {1};
+    const flatbuffers::Offset<DimensionMetadata> dim_metadata[] = {
+        CreateDimensionMetadata(builder_, DimensionType_DENSE, rows),
+        CreateDimensionMetadata(
+            builder_, DimensionType_SPARSE_CSR, cols / block_size,
+            SparseIndexVector_Int32Vector,
+            CreateInt32Vector(builder_,
+                              builder_.CreateVector(segments, rows + 1))
+                .Union(),
+            SparseIndexVector_Int32Vector,
+            CreateInt32Vector(builder_, builder_.CreateVector(indices, blocks))
+                .Union()),
+        CreateDimensionMetadata(builder_, DimensionType_DENSE, block_size)};
+    return CreateSparsityParameters(
+        builder_, builder_.CreateVector(traversal_order, 3),
+        builder_.CreateVector(block_map, 1),
+        builder_.CreateVector(dim_metadata, 3));
+  }
+
+  // Adds a per-tensor quantized activation tensor.
+  int AddQuantizedTensor(TensorType type, std::initializer_list<int32_t> shape,
+                         float scale, int64_t zero_point) {
+    return AddTensor(type, shape.begin(), shape.size(), nullptr, 0, &scale,
+                     &zero_point, 1);
+  }
+
+  int AddOperator(int operator_code, std::initializer_list<int32_t> inputs,
+                  std::initializer_list<int32_t> outputs,
+                  BuiltinOptions options_type = BuiltinOptions_NONE,
+                  flatbuffers::Offset<void> options = 0) {
+    TFLITE_DCHECK(next_operator_id_ < kMaxOperators);
+    operators_[next_operator_id_] = CreateOperator(
+        builder_, operator_code,
+        builder_.CreateVector(inputs.begin(), inputs.size()),
+        builder_.CreateVector(outputs.begin(), outputs.size()), options_type,
+        options);
+    return next_operator_id_++;
+  }
+
+  // Adds a metadata entry named `name` whose buffer holds `words`.
+  void AddMetadata(const char* name, const uint32_t* words, int count) {
+    TFLITE_DCHECK(next_metadata_id_ < kMaxMetadata);
+    const int buffer = AddBuffer(words, count * sizeof(uint32_t));
+    metadata_[next_metadata_id_++] =
+        CreateMetadata(builder_, builder_.CreateString(name), buffer);
+  }
+
+  // Ends the current subgraph. Tensors and operators added afterwards belong
+  // to the next subgraph, and their indices start from 0 again.
+  void FinishSubgraph(std::initializer_list<int32_t> inputs,
+                      std::initializer_list<int32_t> outputs) {
+    TFLITE_DCHECK(next_subgraph_id_ < kMaxSubgraphs);
+    subgraphs_[next_subgraph_id_++] = CreateSubGraph(
+        builder_, builder_.CreateVector(tensors_, next_tensor_id_),
+        builder_.CreateVector(inputs.begin(), inputs.size()),
+        builder_.CreateVector(outputs.begin(), outputs.size()),
+        builder_.CreateVector(operators_, next_operator_id_));
+    next_tensor_id_ = 0;
+    next_operator_id_ = 0;
+  }
+
+  // Ends the last subgraph with `inputs` and `outputs` and builds the model.
+  const Model* BuildModel(std::initializer_list<int32_t> inputs,
+                          std::initializer_list<int32_t> outputs) {
+    FinishSubgraph(inputs, outputs);
+    const flatbuffers::Offset<Model> model = CreateModel(
+        builder_, TFLITE_SCHEMA_VERSION,
+        builder_.CreateVector(operator_codes_, next_operator_code_id_),
+        builder_.CreateVector(subgraphs_, next_subgraph_id_), 0,
+        builder_.CreateVector(buffers_, next_buffer_id_), 0,
+        next_metadata_id_ == 0
+            ? 0
+            : builder_.CreateVector(metadata_, next_metadata_id_));
+    FinishModelBuffer(builder_, model);
+    return GetModel(builder_.GetBufferPointer());
+  }
+
+ private:
+  int AddBuffer(const void* data, size_t bytes) {
+    TFLITE_DCHECK(next_buffer_id_ < kMaxBuffers);
+    // Kernels may read constant data with wider loads.
+    builder_.ForceVectorAlignment(bytes, 1, 16);
+    buffers_[next_buffer_id_] = CreateBuffer(
+        builder_, builder_.CreateVector(static_cast<const uint8_t*>(data),
+                                        bytes));
+    return next_buffer_id_++;
+  }
+
+  flatbuffers::FlatBufferBuilder builder_;
+
+  static constexpr int kMaxOperatorCodes = 8;
+  flatbuffers::Offset<OperatorCode> operator_codes_[kMaxOperatorCodes];
+  int next_operator_code_id_ = 0;
+
+  static constexpr int kMaxSubgraphs = 4;
+  flatbuffers::Offset<SubGraph> subgraphs_[kMaxSubgraphs];
+  int next_subgraph_id_ = 0;
+
+  static constexpr int kMaxOperators = 16;
+  flatbuffers::Offset<Operator> operators_[kMaxOperators];
+  int next_operator_id_ = 0;
+
+  static constexpr int kMaxTensors = 32;
+  flatbuffers::Offset<Tensor> tensors_[kMaxTensors];
+  int next_tensor_id_ = 0;
+
+  static constexpr int kMaxBuffers = 32;
+  flatbuffers::Offset<Buffer> buffers_[kMaxBuffers];
+  int next_buffer_id_ = 0;
+
+  static constexpr int kMaxMetadata = 4;
+  flatbuffers::Offset<Metadata> metadata_[kMaxMetadata];
+  int next_metadata_id_ = 0;
+};
+
+}  // namespace testing
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_TESTING_TEST_MODEL_BUILDER_H_
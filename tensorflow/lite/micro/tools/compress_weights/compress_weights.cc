@@ -0,0 +1,308 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that stores the weights of FULLY_CONNECTED, CONV_2D and
+// DEPTHWISE_CONV_2D as palette indices when they take few distinct values,
+// e.g. after weight clustering, or as packed int4 when they are int8 values
+// within [-8, 7], e.g. after 4 bit quantization aware training. See
+// tensorflow/lite/micro/compressed_weights.h for the format and the runtime
+// side.
+//
+// Build and run on the host, from the repository root:
+//   g++ -std=c++11 -I. -Ithird_party/flatbuffers/include -o compress_weights
+//     tensorflow/lite/micro/tools/compress_weights/compress_weights.cc
+//   ./compress_weights model.tflite compressed.tflite
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/micro/compressed_weights.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+// Below this, the palette and metadata outweigh the savings.
+constexpr size_t kMinTensorBytes = 64;
+
+bool ReadFile(const char* path, std::vector<char>* contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  return true;
+}
+
+size_t ElementSize(tflite::TensorType type) {
+  switch (type) {
+    case tflite::TensorType_INT8:
+    case tflite::TensorType_UINT8:
+    case tflite::TensorType_BOOL:
+      return 1;
+    case tflite::TensorType_INT16:
+    case tflite::TensorType_FLOAT16:
+      return 2;
+    case tflite::TensorType_INT32:
+    case tflite::TensorType_FLOAT32:
+      return 4;
+    case tflite::TensorType_INT64:
+    case tflite::TensorType_COMPLEX64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+bool IsWeightsInput(tflite::BuiltinOperator op, size_t input) {
+  return input == 1 && (op == tflite::BuiltinOperator_FULLY_CONNECTED ||
+                        op == tflite::BuiltinOperator_CONV_2D ||
+                        op == tflite::BuiltinOperator_DEPTHWISE_CONV_2D);
+}
+
+// Replaces the contents of `data` with packed palette indices and returns the
+// palette, or an empty palette if the values don't fit into 16 entries.
+std::vector<uint8_t> Compress(size_t element_size, std::vector<uint8_t>* data,
+                              int* bits) {
+  const size_t count = data->size() / element_size;
+  std::map<std::string, int> palette_index;
+  std::vector<uint8_t> palette;
+  std::vector<int> indices(count);
+  for (size_t i = 0; i < count; ++i) {
+    const std::string value(
+        reinterpret_cast<const char*>(data->data() + i * element_size),
+        element_size);
+    auto it = palette_index.find(value);
+    if (it == palette_index.end()) {
+      if (palette_index.size() == 16) {
+        return {};
+      }
+      it = palette_index.emplace(value, palette_index.size()).first;
+      palette.insert(palette.end(), value.begin(), value.end());
+    }
+    indices[i] = it->second;
+  }
+  *bits = palette_index.size() <= 2 ? 1 : palette_index.size() <= 4 ? 2 : 4;
+  const int per_byte = 8 / *bits;
+  std::vector<uint8_t> packed((count + per_byte - 1) / per_byte, 0);
+  for (size_t i = 0; i < count; ++i) {
+    packed[i / per_byte] |= indices[i] << ((i % per_byte) * *bits);
+  }
+  data->swap(packed);
+  return palette;
+}
+
+// Packs `data` as int4 if it holds int8 values within [-8, 7].
+bool PackInt4(std::vector<uint8_t>* data) {
+  std::vector<uint8_t> packed((data->size() + 1) / 2, 0);
+  for (size_t i = 0; i < data->size(); ++i) {
+    const int value = static_cast<int8_t>((*data)[i]);
+    if (value < -8 || value > 7) {
+      return false;
+    }
+    packed[i / 2] |= (value & 0x0F) << ((i % 2) * 4);
+  }
+  data->swap(packed);
+  return true;
+}
+
+void AppendWord(uint32_t value, std::vector<uint8_t>* table) {
+  for (int i = 0; i < 4; ++i) {
+    table->push_back((value >> (i * 8)) & 0xFF);
+  }
+}
+
+// Adds a metadata entry named `name` holding the header and `table`.
+void AddTable(const char* name, uint32_t version, uint32_t entries,
+              const std::vector<uint8_t>& table, tflite::ModelT* model) {
+  std::vector<uint8_t> data;
+  AppendWord(version, &data);
+  AppendWord(entries, &data);
+  data.insert(data.end(), table.begin(), table.end());
+  model->buffers.emplace_back(new tflite::BufferT);
+  model->buffers.back()->data = data;
+  model->metadata.emplace_back(new tflite::MetadataT);
+  model->metadata.back()->name = name;
+  model->metadata.back()->buffer = model->buffers.size() - 1;
+}
+
+// Same as Pack(), but keeps buffers 16 byte aligned like the converter does,
+// since kernels read them in place.
+void Serialize(const tflite::ModelT& model,
+               flatbuffers::FlatBufferBuilder* fbb) {
+  std::vector<flatbuffers::Offset<tflite::Buffer>> buffers;
+  for (const auto& buffer : model.buffers) {
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> data = 0;
+    if (!buffer->data.empty()) {
+      fbb->ForceVectorAlignment(buffer->data.size(), 1, 16);
+      data = fbb->CreateVector(buffer->data);
+    }
+    buffers.push_back(tflite::CreateBuffer(*fbb, data));
+  }
+  std::vector<flatbuffers::Offset<tflite::OperatorCode>> operator_codes;
+  for (const auto& code : model.operator_codes) {
+    operator_codes.push_back(tflite::CreateOperatorCode(*fbb, code.get()));
+  }
+  std::vector<flatbuffers::Offset<tflite::SubGraph>> subgraphs;
+  for (const auto& subgraph : model.subgraphs) {
+    subgraphs.push_back(tflite::CreateSubGraph(*fbb, subgraph.get()));
+  }
+  std::vector<flatbuffers::Offset<tflite::Metadata>> metadata;
+  for (const auto& entry : model.metadata) {
+    metadata.push_back(tflite::CreateMetadata(*fbb, entry.get()));
+  }
+  auto root = tflite::CreateModel(
+      *fbb, model.version, fbb->CreateVector(operator_codes),
+      fbb->CreateVector(subgraphs),
+      model.description.empty() ? 0 : fbb->CreateString(model.description),
+      fbb->CreateVector(buffers),
+      model.metadata_buffer.empty() ? 0
+                                    : fbb->CreateVector(model.metadata_buffer),
+      metadata.empty() ? 0 : fbb->CreateVector(metadata));
+  tflite::FinishModelBuffer(*fbb, root);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <model.tflite> <compressed.tflite>\n", argv[0]);
+    return 1;
+  }
+  std::vector<char> input;
+  if (!ReadFile(argv[1], &input)) {
+    fprintf(stderr, "Failed to read %s\n", argv[1]);
+    return 1;
+  }
+  flatbuffers::Verifier verifier(
+      reinterpret_cast<const uint8_t*>(input.data()), input.size());
+  if (!tflite::VerifyModelBuffer(verifier)) {
+    fprintf(stderr, "%s is not a valid TensorFlow Lite model\n", argv[1]);
+    return 1;
+  }
+  std::unique_ptr<tflite::ModelT> model =
+      tflite::UnPackModel(input.data());
+  for (const auto& entry : model->metadata) {
+    if (entry->name == tflite::kCompressedWeightsMetadata ||
+        entry->name == tflite::kInt4WeightsMetadata) {
+      fprintf(stderr, "%s is already compressed\n", argv[1]);
+      return 1;
+    }
+  }
+
+  // Buffers shared between tensors are left alone.
+  std::vector<int> buffer_users(model->buffers.size(), 0);
+  for (const auto& subgraph : model->subgraphs) {
+    for (const auto& tensor : subgraph->tensors) {
+      ++buffer_users[tensor->buffer];
+    }
+  }
+
+  std::vector<uint8_t> table;
+  uint32_t entries = 0;
+  std::vector<uint8_t> int4_table;
+  uint32_t int4_entries = 0;
+  size_t saved_bytes = 0;
+  for (size_t s = 0; s < model->subgraphs.size(); ++s) {
+    tflite::SubGraphT* subgraph = model->subgraphs[s].get();
+    std::vector<bool> is_weights(subgraph->tensors.size(), false);
+    for (const auto& op : subgraph->operators) {
+      const tflite::BuiltinOperator code =
+          model->operator_codes[op->opcode_index]->builtin_code;
+      for (size_t i = 0; i < op->inputs.size(); ++i) {
+        if (op->inputs[i] >= 0 && IsWeightsInput(code, i)) {
+          is_weights[op->inputs[i]] = true;
+        }
+      }
+    }
+    for (size_t t = 0; t < subgraph->tensors.size(); ++t) {
+      tflite::TensorT* tensor = subgraph->tensors[t].get();
+      std::vector<uint8_t>& data = model->buffers[tensor->buffer]->data;
+      const size_t element_size = ElementSize(tensor->type);
+      if (!is_weights[t] || tensor->sparsity || tensor->is_variable ||
+          buffer_users[tensor->buffer] != 1 || element_size == 0 ||
+          data.size() < kMinTensorBytes) {
+        continue;
+      }
+      const size_t original_size = data.size();
+      // Int4 needs no palette and is read in place by the kernels, while
+      // palettes of up to 4 values take fewer bits.
+      std::vector<uint8_t> unpacked = data;
+      int bits;
+      std::vector<uint8_t> palette = Compress(element_size, &data, &bits);
+      if (tensor->type == tflite::TensorType_INT8 &&
+          (palette.empty() || bits == 4) && PackInt4(&unpacked)) {
+        data.swap(unpacked);
+        saved_bytes += original_size - data.size();
+        printf("Tensor %zu of subgraph %zu: %zu -> %zu bytes, int4.\n", t, s,
+               original_size, data.size());
+        AppendWord(s, &int4_table);
+        AppendWord(t, &int4_table);
+        ++int4_entries;
+        continue;
+      }
+      if (palette.empty()) {
+        printf("Tensor %zu of subgraph %zu has more than 16 values, kept.\n",
+               t, s);
+        continue;
+      }
+      saved_bytes += original_size - data.size() - palette.size();
+      printf("Tensor %zu of subgraph %zu: %zu -> %zu bytes, %d bits.\n", t, s,
+             original_size, data.size() + palette.size(), bits);
+
+      model->buffers.emplace_back(new tflite::BufferT);
+      model->buffers.back()->data = palette;
+      AppendWord(s, &table);
+      AppendWord(t, &table);
+      AppendWord(model->buffers.size() - 1, &table);
+      AppendWord(bits, &table);
+      ++entries;
+    }
+  }
+  if (entries + int4_entries == 0) {
+    fprintf(stderr, "No compressible weights found in %s\n", argv[1]);
+    return 1;
+  }
+
+  if (entries > 0) {
+    AddTable(tflite::kCompressedWeightsMetadata,
+             tflite::kCompressedWeightsVersion, entries, table, model.get());
+  }
+  if (int4_entries > 0) {
+    AddTable(tflite::kInt4WeightsMetadata, tflite::kInt4WeightsVersion,
+             int4_entries, int4_table, model.get());
+  }
+
+  flatbuffers::FlatBufferBuilder fbb;
+  Serialize(*model, &fbb);
+  FILE* out = fopen(argv[2], "wb");
+  if (out == nullptr ||
+      fwrite(fbb.GetBufferPointer(), 1, fbb.GetSize(), out) != fbb.GetSize()) {
+    fprintf(stderr, "Failed to write %s\n", argv[2]);
+    return 1;
+  }
+  fclose(out);
+  printf("Compressed %u tensors, %zu -> %zu bytes (%zu bytes of weights "
+         "saved).\n",
+         entries + int4_entries, input.size(), static_cast<size_t>(fbb.GetSize()),
+         saved_bytes);
+  return 0;
+}
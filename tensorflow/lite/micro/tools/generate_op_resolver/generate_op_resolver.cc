@@ -0,0 +1,264 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that reads one or more .tflite models and writes a header with a
+// ModelOpResolver holding exactly the operators (and versions) they use. See
+// tensorflow/lite/micro/micro_static_op_resolver.h for the runtime side.
+//
+// Build and run on the host, from the repository root:
+//   g++ -std=c++11 -I. -Ithird_party/flatbuffers/include -o generate_op_resolver
+//     tensorflow/lite/micro/tools/generate_op_resolver/generate_op_resolver.cc
+//   ./generate_op_resolver src/model_op_resolver.h model.tflite
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+struct UsedOp {
+  int min_version;
+  int max_version;
+};
+
+bool ReadFile(const char* path, std::vector<char>* contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  return true;
+}
+
+template <typename Key>
+void RecordVersion(const Key& key, int version, std::map<Key, UsedOp>* ops) {
+  auto it = ops->find(key);
+  if (it == ops->end()) {
+    (*ops)[key] = {version, version};
+  } else {
+    it->second.min_version = std::min(it->second.min_version, version);
+    it->second.max_version = std::max(it->second.max_version, version);
+  }
+}
+
+// Collects the operators referenced from any subgraph of the model. Operator
+// codes that are listed but never used by an operator are skipped.
+bool CollectOps(const tflite::Model* model,
+                std::map<tflite::BuiltinOperator, UsedOp>* builtin_ops,
+                std::map<std::string, UsedOp>* custom_ops) {
+  const auto* opcodes = model->operator_codes();
+  if (opcodes == nullptr || model->subgraphs() == nullptr) {
+    return false;
+  }
+  for (const tflite::SubGraph* subgraph : *model->subgraphs()) {
+    if (subgraph->operators() == nullptr) {
+      continue;
+    }
+    for (const tflite::Operator* op : *subgraph->operators()) {
+      if (op->opcode_index() >= opcodes->size()) {
+        fprintf(stderr, "Invalid opcode_index %u\n", op->opcode_index());
+        return false;
+      }
+      const tflite::OperatorCode* opcode = opcodes->Get(op->opcode_index());
+      const int version = opcode->version();
+      if (opcode->builtin_code() == tflite::BuiltinOperator_CUSTOM) {
+        if (opcode->custom_code() == nullptr) {
+          fprintf(stderr, "CUSTOM operator without custom_code\n");
+          return false;
+        }
+        RecordVersion(opcode->custom_code()->str(), version, custom_ops);
+      } else {
+        RecordVersion(opcode->builtin_code(), version, builtin_ops);
+      }
+    }
+  }
+  return true;
+}
+
+// Custom op names are free-form strings, so make them usable as a C++
+// identifier for the Register_ function the application has to provide.
+std::string RegisterFunctionForCustomOp(const std::string& name) {
+  std::string result = "Register_";
+  for (char c : name) {
+    result += std::isalnum(static_cast<unsigned char>(c))
+                  ? static_cast<char>(std::toupper(c))
+                  : '_';
+  }
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <output.h> <model.tflite> [<model.tflite>...]\n",
+            argv[0]);
+    return 1;
+  }
+
+  std::map<tflite::BuiltinOperator, UsedOp> builtin_ops;
+  std::map<std::string, UsedOp> custom_ops;
+  for (int i = 2; i < argc; ++i) {
+    std::vector<char> buffer;
+    if (!ReadFile(argv[i], &buffer)) {
+      fprintf(stderr, "Failed to read %s\n", argv[i]);
+      return 1;
+    }
+    flatbuffers::Verifier verifier(
+        reinterpret_cast<const uint8_t*>(buffer.data()), buffer.size());
+    if (!tflite::VerifyModelBuffer(verifier)) {
+      fprintf(stderr, "%s is not a valid TensorFlow Lite model\n", argv[i]);
+      return 1;
+    }
+    if (!CollectOps(tflite::GetModel(buffer.data()), &builtin_ops,
+                    &custom_ops)) {
+      fprintf(stderr, "Failed to collect operators from %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  const size_t op_count = builtin_ops.size() + custom_ops.size();
+  if (op_count == 0 || op_count >= 0xFF) {
+    fprintf(stderr, "Unsupported number of operators: %zu\n", op_count);
+    return 1;
+  }
+
+  FILE* out = fopen(argv[1], "w");
+  if (out == nullptr) {
+    fprintf(stderr, "Failed to open %s for writing\n", argv[1]);
+    return 1;
+  }
+
+  fprintf(out,
+          "// Automatically created by "
+          "tensorflow/lite/micro/tools/generate_op_resolver from:\n");
+  for (int i = 2; i < argc; ++i) {
+    fprintf(out, "//   %s\n", argv[i]);
+  }
+  fprintf(out,
+          "// Regenerate it whenever the model changes.\n\n"
+          "#ifndef MODEL_OP_RESOLVER_H_\n"
+          "#define MODEL_OP_RESOLVER_H_\n\n"
+          "#include \"tensorflow/lite/micro/compatibility.h\"\n"
+          "#include \"tensorflow/lite/micro/kernels/micro_ops.h\"\n"
+          "#include \"tensorflow/lite/micro/micro_static_op_resolver.h\"\n"
+          "#include \"tensorflow/lite/schema/schema_generated.h\"\n\n");
+
+  if (!custom_ops.empty()) {
+    fprintf(out,
+            "// Custom operators have to be implemented by the application.\n"
+            "namespace tflite {\nnamespace ops {\nnamespace micro {\n");
+    for (const auto& op : custom_ops) {
+      fprintf(out, "TfLiteRegistration* %s();\n",
+              RegisterFunctionForCustomOp(op.first).c_str());
+    }
+    fprintf(out, "}  // namespace micro\n}  // namespace ops\n}  // namespace "
+                 "tflite\n\n");
+  }
+
+  fprintf(out, "namespace model_op_resolver {\n\n");
+  fprintf(out, "static_assert(tflite::BuiltinOperator_MAX == %d,\n"
+               "              \"Schema changed, regenerate this file.\");\n\n",
+          static_cast<int>(tflite::BuiltinOperator_MAX));
+  fprintf(out, "constexpr unsigned int kOpCount = %zu;\n", op_count);
+  // One registration per version, so that each reports its own version.
+  int registration_count = 0;
+  for (const auto& op : builtin_ops) {
+    registration_count += op.second.max_version - op.second.min_version + 1;
+  }
+  for (const auto& op : custom_ops) {
+    registration_count += op.second.max_version - op.second.min_version + 1;
+  }
+  fprintf(out, "constexpr unsigned int kRegistrationCount = %d;\n\n",
+          registration_count);
+
+  // Index table, one byte per builtin code.
+  std::map<tflite::BuiltinOperator, int> positions;
+  int position = 0;
+  for (const auto& op : builtin_ops) {
+    positions[op.first] = position++;
+  }
+  fprintf(out,
+          "constexpr uint8_t kNone = tflite::kMicroStaticOpNotFound;\n"
+          "constexpr uint8_t kOpIndex[tflite::BuiltinOperator_MAX + 1] = {\n");
+  // Runs of unused codes are packed eight to a line to keep this readable.
+  int unused_on_line = 0;
+  for (int code = tflite::BuiltinOperator_MIN;
+       code <= tflite::BuiltinOperator_MAX; ++code) {
+    auto it = positions.find(static_cast<tflite::BuiltinOperator>(code));
+    if (it == positions.end()) {
+      fprintf(out, "%skNone,", unused_on_line == 0 ? "    " : " ");
+      if (++unused_on_line == 8) {
+        fprintf(out, "\n");
+        unused_on_line = 0;
+      }
+      continue;
+    }
+    if (unused_on_line != 0) {
+      fprintf(out, "\n");
+      unused_on_line = 0;
+    }
+    fprintf(out, "    %d,  // %s\n", it->second,
+            tflite::EnumNameBuiltinOperator(it->first));
+  }
+  if (unused_on_line != 0) {
+    fprintf(out, "\n");
+  }
+  fprintf(out, "};\n\n");
+
+  fprintf(out, "constexpr tflite::MicroStaticOpEntry kOps[kOpCount] = {\n");
+  for (const auto& op : builtin_ops) {
+    const char* name = tflite::EnumNameBuiltinOperator(op.first);
+    fprintf(out,
+            "    {tflite::BuiltinOperator_%s, nullptr, %d, %d,\n"
+            "     tflite::ops::micro::Register_%s},\n",
+            name, op.second.min_version, op.second.max_version, name);
+  }
+  for (const auto& op : custom_ops) {
+    fprintf(out,
+            "    {tflite::BuiltinOperator_CUSTOM, \"%s\", %d, %d,\n"
+            "     tflite::ops::micro::%s},\n",
+            op.first.c_str(), op.second.min_version, op.second.max_version,
+            RegisterFunctionForCustomOp(op.first).c_str());
+  }
+  fprintf(out, "};\n\n");
+
+  fprintf(out,
+          "}  // namespace model_op_resolver\n\n"
+          "class ModelOpResolver\n"
+          "    : public tflite::MicroStaticOpResolver<\n"
+          "          model_op_resolver::kOpCount,\n"
+          "          model_op_resolver::kRegistrationCount> {\n"
+          " public:\n"
+          "  ModelOpResolver()\n"
+          "      : MicroStaticOpResolver(model_op_resolver::kOpIndex,\n"
+          "                              model_op_resolver::kOps) {}\n\n"
+          " private:\n"
+          "  TF_LITE_REMOVE_VIRTUAL_DELETE\n"
+          "};\n\n"
+          "#endif  // MODEL_OP_RESOLVER_H_\n");
+  fclose(out);
+
+  printf("Wrote %s with %zu operators.\n", argv[1], op_count);
+  return 0;
+}
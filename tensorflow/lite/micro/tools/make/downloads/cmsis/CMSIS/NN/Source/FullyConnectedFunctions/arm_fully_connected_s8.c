@@ -271,6 +271,7 @@ arm_fully_connected_s8(const int8_t *input,
                                  output_activation_min,
                                  output_activation_max);
         input += col_dim;
+        output += row_dim;
         batch_cnt--;
     }
     return (ARM_MATH_SUCCESS);
@@ -0,0 +1,884 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that rewrites a model for the micro interpreter:
+//  - RELU, RELU6 and RELU_N1_TO_1 are fused into the operator producing their
+//    input, if it has a fused activation and the quantization matches.
+//  - QUANTIZE operators that don't change the quantization and
+//    DEQUANTIZE -> QUANTIZE round trips are removed.
+//  - Unused tensors, buffers and operator codes are removed.
+//  - Names, descriptions, metadata and other fields the micro interpreter
+//    doesn't read are stripped.
+//  - Operators are reordered if another order needs a smaller arena.
+// It reports flash and arena sizes before and after, and optionally the
+// offsets the memory planner gives each activation tensor.
+//
+// Build and run on the host, from the repository root:
+//   g++ -std=c++11 -I. -Ithird_party/flatbuffers/include -o optimize_model
+//     tensorflow/lite/micro/tools/optimize_model/optimize_model.cc
+//     tensorflow/lite/micro/memory_planner/greedy_memory_planner.cc
+//     tensorflow/lite/core/api/error_reporter.cc
+//   ./optimize_model [--print_plan] model.tflite optimized.tflite
+//     [model_data.cc]
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/core/api/error_reporter.h"
+#include "tensorflow/lite/micro/compressed_weights.h"
+#include "tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+// Same as kBufferAlignment in micro_allocator.cc.
+constexpr size_t kBufferAlignment = 16;
+
+// Number of partial schedules the reordering looks at per subgraph before it
+// settles for the best order found so far.
+constexpr int kScheduleBudget = 200000;
+
+class StderrReporter : public tflite::ErrorReporter {
+ public:
+  int Report(const char* format, va_list args) override {
+    const int result = vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    return result;
+  }
+};
+
+bool ReadFile(const char* path, std::vector<char>* contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  return true;
+}
+
+size_t ElementSize(tflite::TensorType type) {
+  switch (type) {
+    case tflite::TensorType_INT8:
+    case tflite::TensorType_UINT8:
+    case tflite::TensorType_BOOL:
+      return 1;
+    case tflite::TensorType_INT16:
+    case tflite::TensorType_FLOAT16:
+      return 2;
+    case tflite::TensorType_INT32:
+    case tflite::TensorType_FLOAT32:
+      return 4;
+    case tflite::TensorType_INT64:
+    case tflite::TensorType_COMPLEX64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+// Arena bytes of a tensor, rounded up like the allocator does.
+size_t ArenaBytes(const tflite::TensorT& tensor) {
+  size_t bytes = ElementSize(tensor.type);
+  for (int32_t dim : tensor.shape) {
+    bytes *= dim;
+  }
+  return (bytes + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+}
+
+bool Contains(const std::vector<int32_t>& list, int32_t value) {
+  return std::find(list.begin(), list.end(), value) != list.end();
+}
+
+bool HasData(const tflite::ModelT& model, const tflite::TensorT& tensor) {
+  return tensor.buffer < model.buffers.size() &&
+         !model.buffers[tensor.buffer]->data.empty();
+}
+
+// Returns the index of the operator writing `tensor`, or -1.
+int Producer(const tflite::SubGraphT& subgraph, int tensor) {
+  for (size_t i = 0; i < subgraph.operators.size(); ++i) {
+    if (Contains(subgraph.operators[i]->outputs, tensor)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+std::vector<int> Consumers(const tflite::SubGraphT& subgraph, int tensor) {
+  std::vector<int> consumers;
+  for (size_t i = 0; i < subgraph.operators.size(); ++i) {
+    if (Contains(subgraph.operators[i]->inputs, tensor)) {
+      consumers.push_back(i);
+    }
+  }
+  return consumers;
+}
+
+bool SameQuantization(const tflite::TensorT& a, const tflite::TensorT& b) {
+  if (a.type != b.type) {
+    return false;
+  }
+  const bool a_quantized = a.quantization && !a.quantization->scale.empty();
+  const bool b_quantized = b.quantization && !b.quantization->scale.empty();
+  if (!a_quantized || !b_quantized) {
+    return a_quantized == b_quantized;
+  }
+  return a.quantization->scale == b.quantization->scale &&
+         a.quantization->zero_point == b.quantization->zero_point &&
+         a.quantization->quantized_dimension ==
+             b.quantization->quantized_dimension;
+}
+
+// Returns the fused activation of `op`, or nullptr if its options have none.
+tflite::ActivationFunctionType* FusedActivation(tflite::OperatorT* op) {
+  tflite::BuiltinOptionsUnion& options = op->builtin_options;
+  if (options.value == nullptr) {
+    return nullptr;
+  }
+  switch (options.type) {
+    case tflite::BuiltinOptions_Conv2DOptions:
+      return &options.AsConv2DOptions()->fused_activation_function;
+    case tflite::BuiltinOptions_DepthwiseConv2DOptions:
+      return &options.AsDepthwiseConv2DOptions()->fused_activation_function;
+    case tflite::BuiltinOptions_FullyConnectedOptions:
+      return &options.AsFullyConnectedOptions()->fused_activation_function;
+    case tflite::BuiltinOptions_AddOptions:
+      return &options.AsAddOptions()->fused_activation_function;
+    case tflite::BuiltinOptions_MulOptions:
+      return &options.AsMulOptions()->fused_activation_function;
+    case tflite::BuiltinOptions_Pool2DOptions:
+      return &options.AsPool2DOptions()->fused_activation_function;
+    default:
+      return nullptr;
+  }
+}
+
+tflite::BuiltinOperator OpCode(const tflite::ModelT& model,
+                               const tflite::OperatorT& op) {
+  return model.operator_codes[op.opcode_index]->builtin_code;
+}
+
+// Replaces every use of tensor `from` by `to`, in operator inputs and
+// outputs as well as in the subgraph outputs.
+void RenameTensor(int from, int to, tflite::SubGraphT* subgraph) {
+  for (auto& op : subgraph->operators) {
+    std::replace(op->inputs.begin(), op->inputs.end(), from, to);
+    std::replace(op->outputs.begin(), op->outputs.end(), from, to);
+  }
+  std::replace(subgraph->outputs.begin(), subgraph->outputs.end(), from, to);
+}
+
+// Removes the operators `ops`, which together turn tensor `input` into
+// `output` without changing the values, by connecting the consumers of
+// `output` to `input`. If `output` is a subgraph output, the producer of
+// `input` writes `output` instead.
+bool Bypass(const tflite::ModelT& model, std::vector<int> ops, int input,
+            int output, tflite::SubGraphT* subgraph) {
+  const bool keep_output = Contains(subgraph->outputs, output);
+  if (keep_output &&
+      (Contains(subgraph->inputs, input) ||
+       Contains(subgraph->outputs, input) ||
+       HasData(model, *subgraph->tensors[input]) ||
+       Producer(*subgraph, input) < 0)) {
+    return false;
+  }
+  std::sort(ops.rbegin(), ops.rend());
+  for (int op : ops) {
+    subgraph->operators.erase(subgraph->operators.begin() + op);
+  }
+  if (keep_output) {
+    RenameTensor(input, output, subgraph);
+  } else {
+    RenameTensor(output, input, subgraph);
+  }
+  return true;
+}
+
+// Fuses RELU, RELU6 and RELU_N1_TO_1 into the operator before them.
+int FoldActivations(const tflite::ModelT& model, tflite::SubGraphT* subgraph) {
+  int folded = 0;
+  for (size_t i = 0; i < subgraph->operators.size();) {
+    const tflite::OperatorT& op = *subgraph->operators[i];
+    tflite::ActivationFunctionType activation;
+    switch (OpCode(model, op)) {
+      case tflite::BuiltinOperator_RELU:
+        activation = tflite::ActivationFunctionType_RELU;
+        break;
+      case tflite::BuiltinOperator_RELU6:
+        activation = tflite::ActivationFunctionType_RELU6;
+        break;
+      case tflite::BuiltinOperator_RELU_N1_TO_1:
+        activation = tflite::ActivationFunctionType_RELU_N1_TO_1;
+        break;
+      default:
+        ++i;
+        continue;
+    }
+    const int input = op.inputs[0];
+    const int output = op.outputs[0];
+    const int producer = Producer(*subgraph, input);
+    tflite::ActivationFunctionType* fused =
+        producer < 0 ? nullptr
+                     : FusedActivation(subgraph->operators[producer].get());
+    // The producer's output becomes the activation's output, so it must not
+    // be read by anything else.
+    if (fused == nullptr || *fused != tflite::ActivationFunctionType_NONE ||
+        Consumers(*subgraph, input).size() != 1 ||
+        Contains(subgraph->outputs, input) ||
+        !SameQuantization(*subgraph->tensors[input],
+                          *subgraph->tensors[output])) {
+      ++i;
+      continue;
+    }
+    *fused = activation;
+    std::replace(subgraph->operators[producer]->outputs.begin(),
+                 subgraph->operators[producer]->outputs.end(), input, output);
+    subgraph->operators.erase(subgraph->operators.begin() + i);
+    ++folded;
+  }
+  return folded;
+}
+
+// Removes QUANTIZE operators that keep the quantization, and DEQUANTIZE ->
+// QUANTIZE pairs that give back the original quantization.
+int FoldQuantize(const tflite::ModelT& model, tflite::SubGraphT* subgraph) {
+  int folded = 0;
+  for (size_t i = 0; i < subgraph->operators.size();) {
+    const tflite::OperatorT& op = *subgraph->operators[i];
+    if (OpCode(model, op) != tflite::BuiltinOperator_QUANTIZE) {
+      ++i;
+      continue;
+    }
+    const int input = op.inputs[0];
+    const int output = op.outputs[0];
+    if (SameQuantization(*subgraph->tensors[input],
+                         *subgraph->tensors[output])) {
+      if (Bypass(model, {static_cast<int>(i)}, input, output, subgraph)) {
+        ++folded;
+        continue;
+      }
+      ++i;
+      continue;
+    }
+    const int producer = Producer(*subgraph, input);
+    if (producer < 0 ||
+        OpCode(model, *subgraph->operators[producer]) !=
+            tflite::BuiltinOperator_DEQUANTIZE ||
+        Consumers(*subgraph, input).size() != 1 ||
+        Contains(subgraph->outputs, input)) {
+      ++i;
+      continue;
+    }
+    const int source = subgraph->operators[producer]->inputs[0];
+    if (SameQuantization(*subgraph->tensors[source],
+                         *subgraph->tensors[output]) &&
+        Bypass(model, {producer, static_cast<int>(i)}, source, output,
+               subgraph)) {
+      folded += 2;
+      // The DEQUANTIZE may have come before the QUANTIZE.
+      i = std::min(i, static_cast<size_t>(producer));
+      continue;
+    }
+    ++i;
+  }
+  return folded;
+}
+
+// Activation tensor lifetimes, mirroring AllocationInfoBuilder in
+// micro_allocator.cc. Tensors that aren't planned get a size of 0.
+struct Lifetime {
+  size_t bytes;
+  int first_created;
+  int last_used;
+  // Tensor whose buffer the output of an in-place RELU or RELU6 takes, or -1.
+  int shared_with;
+};
+
+std::vector<Lifetime> Lifetimes(const tflite::ModelT& model,
+                                const tflite::SubGraphT& subgraph,
+                                int operator_offset) {
+  std::vector<Lifetime> lifetimes(subgraph.tensors.size(), {0, -1, -1, -1});
+  const int first_operator = operator_offset;
+  const int last_operator = operator_offset + subgraph.operators.size() - 1;
+  // Created at the last operator of the previous subgraph, so that its
+  // outputs can be copied into them.
+  const int inputs_created = first_operator > 0 ? first_operator - 1 : 0;
+  for (int32_t tensor : subgraph.inputs) {
+    lifetimes[tensor].first_created = inputs_created;
+  }
+  for (int32_t tensor : subgraph.outputs) {
+    lifetimes[tensor].last_used = last_operator;
+  }
+  for (size_t i = 0; i < subgraph.operators.size(); ++i) {
+    const int index = operator_offset + i;
+    for (int32_t tensor : subgraph.operators[i]->inputs) {
+      if (tensor >= 0) {
+        lifetimes[tensor].last_used =
+            std::max(lifetimes[tensor].last_used, index);
+      }
+    }
+    for (int32_t tensor : subgraph.operators[i]->outputs) {
+      if (lifetimes[tensor].first_created == -1) {
+        lifetimes[tensor].first_created = index;
+      }
+    }
+  }
+  for (size_t i = 0; i < subgraph.tensors.size(); ++i) {
+    const tflite::TensorT& tensor = *subgraph.tensors[i];
+    if (lifetimes[i].first_created != -1 && lifetimes[i].last_used != -1 &&
+        !HasData(model, tensor) && !tensor.is_variable) {
+      lifetimes[i].bytes = ArenaBytes(tensor);
+    }
+  }
+  // Like ShareInPlaceBuffers, RELU and RELU6 write over an input that only
+  // they read and that is no input or output of the subgraph.
+  for (const auto& op : subgraph.operators) {
+    const tflite::BuiltinOperator code = OpCode(model, *op);
+    if ((code != tflite::BuiltinOperator_RELU &&
+         code != tflite::BuiltinOperator_RELU6) ||
+        op->inputs.size() != 1 || op->outputs.size() != 1) {
+      continue;
+    }
+    const int input = op->inputs[0];
+    const int output = op->outputs[0];
+    const int buffer = lifetimes[input].shared_with >= 0
+                           ? lifetimes[input].shared_with
+                           : input;
+    if (lifetimes[buffer].bytes == 0 || lifetimes[output].bytes == 0 ||
+        ArenaBytes(*subgraph.tensors[input]) != lifetimes[output].bytes ||
+        Contains(subgraph.inputs, input) ||
+        Contains(subgraph.outputs, input) ||
+        Consumers(subgraph, input).size() != 1) {
+      continue;
+    }
+    lifetimes[buffer].last_used =
+        std::max(lifetimes[buffer].last_used, lifetimes[output].last_used);
+    lifetimes[output].bytes = 0;
+    lifetimes[output].shared_with = buffer;
+  }
+  return lifetimes;
+}
+
+// Plans the activation tensors of all subgraphs like the micro allocator,
+// without kernel scratch buffers, and returns the arena bytes needed. If
+// `offsets` is given, it receives the offset of each tensor, or -1.
+size_t PlanArena(const tflite::ModelT& model,
+                 std::vector<std::vector<int>>* offsets) {
+  StderrReporter reporter;
+  std::vector<std::vector<Lifetime>> lifetimes;
+  int operator_offset = 0;
+  size_t buffer_count = 0;
+  for (const auto& subgraph : model.subgraphs) {
+    lifetimes.push_back(Lifetimes(model, *subgraph, operator_offset));
+    operator_offset += subgraph->operators.size();
+    buffer_count += subgraph->tensors.size();
+  }
+  // Generous for the planner's per buffer bookkeeping.
+  std::vector<unsigned char> scratch(buffer_count * 64 + 64);
+  tflite::GreedyMemoryPlanner planner(scratch.data(), scratch.size());
+  for (const auto& subgraph_lifetimes : lifetimes) {
+    for (const Lifetime& lifetime : subgraph_lifetimes) {
+      if (lifetime.bytes > 0) {
+        planner.AddBuffer(&reporter, lifetime.bytes, lifetime.first_created,
+                          lifetime.last_used);
+      }
+    }
+  }
+  const size_t arena_bytes = planner.GetMaximumMemorySize();
+  if (offsets != nullptr) {
+    offsets->clear();
+    int buffer = 0;
+    for (const auto& subgraph_lifetimes : lifetimes) {
+      offsets->emplace_back(subgraph_lifetimes.size(), -1);
+      for (size_t i = 0; i < subgraph_lifetimes.size(); ++i) {
+        if (subgraph_lifetimes[i].bytes > 0) {
+          planner.GetOffsetForBuffer(&reporter, buffer++,
+                                     &offsets->back()[i]);
+        }
+      }
+      for (size_t i = 0; i < subgraph_lifetimes.size(); ++i) {
+        if (subgraph_lifetimes[i].shared_with >= 0) {
+          offsets->back()[i] =
+              offsets->back()[subgraph_lifetimes[i].shared_with];
+        }
+      }
+    }
+  }
+  return arena_bytes;
+}
+
+// Searches the topological orders of a subgraph for the one with the lowest
+// peak of live activation bytes. Depth first with branch and bound, trying
+// the operators that free the most memory first, for a bounded number of
+// steps.
+class Scheduler {
+ public:
+  Scheduler(const tflite::ModelT& model, const tflite::SubGraphT& subgraph)
+      : subgraph_(subgraph),
+        bytes_(subgraph.tensors.size(), 0),
+        uses_(subgraph.tensors.size(), 0),
+        live_(subgraph.tensors.size(), false),
+        scheduled_(subgraph.operators.size(), false) {
+    const std::vector<Lifetime> lifetimes = Lifetimes(model, subgraph, 0);
+    for (size_t i = 0; i < lifetimes.size(); ++i) {
+      // In-place outputs are counted as buffers of their own, which
+      // overestimates the peak at a RELU by that buffer.
+      bytes_[i] = lifetimes[i].shared_with >= 0
+                      ? lifetimes[lifetimes[i].shared_with].bytes
+                      : lifetimes[i].bytes;
+    }
+    producer_.assign(subgraph.tensors.size(), -1);
+    for (size_t i = 0; i < subgraph.operators.size(); ++i) {
+      for (int32_t tensor : subgraph.operators[i]->outputs) {
+        producer_[tensor] = i;
+      }
+      for (int32_t tensor : subgraph.operators[i]->inputs) {
+        if (tensor >= 0) {
+          ++uses_[tensor];
+        }
+      }
+    }
+    for (int32_t tensor : subgraph.inputs) {
+      Allocate(tensor);
+    }
+  }
+
+  // Returns the peak of the current order.
+  size_t Peak(const std::vector<int>& order) {
+    size_t peak = live_bytes_;
+    for (int op : order) {
+      peak = std::max(peak, Run(op));
+    }
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      Undo(*it);
+    }
+    return peak;
+  }
+
+  // Returns the best order found, starting from `order` as the bound.
+  std::vector<int> Search(const std::vector<int>& order) {
+    best_order_ = order;
+    best_peak_ = Peak(order);
+    steps_ = 0;
+    Visit(live_bytes_);
+    return best_order_;
+  }
+
+ private:
+  void Allocate(int tensor) {
+    if (!live_[tensor]) {
+      live_[tensor] = true;
+      live_bytes_ += bytes_[tensor];
+    }
+  }
+
+  bool Ready(int op) const {
+    if (scheduled_[op]) {
+      return false;
+    }
+    for (int32_t tensor : subgraph_.operators[op]->inputs) {
+      if (tensor >= 0 && producer_[tensor] >= 0 &&
+          !scheduled_[producer_[tensor]]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Runs `op` and returns the live bytes while it runs.
+  size_t Run(int op) {
+    const tflite::OperatorT& node = *subgraph_.operators[op];
+    scheduled_[op] = true;
+    for (int32_t tensor : node.outputs) {
+      Allocate(tensor);
+    }
+    const size_t peak = live_bytes_;
+    for (int32_t tensor : node.inputs) {
+      if (tensor >= 0 && --uses_[tensor] == 0 && live_[tensor] &&
+          !Contains(subgraph_.outputs, tensor)) {
+        live_[tensor] = false;
+        live_bytes_ -= bytes_[tensor];
+      }
+    }
+    return peak;
+  }
+
+  void Undo(int op) {
+    const tflite::OperatorT& node = *subgraph_.operators[op];
+    for (int32_t tensor : node.inputs) {
+      if (tensor >= 0 && uses_[tensor]++ == 0 &&
+          (producer_[tensor] >= 0 || Contains(subgraph_.inputs, tensor)) &&
+          !Contains(subgraph_.outputs, tensor)) {
+        live_[tensor] = true;
+        live_bytes_ += bytes_[tensor];
+      }
+    }
+    for (int32_t tensor : node.outputs) {
+      if (live_[tensor]) {
+        live_[tensor] = false;
+        live_bytes_ -= bytes_[tensor];
+      }
+    }
+    scheduled_[op] = false;
+  }
+
+  void Visit(size_t peak) {
+    if (peak >= best_peak_ || ++steps_ > kScheduleBudget) {
+      return;
+    }
+    if (order_.size() == subgraph_.operators.size()) {
+      best_peak_ = peak;
+      best_order_ = order_;
+      return;
+    }
+    std::vector<std::pair<size_t, int>> candidates;
+    for (size_t op = 0; op < subgraph_.operators.size(); ++op) {
+      if (Ready(op)) {
+        Run(op);
+        candidates.emplace_back(live_bytes_, op);
+        Undo(op);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (const auto& candidate : candidates) {
+      const int op = candidate.second;
+      order_.push_back(op);
+      const size_t step_peak = Run(op);
+      Visit(std::max(peak, step_peak));
+      Undo(op);
+      order_.pop_back();
+    }
+  }
+
+  const tflite::SubGraphT& subgraph_;
+  std::vector<size_t> bytes_;
+  std::vector<int> producer_;
+  std::vector<int> uses_;
+  std::vector<bool> live_;
+  std::vector<bool> scheduled_;
+  size_t live_bytes_ = 0;
+  std::vector<int> order_;
+  std::vector<int> best_order_;
+  size_t best_peak_ = 0;
+  int steps_ = 0;
+};
+
+// Reorders the operators of each subgraph if that lowers the planned arena.
+int Reorder(tflite::ModelT* model) {
+  int reordered = 0;
+  for (auto& subgraph : model->subgraphs) {
+    std::vector<int> order(subgraph->operators.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    const std::vector<int> best = Scheduler(*model, *subgraph).Search(order);
+    if (best == order) {
+      continue;
+    }
+    // The planner packs buffers of different sizes, so the lower peak is
+    // only kept if it also gives a smaller arena.
+    const size_t arena_bytes = PlanArena(*model, nullptr);
+    std::vector<std::unique_ptr<tflite::OperatorT>> operators;
+    for (int op : best) {
+      operators.push_back(std::move(subgraph->operators[op]));
+    }
+    operators.swap(subgraph->operators);
+    if (PlanArena(*model, nullptr) < arena_bytes) {
+      ++reordered;
+      continue;
+    }
+    for (size_t i = 0; i < best.size(); ++i) {
+      operators[best[i]] = std::move(subgraph->operators[i]);
+    }
+    operators.swap(subgraph->operators);
+  }
+  return reordered;
+}
+
+// Drops the tensors no operator or subgraph uses, then the buffers and
+// operator codes no longer referenced.
+void RemoveUnused(tflite::ModelT* model) {
+  std::vector<int> buffer_map(model->buffers.size(), -1);
+  buffer_map[0] = 0;  // The empty buffer stays first.
+  std::vector<int> code_map(model->operator_codes.size(), -1);
+  for (auto& subgraph : model->subgraphs) {
+    std::vector<int> tensor_map(subgraph->tensors.size(), -1);
+    auto use = [&tensor_map](int32_t tensor) {
+      if (tensor >= 0) {
+        tensor_map[tensor] = 0;
+      }
+    };
+    std::for_each(subgraph->inputs.begin(), subgraph->inputs.end(), use);
+    std::for_each(subgraph->outputs.begin(), subgraph->outputs.end(), use);
+    for (const auto& op : subgraph->operators) {
+      std::for_each(op->inputs.begin(), op->inputs.end(), use);
+      std::for_each(op->outputs.begin(), op->outputs.end(), use);
+      std::for_each(op->intermediates.begin(), op->intermediates.end(), use);
+      code_map[op->opcode_index] = 0;
+    }
+    std::vector<std::unique_ptr<tflite::TensorT>> tensors;
+    for (size_t i = 0; i < tensor_map.size(); ++i) {
+      if (tensor_map[i] == 0) {
+        tensor_map[i] = tensors.size();
+        buffer_map[subgraph->tensors[i]->buffer] = 0;
+        tensors.push_back(std::move(subgraph->tensors[i]));
+      }
+    }
+    subgraph->tensors.swap(tensors);
+    auto remap = [&tensor_map](int32_t& tensor) {
+      if (tensor >= 0) {
+        tensor = tensor_map[tensor];
+      }
+    };
+    std::for_each(subgraph->inputs.begin(), subgraph->inputs.end(), remap);
+    std::for_each(subgraph->outputs.begin(), subgraph->outputs.end(), remap);
+    for (auto& op : subgraph->operators) {
+      std::for_each(op->inputs.begin(), op->inputs.end(), remap);
+      std::for_each(op->outputs.begin(), op->outputs.end(), remap);
+      std::for_each(op->intermediates.begin(), op->intermediates.end(), remap);
+    }
+  }
+  for (const auto& entry : model->metadata) {
+    buffer_map[entry->buffer] = 0;
+  }
+
+  std::vector<std::unique_ptr<tflite::BufferT>> buffers;
+  for (size_t i = 0; i < buffer_map.size(); ++i) {
+    if (buffer_map[i] == 0) {
+      buffer_map[i] = buffers.size();
+      buffers.push_back(std::move(model->buffers[i]));
+    }
+  }
+  model->buffers.swap(buffers);
+  std::vector<std::unique_ptr<tflite::OperatorCodeT>> operator_codes;
+  for (size_t i = 0; i < code_map.size(); ++i) {
+    if (code_map[i] == 0) {
+      code_map[i] = operator_codes.size();
+      operator_codes.push_back(std::move(model->operator_codes[i]));
+    }
+  }
+  model->operator_codes.swap(operator_codes);
+  for (auto& subgraph : model->subgraphs) {
+    for (auto& tensor : subgraph->tensors) {
+      tensor->buffer = buffer_map[tensor->buffer];
+    }
+    for (auto& op : subgraph->operators) {
+      op->opcode_index = code_map[op->opcode_index];
+    }
+  }
+  for (auto& entry : model->metadata) {
+    entry->buffer = buffer_map[entry->buffer];
+  }
+}
+
+// Clears what the micro interpreter doesn't read.
+void StripStrings(tflite::ModelT* model) {
+  model->description.clear();
+  model->metadata_buffer.clear();
+  model->metadata.clear();
+  for (auto& subgraph : model->subgraphs) {
+    subgraph->name.clear();
+    for (auto& tensor : subgraph->tensors) {
+      tensor->name.clear();
+      tensor->shape_signature.clear();
+      if (tensor->quantization) {
+        tensor->quantization->min.clear();
+        tensor->quantization->max.clear();
+      }
+    }
+  }
+}
+
+// Same as Pack(), but keeps buffers 16 byte aligned like the converter does,
+// since kernels read them in place.
+void Serialize(const tflite::ModelT& model,
+               flatbuffers::FlatBufferBuilder* fbb) {
+  std::vector<flatbuffers::Offset<tflite::Buffer>> buffers;
+  for (const auto& buffer : model.buffers) {
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> data = 0;
+    if (!buffer->data.empty()) {
+      fbb->ForceVectorAlignment(buffer->data.size(), 1, 16);
+      data = fbb->CreateVector(buffer->data);
+    }
+    buffers.push_back(tflite::CreateBuffer(*fbb, data));
+  }
+  std::vector<flatbuffers::Offset<tflite::OperatorCode>> operator_codes;
+  for (const auto& code : model.operator_codes) {
+    operator_codes.push_back(tflite::CreateOperatorCode(*fbb, code.get()));
+  }
+  std::vector<flatbuffers::Offset<tflite::SubGraph>> subgraphs;
+  for (const auto& subgraph : model.subgraphs) {
+    subgraphs.push_back(tflite::CreateSubGraph(*fbb, subgraph.get()));
+  }
+  std::vector<flatbuffers::Offset<tflite::Metadata>> metadata;
+  for (const auto& entry : model.metadata) {
+    metadata.push_back(tflite::CreateMetadata(*fbb, entry.get()));
+  }
+  auto root = tflite::CreateModel(
+      *fbb, model.version, fbb->CreateVector(operator_codes),
+      fbb->CreateVector(subgraphs),
+      model.description.empty() ? 0 : fbb->CreateString(model.description),
+      fbb->CreateVector(buffers),
+      model.metadata_buffer.empty() ? 0
+                                    : fbb->CreateVector(model.metadata_buffer),
+      metadata.empty() ? 0 : fbb->CreateVector(metadata));
+  tflite::FinishModelBuffer(*fbb, root);
+}
+
+// Writes the model as a C array in the layout of src/model_data.cc.
+bool WriteArray(const char* path, const char* input, const char* output,
+                const uint8_t* data, size_t size) {
+  FILE* out = fopen(path, "w");
+  if (out == nullptr) {
+    return false;
+  }
+  fprintf(out,
+          "// Automatically created from a TensorFlow Lite flatbuffer using "
+          "the command:\n"
+          "// optimize_model %s %s %s\n\n"
+          "#include \"model_data.h\"\n\n"
+          "// We need to keep the data array aligned on some architectures.\n"
+          "#ifdef __has_attribute\n"
+          "#define HAVE_ATTRIBUTE(x) __has_attribute(x)\n"
+          "#else\n"
+          "#define HAVE_ATTRIBUTE(x) 0\n"
+          "#endif\n"
+          "#if HAVE_ATTRIBUTE(aligned) || (defined(__GNUC__) && "
+          "!defined(__clang__))\n"
+          "#define DATA_ALIGN_ATTRIBUTE __attribute__((aligned(16)))\n"
+          "#else\n"
+          "#define DATA_ALIGN_ATTRIBUTE\n"
+          "#endif\n\n"
+          "const unsigned char g_model_data[] DATA_ALIGN_ATTRIBUTE =  {",
+          input, output, path);
+  for (size_t i = 0; i < size; ++i) {
+    fprintf(out, "%s0x%02x", i == 0 ? "\n  " : i % 12 == 0 ? ",\n  " : ", ",
+            data[i]);
+  }
+  fprintf(out, "\n};\nconst int g_model_data_len = %zu;\n", size);
+  return fclose(out) == 0;
+}
+
+void PrintPlan(const tflite::ModelT& model) {
+  std::vector<std::vector<int>> offsets;
+  PlanArena(model, &offsets);
+  printf("Arena plan (subgraph, tensor, offset, bytes, operators):\n");
+  int operator_offset = 0;
+  for (size_t s = 0; s < model.subgraphs.size(); ++s) {
+    const std::vector<Lifetime> lifetimes =
+        Lifetimes(model, *model.subgraphs[s], operator_offset);
+    operator_offset += model.subgraphs[s]->operators.size();
+    for (size_t t = 0; t < lifetimes.size(); ++t) {
+      if (lifetimes[t].bytes > 0) {
+        printf("  %zu %zu %d %zu %d-%d\n", s, t, offsets[s][t],
+               lifetimes[t].bytes, lifetimes[t].first_created,
+               lifetimes[t].last_used);
+      } else if (lifetimes[t].shared_with >= 0) {
+        printf("  %zu %zu %d in place of tensor %d\n", s, t, offsets[s][t],
+               lifetimes[t].shared_with);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool print_plan = false;
+  if (argc > 1 && strcmp(argv[1], "--print_plan") == 0) {
+    print_plan = true;
+    --argc;
+    ++argv;
+  }
+  if (argc != 3 && argc != 4) {
+    fprintf(stderr,
+            "Usage: optimize_model [--print_plan] <model.tflite> "
+            "<optimized.tflite> [model_data.cc]\n");
+    return 1;
+  }
+  std::vector<char> input;
+  if (!ReadFile(argv[1], &input)) {
+    fprintf(stderr, "Failed to read %s\n", argv[1]);
+    return 1;
+  }
+  flatbuffers::Verifier verifier(
+      reinterpret_cast<const uint8_t*>(input.data()), input.size());
+  if (!tflite::VerifyModelBuffer(verifier)) {
+    fprintf(stderr, "%s is not a valid TensorFlow Lite model\n", argv[1]);
+    return 1;
+  }
+  std::unique_ptr<tflite::ModelT> model =
+      tflite::UnPackModel(input.data());
+  // The compressed weights tables refer to tensors by index.
+  for (const auto& entry : model->metadata) {
+    if (entry->name == tflite::kCompressedWeightsMetadata ||
+        entry->name == tflite::kInt4WeightsMetadata) {
+      fprintf(stderr,
+              "%s has compressed weights, optimize it before compressing\n",
+              argv[1]);
+      return 1;
+    }
+  }
+
+  const size_t arena_bytes = PlanArena(*model, nullptr);
+  int activations = 0;
+  int quantizations = 0;
+  for (auto& subgraph : model->subgraphs) {
+    activations += FoldActivations(*model, subgraph.get());
+    quantizations += FoldQuantize(*model, subgraph.get());
+  }
+  const size_t operator_codes = model->operator_codes.size();
+  RemoveUnused(model.get());
+  StripStrings(model.get());
+  const int reordered = Reorder(model.get());
+
+  flatbuffers::FlatBufferBuilder fbb;
+  Serialize(*model, &fbb);
+  FILE* out = fopen(argv[2], "wb");
+  if (out == nullptr ||
+      fwrite(fbb.GetBufferPointer(), 1, fbb.GetSize(), out) != fbb.GetSize()) {
+    fprintf(stderr, "Failed to write %s\n", argv[2]);
+    return 1;
+  }
+  fclose(out);
+  if (argc == 4 &&
+      !WriteArray(argv[3], argv[1], argv[2], fbb.GetBufferPointer(),
+                  fbb.GetSize())) {
+    fprintf(stderr, "Failed to write %s\n", argv[3]);
+    return 1;
+  }
+
+  printf("Fused %d activations, removed %d quantizations and %zu operator "
+         "codes, reordered %d subgraphs.\n",
+         activations, quantizations,
+         operator_codes - model->operator_codes.size(), reordered);
+  printf("Flash: %zu -> %zu bytes.\n", input.size(),
+         static_cast<size_t>(fbb.GetSize()));
+  printf("Arena for activations: %zu -> %zu bytes, without kernel scratch "
+         "buffers.\n",
+         arena_bytes, PlanArena(*model, nullptr));
+  if (print_plan) {
+    PrintPlan(*model);
+  }
+  return 0;
+}